@@ -0,0 +1,291 @@
+#include "abl.h"
+#include "FvhParser.h"
+#include "HashSegment.h"
+#include "Trace.h"
+
+#include <cerrno>
+#include <cstddef>
+#include <new>
+#include <cstring>
+#include <memory>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+struct abl_image {
+    QByteArray        data;          // borrowed, mapped or owned bytes
+    QVector<FvhBlock> blocks;
+    void             *map     = nullptr;
+    size_t            mapSize = 0;
+};
+
+// abl_block_info as first published; callers built against it stay valid
+static constexpr size_t ABL_BLOCK_INFO_V1_SIZE = offsetof(abl_block_info, segment);
+
+static thread_local char t_lastError[512];
+
+static int fail(int status, const QString &msg) {
+    QByteArray utf8 = msg.toUtf8();
+    qstrncpy(t_lastError, utf8.constData(), sizeof(t_lastError));
+    return status;
+}
+
+// Repack output must not alias the image: the original bytes are needed for
+// the hash segment's old digests and for rolling back, and borrowed or
+// mapped images may be read-only or belong to the caller
+static bool overlapsImage(const abl_image *image, const void *out, size_t capacity) {
+    const char *begin = image->data.constData();
+    const char *end   = begin + image->data.size();
+    const char *o     = static_cast<const char*>(out);
+    return o < end && begin < o + capacity;
+}
+
+// Closes a half-opened image (and unmaps it) on every early return or throw
+using ImageHolder = std::unique_ptr<abl_image, decltype(&abl_close)>;
+
+static int scanImage(ImageHolder &img, abl_image **out) {
+    FvhParser parser(img->data);
+    img->blocks = parser.findBlocks();
+    if (img->blocks.isEmpty())
+        return fail(ABL_E_NO_BLOCKS, "No _FVH blocks found in image");
+    *out = img.release();
+    return ABL_OK;
+}
+
+extern "C" {
+
+uint32_t abl_api_version(void) {
+    return ABL_API_VERSION;
+}
+
+const char *abl_status_string(int status) {
+    switch (status) {
+    case ABL_OK:          return "ok";
+    case ABL_E_INVALID:   return "invalid argument";
+    case ABL_E_IO:        return "I/O error";
+    case ABL_E_NOMEM:     return "out of memory";
+    case ABL_E_NO_BLOCKS: return "no _FVH blocks found";
+    case ABL_E_DECODE:    return "decode failed";
+    case ABL_E_ENCODE:    return "encode failed";
+    case ABL_E_BUFFER:    return "buffer too small";
+    }
+    return "unknown status";
+}
+
+const char *abl_last_error(void) {
+    return t_lastError;
+}
+
+int abl_open_buffer(const void *data, size_t size, uint32_t flags, abl_image **out) {
+    if (!out || (!data && size)) return fail(ABL_E_INVALID, "null argument");
+    *out = nullptr;
+    try {
+        ImageHolder img(new abl_image, &abl_close);
+        const char *bytes = static_cast<const char*>(data);
+        img->data = (flags & ABL_OPEN_COPY)
+            ? QByteArray(bytes, (qsizetype)size)
+            : QByteArray::fromRawData(bytes, (qsizetype)size);
+        return scanImage(img, out);
+    } catch (const std::bad_alloc &) {
+        return fail(ABL_E_NOMEM, "out of memory");
+    }
+}
+
+int abl_open_fd(int fd, abl_image **out) {
+    if (!out || fd < 0) return fail(ABL_E_INVALID, "bad fd");
+    *out = nullptr;
+
+    struct stat st;
+    if (fstat(fd, &st) != 0)
+        return fail(ABL_E_IO, QString("fstat failed: %1").arg(strerror(errno)));
+
+    try {
+        ImageHolder img(new abl_image, &abl_close);
+        if (S_ISREG(st.st_mode) && st.st_size > 0) {
+            void *p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                img->map     = p;
+                img->mapSize = (size_t)st.st_size;
+                img->data    = QByteArray::fromRawData(static_cast<const char*>(p),
+                                                       (qsizetype)st.st_size);
+                return scanImage(img, out);
+            }
+        }
+
+        // Pipes, sockets and files that refuse mmap: read everything
+        char chunk[65536];
+        while (true) {
+            ssize_t n = read(fd, chunk, sizeof(chunk));
+            if (n == 0) break;
+            if (n < 0) {
+                if (errno == EINTR) continue;
+                int err = errno;
+                return fail(ABL_E_IO, QString("read failed: %1").arg(strerror(err)));
+            }
+            img->data.append(chunk, n);
+        }
+        return scanImage(img, out);
+    } catch (const std::bad_alloc &) {
+        return fail(ABL_E_NOMEM, "out of memory");
+    }
+}
+
+void abl_close(abl_image *image) {
+    if (!image) return;
+    image->blocks.clear();
+    image->data.clear();
+    if (image->map) munmap(image->map, image->mapSize);
+    delete image;
+}
+
+size_t abl_image_size(const abl_image *image) {
+    return image ? (size_t)image->data.size() : 0;
+}
+
+size_t abl_block_count(const abl_image *image) {
+    return image ? (size_t)image->blocks.size() : 0;
+}
+
+int abl_block_info_get(const abl_image *image, size_t index, abl_block_info *out) {
+    if (!image || !out || index >= (size_t)image->blocks.size())
+        return fail(ABL_E_INVALID, "bad image or block index");
+    if (out->struct_size < ABL_BLOCK_INFO_V1_SIZE)
+        return fail(ABL_E_INVALID, "abl_block_info.struct_size is too small");
+
+    const FvhBlock &b = image->blocks[(qsizetype)index];
+    qint64 decoded = FvhParser::decodedSize(b);
+    out->has_lzma     = b.hasLzma ? 1 : 0;
+    out->fvh_offset   = (uint64_t)b.fvhOffset;
+    out->fv_start     = (uint64_t)b.fvStart;
+    out->fv_size      = b.fvSize;
+    out->lzma_offset  = b.lzmaOffset;
+    out->lzma_size    = (uint64_t)b.lzmaSize;
+    out->decoded_size = decoded >= 0 ? (uint64_t)decoded : ABL_SIZE_UNKNOWN;
+    if (out->struct_size >= sizeof(abl_block_info)) {
+        out->segment        = b.segment;
+        out->segment_offset = (uint64_t)b.segOffset;
+        out->segment_size   = (uint64_t)b.segFileSize;
+    }
+    return ABL_OK;
+}
+
+int abl_decode(const abl_image *image, size_t index,
+               void *out, size_t capacity, size_t *written)
+{
+    if (!image || !out || index >= (size_t)image->blocks.size())
+        return fail(ABL_E_INVALID, "bad image, buffer or block index");
+    try {
+        const FvhBlock &b = image->blocks[(qsizetype)index];
+        qint64 declared = FvhParser::decodedSize(b);
+        if (declared >= 0 && (size_t)declared > capacity)
+            return fail(ABL_E_BUFFER, QString("need %1 bytes, buffer holds %2")
+                                      .arg(declared).arg((quint64)capacity));
+
+        QString err;
+        qint64 n = FvhParser::decompressInto(b, static_cast<char*>(out),
+                                             (qint64)capacity, err);
+        if (n < 0)
+            return fail(err.startsWith("Output buffer") ? ABL_E_BUFFER : ABL_E_DECODE, err);
+        if (written) *written = (size_t)n;
+        return ABL_OK;
+    } catch (const std::bad_alloc &) {
+        return fail(ABL_E_NOMEM, "out of memory");
+    }
+}
+
+int abl_repack(const abl_image *image, size_t index,
+               const void *patched, size_t patched_size,
+               void *out, size_t capacity, size_t *written)
+{
+    if (!image || !out || (!patched && patched_size) || index >= (size_t)image->blocks.size())
+        return fail(ABL_E_INVALID, "bad image, buffer or block index");
+    const size_t imageSize = (size_t)image->data.size();
+    if (capacity < imageSize)
+        return fail(ABL_E_BUFFER, QString("need %1 bytes, buffer holds %2")
+                                  .arg((quint64)imageSize).arg((quint64)capacity));
+    if (overlapsImage(image, out, capacity))
+        return fail(ABL_E_INVALID, "output buffer overlaps the image");
+    try {
+        char *dst = static_cast<char*>(out);
+        std::memcpy(dst, image->data.constData(), imageSize);
+
+        QString err;
+        if (FvhParser::repackInto(dst, (qint64)imageSize, image->blocks[(qsizetype)index],
+                                  static_cast<const char*>(patched),
+                                  (qint64)patched_size, err) < 0)
+            return fail(ABL_E_ENCODE, err);
+        const FvhBlock &b = image->blocks[(qsizetype)index];
+        QVector<int> stale;
+        HashSegment::refresh(image->data, dst, (qint64)imageSize,
+                             b.fvStart + b.lzmaOffset, b.lzmaSize, stale);
+        if (written) *written = imageSize;
+        return ABL_OK;
+    } catch (const std::bad_alloc &) {
+        return fail(ABL_E_NOMEM, "out of memory");
+    }
+}
+
+int abl_repack_batch(const abl_image *image,
+                     const abl_repack_edit *edits, size_t count,
+                     void *out, size_t capacity, size_t *written)
+{
+    if (!image || !out || (!edits && count))
+        return fail(ABL_E_INVALID, "bad image, buffer or edit list");
+    const size_t imageSize = (size_t)image->data.size();
+    if (capacity < imageSize)
+        return fail(ABL_E_BUFFER, QString("need %1 bytes, buffer holds %2")
+                                  .arg((quint64)imageSize).arg((quint64)capacity));
+    if (overlapsImage(image, out, capacity))
+        return fail(ABL_E_INVALID, "output buffer overlaps the image");
+    try {
+        QVector<FvhParser::RepackEdit> batch((qsizetype)count);
+        for (size_t i = 0; i < count; ++i) {
+            const abl_repack_edit &e = edits[i];
+            if ((!e.patched && e.patched_size) || e.index >= (size_t)image->blocks.size())
+                return fail(ABL_E_INVALID, QString("edit %1: bad block index or payload").arg((quint64)i));
+            batch[(qsizetype)i].block   = image->blocks[(qsizetype)e.index];
+            batch[(qsizetype)i].patched = QByteArray::fromRawData(
+                static_cast<const char*>(e.patched), (qsizetype)e.patched_size);
+        }
+
+        char *dst = static_cast<char*>(out);
+        std::memcpy(dst, image->data.constData(), imageSize);
+
+        QString err;
+        if (!FvhParser::repackBatchInto(image->data, dst, (qint64)imageSize, batch, err))
+            return fail(count ? ABL_E_ENCODE : ABL_E_INVALID, err);
+        if (written) *written = imageSize;
+        return ABL_OK;
+    } catch (const std::bad_alloc &) {
+        return fail(ABL_E_NOMEM, "out of memory");
+    }
+}
+
+void abl_set_xz_decode_options(uint32_t threads, uint64_t memlimit) {
+    XzDecodeOptions o;
+    o.threads  = threads;
+    o.memlimit = memlimit;
+    FvhParser::setXzDecodeOptions(o);
+}
+
+void abl_set_verify_repack(int on) {
+    FvhParser::setVerifyRepack(on != 0);
+}
+
+int abl_trace_export_chrome(const char *path) {
+    if (!path) return fail(ABL_E_INVALID, "null path");
+    QString err;
+    if (!Trace::exportChromeJson(QString::fromUtf8(path), err))
+        return fail(ABL_E_IO, err);
+    return ABL_OK;
+}
+
+int abl_metrics_export_prometheus(const char *path) {
+    if (!path) return fail(ABL_E_INVALID, "null path");
+    QString err;
+    if (!Trace::exportPrometheus(QString::fromUtf8(path), err))
+        return fail(ABL_E_IO, err);
+    return ABL_OK;
+}
+
+} // extern "C"
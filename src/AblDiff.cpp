@@ -0,0 +1,389 @@
+#include "AblDiff.h"
+#include "Trace.h"
+
+#include <QtConcurrent>
+#include <algorithm>
+#include <cstring>
+#include <unordered_map>
+
+static constexpr qint64  WINDOW          = 32;         // rolling-hash window (bytes)
+static constexpr quint64 ANCHOR_BITS     = 8;          // ~1 anchor per 256 bytes
+static constexpr qint64  SEGMENT_SIZE    = 4 * 1024 * 1024;
+static constexpr qint64  MIN_JUMP_MATCH  = 128;        // shortest match allowed to change alignment
+static constexpr qint64  MERGE_EQUAL_GAP = 8;          // equal bytes tolerated inside one change
+static constexpr int     SKETCH_SIZE     = 256;        // anchors kept per payload for block pairing
+static constexpr double  MIN_PAIR_SHARE  = 0.05;       // less in common than this: not the same block
+
+static constexpr quint64 HASH_MUL = 0x100000001B3ULL;
+
+struct Match {
+    qint64 aStart;
+    qint64 bStart;
+    qint64 len;
+};
+
+// Per-byte random substitution keeps the rolling hash from degenerating on
+// low-entropy data such as small integers and ASCII.
+static const quint64 *byteTable() {
+    static quint64 table[256];
+    static bool init = [] {
+        quint64 x = 0x9E3779B97F4A7C15ULL;
+        for (quint64 &v : table) {
+            x ^= x >> 12; x ^= x << 25; x ^= x >> 27;
+            v = x * 0x2545F4914F6CDD1DULL;
+        }
+        return true;
+    }();
+    Q_UNUSED(init);
+    return table;
+}
+
+static quint64 hashPowW() {
+    static const quint64 p = [] {
+        quint64 r = 1;
+        for (qint64 i = 0; i < WINDOW; ++i) r *= HASH_MUL;
+        return r;
+    }();
+    return p;
+}
+
+static inline quint64 windowHash(const quint8 *p) {
+    const quint64 *t = byteTable();
+    quint64 h = 0;
+    for (qint64 i = 0; i < WINDOW; ++i) h = h * HASH_MUL + t[p[i]];
+    return h;
+}
+
+static inline quint64 rollHash(quint64 h, quint8 out, quint8 in) {
+    const quint64 *t = byteTable();
+    return h * HASH_MUL - t[out] * hashPowW() + t[in];
+}
+
+static inline bool isAnchor(quint64 h) {
+    return ((h * 0x9E3779B97F4A7C15ULL) >> (64 - ANCHOR_BITS)) == 0;
+}
+
+static qint64 commonForward(const quint8 *a, const quint8 *b, qint64 max) {
+    qint64 n = 0;
+    while (n + 8 <= max) {
+        quint64 x, y;
+        std::memcpy(&x, a + n, 8);
+        std::memcpy(&y, b + n, 8);
+        if (x != y) break;
+        n += 8;
+    }
+    while (n < max && a[n] == b[n]) ++n;
+    return n;
+}
+
+static qint64 commonBackward(const quint8 *aEnd, const quint8 *bEnd, qint64 max) {
+    qint64 n = 0;
+    while (n < max && aEnd[-1 - n] == bEnd[-1 - n]) ++n;
+    return n;
+}
+
+// Split [begin, end) into segments for parallel processing
+static QVector<QPair<qint64, qint64>> segments(qint64 begin, qint64 end) {
+    QVector<QPair<qint64, qint64>> segs;
+    for (qint64 s = begin; s < end; s += SEGMENT_SIZE)
+        segs.append({ s, qMin(end, s + SEGMENT_SIZE) });
+    return segs;
+}
+
+QVector<DiffRange> AblDiff::diff(const QByteArray &aBytes, const QByteArray &bBytes) {
+    ABL_TRACE_SPAN("diff");
+    const auto *a = reinterpret_cast<const quint8*>(aBytes.constData());
+    const auto *b = reinterpret_cast<const quint8*>(bBytes.constData());
+    const qint64 aSize = aBytes.size();
+    const qint64 bSize = bBytes.size();
+
+    // 1. Common prefix / suffix: the usual case for small patches
+    const qint64 prefix = commonForward(a, b, qMin(aSize, bSize));
+    if (prefix == aSize && prefix == bSize) return {};
+    const qint64 suffix = commonBackward(a + aSize, b + bSize,
+                                         qMin(aSize, bSize) - prefix);
+    const qint64 aEnd = aSize - suffix;
+    const qint64 bEnd = bSize - suffix;
+
+    // 2. Index content-defined anchors of B's middle section in parallel
+    std::unordered_map<quint64, qint64> index;
+    if (bEnd - prefix >= WINDOW) {
+        auto segs = segments(prefix, bEnd - WINDOW + 1);
+        auto perSeg = QtConcurrent::blockingMapped<QVector<QVector<QPair<quint64, qint64>>>>(
+            segs, [b](const QPair<qint64, qint64> &seg) {
+                QVector<QPair<quint64, qint64>> anchors;
+                quint64 h = windowHash(b + seg.first);
+                quint64 lastAnchor = 0;
+                bool haveLast = false;
+                for (qint64 p = seg.first; p < seg.second; ++p) {
+                    if (p > seg.first) h = rollHash(h, b[p - 1], b[p + WINDOW - 1]);
+                    // Runs of identical windows (padding) only need their first anchor
+                    if (isAnchor(h) && !(haveLast && h == lastAnchor)) {
+                        anchors.append({ h, p });
+                        lastAnchor = h;
+                        haveLast = true;
+                    }
+                }
+                return anchors;
+            });
+        size_t total = 0;
+        for (const auto &v : perSeg) total += v.size();
+        index.reserve(total);
+        for (const auto &v : perSeg)
+            for (const auto &e : v) index.emplace(e.first, e.second);   // first occurrence wins
+    }
+
+    // 3. Scan A's middle section for anchors, verify and extend matches
+    QVector<Match> matches;
+    if (aEnd - prefix >= WINDOW && !index.empty()) {
+        auto segs = segments(prefix, aEnd - WINDOW + 1);
+        auto perSeg = QtConcurrent::blockingMapped<QVector<QVector<Match>>>(
+            segs, [&, a, b](const QPair<qint64, qint64> &seg) {
+                QVector<Match> found;
+                qint64 delta = 0;          // b - a of the last match in this segment
+                bool haveDelta = false;
+                qint64 p = seg.first;
+                quint64 h = windowHash(a + p);
+                while (p < seg.second) {
+                    if (isAnchor(h)) {
+                        qint64 bPos = -1;
+                        // Prefer the alignment we're already following; this keeps
+                        // repeated content (tables, padding) matched in place.
+                        qint64 expect = p + delta;
+                        if (haveDelta && expect >= prefix && expect + WINDOW <= bEnd
+                            && std::memcmp(a + p, b + expect, WINDOW) == 0) {
+                            bPos = expect;
+                        } else {
+                            auto it = index.find(h);
+                            if (it != index.end() && it->second + WINDOW <= bEnd
+                                && std::memcmp(a + p, b + it->second, WINDOW) == 0)
+                                bPos = it->second;
+                        }
+                        if (bPos >= 0) {
+                            qint64 back = commonBackward(a + p, b + bPos,
+                                                         qMin(p - seg.first, bPos - prefix));
+                            qint64 fwdMax = qMin(seg.second + WINDOW - 1 - p, bEnd - bPos);
+                            qint64 fwd = WINDOW + commonForward(a + p + WINDOW, b + bPos + WINDOW,
+                                                                qMax<qint64>(0, fwdMax - WINDOW));
+                            found.append({ p - back, bPos - back, back + fwd });
+                            delta = bPos - p;
+                            haveDelta = true;
+                            p += fwd;
+                            if (p >= seg.second) break;
+                            h = windowHash(a + p);
+                            continue;
+                        }
+                    }
+                    ++p;
+                    if (p < seg.second) h = rollHash(h, a[p - 1], a[p + WINDOW - 1]);
+                }
+                return found;
+            });
+        for (const auto &v : perSeg) matches += v;
+    }
+
+    // 4. Keep a monotonic chain of matches, trimming overlaps and coalescing
+    //    contiguous pieces; the prefix and suffix act as fixed endpoints
+    QVector<Match> chain;
+    chain.append({ 0, 0, prefix });
+    qint64 curDelta = 0;
+    for (Match m : matches) {
+        Match &last = chain.last();
+        qint64 lastA = last.aStart + last.len;
+        qint64 lastB = last.bStart + last.len;
+        qint64 overlap = qMax(lastA - m.aStart, lastB - m.bStart);
+        if (overlap > 0) {
+            m.aStart += overlap;
+            m.bStart += overlap;
+            m.len    -= overlap;
+        }
+        if (m.len <= 0) continue;
+        qint64 d = m.bStart - m.aStart;
+        if (d != curDelta && m.len < MIN_JUMP_MATCH) continue;
+        if (m.aStart == lastA && m.bStart == lastB) {
+            last.len += m.len;
+        } else {
+            chain.append(m);
+            curDelta = d;
+        }
+    }
+    chain.append({ aEnd, bEnd, suffix });
+
+    // 5. Gaps between chained matches are the changes; same-length gaps are
+    //    narrowed to the bytes that actually differ
+    QVector<DiffRange> out;
+    for (int i = 1; i < chain.size(); ++i) {
+        const Match &prev = chain[i - 1];
+        const Match &cur  = chain[i];
+        qint64 gA = prev.aStart + prev.len, gAL = cur.aStart - gA;
+        qint64 gB = prev.bStart + prev.len, gBL = cur.bStart - gB;
+        if (gAL <= 0 && gBL <= 0) continue;
+        if (gAL != gBL) {
+            out.append({ gA, qMax<qint64>(0, gAL), gB, qMax<qint64>(0, gBL) });
+            continue;
+        }
+        qint64 runStart = -1, lastDiff = -1;
+        for (qint64 k = 0; k < gAL; ++k) {
+            if (a[gA + k] == b[gB + k]) continue;
+            if (runStart >= 0 && k - lastDiff > MERGE_EQUAL_GAP) {
+                out.append({ gA + runStart, lastDiff - runStart + 1,
+                             gB + runStart, lastDiff - runStart + 1 });
+                runStart = -1;
+            }
+            if (runStart < 0) runStart = k;
+            lastDiff = k;
+        }
+        if (runStart >= 0)
+            out.append({ gA + runStart, lastDiff - runStart + 1,
+                         gB + runStart, lastDiff - runStart + 1 });
+    }
+    ABL_TRACE_COUNT("abl_diff_bytes_total", "Payload bytes compared by the diff engine.", aSize + bSize);
+    return out;
+}
+
+qint64 AblDiff::mapAtoB(const QVector<DiffRange> &changes, qint64 aOff) {
+    // Last change starting at or before aOff
+    auto it = std::upper_bound(changes.begin(), changes.end(), aOff,
+        [](qint64 off, const DiffRange &r) { return off < r.aStart; });
+    if (it == changes.begin()) return aOff;
+    const DiffRange &r = *(it - 1);
+    if (aOff < r.aStart + r.aLen)
+        return r.bStart + qMin(aOff - r.aStart, qMax<qint64>(0, r.bLen - 1));
+    return aOff - (r.aStart + r.aLen) + (r.bStart + r.bLen);
+}
+
+qint64 AblDiff::mapBtoA(const QVector<DiffRange> &changes, qint64 bOff) {
+    auto it = std::upper_bound(changes.begin(), changes.end(), bOff,
+        [](qint64 off, const DiffRange &r) { return off < r.bStart; });
+    if (it == changes.begin()) return bOff;
+    const DiffRange &r = *(it - 1);
+    if (bOff < r.bStart + r.bLen)
+        return r.aStart + qMin(bOff - r.bStart, qMax<qint64>(0, r.aLen - 1));
+    return bOff - (r.bStart + r.bLen) + (r.aStart + r.aLen);
+}
+
+// ── Block pairing ─────────────────────────────────────────────────
+
+// The SKETCH_SIZE smallest distinct anchor hashes of a payload (bottom-k
+// MinHash). Payloads shorter than one window get a hash of all their bytes.
+static QVector<quint64> sketch(const QByteArray &bytes) {
+    const auto *p = reinterpret_cast<const quint8*>(bytes.constData());
+    const qint64 size = bytes.size();
+    QVector<quint64> hashes;
+    if (size < WINDOW) {
+        if (size > 0) hashes.append(quint64(qHashBits(p, size_t(size))) * 0x9E3779B97F4A7C15ULL);
+        return hashes;
+    }
+    quint64 h = windowHash(p);
+    for (qint64 i = 0; i + WINDOW <= size; ++i) {
+        if (i > 0) h = rollHash(h, p[i - 1], p[i + WINDOW - 1]);
+        if (isAnchor(h)) hashes.append(h * 0x9E3779B97F4A7C15ULL);
+    }
+    std::sort(hashes.begin(), hashes.end());
+    hashes.erase(std::unique(hashes.begin(), hashes.end()), hashes.end());
+    if (hashes.size() > SKETCH_SIZE) hashes.resize(SKETCH_SIZE);
+    return hashes;
+}
+
+// Estimated share of anchors two payloads have in common (0..1)
+static double similarity(const QVector<quint64> &x, const QVector<quint64> &y) {
+    if (x.isEmpty() || y.isEmpty()) return 0;
+    int i = 0, j = 0, seen = 0, shared = 0;
+    while (seen < SKETCH_SIZE && i < x.size() && j < y.size()) {
+        if (x[i] == y[j]) { ++shared; ++i; ++j; }
+        else if (x[i] < y[j]) ++i;
+        else ++j;
+        ++seen;
+    }
+    return double(shared) / seen;
+}
+
+// Order-preserving alignment of A's blocks with B's that maximises the total
+// similarity of the pairs. Returns (indexA, indexB) in image order, -1 on the
+// side of a block that has no partner.
+static QVector<QPair<int, int>> pairBlocks(const QVector<QVector<quint64>> &sketchA,
+                                           const QVector<QVector<quint64>> &sketchB) {
+    const int n = sketchA.size();
+    const int m = sketchB.size();
+    QVector<QVector<double>> sim(n, QVector<double>(m));
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < m; ++j)
+            sim[i][j] = similarity(sketchA[i], sketchB[j]);
+
+    // Any acceptable pair beats leaving both blocks unpaired
+    auto pairScore = [&](int i, int j) { return sim[i][j] + 1.0; };
+    QVector<QVector<double>> best(n + 1, QVector<double>(m + 1, 0));
+    for (int i = 1; i <= n; ++i)
+        for (int j = 1; j <= m; ++j) {
+            best[i][j] = qMax(best[i - 1][j], best[i][j - 1]);
+            if (sim[i - 1][j - 1] >= MIN_PAIR_SHARE)
+                best[i][j] = qMax(best[i][j], best[i - 1][j - 1] + pairScore(i - 1, j - 1));
+        }
+
+    QVector<QPair<int, int>> pairs;
+    int i = n, j = m;
+    while (i > 0 || j > 0) {
+        if (i > 0 && j > 0 && sim[i - 1][j - 1] >= MIN_PAIR_SHARE
+            && best[i][j] == best[i - 1][j - 1] + pairScore(i - 1, j - 1)) {
+            pairs.append({ --i, --j });
+        } else if (j > 0 && (i == 0 || best[i][j] == best[i][j - 1])) {
+            pairs.append({ -1, --j });
+        } else {
+            pairs.append({ --i, -1 });
+        }
+    }
+    std::reverse(pairs.begin(), pairs.end());
+    return pairs;
+}
+
+QVector<BlockDiff> AblDiff::diffImages(const QByteArray &imageA,
+                                       const QByteArray &imageB,
+                                       QString &errorOut)
+{
+    QVector<FvhBlock> blocksA = FvhParser(imageA).findBlocks();
+    QVector<FvhBlock> blocksB = FvhParser(imageB).findBlocks();
+    if (blocksA.isEmpty() || blocksB.isEmpty()) {
+        errorOut = blocksA.isEmpty() ? "No _FVH blocks in the first image."
+                                     : "No _FVH blocks in the second image.";
+        return {};
+    }
+
+    // Decode and sketch all blocks of both images at once. A block that fails
+    // to decode is sketched from its raw bytes so it can still be paired.
+    struct Decoded { QByteArray bytes; QString error; QVector<quint64> sketch; };
+    QVector<FvhBlock> jobs = blocksA + blocksB;
+    QVector<Decoded> decoded = QtConcurrent::blockingMapped<QVector<Decoded>>(
+        jobs, [](const FvhBlock &blk) {
+            Decoded d;
+            d.bytes  = FvhParser::decompress(blk, d.error);
+            d.sketch = sketch(d.error.isEmpty() ? d.bytes : blk.raw);
+            return d;
+        });
+
+    const int countA = blocksA.size();
+    QVector<QVector<quint64>> sketchA, sketchB;
+    for (int i = 0; i < decoded.size(); ++i)
+        (i < countA ? sketchA : sketchB).append(decoded[i].sketch);
+
+    QVector<BlockDiff> result;
+    for (const auto &pair : pairBlocks(sketchA, sketchB)) {
+        BlockDiff bd;
+        bd.indexA = pair.first;
+        bd.indexB = pair.second;
+        const Decoded *da = bd.indexA >= 0 ? &decoded[bd.indexA] : nullptr;
+        const Decoded *db = bd.indexB >= 0 ? &decoded[countA + bd.indexB] : nullptr;
+        if (da) bd.a = da->bytes;
+        if (db) bd.b = db->bytes;
+
+        QStringList errs;
+        if (!da) errs << "block only present in the second image";
+        if (!db) errs << "block only present in the first image";
+        if (da && !da->error.isEmpty()) errs << "A: " + da->error;
+        if (db && !db->error.isEmpty()) errs << "B: " + db->error;
+        bd.error = errs.join("; ");
+
+        bd.changes = diff(bd.a, bd.b);
+        result.append(bd);
+    }
+    return result;
+}
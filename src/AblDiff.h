@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include "FvhParser.h"
+
+// One changed region: bytes [aStart, aStart+aLen) of the old payload were
+// replaced by [bStart, bStart+bLen) of the new one. Either length may be 0
+// (pure insertion / deletion).
+struct DiffRange {
+    qint64 aStart;
+    qint64 aLen;
+    qint64 bStart;
+    qint64 bLen;
+};
+
+// Decoded payloads of a pair of matching blocks and their differences. A
+// block with no counterpart in the other image has -1 on that side and an
+// empty payload there.
+struct BlockDiff {
+    int                indexA = -1;
+    int                indexB = -1;
+    QByteArray         a;
+    QByteArray         b;
+    QVector<DiffRange> changes;
+    QString            error;       // non-empty if either side failed to decode
+};
+
+class AblDiff {
+public:
+    // Decode every block of both images in parallel, pair the blocks by
+    // content and diff each pair. Pairing keeps the image order and goes by
+    // the share of common anchors in the payloads, so an added or removed
+    // block shows up on its own instead of shifting every later pair.
+    // Returns an empty list and sets errorOut if either image has no blocks.
+    static QVector<BlockDiff> diffImages(const QByteArray &imageA,
+                                         const QByteArray &imageB,
+                                         QString &errorOut);
+
+    // Byte-level diff of two payloads. Matching regions are found through
+    // content-defined rolling-hash anchors, so insertions and shifts only
+    // show up where they happen instead of misaligning everything after them.
+    static QVector<DiffRange> diff(const QByteArray &a, const QByteArray &b);
+
+    // Map an offset in A to the corresponding offset in B using the change list
+    static qint64 mapAtoB(const QVector<DiffRange> &changes, qint64 aOff);
+    static qint64 mapBtoA(const QVector<DiffRange> &changes, qint64 bOff);
+};
@@ -5,7 +5,8 @@
 #include <QString>
 #include "FvhParser.h"
 
-// Runs heavy operations (decompress / repack) in a background thread.
+// Runs heavy operations (decompression) in a background thread.
+// Progress goes straight to Log rather than through queued signals.
 class AblWorker : public QObject {
     Q_OBJECT
 public:
@@ -13,11 +14,8 @@ public:
 
 public slots:
     void extract(QByteArray ablData, FvhBlock block);
-    void repack(QByteArray ablData, FvhBlock block, QByteArray patchedBinary);
 
 signals:
     void extractDone(QByteArray decompressed);
-    void repackDone(QByteArray newAbl);
     void error(QString message);
-    void progress(QString message);
 };
@@ -0,0 +1,387 @@
+#include "Arm64Disasm.h"
+
+#if ABL_HAVE_CAPSTONE
+#include <capstone/capstone.h>
+#if CS_API_MAJOR >= 6
+#define ABL_CS_ARCH CS_ARCH_AARCH64     // renamed in Capstone 6
+#else
+#define ABL_CS_ARCH CS_ARCH_ARM64
+#endif
+#endif
+
+// ── Backend ───────────────────────────────────────────────────────
+
+Arm64Disasm::Arm64Disasm() {
+#if ABL_HAVE_CAPSTONE
+    csh handle = 0;
+    if (cs_open(ABL_CS_ARCH, CS_MODE_ARM, &handle) == CS_ERR_OK) {
+        m_handle = handle;
+        m_insn   = cs_malloc(handle);
+    }
+#endif
+}
+
+Arm64Disasm::~Arm64Disasm() {
+#if ABL_HAVE_CAPSTONE
+    if (m_insn) cs_free(static_cast<cs_insn *>(m_insn), 1);
+    if (m_handle) {
+        csh handle = m_handle;
+        cs_close(&handle);
+    }
+#endif
+}
+
+QString Arm64Disasm::backend() const {
+    return m_insn ? QStringLiteral("capstone") : QStringLiteral("built-in");
+}
+
+QString Arm64Disasm::decode(quint32 word, quint64 address) {
+#if ABL_HAVE_CAPSTONE
+    if (m_insn) {
+        const uint8_t bytes[4] = { uint8_t(word), uint8_t(word >> 8), uint8_t(word >> 16), uint8_t(word >> 24) };
+        const uint8_t *code = bytes;
+        size_t size = sizeof(bytes);
+        uint64_t pc = address;
+        auto *insn = static_cast<cs_insn *>(m_insn);
+        if (cs_disasm_iter(m_handle, &code, &size, &pc, insn)) {
+            return insn->op_str[0]
+                ? QString("%1 %2").arg(QLatin1String(insn->mnemonic), QLatin1String(insn->op_str))
+                : QString(QLatin1String(insn->mnemonic));
+        }
+        return QString(".inst 0x%1").arg(word, 8, 16, QChar('0'));
+    }
+#endif
+    return decodeBuiltin(word, address);
+}
+
+// ── Built-in decoder ──────────────────────────────────────────────
+
+static qint64 signExtend(quint64 value, int bits) {
+    const quint64 m = quint64(1) << (bits - 1);
+    value &= (m << 1) - 1;
+    return qint64((value ^ m) - m);
+}
+
+// Register name; 31 is SP where the encoding allows it, otherwise ZR
+static QString reg(int n, bool sf, bool sp = false) {
+    if (n == 31) return sp ? (sf ? "sp" : "wsp") : (sf ? "xzr" : "wzr");
+    return QString("%1%2").arg(QChar(sf ? 'x' : 'w')).arg(n);
+}
+
+static QString imm(qint64 v) {
+    return v < 0 ? QString("#-0x%1").arg(-v, 0, 16) : QString("#0x%1").arg(v, 0, 16);
+}
+
+static QString addr(quint64 v) {
+    return QString("0x%1").arg(v, 0, 16);
+}
+
+static const char *const kCond[16] = {
+    "eq", "ne", "hs", "lo", "mi", "pl", "vs", "vc",
+    "hi", "ls", "ge", "lt", "gt", "le", "al", "nv"
+};
+static const char *const kShift[4] = { "lsl", "lsr", "asr", "ror" };
+
+// [Rn{, #off}] / [Rn, #off]! / [Rn], #off
+static QString memOperand(int rn, qint64 off, int mode) {
+    const QString base = reg(rn, true, true);
+    switch (mode) {
+    case 1:  return QString("[%1], %2").arg(base, imm(off));      // post-index
+    case 3:  return QString("[%1, %2]!").arg(base, imm(off));     // pre-index
+    default: return off ? QString("[%1, %2]").arg(base, imm(off)) : QString("[%1]").arg(base);
+    }
+}
+
+// DecodeBitMasks() from the ARM ARM, for logical immediates
+static bool logicalImmediate(bool sf, int n, int immr, int imms, quint64 &out) {
+    const int combined = (n << 6) | (~imms & 0x3F);
+    int len = -1;
+    for (int b = 6; b >= 0; --b)
+        if (combined & (1 << b)) { len = b; break; }
+    if (len < 1 || (!sf && n)) return false;
+    const int esize  = 1 << len;
+    const int levels = esize - 1;
+    const int s = imms & levels, r = immr & levels;
+    if (s == levels) return false;
+    quint64 elem = (s + 1 == 64) ? ~quint64(0) : (quint64(1) << (s + 1)) - 1;
+    if (r) elem = ((elem >> r) | (elem << (esize - r))) & (esize == 64 ? ~quint64(0) : (quint64(1) << esize) - 1);
+    quint64 v = 0;
+    for (int i = 0; i < 64; i += esize) v |= elem << i;
+    out = sf ? v : (v & 0xFFFFFFFFu);
+    return true;
+}
+
+// Base mnemonic + register class of a load/store by size/V/opc
+static bool ldstName(int size, bool vector, int opc, QString &name, bool &sf, char &vreg, int &scale) {
+    scale = size;
+    vreg  = 0;
+    if (vector) {
+        static const char regs[4] = { 'b', 'h', 's', 'd' };
+        if (opc & 2) {
+            if (size != 0) return false;
+            vreg = 'q';
+            scale = 4;
+        } else {
+            vreg = regs[size];
+        }
+        name = (opc & 1) ? "ldr" : "str";
+        return true;
+    }
+    static const char *const suffix[3] = { "b", "h", "" };
+    const QString sfx = size < 3 ? suffix[qMin(size, 2)] : "";
+    switch (opc) {
+    case 0: name = "str" + sfx; sf = size == 3; return true;
+    case 1: name = "ldr" + sfx; sf = size == 3; return true;
+    case 2:
+        if (size == 3) { name = "prfm"; return true; }
+        name = size == 2 ? "ldrsw" : "ldrs" + sfx; sf = true; return true;
+    case 3:
+        if (size >= 2) return false;
+        name = "ldrs" + sfx; sf = false; return true;
+    }
+    return false;
+}
+
+static QString ldstReg(int rt, bool sf, char vreg) {
+    return vreg ? QString("%1%2").arg(QChar(vreg)).arg(rt) : reg(rt, sf);
+}
+
+QString Arm64Disasm::decodeBuiltin(quint32 w, quint64 pc) {
+    const int  rd = w & 31;
+    const int  rn = (w >> 5) & 31;
+    const int  rm = (w >> 16) & 31;
+    const bool sf = w >> 31;
+
+    // Hints and barriers
+    if ((w & 0xFFFFF01F) == 0xD503201F) {
+        switch ((w >> 5) & 0x7F) {
+        case 0x00: return "nop";
+        case 0x19: return "paciasp";
+        case 0x1B: return "pacibsp";
+        case 0x1D: return "autiasp";
+        case 0x1F: return "autibsp";
+        default:   return QString("hint #%1").arg((w >> 5) & 0x7F);
+        }
+    }
+    if ((w & 0xFFFFF01F) == 0xD503301F) {
+        const int crm = (w >> 8) & 0xF;
+        const QString opt = crm == 15 ? "sy" : QString("#%1").arg(crm);
+        switch ((w >> 5) & 7) {
+        case 4: return "dsb " + opt;
+        case 5: return "dmb " + opt;
+        case 6: return "isb";
+        }
+    }
+    if ((w & 0xFFD00000) == 0xD5100000) {   // MSR / MRS (register)
+        const QString sys = QString("s%1_%2_c%3_c%4_%5")
+            .arg(2 + ((w >> 19) & 1)).arg((w >> 16) & 7).arg((w >> 12) & 0xF).arg((w >> 8) & 0xF).arg((w >> 5) & 7);
+        return (w & 0x00200000) ? QString("mrs %1, %2").arg(reg(rd, true), sys)
+                                : QString("msr %1, %2").arg(sys, reg(rd, true));
+    }
+    if ((w & 0xFFE0001C) == 0xD4000000 && (w & 3)) {
+        static const char *const call[4] = { "", "svc", "hvc", "smc" };
+        return QString("%1 %2").arg(call[w & 3], imm((w >> 5) & 0xFFFF));
+    }
+
+    // Branches
+    if ((w & 0xFFFFFC1F) == 0xD65F0000) return rn == 30 ? QString("ret") : "ret " + reg(rn, true);
+    if ((w & 0xFFFFFC1F) == 0xD61F0000) return "br " + reg(rn, true);
+    if ((w & 0xFFFFFC1F) == 0xD63F0000) return "blr " + reg(rn, true);
+    if ((w & 0x7C000000) == 0x14000000)
+        return QString("%1 %2").arg(sf ? "bl" : "b", addr(pc + signExtend(w, 26) * 4));
+    if ((w & 0xFF000010) == 0x54000000)
+        return QString("b.%1 %2").arg(kCond[w & 0xF], addr(pc + signExtend(w >> 5, 19) * 4));
+    if ((w & 0x7E000000) == 0x34000000)
+        return QString("%1 %2, %3").arg((w >> 24) & 1 ? "cbnz" : "cbz", reg(rd, sf),
+                                        addr(pc + signExtend(w >> 5, 19) * 4));
+    if ((w & 0x7E000000) == 0x36000000) {
+        const int bit = (sf << 5) | ((w >> 19) & 31);
+        return QString("%1 %2, #%3, %4").arg((w >> 24) & 1 ? "tbnz" : "tbz", reg(rd, sf)).arg(bit)
+            .arg(addr(pc + signExtend(w >> 5, 14) * 4));
+    }
+
+    // ADR / ADRP
+    if ((w & 0x1F000000) == 0x10000000) {
+        const qint64 off = signExtend((((w >> 5) & 0x7FFFF) << 2) | ((w >> 29) & 3), 21);
+        return sf ? QString("adrp %1, %2").arg(reg(rd, true), addr((pc & ~quint64(0xFFF)) + off * 4096))
+                  : QString("adr %1, %2").arg(reg(rd, true), addr(pc + off));
+    }
+
+    // Add/sub (immediate)
+    if ((w & 0x1F800000) == 0x11000000) {
+        const bool sub = (w >> 30) & 1, setf = (w >> 29) & 1;
+        const qint64 v = qint64((w >> 10) & 0xFFF) << (((w >> 22) & 1) ? 12 : 0);
+        if (!sub && !setf && v == 0 && (rd == 31 || rn == 31))
+            return QString("mov %1, %2").arg(reg(rd, sf, true), reg(rn, sf, true));
+        if (setf && rd == 31)
+            return QString("%1 %2, %3").arg(sub ? "cmp" : "cmn", reg(rn, sf, true), imm(v));
+        return QString("%1%2 %3, %4, %5").arg(sub ? "sub" : "add", setf ? "s" : "")
+            .arg(reg(rd, sf, !setf), reg(rn, sf, true), imm(v));
+    }
+
+    // Logical (immediate)
+    if ((w & 0x1F800000) == 0x12000000) {
+        static const char *const ops[4] = { "and", "orr", "eor", "ands" };
+        const int opc = (w >> 29) & 3;
+        quint64 v;
+        if (logicalImmediate(sf, (w >> 22) & 1, (w >> 16) & 0x3F, (w >> 10) & 0x3F, v)) {
+            if (opc == 1 && rn == 31) return QString("mov %1, %2").arg(reg(rd, sf, true), imm(qint64(v)));
+            if (opc == 3 && rd == 31) return QString("tst %1, %2").arg(reg(rn, sf), imm(qint64(v)));
+            return QString("%1 %2, %3, %4").arg(ops[opc], reg(rd, sf, opc != 3), reg(rn, sf), imm(qint64(v)));
+        }
+    }
+
+    // Move wide
+    if ((w & 0x1F800000) == 0x12800000) {
+        const int opc = (w >> 29) & 3, hw = (w >> 21) & 3;
+        const qint64 v = (w >> 5) & 0xFFFF;
+        if (opc == 1 || (!sf && hw >= 2)) return QString(".inst 0x%1").arg(w, 8, 16, QChar('0'));
+        if (opc == 2 && (hw == 0 || v != 0))
+            return QString("mov %1, %2").arg(reg(rd, sf), imm(v << (hw * 16)));
+        const QString shift = hw ? QString(", lsl #%1").arg(hw * 16) : QString();
+        return QString("%1 %2, %3%4").arg(opc == 3 ? "movk" : opc == 2 ? "movz" : "movn", reg(rd, sf), imm(v), shift);
+    }
+
+    // Bitfield
+    if ((w & 0x1F800000) == 0x13000000) {
+        const int opc = (w >> 29) & 3, immr = (w >> 16) & 0x3F, imms = (w >> 10) & 0x3F;
+        const int width = sf ? 64 : 32;
+        if (opc == 2) {
+            if (imms == width - 1) return QString("lsr %1, %2, #%3").arg(reg(rd, sf), reg(rn, sf)).arg(immr);
+            if (imms + 1 == immr)  return QString("lsl %1, %2, #%3").arg(reg(rd, sf), reg(rn, sf)).arg(width - 1 - imms);
+            if (!sf && immr == 0 && imms == 7)  return QString("uxtb %1, %2").arg(reg(rd, false), reg(rn, false));
+            if (!sf && immr == 0 && imms == 15) return QString("uxth %1, %2").arg(reg(rd, false), reg(rn, false));
+            if (imms >= immr) return QString("ubfx %1, %2, #%3, #%4").arg(reg(rd, sf), reg(rn, sf)).arg(immr).arg(imms - immr + 1);
+        }
+        if (opc == 0) {
+            if (imms == width - 1) return QString("asr %1, %2, #%3").arg(reg(rd, sf), reg(rn, sf)).arg(immr);
+            if (immr == 0 && imms == 7)  return QString("sxtb %1, %2").arg(reg(rd, sf), reg(rn, false));
+            if (immr == 0 && imms == 15) return QString("sxth %1, %2").arg(reg(rd, sf), reg(rn, false));
+            if (immr == 0 && imms == 31) return QString("sxtw %1, %2").arg(reg(rd, sf), reg(rn, false));
+            if (imms >= immr) return QString("sbfx %1, %2, #%3, #%4").arg(reg(rd, sf), reg(rn, sf)).arg(immr).arg(imms - immr + 1);
+        }
+        static const char *const ops[4] = { "sbfm", "bfm", "ubfm", "" };
+        if (opc < 3)
+            return QString("%1 %2, %3, #%4, #%5").arg(ops[opc], reg(rd, sf), reg(rn, sf)).arg(immr).arg(imms);
+    }
+
+    // Logical (shifted register)
+    if ((w & 0x1F000000) == 0x0A000000) {
+        static const char *const ops[8] = { "and", "bic", "orr", "orn", "eor", "eon", "ands", "bics" };
+        const int opc = (w >> 29) & 3, n = (w >> 21) & 1, shift = (w >> 22) & 3, amount = (w >> 10) & 0x3F;
+        const QString sh = amount ? QString(", %1 #%2").arg(kShift[shift]).arg(amount) : QString();
+        if (opc == 1 && !n && rn == 31 && !amount) return QString("mov %1, %2").arg(reg(rd, sf), reg(rm, sf));
+        if (opc == 1 &&  n && rn == 31) return QString("mvn %1, %2%3").arg(reg(rd, sf), reg(rm, sf), sh);
+        if (opc == 3 && !n && rd == 31) return QString("tst %1, %2%3").arg(reg(rn, sf), reg(rm, sf), sh);
+        return QString("%1 %2, %3, %4%5").arg(ops[opc * 2 + n], reg(rd, sf), reg(rn, sf), reg(rm, sf), sh);
+    }
+
+    // Add/sub (shifted register)
+    if ((w & 0x1F200000) == 0x0B000000) {
+        const bool sub = (w >> 30) & 1, setf = (w >> 29) & 1;
+        const int shift = (w >> 22) & 3, amount = (w >> 10) & 0x3F;
+        const QString sh = amount ? QString(", %1 #%2").arg(kShift[shift]).arg(amount) : QString();
+        if (setf && rd == 31)
+            return QString("%1 %2, %3%4").arg(sub ? "cmp" : "cmn", reg(rn, sf), reg(rm, sf), sh);
+        if (sub && rn == 31)
+            return QString("neg%1 %2, %3%4").arg(setf ? "s" : "", reg(rd, sf), reg(rm, sf), sh);
+        return QString("%1%2 %3, %4, %5%6").arg(sub ? "sub" : "add", setf ? "s" : "")
+            .arg(reg(rd, sf), reg(rn, sf), reg(rm, sf), sh);
+    }
+
+    // Conditional select
+    if ((w & 0x1FE00000) == 0x1A800000 && !((w >> 29) & 1)) {
+        static const char *const ops[4] = { "csel", "csinc", "csinv", "csneg" };
+        const int op = (((w >> 30) & 1) << 1) | ((w >> 10) & 1);
+        const int cond = (w >> 12) & 0xF;
+        if (op == 1 && rn == 31 && rm == 31 && cond < 14)
+            return QString("cset %1, %2").arg(reg(rd, sf), kCond[cond ^ 1]);
+        return QString("%1 %2, %3, %4, %5").arg(ops[op], reg(rd, sf), reg(rn, sf), reg(rm, sf), kCond[cond]);
+    }
+
+    // Data processing (2 source): udiv/sdiv/shifts by register
+    if ((w & 0x5FE00000) == 0x1AC00000) {
+        const char *op = nullptr;
+        switch ((w >> 10) & 0x3F) {
+        case 2:  op = "udiv"; break;
+        case 3:  op = "sdiv"; break;
+        case 8:  op = "lsl";  break;
+        case 9:  op = "lsr";  break;
+        case 10: op = "asr";  break;
+        case 11: op = "ror";  break;
+        }
+        if (op) return QString("%1 %2, %3, %4").arg(op, reg(rd, sf), reg(rn, sf), reg(rm, sf));
+    }
+
+    // Data processing (3 source): madd/msub
+    if ((w & 0x7FE00000) == 0x1B000000) {
+        const int ra = (w >> 10) & 31;
+        const bool sub = (w >> 15) & 1;
+        if (ra == 31)
+            return QString("%1 %2, %3, %4").arg(sub ? "mneg" : "mul", reg(rd, sf), reg(rn, sf), reg(rm, sf));
+        return QString("%1 %2, %3, %4, %5").arg(sub ? "msub" : "madd", reg(rd, sf), reg(rn, sf), reg(rm, sf), reg(ra, sf));
+    }
+
+    // Load literal
+    if ((w & 0x3B000000) == 0x18000000) {
+        const int opc = (w >> 30) & 3;
+        const bool vector = (w >> 26) & 1;
+        const QString target = addr(pc + signExtend(w >> 5, 19) * 4);
+        if (vector && opc < 3)
+            return QString("ldr %1%2, %3").arg(QChar("sdq"[opc])).arg(rd).arg(target);
+        if (!vector && opc < 3)
+            return QString("%1 %2, %3").arg(opc == 2 ? "ldrsw" : "ldr", reg(rd, opc != 0), target);
+        if (!vector && opc == 3)
+            return QString("prfm #%1, %2").arg(rd).arg(target);
+    }
+
+    // Load/store pair
+    if ((w & 0x3A000000) == 0x28000000) {
+        const int opc = (w >> 30) & 3, mode = (w >> 23) & 3;
+        const bool vector = (w >> 26) & 1, load = (w >> 22) & 1;
+        const int rt2 = (w >> 10) & 31;
+        if (opc < 3 && !(opc == 1 && !vector && !load)) {
+            const int scale = vector ? 2 + opc : (opc == 2 ? 3 : 2);
+            const qint64 off = signExtend(w >> 15, 7) << scale;
+            QString name = mode == 0 ? (load ? "ldnp" : "stnp") : (load ? "ldp" : "stp");
+            if (opc == 1 && !vector) name = "ldpsw";
+            auto r = [&](int n) {
+                return vector ? QString("%1%2").arg(QChar("sdq"[opc])).arg(n) : reg(n, opc != 0);
+            };
+            return QString("%1 %2, %3, %4").arg(name, r(rd), r(rt2), memOperand(rn, off, mode));
+        }
+    }
+
+    // Load/store (unsigned offset)
+    if ((w & 0x3B000000) == 0x39000000) {
+        QString name; bool wide = false; char vreg; int scale;
+        if (ldstName(w >> 30, (w >> 26) & 1, (w >> 22) & 3, name, wide, vreg, scale)) {
+            const qint64 off = qint64((w >> 10) & 0xFFF) << scale;
+            if (name == "prfm") return QString("prfm #%1, %2").arg(rd).arg(memOperand(rn, off, 2));
+            return QString("%1 %2, %3").arg(name, ldstReg(rd, wide, vreg), memOperand(rn, off, 2));
+        }
+    }
+
+    // Load/store (unscaled / post-index / pre-index / register offset)
+    if ((w & 0x3B200000) == 0x38000000 || (w & 0x3B200C00) == 0x38200800) {
+        QString name; bool wide = false; char vreg; int scale;
+        if (ldstName(w >> 30, (w >> 26) & 1, (w >> 22) & 3, name, wide, vreg, scale) && name != "prfm") {
+            if (w & 0x00200000) {   // register offset
+                const int option = (w >> 13) & 7;
+                const bool s = (w >> 12) & 1;
+                const QString index = (option == 3)
+                    ? (s ? QString("%1, lsl #%2").arg(reg(rm, true)).arg(scale) : reg(rm, true))
+                    : QString("%1, %2xtw%3").arg(reg(rm, false), option & 4 ? "s" : "u",
+                                                 s ? QString(" #%1").arg(scale) : QString());
+                return QString("%1 %2, [%3, %4]").arg(name, ldstReg(rd, wide, vreg), reg(rn, true, true), index);
+            }
+            const int mode = (w >> 10) & 3;
+            if (mode == 0) name.insert(2, 'u');          // ldr → ldur, strb → sturb
+            if (mode != 2)
+                return QString("%1 %2, %3").arg(name, ldstReg(rd, wide, vreg),
+                                                memOperand(rn, signExtend(w >> 12, 9), mode));
+        }
+    }
+
+    return QString(".inst 0x%1").arg(w, 8, 16, QChar('0'));
+}
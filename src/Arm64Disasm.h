@@ -0,0 +1,29 @@
+#pragma once
+
+#include <QString>
+#include <QtGlobal>
+
+// Single-instruction A64 disassembler. Uses Capstone when libabl was built
+// with it (ABL_HAVE_CAPSTONE); otherwise a built-in decoder that covers the
+// instructions that dominate bootloader code (branches, ADR/ADRP, add/sub,
+// moves, logic, loads/stores and pairs) and prints ".inst" for the rest.
+// Not thread-safe: use one instance per thread.
+class Arm64Disasm {
+public:
+    Arm64Disasm();
+    ~Arm64Disasm();
+
+    // "mnemonic operands" for the little-endian word at `address`
+    QString decode(quint32 word, quint64 address);
+
+    // Name of the active backend, for the UI
+    QString backend() const;
+
+    static QString decodeBuiltin(quint32 word, quint64 address);
+
+private:
+    Q_DISABLE_COPY(Arm64Disasm)
+
+    size_t m_handle = 0;        // csh
+    void  *m_insn   = nullptr;  // cs_insn scratch buffer
+};
@@ -0,0 +1,154 @@
+#include "ByteOps.h"
+
+#include <QtEndian>
+#include <cstring>
+#include <numeric>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define ABL_BYTEOPS_AVX2 1
+#include <immintrin.h>
+#endif
+
+using Logic   = ByteOps::Logic;
+using LogicFn = void (*)(Logic op, uchar *data, const uchar *key, qint64 n);
+using SwapFn  = void (*)(uchar *data, qint64 n, int width);
+
+static constexpr qint64 kVector  = 32;     // bytes per AVX2 register
+static constexpr qint64 kTileMin = 4096;
+
+// `pattern` repeated to a whole number of its own length and of kVector, so
+// the range can be walked tile by tile with the pattern always in phase.
+// Never longer than `size`.
+static QByteArray tile(const QByteArray &pattern, qint64 size) {
+    const qint64 n      = pattern.size();
+    const qint64 period = n / std::gcd(n, kVector) * kVector;
+    const qint64 len    = qMin(period * qMax<qint64>(1, kTileMin / period), size);
+    QByteArray t(len, Qt::Uninitialized);
+    for (qint64 i = 0; i < len; i += n)
+        std::memcpy(t.data() + i, pattern.constData(), size_t(qMin(n, len - i)));
+    return t;
+}
+
+// ── Portable ──────────────────────────────────────────────────────
+
+static void logicPortable(Logic op, uchar *data, const uchar *key, qint64 n) {
+    switch (op) {
+    case Logic::Xor: for (qint64 i = 0; i < n; ++i) data[i] ^= key[i]; break;
+    case Logic::And: for (qint64 i = 0; i < n; ++i) data[i] &= key[i]; break;
+    case Logic::Or:  for (qint64 i = 0; i < n; ++i) data[i] |= key[i]; break;
+    }
+}
+
+static void swapPortable(uchar *data, qint64 n, int width) {
+    switch (width) {
+    case 2:
+        for (qint64 i = 0; i < n; i += 2)
+            qToUnaligned(qbswap(qFromUnaligned<quint16>(data + i)), data + i);
+        break;
+    case 4:
+        for (qint64 i = 0; i < n; i += 4)
+            qToUnaligned(qbswap(qFromUnaligned<quint32>(data + i)), data + i);
+        break;
+    case 8:
+        for (qint64 i = 0; i < n; i += 8)
+            qToUnaligned(qbswap(qFromUnaligned<quint64>(data + i)), data + i);
+        break;
+    }
+}
+
+// ── AVX2 ──────────────────────────────────────────────────────────
+
+#ifdef ABL_BYTEOPS_AVX2
+__attribute__((target("avx2")))
+static void logicAvx2(Logic op, uchar *data, const uchar *key, qint64 n) {
+    auto *d = reinterpret_cast<__m256i *>(data);
+    const auto *k = reinterpret_cast<const __m256i *>(key);
+    const qint64 vectors = n / kVector;
+    switch (op) {
+    case Logic::Xor:
+        for (qint64 i = 0; i < vectors; ++i)
+            _mm256_storeu_si256(d + i, _mm256_xor_si256(_mm256_loadu_si256(d + i), _mm256_loadu_si256(k + i)));
+        break;
+    case Logic::And:
+        for (qint64 i = 0; i < vectors; ++i)
+            _mm256_storeu_si256(d + i, _mm256_and_si256(_mm256_loadu_si256(d + i), _mm256_loadu_si256(k + i)));
+        break;
+    case Logic::Or:
+        for (qint64 i = 0; i < vectors; ++i)
+            _mm256_storeu_si256(d + i, _mm256_or_si256(_mm256_loadu_si256(d + i), _mm256_loadu_si256(k + i)));
+        break;
+    }
+    const qint64 done = vectors * kVector;
+    logicPortable(op, data + done, key + done, n - done);
+}
+
+// Widths up to 8 never cross a 128-bit lane, so one in-lane shuffle does it
+__attribute__((target("avx2")))
+static void swapAvx2(uchar *data, qint64 n, int width) {
+    char order[kVector];
+    for (int j = 0; j < kVector; ++j)
+        order[j] = char(j % 16 - j % width + (width - 1 - j % width));
+    const __m256i mask = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(order));
+
+    auto *d = reinterpret_cast<__m256i *>(data);
+    const qint64 vectors = n / kVector;
+    for (qint64 i = 0; i < vectors; ++i)
+        _mm256_storeu_si256(d + i, _mm256_shuffle_epi8(_mm256_loadu_si256(d + i), mask));
+    const qint64 done = vectors * kVector;
+    swapPortable(data + done, n - done, width);
+}
+#endif
+
+static LogicFn logicFn() {
+#ifdef ABL_BYTEOPS_AVX2
+    static const LogicFn fn = __builtin_cpu_supports("avx2") ? logicAvx2 : logicPortable;
+    return fn;
+#else
+    return logicPortable;
+#endif
+}
+
+static SwapFn swapFn() {
+#ifdef ABL_BYTEOPS_AVX2
+    static const SwapFn fn = __builtin_cpu_supports("avx2") ? swapAvx2 : swapPortable;
+    return fn;
+#else
+    return swapPortable;
+#endif
+}
+
+// ── Public ────────────────────────────────────────────────────────
+
+void ByteOps::fill(char *data, qint64 size, const QByteArray &pattern) {
+    if (size <= 0 || pattern.isEmpty()) return;
+    if (pattern.size() == 1) {
+        std::memset(data, pattern[0], size_t(size));
+        return;
+    }
+    const QByteArray t = tile(pattern, size);
+    for (qint64 at = 0; at < size; at += t.size())
+        std::memcpy(data + at, t.constData(), size_t(qMin<qint64>(t.size(), size - at)));
+}
+
+void ByteOps::apply(Logic op, char *data, qint64 size, const QByteArray &key) {
+    if (size <= 0 || key.isEmpty()) return;
+    const LogicFn fn = logicFn();
+    const QByteArray t = tile(key, size);
+    const auto *k = reinterpret_cast<const uchar *>(t.constData());
+    for (qint64 at = 0; at < size; at += t.size())
+        fn(op, reinterpret_cast<uchar *>(data) + at, k, qMin<qint64>(t.size(), size - at));
+}
+
+bool ByteOps::swap(char *data, qint64 size, int width) {
+    if (width != 2 && width != 4 && width != 8) return false;
+    if (size >= width)
+        swapFn()(reinterpret_cast<uchar *>(data), size / width * width, width);
+    return true;
+}
+
+QString ByteOps::backend() {
+#ifdef ABL_BYTEOPS_AVX2
+    if (logicFn() == logicAvx2) return "AVX2";
+#endif
+    return "portable";
+}
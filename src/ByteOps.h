@@ -0,0 +1,24 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+// In-place kernels for bulk edits of a byte range (hex editor selections).
+// Uses AVX2 when the CPU has it, portable code otherwise; the choice is
+// made once per process.
+class ByteOps {
+public:
+    enum class Logic { Xor, And, Or };
+
+    // Repeat `pattern` over [data, data + size), starting with its first byte
+    static void fill(char *data, qint64 size, const QByteArray &pattern);
+
+    // data[i] = data[i] op key[i % key.size()]
+    static void apply(Logic op, char *data, qint64 size, const QByteArray &key);
+
+    // Reverse the byte order of every `width`-byte group (2, 4 or 8). A
+    // partial group at the end is left as it is. False for other widths.
+    static bool swap(char *data, qint64 size, int width);
+
+    static QString backend();   // "AVX2" or "portable"
+};
@@ -0,0 +1,128 @@
+#include "ByteStats.h"
+#include "Trace.h"
+
+#include <QtConcurrent>
+#include <cmath>
+#include <cstring>
+
+static constexpr qint64 CHUNKS_PER_TASK = 256;   // 1 MiB of input per parallel task
+
+// c * log2(c) for every count a full chunk can produce
+static const float *clog2Table() {
+    static float table[ByteStats::ChunkSize + 1];
+    static bool init = [] {
+        table[0] = 0;
+        for (int c = 1; c <= ByteStats::ChunkSize; ++c)
+            table[c] = float(c * std::log2(double(c)));
+        return true;
+    }();
+    Q_UNUSED(init);
+    return table;
+}
+
+// Top bytes of the ARM64 encodings that make up most of real code: branches,
+// ADRP, loads/stores and pairs, add/sub/cmp, moves, logic, bitfield, system.
+// Random data hits ~25% of them, compiled code ~90%.
+static const bool *codeTopByteTable() {
+    static bool table[256];
+    static bool init = [] {
+        static const quint8 common[] = {
+            0x14, 0x15, 0x16, 0x17, 0x94, 0x95, 0x96, 0x97,          // B, BL
+            0x54, 0x34, 0x35, 0xB4, 0xB5, 0x36, 0x37, 0xB6, 0xB7,    // B.cond, CBZ/CBNZ, TBZ/TBNZ
+            0x28, 0x29, 0xA8, 0xA9, 0x6D, 0xAD,                      // STP/LDP
+            0x38, 0x39, 0x78, 0x79, 0xB8, 0xB9, 0xF8, 0xF9,          // LDR/STR
+            0x11, 0x31, 0x51, 0x71, 0x91, 0xB1, 0xD1, 0xF1,          // ADD/SUB(S) imm
+            0x0B, 0x2B, 0x4B, 0x6B, 0x8B, 0xAB, 0xCB, 0xEB,          // ADD/SUB(S) reg
+            0x0A, 0x2A, 0x8A, 0xAA, 0x12, 0x32, 0x92, 0xB2,          // AND/ORR reg + imm
+            0x52, 0x72, 0xD2, 0xF2,                                  // MOVZ/MOVK
+            0x13, 0x53, 0x93, 0xD3, 0x1A, 0x9A, 0x1B, 0x9B,          // SBFM/UBFM, CSEL, MADD
+            0xD5, 0xD6,                                              // system/NOP, BR/BLR/RET
+        };
+        for (quint8 b : common) table[b] = true;
+        for (int b = 0x90; b < 0x100; ++b)                           // ADRP
+            if ((b & 0x9F) == 0x90) table[b] = true;
+        return true;
+    }();
+    Q_UNUSED(init);
+    return table;
+}
+
+ChunkStats ByteStats::chunk(const quint8 *p, qint64 n) {
+    ChunkStats s;
+    if (n <= 0) return s;
+
+    // Four interleaved histograms so consecutive equal bytes don't serialise
+    // on the same counter; 8-byte loads feed them
+    quint32 h[4][256];
+    std::memset(h, 0, sizeof(h));
+    qint64 i = 0;
+    for (; i + 8 <= n; i += 8) {
+        quint64 w;
+        std::memcpy(&w, p + i, 8);
+        ++h[0][w & 0xFF];         ++h[1][(w >> 8) & 0xFF];
+        ++h[2][(w >> 16) & 0xFF]; ++h[3][(w >> 24) & 0xFF];
+        ++h[0][(w >> 32) & 0xFF]; ++h[1][(w >> 40) & 0xFF];
+        ++h[2][(w >> 48) & 0xFF]; ++h[3][w >> 56];
+    }
+    for (; i < n; ++i) ++h[0][p[i]];
+
+    const float *clog2 = clog2Table();
+    const bool full = n == ChunkSize;
+    double sumClog = 0;
+    quint32 text = 0;
+    for (int b = 0; b < 256; ++b) {
+        const quint32 c = h[0][b] + h[1][b] + h[2][b] + h[3][b];
+        h[0][b] = c;
+        sumClog += full ? clog2[c] : (c ? c * std::log2(double(c)) : 0.0);
+        if ((b >= 0x20 && b < 0x7F) || b == '\t' || b == '\n' || b == '\r') text += c;
+    }
+    s.entropy = float(std::log2(double(n)) - sumClog / n);
+    s.fill    = float(h[0][0x00] + h[0][0xFF]) / n;
+    s.text    = float(text) / n;
+
+    // Little-endian words: the top byte is the last of each four
+    const bool *codeTop = codeTopByteTable();
+    quint32 words = 0, hits = 0;
+    for (qint64 w = 0; w + 4 <= n; w += 4) {
+        quint32 v;
+        std::memcpy(&v, p + w, 4);
+        if (v == 0) continue;
+        ++words;
+        hits += codeTop[v >> 24];
+    }
+    s.code = words ? float(hits) / words : 0;
+    return s;
+}
+
+QVector<ChunkStats> ByteStats::compute(const QByteArray &data) {
+    ABL_TRACE_SPAN("byte_stats");
+    const qint64 size = data.size();
+    QVector<ChunkStats> stats((size + ChunkSize - 1) / ChunkSize);
+
+    QVector<qint64> firstChunks;
+    for (qint64 c = 0; c < stats.size(); c += CHUNKS_PER_TASK) firstChunks.append(c);
+
+    const quint8 *p = reinterpret_cast<const quint8 *>(data.constData());
+    ChunkStats *out = stats.data();
+    QtConcurrent::blockingMap(firstChunks, [&](qint64 first) {
+        const qint64 last = qMin<qint64>(stats.size(), first + CHUNKS_PER_TASK);
+        for (qint64 c = first; c < last; ++c) {
+            const qint64 off = c * ChunkSize;
+            out[c] = chunk(p + off, qMin(ChunkSize, size - off));
+        }
+    });
+    return stats;
+}
+
+void ByteStats::update(const QByteArray &data, QVector<ChunkStats> &stats,
+                       qint64 offset, qint64 length) {
+    const qint64 size = data.size();
+    if (length <= 0 || offset >= size || stats.size() != (size + ChunkSize - 1) / ChunkSize)
+        return;
+    const quint8 *p = reinterpret_cast<const quint8 *>(data.constData());
+    const qint64 last = qMin(size, offset + length) - 1;
+    for (qint64 c = qMax<qint64>(0, offset) / ChunkSize; c <= last / ChunkSize; ++c) {
+        const qint64 off = c * ChunkSize;
+        stats[c] = chunk(p + off, qMin(ChunkSize, size - off));
+    }
+}
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVector>
+
+// Summary of one fixed-size chunk of a payload, for the minimap
+struct ChunkStats {
+    float entropy  = 0;   // Shannon entropy, bits per byte (0..8)
+    float fill     = 0;   // fraction of 0x00 / 0xFF bytes
+    float text     = 0;   // fraction of printable ASCII + \t \n \r
+    float code     = 0;   // fraction of non-zero words that decode as common ARM64 instructions
+};
+
+class ByteStats {
+public:
+    static constexpr qint64 ChunkSize = 4096;
+
+    // Stats for every ChunkSize chunk of `data`, computed across all cores
+    static QVector<ChunkStats> compute(const QByteArray &data);
+
+    // Recompute only the chunks touched by [offset, offset+length) after an
+    // edit. `stats` must have been computed for a buffer of the same size.
+    static void update(const QByteArray &data, QVector<ChunkStats> &stats,
+                       qint64 offset, qint64 length);
+
+    static ChunkStats chunk(const quint8 *p, qint64 n);
+};
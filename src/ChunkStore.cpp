@@ -0,0 +1,307 @@
+#include "ChunkStore.h"
+#include "Sha256.h"
+#include "Trace.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QLockFile>
+#include <QSaveFile>
+#include <QtConcurrent>
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <numeric>
+
+static const char    INDEX_MAGIC[]    = "ABLCIDX1";
+static const char    MANIFEST_MAGIC[] = "ABLCMAN1";
+static constexpr int MAGIC_SIZE       = 8;
+static constexpr int INDEX_RECORD     = Sha256::DigestSize + 8 + 4;
+static constexpr int MANIFEST_HEADER  = MAGIC_SIZE + 8 + Sha256::DigestSize + 4;
+
+// ── Content-defined chunking ──────────────────────────────────────
+
+// FastCDC with normalised chunking: up to AvgChunk a cut needs 15 zero bits
+// of the Gear hash, after it 11, so chunk sizes cluster around 8 KiB. The
+// masks take the top bits, which depend on the last 64 bytes; MASK_L's bits
+// are a subset of MASK_S's.
+static constexpr quint64 MASK_S = 0xFFFE000000000000ULL;
+static constexpr quint64 MASK_L = 0xFFE0000000000000ULL;
+
+// Input searched per task for cut candidates
+static constexpr qint64 CDC_SEGMENT = 1024 * 1024;
+
+// Fixed for good: it decides where every stored object was cut
+static const std::array<quint64, 256> &gearTable() {
+    static const std::array<quint64, 256> table = [] {
+        std::array<quint64, 256> t;
+        quint64 x = 0x41424C4344433031ULL;   // splitmix64
+        for (quint64 &v : t) {
+            quint64 z = (x += 0x9E3779B97F4A7C15ULL);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+            v = z ^ (z >> 31);
+        }
+        return t;
+    }();
+    return table;
+}
+
+struct CutCandidate {
+    qint64 end;      // a chunk may end here
+    bool   strict;   // the hash passes MASK_S as well
+};
+
+QVector<qint64> ChunkStore::chunkEnds(const QByteArray &data) {
+    ABL_TRACE_SPAN("cdc_chunk");
+    const qint64 n = data.size();
+    QVector<qint64> segments;
+    for (qint64 s = 0; s < n; s += CDC_SEGMENT) segments.append(s);
+
+    // The hash only remembers 64 bytes, so each segment starts 64 bytes
+    // early and gets exactly the values a single pass would
+    const QVector<QVector<CutCandidate>> found = QtConcurrent::blockingMapped<QVector<QVector<CutCandidate>>>(
+        segments, [&data, n](qint64 start) {
+            const auto &gear = gearTable();
+            const uchar *d = reinterpret_cast<const uchar *>(data.constData());
+            const qint64 stop = qMin(n, start + CDC_SEGMENT);
+            QVector<CutCandidate> c;
+            quint64 h = 0;
+            for (qint64 i = qMax<qint64>(0, start - 64); i < start; ++i) h = (h << 1) + gear[d[i]];
+            for (qint64 i = start; i < stop; ++i) {
+                h = (h << 1) + gear[d[i]];
+                if (!(h & MASK_L)) c.append({ i + 1, !(h & MASK_S) });
+            }
+            return c;
+        });
+
+    // Sizes decide which candidates are taken, so this part runs in order
+    QVector<qint64> ends;
+    qint64 start = 0;
+    int seg = 0, k = 0;
+    auto next = [&]() -> const CutCandidate * {   // candidates in offset order
+        while (seg < found.size() && k >= found[seg].size()) { ++seg; k = 0; }
+        return seg < found.size() ? &found[seg][k] : nullptr;
+    };
+    while (start < n) {
+        qint64 end = qMin(n, start + MaxChunk);
+        for (const CutCandidate *c = next(); c && c->end < end; ++k, c = next()) {
+            const qint64 size = c->end - start;
+            if (size < MinChunk) continue;
+            if (size < AvgChunk && !c->strict) continue;
+            end = c->end;
+            ++k;
+            break;
+        }
+        ends.append(end);
+        start = end;
+    }
+    return ends;
+}
+
+// ── Store ─────────────────────────────────────────────────────────
+
+bool ChunkStore::open(const QString &dir, QString &errorOut) {
+    m_dir = QDir(dir).absolutePath();
+    m_chunks.clear();
+    m_lookup.clear();
+    if (!QDir().mkpath(m_dir + "/objects")) {
+        errorOut = "Cannot create " + m_dir;
+        return false;
+    }
+    if (!QFile::exists(m_dir + "/index")) {   // new store; closed before it is read back
+        QFile pack(m_dir + "/pack");
+        QFile index(m_dir + "/index");
+        if (!pack.open(QIODevice::WriteOnly | QIODevice::Append)
+            || !index.open(QIODevice::WriteOnly) || index.write(INDEX_MAGIC, MAGIC_SIZE) != MAGIC_SIZE) {
+            errorOut = "Cannot initialise the store in " + m_dir;
+            return false;
+        }
+    }
+    return loadIndex(errorOut);
+}
+
+// Read the index records past the ones already known (another process may
+// have appended some). A torn last record is ignored.
+bool ChunkStore::loadIndex(QString &errorOut) {
+    QFile index(m_dir + "/index");
+    if (!index.open(QIODevice::ReadOnly) || index.read(MAGIC_SIZE) != QByteArray(INDEX_MAGIC)) {
+        errorOut = m_dir + " is not a chunk store";
+        return false;
+    }
+    const qint64 known = m_chunks.size();
+    if (!index.seek(MAGIC_SIZE + known * INDEX_RECORD)) return true;
+    const QByteArray records = index.readAll();
+    const int count = int(records.size() / INDEX_RECORD);
+    m_chunks.reserve(known + count);
+    for (int i = 0; i < count; ++i) {
+        const char *r = records.constData() + qint64(i) * INDEX_RECORD;
+        Chunk c;
+        std::memcpy(&c.offset, r + Sha256::DigestSize, 8);
+        std::memcpy(&c.size,   r + Sha256::DigestSize + 8, 4);
+        m_lookup.insert(QByteArray(r, Sha256::DigestSize), m_chunks.size());
+        m_chunks.append(c);
+    }
+    return true;
+}
+
+QString ChunkStore::manifestPath(const QString &name) const {
+    return m_dir + "/objects/" + QString::fromLatin1(name.toUtf8().toPercentEncoding()) + ".ablm";
+}
+
+bool ChunkStore::put(const QString &name, const QByteArray &data, PutStats &stats, QString &errorOut) {
+    ABL_TRACE_SPAN("archive_put");
+    stats = PutStats();
+    QLockFile lock(m_dir + "/lock");
+    if (!lock.lock()) {
+        errorOut = "Cannot lock " + m_dir;
+        return false;
+    }
+    if (!loadIndex(errorOut)) return false;
+
+    const QVector<qint64> ends = chunkEnds(data);
+    QVector<qint64> starts(ends.size());
+    for (int i = 1; i < ends.size(); ++i) starts[i] = ends[i - 1];
+    QVector<int> order(ends.size());
+    std::iota(order.begin(), order.end(), 0);
+    const QVector<QByteArray> digests = QtConcurrent::blockingMapped<QVector<QByteArray>>(
+        order, [&](int i) { return Sha256::hash(data.constData() + starts[i], ends[i] - starts[i]); });
+
+    QFile pack(m_dir + "/pack");
+    QFile index(m_dir + "/index");
+    if (!pack.open(QIODevice::WriteOnly | QIODevice::Append) || !index.open(QIODevice::ReadWrite)
+        || !index.resize(MAGIC_SIZE + qint64(m_chunks.size()) * INDEX_RECORD)   // drop a torn record
+        || !index.seek(index.size())) {
+        errorOut = "Cannot write to the store in " + m_dir;
+        return false;
+    }
+
+    // New chunks go to the pack first, then the index, then the manifest;
+    // an interruption leaves at most unreferenced bytes behind
+    QHash<QByteArray, int> added;
+    QVector<Chunk>   addedChunks;
+    QVector<quint32> refs(ends.size());
+    QByteArray       records;
+    qint64           packEnd = pack.size();
+    for (int i = 0; i < ends.size(); ++i) {
+        int id = m_lookup.value(digests[i], -1);
+        if (id < 0) id = added.value(digests[i], -1);
+        if (id < 0) {
+            const Chunk c { packEnd, quint32(ends[i] - starts[i]) };
+            if (pack.write(data.constData() + starts[i], c.size) != c.size) {
+                errorOut = "Cannot write to " + pack.fileName();
+                return false;
+            }
+            id = m_chunks.size() + addedChunks.size();
+            added.insert(digests[i], id);
+            addedChunks.append(c);
+            records += digests[i];
+            records.append(reinterpret_cast<const char *>(&c.offset), 8);
+            records.append(reinterpret_cast<const char *>(&c.size), 4);
+            packEnd += c.size;
+            stats.newBytes += c.size;
+        }
+        refs[i] = quint32(id);
+    }
+    if (!pack.flush() || index.write(records) != records.size() || !index.flush()) {
+        errorOut = "Cannot write to the store in " + m_dir;
+        return false;
+    }
+    for (auto it = added.constBegin(); it != added.constEnd(); ++it) m_lookup.insert(it.key(), it.value());
+    m_chunks += addedChunks;
+
+    QByteArray manifest(MANIFEST_MAGIC, MAGIC_SIZE);
+    const qint64  size  = data.size();
+    const quint32 count = quint32(refs.size());
+    manifest.append(reinterpret_cast<const char *>(&size), 8);
+    manifest += Sha256::hash(data);
+    manifest.append(reinterpret_cast<const char *>(&count), 4);
+    manifest.append(reinterpret_cast<const char *>(refs.constData()), qint64(refs.size()) * 4);
+    QSaveFile out(manifestPath(name));
+    if (!out.open(QIODevice::WriteOnly) || out.write(manifest) != manifest.size() || !out.commit()) {
+        errorOut = "Cannot write " + out.fileName();
+        return false;
+    }
+    stats.chunks    = ends.size();
+    stats.newChunks = addedChunks.size();
+    ABL_TRACE_COUNT("abl_archive_new_bytes_total", "Chunk bytes appended to the archive pack.", stats.newBytes);
+    return true;
+}
+
+QByteArray ChunkStore::get(const QString &name, QString &errorOut) const {
+    ABL_TRACE_SPAN("archive_get");
+    QFile mf(manifestPath(name));
+    if (!mf.open(QIODevice::ReadOnly)) {
+        errorOut = QString("No object named %1 in %2").arg(name, m_dir);
+        return {};
+    }
+    const QByteArray manifest = mf.readAll();
+    qint64  size  = 0;
+    quint32 count = 0;
+    if (manifest.size() >= MANIFEST_HEADER) {
+        std::memcpy(&size,  manifest.constData() + MAGIC_SIZE, 8);
+        std::memcpy(&count, manifest.constData() + MAGIC_SIZE + 8 + Sha256::DigestSize, 4);
+    }
+    if (!manifest.startsWith(MANIFEST_MAGIC) || manifest.size() != MANIFEST_HEADER + qint64(count) * 4) {
+        errorOut = mf.fileName() + " is damaged";
+        return {};
+    }
+    const QByteArray digest = manifest.mid(MAGIC_SIZE + 8, Sha256::DigestSize);
+    QVector<quint32> refs(count);
+    std::memcpy(refs.data(), manifest.constData() + MANIFEST_HEADER, size_t(count) * 4);
+
+    QFile pack(m_dir + "/pack");
+    if (!pack.open(QIODevice::ReadOnly)) {
+        errorOut = "Cannot open " + pack.fileName();
+        return {};
+    }
+    QByteArray out(size, Qt::Uninitialized);
+    qint64 pos = 0;
+    for (int i = 0; i < refs.size();) {
+        // Chunks stored one after another are read in one go
+        if (refs[i] >= quint32(m_chunks.size())) {
+            errorOut = QString("%1 refers to chunk %2, which is not in the index").arg(name).arg(refs[i]);
+            return {};
+        }
+        const qint64 from = m_chunks[refs[i]].offset;
+        qint64 length = m_chunks[refs[i]].size;
+        for (++i; i < refs.size() && refs[i] < quint32(m_chunks.size())
+                  && m_chunks[refs[i]].offset == from + length; ++i)
+            length += m_chunks[refs[i]].size;
+        if (pos + length > size || !pack.seek(from) || pack.read(out.data() + pos, length) != length) {
+            errorOut = QString("Cannot read %1 from %2").arg(name, pack.fileName());
+            return {};
+        }
+        pos += length;
+    }
+    if (pos != size || Sha256::hash(out) != digest) {
+        errorOut = QString("%1 does not match its checksum; the store is damaged").arg(name);
+        return {};
+    }
+    return out;
+}
+
+QVector<ChunkStoreObject> ChunkStore::objects() const {
+    QVector<ChunkStoreObject> list;
+    const QDir dir(m_dir + "/objects");
+    for (const QString &file : dir.entryList({ "*.ablm" }, QDir::Files, QDir::Name)) {
+        QFile f(dir.filePath(file));
+        if (!f.open(QIODevice::ReadOnly)) continue;
+        const QByteArray header = f.read(MANIFEST_HEADER);
+        if (header.size() != MANIFEST_HEADER || !header.startsWith(MANIFEST_MAGIC)) continue;
+        ChunkStoreObject o;
+        quint32 count = 0;
+        o.name = QString::fromUtf8(QByteArray::fromPercentEncoding(file.chopped(5).toLatin1()));
+        std::memcpy(&o.size, header.constData() + MAGIC_SIZE, 8);
+        std::memcpy(&count,  header.constData() + MAGIC_SIZE + 8 + Sha256::DigestSize, 4);
+        o.chunks = int(count);
+        list.append(o);
+    }
+    std::sort(list.begin(), list.end(),
+              [](const ChunkStoreObject &a, const ChunkStoreObject &b) { return a.name < b.name; });
+    return list;
+}
+
+qint64 ChunkStore::packBytes() const {
+    return QFileInfo(m_dir + "/pack").size();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// Content-addressed archive of images and decoded payloads. Each object is
+// cut into content-defined chunks (FastCDC over a Gear rolling hash), and
+// every distinct chunk is stored once, so consecutive firmware versions
+// cost little more than what actually changed between them.
+//
+// On disk, under one directory:
+//   pack          unique chunks, back to back, append-only
+//   index         "ABLCIDX1", then per chunk: SHA-256, u64 pack offset, u32 size
+//   objects/      one manifest per object: "ABLCMAN1", u64 size, SHA-256 of
+//                 the object, u32 chunk count, u32 index of each chunk
+//
+// Chunks are never removed; replacing an object only rewrites its manifest.
+// Writers hold a lock file, so several processes may share a store.
+//
+//   ChunkStore store;
+//   store.open("archive", err);
+//   store.put("abl_v2.elf", image, stats, err);
+//   const QByteArray again = store.get("abl_v2.elf", err);
+struct ChunkStoreObject {
+    QString name;
+    qint64  size   = 0;
+    int     chunks = 0;
+};
+
+class ChunkStore {
+public:
+    struct PutStats {
+        int    chunks    = 0;
+        int    newChunks = 0;
+        qint64 newBytes  = 0;   // appended to the pack
+    };
+
+    static constexpr qint64 MinChunk = 2 * 1024;
+    static constexpr qint64 AvgChunk = 8 * 1024;
+    static constexpr qint64 MaxChunk = 64 * 1024;
+
+    // Open the store in `dir`, creating it if needed
+    bool open(const QString &dir, QString &errorOut);
+
+    // Store `data` as `name`, replacing an object of that name
+    bool put(const QString &name, const QByteArray &data, PutStats &stats, QString &errorOut);
+
+    // The object's bytes, checked against its SHA-256; empty on error.
+    // Safe to call from several threads.
+    QByteArray get(const QString &name, QString &errorOut) const;
+
+    QVector<ChunkStoreObject> objects() const;   // sorted by name
+    int    chunkCount() const { return m_chunks.size(); }
+    qint64 packBytes() const;
+
+    // End offset of every chunk of `data`; the candidate cut points are
+    // found on all cores
+    static QVector<qint64> chunkEnds(const QByteArray &data);
+
+private:
+    struct Chunk { qint64 offset; quint32 size; };
+
+    bool    loadIndex(QString &errorOut);
+    QString manifestPath(const QString &name) const;
+
+    QString                 m_dir;
+    QVector<Chunk>          m_chunks;   // by index number
+    QHash<QByteArray, int>  m_lookup;   // SHA-256 → index number
+};
@@ -0,0 +1,410 @@
+#include "Cli.h"
+#include "ChunkStore.h"
+#include "Daemon.h"
+#include "DeviceDump.h"
+#include "FvhParser.h"
+#include "PatchPort.h"
+#include "SparseImage.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include <QStringList>
+#include <QTextStream>
+#include <QtConcurrent>
+#include <algorithm>
+#include <limits>
+
+static int usage() {
+    QTextStream(stderr)
+        << "usage: ABLTool --port <set.ablpatch> [-o <dir>] [--partial] <image>...\n"
+        << "       ABLTool --daemon [--socket <name>] [--workers N] [--queue N] [--cache-mb N]\n"
+        << "       ABLTool --client <name> <op> [key=value]... [-n <repeat>]\n"
+        << "       ABLTool --partitions <dump>\n"
+        << "       ABLTool --archive <store> [<image>...]\n"
+        << "       ABLTool --restore <store> <name> [-o <file>]\n";
+    return 2;
+}
+
+// ── --port ────────────────────────────────────────────────────────
+
+struct PortJob {
+    QString path;
+    QString outPath;
+    QString error;
+    QVector<PortResult> results;
+};
+
+static int runPort(const QStringList &args) {
+    QString patchPath, outDir;
+    QStringList images;
+    bool partial = false;   // also write images where only some patches apply
+    for (int i = 0; i < args.size(); ++i) {
+        if (args[i] == "-o" && i + 1 < args.size()) outDir = args[++i];
+        else if (args[i] == "--partial")            partial = true;
+        else if (patchPath.isEmpty())               patchPath = args[i];
+        else                                        images << args[i];
+    }
+    if (patchPath.isEmpty() || images.isEmpty()) return usage();
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    QFile pf(patchPath);
+    if (!pf.open(QIODevice::ReadOnly)) {
+        err << "Cannot open " << patchPath << "\n";
+        return 1;
+    }
+    QString perr;
+    const QVector<PatchSignature> sigs = PatchPort::fromJson(pf.readAll(), perr);
+    if (sigs.isEmpty()) {
+        err << perr << "\n";
+        return 1;
+    }
+    if (!outDir.isEmpty()) QDir().mkpath(outDir);
+
+    // One image per worker: decoding and repacking dominate, and they are
+    // independent between images
+    const QVector<PortJob> jobs = QtConcurrent::blockingMapped<QVector<PortJob>>(
+        images, [&sigs, &outDir, partial](const QString &path) {
+            PortJob job;
+            job.path = path;
+            QFile f(path);
+            if (!f.open(QIODevice::ReadOnly)) {
+                job.error = "cannot open file";
+                return job;
+            }
+            const QByteArray image = f.readAll();
+            f.close();
+
+            QByteArray patched;
+            job.results = PatchPort::portImage(image, sigs, patched, job.error, partial);
+            if (patched.isEmpty()) return job;
+
+            // An incomplete port says so in its name
+            bool complete = true;
+            for (const PortResult &r : std::as_const(job.results))
+                complete &= r.status == PortStatus::Unique || r.status == PortStatus::AlreadyApplied;
+            const QFileInfo fi(path);
+            const QString dir = outDir.isEmpty() ? fi.absolutePath() : outDir;
+            job.outPath = QDir(dir).filePath(fi.completeBaseName() + (complete ? "_ported." : "_partial.")
+                                             + (fi.suffix().isEmpty() ? QString("bin") : fi.suffix()));
+            QFile o(job.outPath);
+            if (!o.open(QIODevice::WriteOnly) || o.write(patched) != patched.size()) {
+                job.error = "cannot write " + job.outPath;
+                job.outPath.clear();
+            }
+            return job;
+        });
+
+    int failed = 0;
+    for (const PortJob &job : jobs) {
+        bool complete = job.error.isEmpty();
+        out << job.path << "\n";
+        for (int i = 0; i < job.results.size(); ++i) {
+            const PortResult &r = job.results[i];
+            complete &= r.status == PortStatus::Unique || r.status == PortStatus::AlreadyApplied;
+            out << "  " << sigs[i].name << ": " << PatchPort::statusName(r.status);
+            if (r.block >= 0) out << " (block " << r.block + 1 << ")";
+            for (qint64 o : r.offsets.mid(0, 4)) out << " 0x" << QString::number(o, 16);
+            if (r.offsets.size() > 4) out << " …";
+            out << "\n";
+        }
+        if (!job.error.isEmpty()) out << "  error: " << job.error << "\n";
+        if (!job.outPath.isEmpty()) out << "  → " << job.outPath << "\n";
+        failed += !complete;
+    }
+    out << jobs.size() - failed << "/" << jobs.size() << " image(s) fully ported\n";
+    return failed ? 1 : 0;
+}
+
+// ── --daemon / --client ───────────────────────────────────────────
+
+static int runDaemon(const QStringList &args) {
+    DaemonOptions opt;
+    for (int i = 0; i + 1 < args.size(); i += 2) {
+        const QString &key = args[i];
+        bool ok = true;
+        if      (key == "--socket")   opt.socketName = args[i + 1];
+        else if (key == "--workers")  opt.workers    = args[i + 1].toInt(&ok);
+        else if (key == "--queue")    opt.maxQueue   = args[i + 1].toInt(&ok);
+        else if (key == "--cache-mb") opt.cacheBytes = args[i + 1].toLongLong(&ok) * 1024 * 1024;
+        else return usage();
+        if (!ok) return usage();
+    }
+    if (args.size() % 2) return usage();
+
+    Daemon daemon(opt);
+    QString err;
+    if (!daemon.listen(err)) {
+        QTextStream(stderr) << err << "\n";
+        return 1;
+    }
+    return QCoreApplication::exec();
+}
+
+// key=value pairs become request fields; values that parse as JSON
+// (numbers, arrays, objects, true/false) are sent as such
+static int runClient(const QStringList &args) {
+    if (args.size() < 2) return usage();
+    QJsonObject request { { "op", args[1] } };
+    int repeat = 1;
+    for (int i = 2; i < args.size(); ++i) {
+        if (args[i] == "-n" && i + 1 < args.size()) {
+            repeat = qMax(1, args[++i].toInt());
+            continue;
+        }
+        const int eq = args[i].indexOf('=');
+        if (eq <= 0) return usage();
+        const QString value = args[i].mid(eq + 1);
+        const QJsonDocument doc = QJsonDocument::fromJson("[" + value.toUtf8() + "]");
+        request[args[i].left(eq)] = doc.isArray() ? doc.array().at(0) : QJsonValue(value);
+    }
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+    QLocalSocket socket;
+    socket.connectToServer(args[0]);
+    if (!socket.waitForConnected(3000)) {
+        err << "Cannot connect to " << args[0] << ": " << socket.errorString() << "\n";
+        return 1;
+    }
+
+    // Requests go one at a time so each sample is a full round trip
+    QVector<double> samples;
+    bool ok = true;
+    QElapsedTimer timer;
+    for (int n = 0; n < repeat; ++n) {
+        request["id"] = n;
+        timer.start();
+        socket.write(QJsonDocument(request).toJson(QJsonDocument::Compact) + "\n");
+        while (!socket.canReadLine())
+            if (!socket.waitForReadyRead(-1)) {
+                err << "Connection lost: " << socket.errorString() << "\n";
+                return 1;
+            }
+        const QByteArray line = socket.readLine();
+        samples.append(timer.nsecsElapsed() / 1e6);
+        ok &= QJsonDocument::fromJson(line).object().value("ok").toBool();
+        if (repeat == 1) out << line;
+    }
+
+    if (repeat > 1) {
+        std::sort(samples.begin(), samples.end());
+        out << repeat << " requests: p50 " << samples[repeat / 2] << " ms, p99 "
+            << samples[qMin(repeat - 1, repeat * 99 / 100)] << " ms, max "
+            << samples.last() << " ms\n";
+    }
+    return ok ? 0 : 1;
+}
+
+// ── --partitions ──────────────────────────────────────────────────
+
+static int runPartitions(const QStringList &args) {
+    if (args.size() != 1) return usage();
+    const QString path = args[0];
+    QTextStream out(stdout), err(stderr);
+
+    SparseImage sparse;
+    QString gptError;
+    if (SparseImage::isSparse(path)) {
+        if (!sparse.open(path, gptError)) {
+            err << gptError << "\n";
+            return 1;
+        }
+        gptError = QString("Sparse image, %1 chunk(s), %2 of %3 KiB stored.")
+                       .arg(sparse.chunkCount()).arg(sparse.storedBytes() / 1024).arg(sparse.size() / 1024);
+    }
+    GptTable gpt;
+    if (sparse.path().isEmpty() && DeviceDump::readGpt(path, gpt, gptError)) {
+        out << "GPT, " << gpt.sectorSize << "-byte sectors"
+            << (gpt.fromBackup ? " (from the backup header)" : "") << "\n";
+        for (const GptPartition &p : gpt.partitions) {
+            out << QString("%1  %2  0x%3  %4 KiB%5\n")
+                       .arg(p.index, 3)
+                       .arg(p.name, -20)
+                       .arg(p.offset, 12, 16, QChar('0'))
+                       .arg(p.size / 1024, 10)
+                       .arg(p.truncated ? "  (truncated)" : "");
+        }
+        return 0;
+    }
+
+    // No partition table: stream the file (or the sparse image's expanded
+    // view) for firmware volumes instead
+    err << gptError << "\nScanning for _FVH blocks...\n";
+    err.flush();
+    FvhScanSink sink;
+    sink.block = [&](const FvhBlock &b) {
+        out << QString("FV @ 0x%1  %2 bytes%3\n")
+                   .arg(b.fvStart, 12, 16, QChar('0'))
+                   .arg(b.fvSize)
+                   .arg(b.hasLzma ? (b.isXz ? "  (xz payload)" : "  (LZMA payload)") : "");
+        out.flush();
+        return true;
+    };
+    QString scanError;
+    QVector<FvhBlock> blocks;
+    if (!sparse.path().isEmpty()) {
+        FvhByteSource source;
+        source.name = path;
+        source.size = sparse.size();
+        source.read = [&sparse](qint64 offset, qint64 length, char *out) {
+            return sparse.read(offset, length, out);
+        };
+        blocks = FvhParser::scanSource(source, 0, source.size, 32768, sink, scanError);
+    } else {
+        blocks = FvhParser::scanFile(path, 0, std::numeric_limits<qint64>::max(), 32768, sink, scanError);
+    }
+    if (!scanError.isEmpty()) {
+        err << scanError << "\n";
+        return 1;
+    }
+    err << blocks.size() << " block(s)\n";
+    return blocks.isEmpty() ? 1 : 0;
+}
+
+// ── --archive / --restore ─────────────────────────────────────────
+
+static QString mib(qint64 bytes) {
+    return QString::number(bytes / (1024.0 * 1024.0), 'f', 2) + " MiB";
+}
+
+// Each image is stored under its file name, and each decoded LZMA payload
+// in it as "<name>#fv<N>", N being its block number among all blocks (raw
+// FVs included, as in the GUI); with no images, list what the store holds
+static int runArchive(const QStringList &args) {
+    if (args.isEmpty()) return usage();
+    QTextStream out(stdout), err(stderr);
+    ChunkStore store;
+    QString error;
+    if (!store.open(args[0], error)) {
+        err << error << "\n";
+        return 1;
+    }
+
+    if (args.size() == 1) {
+        qint64 logical = 0;
+        const QVector<ChunkStoreObject> objects = store.objects();
+        for (const ChunkStoreObject &o : objects) {
+            out << QString("%1  %2  %3 chunk(s)\n").arg(o.name, -40).arg(mib(o.size), 12).arg(o.chunks);
+            logical += o.size;
+        }
+        out << objects.size() << " object(s), " << mib(logical) << " in " << store.chunkCount()
+            << " unique chunk(s), " << mib(store.packBytes()) << " on disk\n";
+        return 0;
+    }
+
+    int failed = 0;
+    for (const QString &path : args.mid(1)) {
+        QFile f(path);
+        if (!f.open(QIODevice::ReadOnly)) {
+            err << "Cannot open " << path << "\n";
+            ++failed;
+            continue;
+        }
+        const QByteArray image = f.readAll();
+        f.close();
+        const QString name = QFileInfo(path).fileName();
+
+        // Payloads decode on all cores; they dedupe far better than the
+        // compressed image, where one change reshuffles the rest of the stream.
+        // Objects keep the block numbers of the GUI and --list, raw FVs included.
+        const QVector<FvhBlock> blocks = FvhParser(image).findBlocks();
+        QVector<int> lzmaBlocks;
+        for (int i = 0; i < blocks.size(); ++i)
+            if (blocks[i].hasLzma) lzmaBlocks.append(i);
+        struct Payload { int index; QByteArray data; QString error; };
+        const QVector<Payload> payloads = QtConcurrent::blockingMapped<QVector<Payload>>(
+            lzmaBlocks, [&blocks](int i) {
+                Payload p;
+                p.index = i;
+                p.data  = FvhParser::decompress(blocks[i], p.error);
+                return p;
+            });
+
+        auto put = [&](const QString &objectName, const QByteArray &data) {
+            ChunkStore::PutStats stats;
+            if (!store.put(objectName, data, stats, error)) {
+                err << objectName << ": " << error << "\n";
+                ++failed;
+                return;
+            }
+            out << QString("%1  %2  %3/%4 new chunk(s), %5 added\n")
+                       .arg(objectName, -40).arg(mib(data.size()), 12)
+                       .arg(stats.newChunks).arg(stats.chunks).arg(mib(stats.newBytes));
+        };
+        put(name, image);
+        for (const Payload &p : payloads) {
+            if (!p.error.isEmpty()) {
+                err << name << " block " << p.index + 1 << ": " << p.error << "\n";
+                ++failed;
+                continue;
+            }
+            put(QString("%1#fv%2").arg(name).arg(p.index + 1), p.data);
+        }
+    }
+    out << store.chunkCount() << " unique chunk(s), " << mib(store.packBytes()) << " on disk\n";
+    return failed ? 1 : 0;
+}
+
+static int runRestore(const QStringList &args) {
+    QString outPath;
+    QStringList rest;
+    for (int i = 0; i < args.size(); ++i) {
+        if (args[i] == "-o" && i + 1 < args.size()) outPath = args[++i];
+        else                                        rest << args[i];
+    }
+    if (rest.size() != 2) return usage();
+    if (outPath.isEmpty()) outPath = QString(rest[1]).replace("#", "_");
+    QTextStream out(stdout), err(stderr);
+
+    ChunkStore store;
+    QString error;
+    QElapsedTimer clock;
+    clock.start();
+    const QByteArray data = store.open(rest[0], error) ? store.get(rest[1], error) : QByteArray();
+    if (!error.isEmpty()) {
+        err << error << "\n";
+        return 1;
+    }
+    QFile f(outPath);
+    if (!f.open(QIODevice::WriteOnly) || f.write(data) != data.size()) {
+        err << "Cannot write " << outPath << "\n";
+        return 1;
+    }
+    const double secs = qMax<qint64>(1, clock.elapsed()) / 1000.0;
+    out << rest[1] << " → " << outPath << " (" << mib(data.size()) << ", "
+        << QString::number(data.size() / (1024.0 * 1024.0) / secs, 'f', 0) << " MiB/s)\n";
+    return 0;
+}
+
+// ── Dispatch ──────────────────────────────────────────────────────
+
+bool isCliCommand(int argc, char *argv[]) {
+    return argc > 1 && (qstrcmp(argv[1], "--port") == 0
+                        || qstrcmp(argv[1], "--daemon") == 0
+                        || qstrcmp(argv[1], "--client") == 0
+                        || qstrcmp(argv[1], "--partitions") == 0
+                        || qstrcmp(argv[1], "--archive") == 0
+                        || qstrcmp(argv[1], "--restore") == 0);
+}
+
+int runCli(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    args.removeFirst();
+    const QString cmd = args.takeFirst();
+    if (cmd == "--port")   return runPort(args);
+    if (cmd == "--daemon") return runDaemon(args);
+    if (cmd == "--client") return runClient(args);
+    if (cmd == "--partitions") return runPartitions(args);
+    if (cmd == "--archive") return runArchive(args);
+    if (cmd == "--restore") return runRestore(args);
+    return usage();
+}
@@ -0,0 +1,33 @@
+#pragma once
+
+// Headless batch commands, run instead of the GUI when the first argument
+// is one of them:
+//
+//   ABLTool --port <set.ablpatch> [-o <dir>] <image>...
+//   ABLTool --daemon [--socket <name>] [--workers N] [--queue N] [--cache-mb N]
+//   ABLTool --client <name> <op> [key=value]... [-n <repeat>]
+//   ABLTool --partitions <dump>
+//   ABLTool --archive <store> [<image>...]
+//   ABLTool --restore <store> <name> [-o <file>]
+//
+// --partitions lists the GPT of a device dump, or, when it has none (or is
+// an Android sparse image), the firmware volumes found by streaming through it.
+//
+// --archive adds images, and every LZMA payload decoded from them, to a
+// deduplicating ChunkStore; with no images it lists the store. --restore
+// writes one object back out, e.g. "abl.elf" or "abl.elf#fv1".
+//
+// Daemon protocol: one JSON object per line each way. Every request has
+// "op" and may carry "id", which the reply echoes; replies carry "ok" and,
+// on failure, "error". Blocks are numbered from 0 as returned by scan.
+//
+//   ping | stats | shutdown | evict [path]
+//   scan   path                                  → blocks
+//   fetch  path block [offset] [length]          → data_b64 (decoded payload)
+//   apply  path (patchset | patches) [out] [partial]  → results, image_b64 or written
+//          nothing is applied unless every patch ports, or partial is true
+//   repack path block (edits | payload_file) [out]
+//          edits: [{"offset": n, "hex": "..."}] applied to the decoded payload
+//
+bool isCliCommand(int argc, char *argv[]);
+int  runCli(int argc, char *argv[]);
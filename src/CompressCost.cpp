@@ -0,0 +1,62 @@
+#include "CompressCost.h"
+#include "Trace.h"
+
+#include <QtConcurrent>
+#include <lzma.h>
+
+static constexpr qint64 WINDOWS_PER_TASK = 16;   // 64 KiB of input per parallel task
+
+quint32 CompressCost::window(const QByteArray &data, qint64 index) {
+    const qint64 start = index * WindowSize;
+    const qint64 size  = data.size();
+    if (start < 0 || start >= size) return 0;
+    const qint64 n   = qMin(WindowSize, size - start);
+    const qint64 ctx = qMin(ContextSize, start);
+    const auto *p = reinterpret_cast<const uint8_t *>(data.constData());
+
+    lzma_options_lzma opt;
+    lzma_lzma_preset(&opt, LZMA_PRESET_DEFAULT);
+    opt.dict_size        = quint32(ContextSize + WindowSize);
+    opt.preset_dict      = ctx ? p + start - ctx : nullptr;
+    opt.preset_dict_size = quint32(ctx);
+    lzma_filter filters[] = {
+        { LZMA_FILTER_LZMA1, &opt },
+        { LZMA_VLI_UNKNOWN,  nullptr },
+    };
+
+    // Incompressible input grows by a few bytes per 64 KiB plus the end marker
+    uint8_t out[WindowSize + WindowSize / 8 + 64];
+    size_t outPos = 0;
+    if (lzma_raw_buffer_encode(filters, nullptr, p + start, size_t(n),
+                               out, &outPos, sizeof(out)) != LZMA_OK)
+        return 0;
+    return quint32(outPos);
+}
+
+QVector<quint32> CompressCost::compute(const QByteArray &data) {
+    ABL_TRACE_SPAN("compress_cost");
+    const qint64 windows = (data.size() + WindowSize - 1) / WindowSize;
+    QVector<quint32> costs(windows);
+
+    QVector<qint64> firstWindows;
+    for (qint64 w = 0; w < windows; w += WINDOWS_PER_TASK) firstWindows.append(w);
+
+    quint32 *out = costs.data();
+    QtConcurrent::blockingMap(firstWindows, [&](qint64 first) {
+        const qint64 last = qMin(windows, first + WINDOWS_PER_TASK);
+        for (qint64 w = first; w < last; ++w) out[w] = window(data, w);
+    });
+    return costs;
+}
+
+void CompressCost::update(const QByteArray &data, QVector<quint32> &costs,
+                          qint64 offset, qint64 length) {
+    const qint64 size = data.size();
+    if (length <= 0 || offset >= size || costs.size() != (size + WindowSize - 1) / WindowSize)
+        return;
+    const qint64 first = qMax<qint64>(0, offset) / WindowSize;
+    // Windows starting within ContextSize after the edit see it in their dictionary
+    const qint64 last = qMin<qint64>(costs.size() - 1,
+                                     (qMin(size, offset + length) - 1 + ContextSize) / WindowSize);
+    for (qint64 w = first; w <= last; ++w) costs[w] = window(data, w);
+}
@@ -0,0 +1,28 @@
+#pragma once
+
+#include <QByteArray>
+#include <QVector>
+
+// Estimates how many compressed bytes each region of a payload costs in its
+// LZMA stream. Every WindowSize window is encoded on its own with the
+// ContextSize bytes before it loaded as a preset dictionary, so matches into
+// earlier code are credited roughly as the real encoder would. Comparing the
+// costs of an edited payload with the original shows which edits eat into
+// the slot. Uses lc=3 lp=0 pb=2, the EDK2 LzmaCompress defaults.
+class CompressCost {
+public:
+    static constexpr qint64 WindowSize  = 4096;
+    static constexpr qint64 ContextSize = 64 * 1024;
+
+    // Cost of every window of `data`, computed across all cores
+    static QVector<quint32> compute(const QByteArray &data);
+
+    // Recompute the windows an edit of [offset, offset+length) can affect:
+    // the ones it touches and the ones that use it as context. `costs` must
+    // have been computed for a buffer of the same size.
+    static void update(const QByteArray &data, QVector<quint32> &costs,
+                       qint64 offset, qint64 length);
+
+    // Compressed bytes of window `index`, 0 if it could not be encoded
+    static quint32 window(const QByteArray &data, qint64 index);
+};
@@ -0,0 +1,114 @@
+#include "CostMap.h"
+#include "CompressCost.h"
+#include "HexEditor.h"
+
+#include <QFutureWatcher>
+#include <QtConcurrent>
+
+// Quiet time after the last keystroke before edits are re-costed
+static constexpr int kDebounceMs = 300;
+
+CostMap::CostMap(HexEditor *editor, QObject *parent) : QObject(parent), m_editor(editor) {
+    m_debounce.setSingleShot(true);
+    m_debounce.setInterval(kDebounceMs);
+    connect(&m_debounce, &QTimer::timeout, this, &CostMap::run);
+    connect(m_editor, &HexEditor::bytesChanged, this, &CostMap::onBytesChanged);
+}
+
+void CostMap::setEnabled(bool on) {
+    if (on == m_enabled) return;
+    m_enabled = on;
+    ++m_generation;
+    m_running = false;
+    m_costs.clear();   // edits made while off were not tracked
+    m_dirtyStart = m_dirtyEnd = -1;
+    m_editor->setMarkers({});
+    emit deltaChanged(0, false);
+    run();
+}
+
+void CostMap::reset(const QByteArray &original) {
+    ++m_generation;
+    m_running = false;
+    if (original.constData() != m_original.constData())
+        m_originalCosts.clear();
+    m_original = original;
+    m_costs.clear();
+    m_dirtyStart = m_dirtyEnd = -1;
+    m_editor->setMarkers({});
+    emit deltaChanged(0, false);
+    run();
+}
+
+void CostMap::onBytesChanged(qint64 offset, qint64 length) {
+    if (!m_enabled) return;
+    m_dirtyStart = m_dirtyStart < 0 ? offset : qMin(m_dirtyStart, offset);
+    m_dirtyEnd   = qMax(m_dirtyEnd, offset + length);
+    m_debounce.start();
+}
+
+// ── Costing ───────────────────────────────────────────────────────
+
+void CostMap::run() {
+    if (!m_enabled || m_running) return;
+    const QByteArray data = m_editor->data();   // shared, not copied
+    if (data.isEmpty() || m_original.isEmpty()) return;   // nothing decoded, or a raw view
+
+    const bool needOriginal = m_originalCosts.isEmpty();
+    const bool full         = m_costs.isEmpty();
+    if (!needOriginal && !full && m_dirtyStart < 0) return;
+
+    struct CostJob { QVector<quint32> original, current; };
+    const QByteArray original = m_original;
+    const QVector<quint32> originalCosts = m_originalCosts;
+    const QVector<quint32> costs = m_costs;
+    const qint64 start = m_dirtyStart, end = m_dirtyEnd;
+    m_dirtyStart = m_dirtyEnd = -1;
+    m_running = true;
+
+    const quint64 generation = m_generation;
+    auto *watcher = new QFutureWatcher<CostJob>(this);
+    connect(watcher, &QFutureWatcher<CostJob>::finished, this, [this, watcher, generation]() {
+        CostJob job = watcher->result();
+        watcher->deleteLater();
+        if (generation != m_generation) return;
+        m_running = false;
+        if (!job.original.isEmpty()) m_originalCosts = job.original;
+        m_costs = job.current;
+        apply();
+        if (m_dirtyStart >= 0) m_debounce.start();   // typed on while this ran
+    });
+    watcher->setFuture(QtConcurrent::run([=]() {
+        CostJob job;
+        if (needOriginal) job.original = CompressCost::compute(original);
+        const QVector<quint32> &base = needOriginal ? job.original : originalCosts;
+        if (!full) {
+            job.current = costs;
+            CompressCost::update(data, job.current, start, end - start);
+        } else if (data.constData() == original.constData()) {
+            job.current = base;                      // not edited yet
+        } else {
+            job.current = CompressCost::compute(data);
+        }
+        return job;
+    }));
+}
+
+// Tint the windows whose cost moved; deeper colour = bigger change
+void CostMap::apply() {
+    QVector<HexMarker> markers;
+    qint64 total = 0;
+    const qint64 n = qMax(m_costs.size(), m_originalCosts.size());
+    for (qint64 w = 0; w < n; ++w) {
+        const qint64 now  = w < m_costs.size() ? m_costs[w] : 0;
+        const qint64 then = w < m_originalCosts.size() ? m_originalCosts[w] : 0;
+        const qint64 d = now - then;
+        total += d;
+        if (d == 0 || w >= m_costs.size()) continue;
+        const int t = int(qMin<qint64>(32, qAbs(d)) * 4);   // saturates at ±32 bytes
+        const QColor color = d > 0 ? QColor(60 + t, 30, 30) : QColor(30, 50 + t / 2, 35);
+        markers.append({ w * CompressCost::WindowSize, CompressCost::WindowSize, color });
+    }
+    m_editor->setMarkers(markers);
+    emit deltaChanged(total, true);
+}
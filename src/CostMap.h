@@ -0,0 +1,45 @@
+#pragma once
+
+#include <QByteArray>
+#include <QObject>
+#include <QTimer>
+#include <QVector>
+
+class HexEditor;
+
+// Compressed-size overlay for a HexEditor: tints every CompressCost window
+// whose estimated LZMA cost differs from the same window of the original
+// payload (red = more expensive, green = cheaper) and reports the total
+// change. Edits are re-costed in the background, a short while after typing
+// stops.
+class CostMap : public QObject {
+    Q_OBJECT
+public:
+    explicit CostMap(HexEditor *editor, QObject *parent = nullptr);
+
+    void setEnabled(bool on);
+    bool isEnabled() const { return m_enabled; }
+
+    // The editor shows a new buffer; `original` is what its costs are compared with
+    void reset(const QByteArray &original);
+
+signals:
+    // Sum of the window deltas, in bytes; valid = false while nothing is profiled
+    void deltaChanged(qint64 bytes, bool valid);
+
+private:
+    void onBytesChanged(qint64 offset, qint64 length);
+    void run();
+    void apply();
+
+    HexEditor       *m_editor;
+    bool             m_enabled = false;
+    QByteArray       m_original;
+    QVector<quint32> m_originalCosts;
+    QVector<quint32> m_costs;                // of the editor's current bytes
+    quint64          m_generation = 0;       // drops results for replaced data
+    bool             m_running    = false;
+    qint64           m_dirtyStart = -1;      // edits not costed yet
+    qint64           m_dirtyEnd   = -1;
+    QTimer           m_debounce;
+};
@@ -0,0 +1,426 @@
+#include "Daemon.h"
+#include "PatchPort.h"
+#include "Trace.h"
+
+#include <QCoreApplication>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QLocalSocket>
+#include <QMutexLocker>
+#include <QTextStream>
+#include <QThread>
+#include <algorithm>
+
+static constexpr int    STATS_WINDOW   = 1024;                // latency samples kept per op
+static constexpr qint64 MAX_LINE       = 256LL * 1024 * 1024; // one request, payload included
+static constexpr qint64 MAX_FETCH      = 64LL * 1024 * 1024;
+
+// ── CachedImage ───────────────────────────────────────────────────
+
+QByteArray CachedImage::payload(int block, QString &errorOut) {
+    std::call_once(m_slotsCreated, [this]() { m_slots.reset(new Slot[blocks.size()]); });
+    Slot &s = m_slots[block];
+    std::call_once(s.decoded, [this, block, &s]() {
+        ABL_TRACE_SPAN("daemon_decode");
+        s.payload = FvhParser::decompress(blocks[block], s.error);
+        if (!s.error.isEmpty()) s.payload.clear();
+        m_payloadBytes.fetch_add(s.payload.size());
+    });
+    errorOut = s.error;
+    return s.payload;
+}
+
+// ── Helpers ───────────────────────────────────────────────────────
+
+static QJsonObject failure(const QString &message) {
+    return { { "ok", false }, { "error", message } };
+}
+
+// Write to `out` when given, otherwise return the bytes inline
+static void emitImage(QJsonObject &response, const QJsonObject &request, const QByteArray &image) {
+    const QString out = request.value("out").toString();
+    if (out.isEmpty()) {
+        response["image_b64"] = QString::fromLatin1(image.toBase64());
+        return;
+    }
+    QFile f(out);
+    if (!f.open(QIODevice::WriteOnly) || f.write(image) != image.size()) {
+        response = failure("cannot write " + out);
+        return;
+    }
+    response["written"] = out;
+    response["size"]    = double(image.size());
+}
+
+static int blockArg(const QJsonObject &request, const CachedImage &img, QString &errorOut) {
+    const int block = request.value("block").toInt(-1);
+    if (block < 0 || block >= img.blocks.size()) {
+        errorOut = QString("block must be 0..%1").arg(img.blocks.size() - 1);
+        return -1;
+    }
+    return block;
+}
+
+// ── Server ────────────────────────────────────────────────────────
+
+Daemon::Daemon(const DaemonOptions &options, QObject *parent)
+    : QObject(parent), m_options(options) {
+    m_pool.setMaxThreadCount(options.workers > 0 ? options.workers : QThread::idealThreadCount());
+    m_clock.start();
+    connect(&m_server, &QLocalServer::newConnection, this, &Daemon::onNewConnection);
+}
+
+// Requests still queued or running use the cache, stats and clock, which
+// are destroyed before m_pool; finish them while everything is alive
+Daemon::~Daemon() {
+    m_pool.clear();
+    m_pool.waitForDone();
+}
+
+bool Daemon::listen(QString &errorOut) {
+    QLocalServer::removeServer(m_options.socketName);   // stale socket from a crashed run
+    m_server.setSocketOptions(QLocalServer::UserAccessOption);
+    if (!m_server.listen(m_options.socketName)) {
+        errorOut = QString("Cannot listen on %1: %2").arg(m_options.socketName, m_server.errorString());
+        return false;
+    }
+    QTextStream(stdout) << "abl daemon listening on " << m_server.fullServerName()
+                        << " (" << m_pool.maxThreadCount() << " workers, queue "
+                        << m_options.maxQueue << ")\n";
+    return true;
+}
+
+void Daemon::onNewConnection() {
+    while (QLocalSocket *socket = m_server.nextPendingConnection()) {
+        connect(socket, &QLocalSocket::readyRead,    this, [this, socket]() { onReadyRead(socket); });
+        connect(socket, &QLocalSocket::disconnected, socket, &QObject::deleteLater);
+    }
+}
+
+void Daemon::onReadyRead(QLocalSocket *socket) {
+    while (socket->canReadLine()) {
+        const QByteArray line = socket->readLine().trimmed();
+        if (line.isEmpty()) continue;
+        QJsonParseError perr;
+        const QJsonDocument doc = QJsonDocument::fromJson(line, &perr);
+        if (!doc.isObject()) {
+            reply(socket, failure("bad request: " + perr.errorString()));
+            continue;
+        }
+        dispatch(socket, doc.object());
+    }
+    if (socket->bytesAvailable() > MAX_LINE) {
+        reply(socket, failure("request too large"));
+        socket->disconnectFromServer();
+    }
+}
+
+void Daemon::reply(QLocalSocket *socket, QJsonObject response) {
+    if (!response.contains("ok")) response["ok"] = true;
+    socket->write(QJsonDocument(response).toJson(QJsonDocument::Compact));
+    socket->write("\n");
+}
+
+void Daemon::dispatch(QLocalSocket *socket, const QJsonObject &request) {
+    const QString op = request.value("op").toString();
+    const QJsonValue id = request.value("id");
+    const qint64 received = m_clock.nsecsElapsed();
+
+    // Cheap control requests are answered inline, never queued
+    if (op == "ping" || op == "stats" || op == "evict" || op == "shutdown") {
+        QJsonObject response;
+        if (op == "stats") {
+            response = statsJson();
+        } else if (op == "evict") {
+            QMutexLocker lock(&m_cacheMutex);
+            const QString path = request.value("path").toString();
+            if (path.isEmpty()) m_images.clear();
+            else m_images.remove(QFileInfo(path).absoluteFilePath());
+        }
+        if (!id.isUndefined()) response["id"] = id;
+        reply(socket, response);
+        if (op == "shutdown") {
+            socket->flush();
+            QCoreApplication::quit();
+        }
+        return;
+    }
+
+    if (m_inFlight >= m_pool.maxThreadCount() + m_options.maxQueue) {
+        QJsonObject response = failure("busy: request queue is full");
+        if (!id.isUndefined()) response["id"] = id;
+        reply(socket, response);
+        m_stats[op].errors++;
+        return;
+    }
+
+    ++m_inFlight;
+    QPointer<QLocalSocket> guard(socket);
+    m_pool.start([this, guard, request, op, id, received]() {
+        const qint64 started = m_clock.nsecsElapsed();
+        QJsonObject response = execute(request);
+        if (!id.isUndefined()) response["id"] = id;
+        const qint64 finished = m_clock.nsecsElapsed();
+        QMetaObject::invokeMethod(this, [=]() {
+            finish(guard, op, response, received, started, finished);
+        }, Qt::QueuedConnection);
+    });
+}
+
+void Daemon::finish(QPointer<QLocalSocket> socket, const QString &op, QJsonObject response,
+                    qint64 receivedNs, qint64 startedNs, qint64 finishedNs) {
+    --m_inFlight;
+    const double totalMs = (finishedNs - receivedNs) / 1e6;
+    const double queueMs = (startedNs - receivedNs) / 1e6;
+    response["latency_ms"] = totalMs;
+
+    OpStats &s = m_stats[op];
+    s.count++;
+    if (!response.value("ok").toBool(true)) s.errors++;
+    s.totalMs += totalMs;
+    s.maxMs = qMax(s.maxMs, totalMs);
+    if (s.recentMs.size() < STATS_WINDOW) {
+        s.recentMs.append(float(totalMs));
+        s.recentQueueMs.append(float(queueMs));
+    } else {
+        s.recentMs[s.next] = float(totalMs);
+        s.recentQueueMs[s.next] = float(queueMs);
+        s.next = (s.next + 1) % STATS_WINDOW;
+    }
+
+    if (socket) reply(socket, response);
+    trimCache();
+}
+
+static double percentile(QVector<float> v, double q) {
+    if (v.isEmpty()) return 0;
+    const int k = qMin(int(v.size() * q), int(v.size()) - 1);
+    std::nth_element(v.begin(), v.begin() + k, v.end());
+    return v[k];
+}
+
+QJsonObject Daemon::statsJson() const {
+    QJsonObject ops;
+    for (auto it = m_stats.constBegin(); it != m_stats.constEnd(); ++it) {
+        const OpStats &s = it.value();
+        ops[it.key()] = QJsonObject {
+            { "count",        double(s.count) },
+            { "errors",       double(s.errors) },
+            { "mean_ms",      s.count ? s.totalMs / s.count : 0.0 },
+            { "p50_ms",       percentile(s.recentMs, 0.50) },
+            { "p99_ms",       percentile(s.recentMs, 0.99) },
+            { "max_ms",       s.maxMs },
+            { "queue_p50_ms", percentile(s.recentQueueMs, 0.50) },
+            { "queue_p99_ms", percentile(s.recentQueueMs, 0.99) },
+        };
+    }
+
+    qint64 cacheBytes = 0;
+    int images = 0;
+    {
+        QMutexLocker lock(&m_cacheMutex);
+        for (const auto &img : m_images) cacheBytes += img->memoryBytes();
+        images = m_images.size();
+    }
+    return {
+        { "ops",   ops },
+        { "queue", QJsonObject { { "in_flight", m_inFlight },
+                                 { "workers",   m_pool.maxThreadCount() },
+                                 { "max_queue", m_options.maxQueue } } },
+        { "cache", QJsonObject { { "images", images },
+                                 { "bytes",  double(cacheBytes) },
+                                 { "limit",  double(m_options.cacheBytes) } } },
+    };
+}
+
+// ── Cache ─────────────────────────────────────────────────────────
+
+QSharedPointer<CachedImage> Daemon::image(const QString &path, QString &errorOut) {
+    const QFileInfo fi(path);
+    const QString key = fi.absoluteFilePath();
+    if (!fi.isFile()) {
+        errorOut = "no such file: " + path;
+        return {};
+    }
+
+    {
+        QMutexLocker lock(&m_cacheMutex);
+        auto it = m_images.find(key);
+        if (it != m_images.end() && it.value()->mtime == fi.lastModified() && it.value()->fileSize == fi.size()) {
+            it.value()->lastUse = ++m_useCounter;
+            ABL_TRACE_COUNT("abl_daemon_cache_hits_total", "Daemon requests served from a cached image", 1);
+            return it.value();
+        }
+    }
+
+    // Load and scan outside the lock; a concurrent duplicate load is harmless
+    ABL_TRACE_SPAN("daemon_load");
+    QFile f(key);
+    if (!f.open(QIODevice::ReadOnly)) {
+        errorOut = "cannot open " + path;
+        return {};
+    }
+    auto img = QSharedPointer<CachedImage>::create();
+    img->path     = key;
+    img->mtime    = fi.lastModified();
+    img->fileSize = fi.size();
+    img->data     = f.readAll();
+    img->blocks   = FvhParser(img->data).findBlocks();
+
+    QMutexLocker lock(&m_cacheMutex);
+    img->lastUse = ++m_useCounter;
+    m_images.insert(key, img);
+    return img;
+}
+
+// Drop least recently used images until the cache fits its budget
+void Daemon::trimCache() {
+    QMutexLocker lock(&m_cacheMutex);
+    qint64 total = 0;
+    for (const auto &img : m_images) total += img->memoryBytes();
+    while (total > m_options.cacheBytes && m_images.size() > 1) {
+        auto oldest = m_images.begin();
+        for (auto it = m_images.begin(); it != m_images.end(); ++it)
+            if (it.value()->lastUse < oldest.value()->lastUse) oldest = it;
+        total -= oldest.value()->memoryBytes();
+        m_images.erase(oldest);
+    }
+}
+
+// ── Operations ────────────────────────────────────────────────────
+
+QJsonObject Daemon::execute(const QJsonObject &request) {
+    const QString op = request.value("op").toString();
+    if (op == "scan")   return opScan(request);
+    if (op == "fetch")  return opFetch(request);
+    if (op == "apply")  return opApply(request);
+    if (op == "repack") return opRepack(request);
+    return failure("unknown op: " + op);
+}
+
+QJsonObject Daemon::opScan(const QJsonObject &request) {
+    ABL_TRACE_SPAN("daemon_scan");
+    QString err;
+    const auto img = image(request.value("path").toString(), err);
+    if (!img) return failure(err);
+
+    QJsonArray blocks;
+    for (int i = 0; i < img->blocks.size(); ++i) {
+        const FvhBlock &b = img->blocks[i];
+        blocks.append(QJsonObject {
+            { "index",       i },
+            { "fv_start",    double(b.fvStart) },
+            { "fv_size",     double(b.fvSize) },
+            { "has_lzma",    b.hasLzma },
+            { "xz",          b.isXz },
+            { "lzma_offset", double(b.lzmaOffset) },
+            { "lzma_size",   double(b.lzmaSize) },
+            { "segment",     b.segment },
+        });
+    }
+    return { { "ok", true }, { "size", double(img->data.size()) }, { "blocks", blocks } };
+}
+
+QJsonObject Daemon::opFetch(const QJsonObject &request) {
+    ABL_TRACE_SPAN("daemon_fetch");
+    QString err;
+    const auto img = image(request.value("path").toString(), err);
+    if (!img) return failure(err);
+    const int block = blockArg(request, *img, err);
+    if (block < 0) return failure(err);
+
+    const QByteArray payload = img->payload(block, err);
+    if (payload.isEmpty()) return failure(err.isEmpty() ? "block has no payload" : err);
+
+    const qint64 offset = qint64(request.value("offset").toDouble(0));
+    const qint64 length = qint64(request.value("length").toDouble(double(payload.size())));
+    if (offset < 0 || length < 0 || offset > payload.size() || length > MAX_FETCH)
+        return failure(QString("range out of bounds (payload is %1 bytes, max fetch %2)")
+                       .arg(payload.size()).arg(MAX_FETCH));
+    const QByteArray bytes = payload.mid(offset, length);
+    return { { "ok", true }, { "payload_size", double(payload.size()) },
+             { "data_b64", QString::fromLatin1(bytes.toBase64()) } };
+}
+
+QJsonObject Daemon::opApply(const QJsonObject &request) {
+    ABL_TRACE_SPAN("daemon_apply");
+    QString err;
+    const auto img = image(request.value("path").toString(), err);
+    if (!img) return failure(err);
+
+    // Patch set from a file or inline (same JSON as a .ablpatch file)
+    QByteArray json;
+    if (request.value("patches").isObject()) {
+        json = QJsonDocument(request.value("patches").toObject()).toJson(QJsonDocument::Compact);
+    } else {
+        QFile pf(request.value("patchset").toString());
+        if (!pf.open(QIODevice::ReadOnly)) return failure("cannot open patch set");
+        json = pf.readAll();
+    }
+    const QVector<PatchSignature> sigs = PatchPort::fromJson(json, err);
+    if (sigs.isEmpty()) return failure(err);
+
+    QVector<QByteArray> payloads(img->blocks.size());
+    for (int b = 0; b < img->blocks.size(); ++b)
+        if (img->blocks[b].hasLzma) payloads[b] = img->payload(b, err);
+
+    QByteArray patched;
+    err.clear();
+    const QVector<PortResult> results = PatchPort::portDecoded(img->data, img->blocks, payloads,
+                                                               sigs, patched, err,
+                                                               request.value("partial").toBool());
+    QJsonArray out;
+    int applied = 0;
+    for (int i = 0; i < results.size(); ++i) {
+        QJsonArray offsets;
+        for (qint64 o : results[i].offsets) offsets.append(double(o));
+        out.append(QJsonObject {
+            { "name",    sigs[i].name },
+            { "status",  PatchPort::statusName(results[i].status) },
+            { "block",   results[i].block },
+            { "offsets", offsets },
+        });
+        applied += results[i].status == PortStatus::Unique;
+    }
+
+    QJsonObject response { { "ok", err.isEmpty() }, { "applied", applied }, { "results", out } };
+    if (!err.isEmpty()) response["error"] = err;
+    if (!patched.isEmpty()) emitImage(response, request, patched);
+    return response;
+}
+
+QJsonObject Daemon::opRepack(const QJsonObject &request) {
+    ABL_TRACE_SPAN("daemon_repack");
+    QString err;
+    const auto img = image(request.value("path").toString(), err);
+    if (!img) return failure(err);
+    const int block = blockArg(request, *img, err);
+    if (block < 0) return failure(err);
+
+    // New payload: a file, or byte edits on top of the cached one
+    QByteArray payload;
+    if (request.contains("payload_file")) {
+        QFile pf(request.value("payload_file").toString());
+        if (!pf.open(QIODevice::ReadOnly)) return failure("cannot open payload file");
+        payload = pf.readAll();
+    } else {
+        payload = img->payload(block, err);
+        if (payload.isEmpty()) return failure(err.isEmpty() ? "block has no payload" : err);
+        for (const QJsonValue &v : request.value("edits").toArray()) {
+            const QJsonObject e = v.toObject();
+            const qint64 off = qint64(e.value("offset").toDouble(-1));
+            const QByteArray bytes = QByteArray::fromHex(e.value("hex").toString().toLatin1());
+            if (off < 0 || off + bytes.size() > payload.size())
+                return failure(QString("edit at %1 is out of bounds").arg(off));
+            payload.replace(off, bytes.size(), bytes);
+        }
+    }
+
+    const QByteArray repacked = FvhParser::repack(img->data, img->blocks[block], payload, err);
+    if (repacked.isEmpty()) return failure(err);
+    QJsonObject response { { "ok", true } };
+    emitImage(response, request, repacked);
+    return response;
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QHash>
+#include <QJsonObject>
+#include <QLocalServer>
+#include <QMutex>
+#include <QObject>
+#include <QPointer>
+#include <QSharedPointer>
+#include <QThreadPool>
+#include <QVector>
+#include "FvhParser.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+class QLocalSocket;
+
+struct DaemonOptions {
+    QString socketName = "abltool";     // QLocalServer name or absolute socket path
+    int     workers    = 0;             // 0 → one per core
+    int     maxQueue   = 64;            // requests waiting beyond the running ones
+    qint64  cacheBytes = 2048LL * 1024 * 1024;
+};
+
+// A loaded image with its scan and, once asked for, decoded payloads
+struct CachedImage {
+    QString           path;
+    QDateTime         mtime;
+    qint64            fileSize = 0;
+    QByteArray        data;
+    QVector<FvhBlock> blocks;
+    quint64           lastUse = 0;
+
+    // Decoded payload of `block`, decoding it on first use. Blocks decode
+    // independently; callers wanting the same block wait for its one decode.
+    QByteArray payload(int block, QString &errorOut);
+    qint64 memoryBytes() const { return data.size() + m_payloadBytes.load(); }   // never blocks
+
+private:
+    struct Slot {
+        std::once_flag decoded;
+        QByteArray     payload;
+        QString        error;
+    };
+
+    std::once_flag           m_slotsCreated;
+    std::unique_ptr<Slot[]>  m_slots;          // one per block
+    std::atomic<qint64>      m_payloadBytes{0};
+};
+
+// Resident server for build pipelines: keeps scanned images and decoded
+// payloads in memory and answers newline-delimited JSON requests over a
+// local socket (see Cli.h for the protocol). Requests run on a bounded
+// thread pool; per-operation latencies are kept for the "stats" request.
+class Daemon : public QObject {
+    Q_OBJECT
+public:
+    explicit Daemon(const DaemonOptions &options, QObject *parent = nullptr);
+    ~Daemon() override;
+
+    bool listen(QString &errorOut);
+
+private:
+    struct OpStats {
+        quint64          count   = 0;
+        quint64          errors  = 0;
+        double           totalMs = 0;
+        double           maxMs   = 0;
+        QVector<float>   recentMs;          // ring of the last samples (total latency)
+        QVector<float>   recentQueueMs;     // same requests, time spent waiting
+        int              next = 0;
+    };
+
+    void onNewConnection();
+    void onReadyRead(QLocalSocket *socket);
+    void dispatch(QLocalSocket *socket, const QJsonObject &request);
+    void reply(QLocalSocket *socket, QJsonObject response);
+    void finish(QPointer<QLocalSocket> socket, const QString &op, QJsonObject response,
+                qint64 receivedNs, qint64 startedNs, qint64 finishedNs);
+
+    // Run on pool threads
+    QJsonObject execute(const QJsonObject &request);
+    QJsonObject opScan(const QJsonObject &request);
+    QJsonObject opFetch(const QJsonObject &request);
+    QJsonObject opApply(const QJsonObject &request);
+    QJsonObject opRepack(const QJsonObject &request);
+
+    QSharedPointer<CachedImage> image(const QString &path, QString &errorOut);
+    void trimCache();
+    QJsonObject statsJson() const;
+
+    DaemonOptions m_options;
+    QLocalServer  m_server;
+    QThreadPool   m_pool;
+    QElapsedTimer m_clock;
+    int           m_inFlight = 0;       // queued + running (main thread only)
+
+    mutable QMutex m_cacheMutex;
+    QHash<QString, QSharedPointer<CachedImage>> m_images;
+    quint64        m_useCounter = 0;
+
+    QHash<QString, OpStats> m_stats;    // main thread only
+};
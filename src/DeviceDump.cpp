@@ -0,0 +1,150 @@
+#include "DeviceDump.h"
+#include "Trace.h"
+
+#include <QFile>
+#include <cstring>
+#include <lzma.h>
+
+static constexpr quint32 GPT_MAX_ENTRIES    = 1024;
+static constexpr quint32 GPT_MAX_ENTRY_SIZE = 4096;
+
+static quint32 rd32(const char *p) { quint32 v; std::memcpy(&v, p, 4); return v; }
+static quint64 rd64(const char *p) { quint64 v; std::memcpy(&v, p, 8); return v; }
+
+// Mixed-endian textual form: the first three fields are little-endian
+static QString guidString(const char *g) {
+    const auto *b = reinterpret_cast<const quint8 *>(g);
+    auto hex = [](quint64 v, int digits) { return QString("%1").arg(v, digits, 16, QChar('0')); };
+    QString s = hex(rd32(g), 8) + "-"
+              + hex(b[4] | b[5] << 8, 4) + "-"
+              + hex(b[6] | b[7] << 8, 4) + "-"
+              + hex(b[8] << 8 | b[9], 4) + "-";
+    for (int i = 10; i < 16; ++i) s += hex(b[i], 2);
+    return s.toUpper();
+}
+
+static bool readAt(QFile &f, qint64 offset, qint64 length, QByteArray &out) {
+    out.resize(length);
+    return offset >= 0 && f.seek(offset) && f.read(out.data(), length) == length;
+}
+
+// Header at `headerOffset` plus its entry array, both CRC-checked
+static bool parseGpt(QFile &f, qint64 fileSize, int sector, qint64 headerOffset,
+                     GptTable &out, QString &errorOut)
+{
+    QByteArray hdr;
+    if (!readAt(f, headerOffset, sector, hdr) || std::memcmp(hdr.constData(), "EFI PART", 8) != 0)
+        return false;
+    const char *h = hdr.constData();
+    const quint32 hdrSize = rd32(h + 12);
+    if (hdrSize < 92 || hdrSize > quint32(sector)) {
+        errorOut = QString("GPT header at 0x%1 has size %2.").arg(headerOffset, 0, 16).arg(hdrSize);
+        return false;
+    }
+    QByteArray zeroed = hdr.left(hdrSize);
+    std::memset(zeroed.data() + 16, 0, 4);
+    if (lzma_crc32(reinterpret_cast<const uint8_t *>(zeroed.constData()), hdrSize, 0) != rd32(h + 16)) {
+        errorOut = QString("GPT header at 0x%1 fails its CRC.").arg(headerOffset, 0, 16);
+        return false;
+    }
+
+    const quint64 entryLba  = rd64(h + 72);
+    const quint32 count     = rd32(h + 80);
+    const quint32 entrySize = rd32(h + 84);
+    if (count > GPT_MAX_ENTRIES || entrySize < 128 || entrySize > GPT_MAX_ENTRY_SIZE || entrySize % 8) {
+        errorOut = QString("GPT entry array of %1 × %2 bytes is not plausible.").arg(count).arg(entrySize);
+        return false;
+    }
+    QByteArray entries;
+    if (!readAt(f, qint64(entryLba) * sector, qint64(count) * entrySize, entries)) {
+        errorOut = QString("GPT entry array at LBA %1 lies outside the file.").arg(entryLba);
+        return false;
+    }
+    if (lzma_crc32(reinterpret_cast<const uint8_t *>(entries.constData()), entries.size(), 0) != rd32(h + 88)) {
+        errorOut = QString("GPT entry array at LBA %1 fails its CRC.").arg(entryLba);
+        return false;
+    }
+
+    out.sectorSize = sector;
+    out.partitions.clear();
+    out.byName.clear();
+    static const char zeroGuid[16] = {};
+    for (quint32 i = 0; i < count; ++i) {
+        const char *e = entries.constData() + qint64(i) * entrySize;
+        if (std::memcmp(e, zeroGuid, 16) == 0) continue;   // unused entry
+
+        GptPartition p;
+        p.index      = int(i);
+        p.typeGuid   = guidString(e);
+        p.uniqueGuid = guidString(e + 16);
+        const quint64 first = rd64(e + 32), last = rd64(e + 40);
+        p.attributes = rd64(e + 48);
+        p.offset     = qint64(first) * sector;
+        p.size       = last >= first ? qint64(last - first + 1) * sector : 0;
+        p.truncated  = p.offset + p.size > fileSize;
+
+        char16_t name[36];
+        std::memcpy(name, e + 56, sizeof(name));
+        int len = 0;
+        while (len < 36 && name[len]) ++len;
+        p.name = QString::fromUtf16(name, len);
+
+        if (!out.byName.contains(p.name)) out.byName.insert(p.name, out.partitions.size());
+        out.partitions.append(p);
+    }
+    return true;
+}
+
+bool DeviceDump::readGpt(const QString &path, GptTable &out, QString &errorOut) {
+    ABL_TRACE_SPAN("gpt");
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        errorOut = "Cannot open " + path;
+        return false;
+    }
+    const qint64 fileSize = f.size();
+    QString err;
+    for (int sector : { 512, 4096 }) {
+        if (parseGpt(f, fileSize, sector, sector, out, err)) return true;
+    }
+    // Primary header damaged or wiped: the backup sits in the last LBA
+    for (int sector : { 512, 4096 }) {
+        if (fileSize < 2 * sector) continue;
+        if (parseGpt(f, fileSize, sector, (fileSize / sector - 1) * sector, out, err)) {
+            out.fromBackup = true;
+            return true;
+        }
+    }
+    errorOut = err.isEmpty() ? "No GPT header at LBA 1 (512 or 4096-byte sectors) or at the end of the file." : err;
+    return false;
+}
+
+QByteArray DeviceDump::read(const QString &path, qint64 offset, qint64 length, QString &errorOut) {
+    QFile f(path);
+    QByteArray out;
+    if (!f.open(QIODevice::ReadOnly) || !readAt(f, offset, length, out)) {
+        errorOut = QString("Cannot read %1 bytes at 0x%2 of %3").arg(length).arg(offset, 0, 16).arg(path);
+        return {};
+    }
+    return out;
+}
+
+bool DeviceDump::writeAt(const QString &path, qint64 offset, const QByteArray &bytes,
+                         QString &errorOut)
+{
+    ABL_TRACE_SPAN("save");
+    QFile f(path);
+    if (!f.open(QIODevice::ReadWrite)) {
+        errorOut = "Cannot open " + path + " for writing";
+        return false;
+    }
+    if (offset < 0 || offset + bytes.size() > f.size()) {
+        errorOut = QString("0x%1+%2 lies outside %3").arg(offset, 0, 16).arg(bytes.size()).arg(path);
+        return false;
+    }
+    if (!f.seek(offset) || f.write(bytes) != bytes.size() || !f.flush()) {
+        errorOut = QString("Write to %1 at 0x%2 failed: %3").arg(path).arg(offset, 0, 16).arg(f.errorString());
+        return false;
+    }
+    return true;
+}
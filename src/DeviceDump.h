@@ -0,0 +1,48 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// One entry of a GPT partition array
+struct GptPartition {
+    int     index;          // position in the entry array
+    QString name;           // e.g. "abl_a"
+    QString typeGuid;
+    QString uniqueGuid;
+    quint64 attributes;
+    qint64  offset;         // bytes from the start of the dump
+    qint64  size;
+    bool    truncated;      // runs past the end of the dump file
+};
+
+struct GptTable {
+    int  sectorSize = 0;                // 512 (eMMC) or 4096 (UFS)
+    bool fromBackup = false;            // primary header was damaged
+    QVector<GptPartition> partitions;   // in entry order, empty entries skipped
+    QHash<QString, int>   byName;       // name → index into partitions
+
+    const GptPartition *find(const QString &name) const {
+        const int i = byName.value(name, -1);
+        return i < 0 ? nullptr : &partitions[i];
+    }
+};
+
+// Raw device dumps (a whole eMMC, or one UFS LUN) that are far too large to
+// load: the partition table is read from disk, and partitions are read and
+// patched in place by offset.
+class DeviceDump {
+public:
+    // GPT of the dump at `path`. Tries 512- and 4096-byte sectors, then the
+    // backup header at the end of the file; headers and entry arrays must
+    // pass their CRC32. False if no valid table was found.
+    static bool readGpt(const QString &path, GptTable &out, QString &errorOut);
+
+    // Bytes [offset, offset+length) of the file, or empty on error
+    static QByteArray read(const QString &path, qint64 offset, qint64 length, QString &errorOut);
+
+    // Overwrite [offset, offset+bytes.size()) of the file; never grows it
+    static bool writeAt(const QString &path, qint64 offset, const QByteArray &bytes,
+                        QString &errorOut);
+};
@@ -0,0 +1,142 @@
+#include "DiffWindow.h"
+
+#include <QVBoxLayout>
+#include <QHBoxLayout>
+#include <QSplitter>
+#include <QGroupBox>
+#include <QFont>
+
+static const QColor CHANGED_A(110, 40, 40);
+static const QColor CHANGED_B(40, 100, 50);
+static const QColor INSERT_POINT(120, 100, 30);
+
+// Changes listed per block are capped; huge rewrites are summarised instead
+static constexpr int MAX_LISTED_CHANGES = 20000;
+
+DiffWindow::DiffWindow(const QString &nameA, const QString &nameB,
+                       const QVector<BlockDiff> &diffs, QWidget *parent)
+    : QWidget(parent, Qt::Window), m_diffs(diffs)
+{
+    setWindowTitle(QString("ABL Diff — %1 ⇄ %2").arg(nameA, nameB));
+    setAttribute(Qt::WA_DeleteOnClose);
+    resize(1400, 800);
+
+    QVBoxLayout *layout = new QVBoxLayout(this);
+    layout->setContentsMargins(6, 6, 6, 6);
+
+    m_blockCombo = new QComboBox;
+    for (const BlockDiff &d : m_diffs) {
+        const QString side = d.indexA < 0 ? QString("— ⇄ %1").arg(d.indexB + 1)
+                           : d.indexB < 0 ? QString("%1 ⇄ —").arg(d.indexA + 1)
+                           : d.indexA == d.indexB ? QString::number(d.indexA + 1)
+                           : QString("%1 ⇄ %2").arg(d.indexA + 1).arg(d.indexB + 1);
+        m_blockCombo->addItem(QString("Block %1 — %2 change(s)%3")
+            .arg(side)
+            .arg(d.changes.size())
+            .arg(d.error.isEmpty() ? QString() : "  ⚠ " + d.error));
+    }
+    layout->addWidget(m_blockCombo);
+
+    QSplitter *splitter = new QSplitter(Qt::Horizontal);
+
+    QGroupBox *groupA = new QGroupBox(nameA);
+    QVBoxLayout *layoutA = new QVBoxLayout(groupA);
+    m_hexA = new HexEditor;
+    m_hexA->setReadOnly(true);
+    layoutA->addWidget(m_hexA);
+    splitter->addWidget(groupA);
+
+    QGroupBox *groupB = new QGroupBox(nameB);
+    QVBoxLayout *layoutB = new QVBoxLayout(groupB);
+    m_hexB = new HexEditor;
+    m_hexB->setReadOnly(true);
+    layoutB->addWidget(m_hexB);
+    splitter->addWidget(groupB);
+
+    QGroupBox *changeGroup = new QGroupBox("Changed ranges");
+    QVBoxLayout *changeLayout = new QVBoxLayout(changeGroup);
+    m_changeList = new QListWidget;
+    m_changeList->setFont(QFont("Monospace", 9));
+    m_changeList->setUniformItemSizes(true);
+    m_changeList->setMinimumWidth(260);
+    changeLayout->addWidget(m_changeList);
+    splitter->addWidget(changeGroup);
+
+    splitter->setStretchFactor(0, 1);
+    splitter->setStretchFactor(1, 1);
+    splitter->setStretchFactor(2, 0);
+    layout->addWidget(splitter, 1);
+
+    m_summary = new QLabel;
+    layout->addWidget(m_summary);
+
+    connect(m_blockCombo, &QComboBox::currentIndexChanged, this, &DiffWindow::onBlockChanged);
+    connect(m_changeList, &QListWidget::currentRowChanged, this, &DiffWindow::onChangeSelected);
+    connect(m_hexA, &HexEditor::topOffsetChanged, this, [this](qint64 off) { syncFrom(m_hexA, off); });
+    connect(m_hexB, &HexEditor::topOffsetChanged, this, [this](qint64 off) { syncFrom(m_hexB, off); });
+
+    if (!m_diffs.isEmpty()) onBlockChanged(0);
+}
+
+void DiffWindow::onBlockChanged(int index) {
+    if (index < 0 || index >= m_diffs.size()) return;
+    m_current = index;
+    const BlockDiff &d = m_diffs[index];
+
+    QVector<HexMarker> markA, markB;
+    markA.reserve(d.changes.size());
+    markB.reserve(d.changes.size());
+    qint64 bytesA = 0, bytesB = 0;
+    for (const DiffRange &r : d.changes) {
+        markA.append({ r.aStart, qMax<qint64>(r.aLen, 1), r.aLen ? CHANGED_A : INSERT_POINT });
+        markB.append({ r.bStart, qMax<qint64>(r.bLen, 1), r.bLen ? CHANGED_B : INSERT_POINT });
+        bytesA += r.aLen;
+        bytesB += r.bLen;
+    }
+
+    m_syncing = true;
+    m_hexA->setData(d.a);
+    m_hexB->setData(d.b);
+    m_hexA->setMarkers(markA);
+    m_hexB->setMarkers(markB);
+    m_syncing = false;
+
+    m_changeList->clear();
+    const int listed = qMin<int>(d.changes.size(), MAX_LISTED_CHANGES);
+    for (int i = 0; i < listed; ++i) {
+        const DiffRange &r = d.changes[i];
+        m_changeList->addItem(QString("%1  A 0x%2 +%3  →  B 0x%4 +%5")
+            .arg(i + 1, 5)
+            .arg(r.aStart, 8, 16, QChar('0'))
+            .arg(r.aLen)
+            .arg(r.bStart, 8, 16, QChar('0'))
+            .arg(r.bLen));
+    }
+    if (listed < d.changes.size())
+        m_changeList->addItem(QString("… %1 more").arg(d.changes.size() - listed));
+
+    m_summary->setText(QString("A: %1 bytes, B: %2 bytes — %3 changed range(s), %4 bytes removed / %5 bytes added")
+        .arg(d.a.size()).arg(d.b.size()).arg(d.changes.size()).arg(bytesA).arg(bytesB));
+}
+
+void DiffWindow::onChangeSelected(int row) {
+    if (m_current < 0 || row < 0 || row >= m_diffs[m_current].changes.size()) return;
+    const DiffRange &r = m_diffs[m_current].changes[row];
+    m_syncing = true;
+    m_hexA->goTo(qMin(r.aStart, (qint64)m_diffs[m_current].a.size() - 1));
+    m_hexB->goTo(qMin(r.bStart, (qint64)m_diffs[m_current].b.size() - 1));
+    m_hexA->setHighlight(r.aStart, r.aLen);
+    m_hexB->setHighlight(r.bStart, r.bLen);
+    m_syncing = false;
+}
+
+void DiffWindow::syncFrom(HexEditor *src, qint64 topOffset) {
+    if (m_syncing || m_current < 0) return;
+    const auto &changes = m_diffs[m_current].changes;
+    m_syncing = true;
+    if (src == m_hexA)
+        m_hexB->scrollToOffset(AblDiff::mapAtoB(changes, topOffset));
+    else
+        m_hexA->scrollToOffset(AblDiff::mapBtoA(changes, topOffset));
+    m_syncing = false;
+}
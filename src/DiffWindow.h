@@ -0,0 +1,35 @@
+#pragma once
+
+#include <QWidget>
+#include <QComboBox>
+#include <QLabel>
+#include <QListWidget>
+#include "AblDiff.h"
+#include "HexEditor.h"
+
+// Side-by-side view of two decoded ABL payloads. Both hex views scroll
+// together (offsets are mapped through the change list, so they stay aligned
+// across insertions), and the list on the right jumps to each changed range.
+class DiffWindow : public QWidget {
+    Q_OBJECT
+public:
+    DiffWindow(const QString &nameA, const QString &nameB,
+               const QVector<BlockDiff> &diffs, QWidget *parent = nullptr);
+
+private slots:
+    void onBlockChanged(int index);
+    void onChangeSelected(int row);
+
+private:
+    void syncFrom(HexEditor *src, qint64 topOffset);
+
+    QVector<BlockDiff> m_diffs;
+    int                m_current = -1;
+    bool               m_syncing = false;
+
+    QComboBox   *m_blockCombo = nullptr;
+    HexEditor   *m_hexA       = nullptr;
+    HexEditor   *m_hexB       = nullptr;
+    QListWidget *m_changeList = nullptr;
+    QLabel      *m_summary    = nullptr;
+};
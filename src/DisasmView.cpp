@@ -0,0 +1,186 @@
+#include "DisasmView.h"
+#include "HexEditor.h"
+#include "Trace.h"
+
+#include <QFontMetrics>
+#include <QKeyEvent>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QScrollBar>
+#include <QSignalBlocker>
+#include <climits>
+#include <cstring>
+
+static constexpr int kPrefetchLines = 128;    // decoded above and below the view
+static constexpr int kCachedLines   = 8192;
+
+static bool isBranch(const QString &m) {
+    return m == "b" || m == "bl" || m == "br" || m == "blr" || m == "ret" || m.startsWith("b.")
+        || m == "cbz" || m == "cbnz" || m == "tbz" || m == "tbnz";
+}
+
+DisasmView::DisasmView(HexEditor *editor, QWidget *parent)
+    : QAbstractScrollArea(parent), m_editor(editor) {
+    QFont font("Monospace", 10);
+    font.setStyleHint(QFont::TypeWriter);
+    setFont(font);
+    setFocusPolicy(Qt::StrongFocus);
+    m_lines.setMaxCost(kCachedLines);
+    updateMetrics();
+
+    connect(m_editor, &HexEditor::dataReset,        this, &DisasmView::reset);
+    connect(m_editor, &HexEditor::bytesChanged,     this, &DisasmView::onBytesChanged);
+    connect(m_editor, &HexEditor::topOffsetChanged, this, &DisasmView::followEditor);
+    connect(m_editor, &HexEditor::cursorMoved,      this, [this](qint64 off) {
+        m_cursor = off & ~qint64(3);
+        const qint64 line = m_cursor / 4;
+        if (line < m_topLine || line >= m_topLine + visibleLines())
+            setTopLine(line - visibleLines() / 2, false);
+        viewport()->update();
+    });
+    // Only user scrolling reaches this; setTopLine() blocks the signal
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, [this](int value) {
+        setTopLine(qint64(value) * m_lineStep, true);
+    });
+}
+
+// ── Editor sync ───────────────────────────────────────────────────
+
+void DisasmView::reset() {
+    m_lines.clear();
+    m_size    = m_editor->size();
+    m_topLine = 0;
+    m_cursor  = -1;
+    updateMetrics();
+    setTopLine(0, false);
+}
+
+void DisasmView::onBytesChanged(qint64 offset, qint64 length) {
+    for (qint64 o = offset & ~qint64(3); o < offset + length; o += 4)
+        m_lines.remove(o);
+    viewport()->update();
+}
+
+void DisasmView::followEditor(qint64 topOffset) {
+    if (!m_syncing) setTopLine(topOffset / 4, false);
+}
+
+void DisasmView::setTopLine(qint64 line, bool syncEditor) {
+    const qint64 maxTop = qMax<qint64>(0, lineCount() - visibleLines());
+    m_topLine = qBound<qint64>(0, line, maxTop);
+    {
+        QSignalBlocker block(verticalScrollBar());
+        verticalScrollBar()->setValue(int(m_topLine / m_lineStep));
+    }
+    if (syncEditor) {
+        m_syncing = true;
+        m_editor->scrollToOffset(m_topLine * 4);
+        m_syncing = false;
+    }
+    viewport()->update();
+}
+
+// ── Layout ────────────────────────────────────────────────────────
+
+void DisasmView::updateMetrics() {
+    QFontMetrics fm(font());
+    m_charW = fm.horizontalAdvance('F');
+    m_charH = fm.height();
+    m_rowH  = m_charH + 4;
+    m_addrDigits = 8;
+    while (m_addrDigits < 16 && ((m_size - 1) >> (4 * m_addrDigits)) > 0) ++m_addrDigits;
+
+    QSignalBlocker block(verticalScrollBar());
+    const qint64 maxTop = qMax<qint64>(0, lineCount() - visibleLines());
+    m_topLine  = qMin(m_topLine, maxTop);
+    m_lineStep = qMax<qint64>(1, (maxTop + INT_MAX - 1) / INT_MAX);
+    verticalScrollBar()->setRange(0, int(maxTop / m_lineStep));
+    verticalScrollBar()->setPageStep(int(qMax<qint64>(1, visibleLines() / m_lineStep)));
+    verticalScrollBar()->setValue(int(m_topLine / m_lineStep));
+}
+
+void DisasmView::resizeEvent(QResizeEvent *event) {
+    QAbstractScrollArea::resizeEvent(event);
+    updateMetrics();
+}
+
+// ── Decoding ──────────────────────────────────────────────────────
+
+void DisasmView::decodeRange(qint64 firstLine, qint64 lastLine) {
+    const QSharedPointer<HexDataProvider> provider = m_editor->provider();
+    if (!provider) return;
+    firstLine = qMax<qint64>(0, firstLine);
+    lastLine  = qMin(lastLine, lineCount());
+
+    qint64 pageIndex = -1;
+    QByteArray page;
+    for (qint64 line = firstLine; line < lastLine; ++line) {
+        const qint64 off = line * 4;
+        if (m_lines.contains(off)) continue;
+        // Words never straddle pages (PageSize is a multiple of 4)
+        if (off / HexDataProvider::PageSize != pageIndex) {
+            pageIndex = off / HexDataProvider::PageSize;
+            if (!provider->readPage(pageIndex, page)) return;
+        }
+        quint32 word;
+        std::memcpy(&word, page.constData() + off % HexDataProvider::PageSize, 4);
+        m_lines.insert(off, new QString(QString("%1  %2")
+            .arg(word, 8, 16, QChar('0'))
+            .arg(m_disasm.decode(word, quint64(off)))));
+    }
+}
+
+void DisasmView::paintEvent(QPaintEvent *) {
+    QPainter p(viewport());
+    p.fillRect(viewport()->rect(), QColor(30, 30, 30));
+    if (lineCount() == 0) return;
+
+    const int vis = visibleLines() + 1;
+    {
+        ABL_TRACE_SPAN("disasm_decode");
+        decodeRange(m_topLine - kPrefetchLines, m_topLine + vis + kPrefetchLines);
+    }
+
+    p.setFont(font());
+    const int textX = m_charW * (m_addrDigits + 2);
+    const qint64 last = qMin(m_topLine + vis, lineCount());
+    for (qint64 line = m_topLine; line < last; ++line) {
+        const qint64 off = line * 4;
+        const int y = int(line - m_topLine) * m_rowH + m_charH;
+        if (off == m_cursor)
+            p.fillRect(0, y - m_charH + 2, viewport()->width(), m_rowH - 2, QColor(50, 70, 110));
+
+        p.setPen(QColor(100, 150, 200));
+        p.drawText(0, y, QString("%1").arg(off, m_addrDigits, 16, QChar('0')).toUpper());
+
+        const QString *text = m_lines.object(off);
+        if (!text) continue;
+        p.setPen(QColor(120, 120, 120));
+        p.drawText(textX, y, text->left(8));
+        const QString insn = text->mid(10);
+        p.setPen(insn.startsWith('.') ? QColor(120, 120, 120)
+               : isBranch(insn.section(' ', 0, 0)) ? QColor(230, 200, 120) : QColor(200, 200, 200));
+        p.drawText(textX + m_charW * 10, y, insn);
+    }
+}
+
+// ── Input ─────────────────────────────────────────────────────────
+
+void DisasmView::mousePressEvent(QMouseEvent *event) {
+    const qint64 line = m_topLine + event->pos().y() / m_rowH;
+    if (line >= lineCount()) return;
+    m_syncing = true;
+    m_editor->goTo(line * 4);
+    m_syncing = false;
+    m_editor->setFocus();
+}
+
+void DisasmView::keyPressEvent(QKeyEvent *event) {
+    switch (event->key()) {
+    case Qt::Key_Down:     setTopLine(m_topLine + 1, true); break;
+    case Qt::Key_Up:       setTopLine(m_topLine - 1, true); break;
+    case Qt::Key_PageDown: setTopLine(m_topLine + visibleLines(), true); break;
+    case Qt::Key_PageUp:   setTopLine(m_topLine - visibleLines(), true); break;
+    default: QAbstractScrollArea::keyPressEvent(event);
+    }
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <QAbstractScrollArea>
+#include <QCache>
+#include <QString>
+#include "Arm64Disasm.h"
+
+class HexEditor;
+
+// A64 listing that follows a HexEditor: same bytes, same scroll position,
+// cursor line highlighted. Only the visible lines plus a prefetch margin are
+// decoded; lines are cached by offset and an edit drops just the words it
+// touched. Clicking a line moves the hex cursor there.
+class DisasmView : public QAbstractScrollArea {
+    Q_OBJECT
+public:
+    explicit DisasmView(HexEditor *editor, QWidget *parent = nullptr);
+
+    QString backend() const { return m_disasm.backend(); }
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void keyPressEvent(QKeyEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    void reset();
+    void onBytesChanged(qint64 offset, qint64 length);
+    void followEditor(qint64 topOffset);
+    void setTopLine(qint64 line, bool syncEditor);
+    void updateMetrics();
+    void decodeRange(qint64 firstLine, qint64 lastLine);
+    int visibleLines() const { return qMax(1, viewport()->height() / m_rowH); }
+    qint64 lineCount() const { return m_size / 4; }
+
+    HexEditor          *m_editor;
+    Arm64Disasm         m_disasm;
+    QCache<qint64, QString> m_lines;   // instruction offset → text, LRU
+    qint64 m_size      = 0;
+    qint64 m_topLine   = 0;
+    qint64 m_lineStep  = 1;            // lines per scrollbar step (> INT_MAX lines)
+    qint64 m_cursor    = -1;
+    bool   m_syncing   = false;        // we are moving the editor; ignore its echo
+
+    int m_charW = 10;
+    int m_charH = 16;
+    int m_rowH  = 20;
+    int m_addrDigits = 8;
+};
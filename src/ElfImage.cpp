@@ -0,0 +1,116 @@
+#include "ElfImage.h"
+
+#include <algorithm>
+#include <cstring>
+
+static constexpr quint8  ELFCLASS32  = 1;
+static constexpr quint8  ELFCLASS64  = 2;
+static constexpr quint8  ELFDATA2LSB = 1;
+static constexpr quint32 PT_LOAD_    = 1;
+static constexpr quint16 PN_XNUM     = 0xFFFF;
+
+template <typename T>
+static T readLe(const char *p) {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+bool ElfImage::isElf(const QByteArray &data) {
+    return data.size() >= 16 && std::memcmp(data.constData(), "\x7F" "ELF", 4) == 0;
+}
+
+bool ElfImage::parse(const QByteArray &data,
+                     QVector<ElfSegment> &segmentsOut,
+                     QString &errorOut)
+{
+    segmentsOut.clear();
+    if (!isElf(data)) {
+        errorOut = "Not an ELF file.";
+        return false;
+    }
+
+    const char *d = data.constData();
+    const quint64 size = data.size();
+    const quint8 cls = quint8(d[4]);
+    if (quint8(d[5]) != ELFDATA2LSB) {
+        errorOut = "Big-endian ELF is not supported.";
+        return false;
+    }
+
+    quint64 phoff;
+    quint16 phentsize, phnum, minEntSize;
+    if (cls == ELFCLASS32) {
+        if (size < 0x34) { errorOut = "Truncated ELF32 header."; return false; }
+        phoff      = readLe<quint32>(d + 0x1C);
+        phentsize  = readLe<quint16>(d + 0x2A);
+        phnum      = readLe<quint16>(d + 0x2C);
+        minEntSize = 0x20;
+    } else if (cls == ELFCLASS64) {
+        if (size < 0x40) { errorOut = "Truncated ELF64 header."; return false; }
+        phoff      = readLe<quint64>(d + 0x20);
+        phentsize  = readLe<quint16>(d + 0x36);
+        phnum      = readLe<quint16>(d + 0x38);
+        minEntSize = 0x38;
+    } else {
+        errorOut = QString("Unknown ELF class %1.").arg(cls);
+        return false;
+    }
+
+    if (phnum == PN_XNUM) {
+        errorOut = "Extended program header count (PN_XNUM) is not supported.";
+        return false;
+    }
+    if (phnum == 0) return true;
+    if (phentsize < minEntSize || phoff > size || quint64(phentsize) * phnum > size - phoff) {
+        errorOut = "Program header table lies outside the file.";
+        return false;
+    }
+
+    for (int i = 0; i < phnum; ++i) {
+        const char *ph = d + phoff + quint64(i) * phentsize;
+        ElfSegment s;
+        s.index = i;
+        s.type  = readLe<quint32>(ph);
+        if (cls == ELFCLASS32) {
+            s.offset   = readLe<quint32>(ph + 0x04);
+            s.vaddr    = readLe<quint32>(ph + 0x08);
+            s.fileSize = readLe<quint32>(ph + 0x10);
+            s.flags    = readLe<quint32>(ph + 0x18);
+        } else {
+            s.flags    = readLe<quint32>(ph + 0x04);
+            s.offset   = readLe<quint64>(ph + 0x08);
+            s.vaddr    = readLe<quint64>(ph + 0x10);
+            s.fileSize = readLe<quint64>(ph + 0x20);
+        }
+        segmentsOut.append(s);
+    }
+    return true;
+}
+
+QVector<ElfSegment> ElfImage::loadSegments(const QByteArray &data) {
+    QVector<ElfSegment> all;
+    QString err;
+    if (!parse(data, all, err)) return {};
+
+    const quint64 size = data.size();
+    QVector<ElfSegment> loads;
+    for (const ElfSegment &s : all) {
+        if (s.type != PT_LOAD_ || s.fileSize == 0 || s.offset >= size) continue;
+        loads.append(s);
+    }
+    std::sort(loads.begin(), loads.end(),
+              [](const ElfSegment &a, const ElfSegment &b) { return a.offset < b.offset; });
+
+    QVector<ElfSegment> result;
+    quint64 covered = 0;
+    for (ElfSegment s : loads) {
+        quint64 end = s.offset + qMin(s.fileSize, size - s.offset);
+        if (s.offset < covered) s.offset = covered;
+        if (end <= s.offset) continue;
+        s.fileSize = end - s.offset;
+        covered = end;
+        result.append(s);
+    }
+    return result;
+}
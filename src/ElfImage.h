@@ -0,0 +1,32 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+// One entry of an ELF program header table
+struct ElfSegment {
+    int     index;      // position in the program header table
+    quint32 type;       // p_type
+    quint32 flags;      // p_flags
+    quint64 offset;     // p_offset
+    quint64 fileSize;   // p_filesz
+    quint64 vaddr;      // p_vaddr
+};
+
+// Minimal little-endian ELF32/ELF64 program header reader. Only what the
+// scanner needs: where the loadable bytes are in the file.
+class ElfImage {
+public:
+    static bool isElf(const QByteArray &data);
+
+    // All program headers. Returns false if `data` is not ELF or the table is
+    // malformed (errorOut says which).
+    static bool parse(const QByteArray &data,
+                      QVector<ElfSegment> &segmentsOut,
+                      QString &errorOut);
+
+    // PT_LOAD segments with file contents, sorted by offset and clipped so
+    // they neither overlap nor run past the end of the file
+    static QVector<ElfSegment> loadSegments(const QByteArray &data);
+};
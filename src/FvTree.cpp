@@ -0,0 +1,524 @@
+#include "FvTree.h"
+#include "HashSegment.h"
+#include "Trace.h"
+
+#include <QMutexLocker>
+#include <cstring>
+
+// ── UEFI PI layout constants ─────────────────────────────────────────────────
+
+static constexpr qint64  FV_SIG_OFFSET       = 0x28;
+static constexpr qint64  FV_MIN_HEADER       = 0x48;
+static constexpr qint64  FFS_HEADER_SIZE     = 24;
+static constexpr qint64  FFS_HEADER2_SIZE    = 32;
+static constexpr quint8  FFS_ATTRIB_LARGE    = 0x01;
+static constexpr quint8  FFS_ATTRIB_CHECKSUM = 0x40;
+static constexpr quint8  FFS_FIXED_CHECKSUM  = 0xAA;
+static constexpr quint8  FFS_TYPE_RAW        = 0x01;
+static constexpr quint8  FFS_TYPE_PAD        = 0xF0;
+
+static constexpr quint8  SECTION_COMPRESSION = 0x01;
+static constexpr quint8  SECTION_GUID        = 0x02;
+static constexpr quint8  SECTION_VERSION     = 0x14;
+static constexpr quint8  SECTION_UI          = 0x15;
+static constexpr quint8  SECTION_FV_IMAGE    = 0x17;
+static constexpr quint8  SECTION_SUBTYPE     = 0x18;
+static constexpr quint16 GUIDED_PROCESSING_REQUIRED = 0x01;
+
+// EE4E5898-3914-4259-9D6E-DC7BD79403CF, in on-disk byte order
+static const quint8 LZMA_GUID[16] = {
+    0x98, 0x58, 0x4E, 0xEE, 0x14, 0x39, 0x59, 0x42,
+    0x9D, 0x6E, 0xDC, 0x7B, 0xD7, 0x94, 0x03, 0xCF
+};
+
+template <typename T>
+static T readLe(const char *p) {
+    T v;
+    std::memcpy(&v, p, sizeof(T));
+    return v;
+}
+
+static quint32 read24(const char *p) {
+    const auto *u = reinterpret_cast<const quint8*>(p);
+    return u[0] | (u[1] << 8) | (u[2] << 16);
+}
+
+static qint64 alignUp(qint64 v, qint64 a) { return (v + a - 1) & ~(a - 1); }
+
+static QString guidString(const char *p) {
+    const auto *u = reinterpret_cast<const quint8*>(p);
+    return QString("%1-%2-%3-%4%5-%6%7%8%9%10%11")
+        .arg(readLe<quint32>(p), 8, 16, QChar('0'))
+        .arg(readLe<quint16>(p + 4), 4, 16, QChar('0'))
+        .arg(readLe<quint16>(p + 6), 4, 16, QChar('0'))
+        .arg(u[8], 2, 16, QChar('0')).arg(u[9], 2, 16, QChar('0'))
+        .arg(u[10], 2, 16, QChar('0')).arg(u[11], 2, 16, QChar('0'))
+        .arg(u[12], 2, 16, QChar('0')).arg(u[13], 2, 16, QChar('0'))
+        .arg(u[14], 2, 16, QChar('0')).arg(u[15], 2, 16, QChar('0'))
+        .toUpper();
+}
+
+static bool looksLikeVolume(const QByteArray &c, qint64 at = 0) {
+    return c.size() - at >= FV_MIN_HEADER
+        && std::memcmp(c.constData() + at + FV_SIG_OFFSET, "_FVH", 4) == 0;
+}
+
+// ── Parsing ──────────────────────────────────────────────────────────────────
+
+static FvNode *newChild(FvNode *parent, FvNodeKind kind, qint64 offset, qint64 size) {
+    FvNode *n = new FvNode(kind);
+    n->parent = parent;
+    n->offset = offset;
+    n->size   = size;
+    parent->children.append(n);
+    return n;
+}
+
+// Walk a section stream in c[begin, end). Returns false if the very first
+// header is implausible (i.e. this isn't a section stream at all).
+static bool parseSections(const QByteArray &c, qint64 begin, qint64 end, FvNode *parent) {
+    const char *d = c.constData();
+    qint64 pos = begin;
+    while (pos + 4 <= end) {
+        qint64 size = read24(d + pos);
+        const quint8 type = quint8(d[pos + 3]);
+        qint64 hdr = 4;
+        if (size == 0xFFFFFF) {
+            if (pos + 8 > end) break;
+            size = readLe<quint32>(d + pos + 4);
+            hdr  = 8;
+        }
+        if (size < hdr || pos + size > end || type == 0 || type == 0xFF) {
+            if (pos == begin) return false;
+            parent->error = QString("Section stream ends in garbage at +0x%1").arg(pos, 0, 16);
+            break;
+        }
+
+        FvNode *s = newChild(parent, FvNodeKind::Section, pos, size);
+        s->type = type;
+        s->headerSize = hdr;
+        switch (type) {
+        case SECTION_COMPRESSION:
+            s->headerSize = qMin(size, hdr + 5);
+            s->opaque = size < hdr + 5 || d[pos + hdr + 4] != 0;   // only "not compressed" is readable
+            break;
+        case SECTION_GUID:
+            if (size >= hdr + 20) {
+                const char *g = d + pos + hdr;
+                s->name = guidString(g);
+                s->headerSize = qBound<qint64>(hdr + 20, readLe<quint16>(g + 16), size);
+                s->compressed = std::memcmp(g, LZMA_GUID, 16) == 0;
+                s->opaque = !s->compressed
+                            && (readLe<quint16>(g + 18) & GUIDED_PROCESSING_REQUIRED);
+            } else {
+                s->opaque = true;
+            }
+            break;
+        case SECTION_VERSION:
+            s->headerSize = qMin(size, hdr + 2);
+            break;
+        case SECTION_SUBTYPE:
+            s->headerSize = qMin(size, hdr + 16);
+            break;
+        case SECTION_UI:
+            s->name = QString::fromUtf16(reinterpret_cast<const char16_t*>(d + pos + hdr),
+                                         (size - hdr) / 2).section(QChar(0), 0, 0);
+            break;
+        default:
+            break;
+        }
+        pos = alignUp(pos + size, 4);
+    }
+    return true;
+}
+
+// UI name of a file whose sections sit directly in its body
+static QString uiNameOf(const QByteArray &fv, qint64 bodyStart, qint64 bodyEnd) {
+    FvNode probe(FvNodeKind::File);
+    if (!parseSections(fv, bodyStart, bodyEnd, &probe)) return QString();
+    for (const FvNode *s : probe.children)
+        if (s->type == SECTION_UI) return s->name;
+    return QString();
+}
+
+static void parseVolume(const QByteArray &c, FvNode *vol) {
+    const char *d = c.constData();
+    const qint64 fvLen  = qMin<qint64>(readLe<quint64>(d + 0x20), c.size());
+    const qint64 hdrLen = readLe<quint16>(d + 0x30);
+    const qint64 extOff = readLe<quint16>(d + 0x34);
+    qint64 pos = hdrLen;
+    if (extOff && extOff + 20 <= fvLen)
+        pos = extOff + readLe<quint32>(d + extOff + 16);
+    pos = alignUp(pos, 8);
+
+    while (pos + FFS_HEADER_SIZE <= fvLen) {
+        const char *h = d + pos;
+        bool erased = true;
+        for (int i = 0; i < FFS_HEADER_SIZE && erased; ++i) erased = quint8(h[i]) == 0xFF;
+        if (erased) break;   // free space
+
+        const quint8 type  = quint8(h[18]);
+        const quint8 attrs = quint8(h[19]);
+        qint64 size = read24(h + 20);
+        qint64 hdr  = FFS_HEADER_SIZE;
+        if (attrs & FFS_ATTRIB_LARGE) {
+            if (pos + FFS_HEADER2_SIZE > fvLen) break;
+            size = readLe<quint64>(h + 24);
+            hdr  = FFS_HEADER2_SIZE;
+        }
+        if (size < hdr || pos + size > fvLen) {
+            vol->error = QString("Malformed FFS file header at +0x%1").arg(pos, 0, 16);
+            break;
+        }
+
+        if (type != FFS_TYPE_PAD) {
+            FvNode *f = newChild(vol, FvNodeKind::File, pos, size);
+            f->type = type;
+            f->headerSize = hdr;
+            f->name = type == FFS_TYPE_RAW ? QString() : uiNameOf(c, pos + hdr, pos + size);
+            if (f->name.isEmpty()) f->name = guidString(h);
+        }
+        pos = alignUp(pos + size, 8);
+    }
+}
+
+// Children of a payload that may be a bare FV or a section stream
+static void parsePayload(const QByteArray &c, FvNode *parent) {
+    if (looksLikeVolume(c)) {
+        FvNode *v = newChild(parent, FvNodeKind::Volume, 0,
+                             qMin<qint64>(readLe<quint64>(c.constData() + 0x20), c.size()));
+        v->name = guidString(c.constData() + 0x10);
+        return;
+    }
+    if (!parseSections(c, 0, c.size(), parent))
+        parent->error = "Payload is neither a firmware volume nor a section stream.";
+}
+
+// ── Checksums ────────────────────────────────────────────────────────────────
+
+static void fixFileChecksum(char *file, qint64 headerSize, qint64 size) {
+    auto *u = reinterpret_cast<quint8*>(file);
+    const quint8 state = u[23];
+    u[16] = 0;
+    u[17] = 0;
+    u[23] = 0;
+    quint8 sum = 0;
+    for (qint64 i = 0; i < headerSize; ++i) sum += u[i];
+    u[16] = quint8(0x100 - sum);
+
+    if (u[19] & FFS_ATTRIB_CHECKSUM) {
+        quint8 body = 0;
+        for (qint64 i = headerSize; i < size; ++i) body += u[i];
+        u[17] = quint8(0x100 - body);
+    } else {
+        u[17] = FFS_FIXED_CHECKSUM;
+    }
+    u[23] = state;
+}
+
+static void fixVolumeChecksum(char *fv, qint64 size) {
+    const qint64 hdrLen = readLe<quint16>(fv + 0x30);
+    if (hdrLen < FV_MIN_HEADER || hdrLen > size || (hdrLen & 1)) return;
+    std::memset(fv + 0x32, 0, 2);
+    quint16 sum = 0;
+    for (qint64 i = 0; i < hdrLen; i += 2) sum += readLe<quint16>(fv + i);
+    const quint16 fix = quint16(0x10000 - sum);
+    std::memcpy(fv + 0x32, &fix, 2);
+}
+
+// A compressed section described as an FvhBlock so FvhParser can decode and
+// re-encode it in place inside the parent's content
+static FvhBlock sectionSlot(const FvNode *n, const QByteArray &parentContent) {
+    FvhBlock b;
+    b.fvhOffset  = n->offset;
+    b.fvStart    = n->offset;
+    b.fvSize     = quint32(n->size);
+    b.raw        = parentContent.mid(n->offset, n->size);
+    b.lzmaOffset = n->headerSize;
+    b.lzmaSize   = n->size - n->headerSize;
+    b.hasLzma    = true;
+    return b;
+}
+
+// ── FvTree ───────────────────────────────────────────────────────────────────
+
+FvTree::FvTree(const QByteArray &image, const QVector<FvhBlock> &blocks)
+    : m_image(image)
+{
+    for (const FvhBlock &b : blocks) addRoot(b);
+}
+
+int FvTree::addRoot(const FvhBlock &block) {
+    QMutexLocker lock(&m_mutex);
+    FvNode *r = new FvNode(FvNodeKind::Block);
+    r->blockIndex = m_blocks.size();
+    r->offset     = block.fvStart;
+    r->size       = block.fvSize;
+    m_blocks.append(block);
+    m_roots.append(r);
+    return r->blockIndex;
+}
+
+int FvTree::adoptRoot(FvTree &from, int index, const FvhBlock &block) {
+    FvNode *r = new FvNode(FvNodeKind::Block);
+    {
+        QMutexLocker lock(&from.m_mutex);
+        r->blockIndex = index;
+        r->offset     = from.m_roots[index]->offset;
+        r->size       = from.m_roots[index]->size;
+        std::swap(r, from.m_roots[index]);
+    }
+    QMutexLocker lock(&m_mutex);
+    r->blockIndex = m_blocks.size();
+    m_blocks.append(block);
+    m_roots.append(r);
+    return r->blockIndex;
+}
+
+FvTree::~FvTree() {
+    qDeleteAll(m_roots);
+}
+
+bool FvTree::loadContent(FvNode *node, QString &errorOut) {
+    if (node->contentLoaded) return true;
+    ABL_TRACE_SPAN("tree_content");
+
+    if (node->kind == FvNodeKind::Block) {
+        const FvhBlock &b = m_blocks[node->blockIndex];
+        QString err;
+        QByteArray payload = FvhParser::decompress(b, err);
+        if (b.hasLzma && !err.isEmpty()) {
+            node->error = errorOut = err;
+            return false;
+        }
+        node->content = payload;
+        node->contentLoaded = true;
+        return true;
+    }
+
+    FvNode *p = node->parent;
+    if (!loadContent(p, errorOut)) return false;
+
+    if (node->compressed) {
+        QString err;
+        const FvhBlock slot = sectionSlot(node, p->content);
+        QByteArray decoded = FvhParser::decompress(slot, err);
+        if (!err.isEmpty()) {
+            node->error = errorOut = "LZMA section: " + err;
+            return false;
+        }
+        node->content = decoded;
+    } else {
+        node->content = p->content.mid(node->offset + node->headerSize, node->size - node->headerSize);
+    }
+    node->contentLoaded = true;
+    return true;
+}
+
+bool FvTree::content(FvNode *node, QByteArray &out, QString &errorOut) {
+    QMutexLocker lock(&m_mutex);
+    if (!loadContent(node, errorOut)) return false;
+    out = node->content;
+    return true;
+}
+
+void FvTree::setBlockContent(int blockIndex, const QByteArray &payload) {
+    QMutexLocker lock(&m_mutex);
+    FvNode *r = m_roots.value(blockIndex);
+    if (!r || r->contentLoaded) return;
+    r->content = payload;
+    r->contentLoaded = true;
+}
+
+void FvTree::releaseContent(FvNode *node) {
+    QMutexLocker lock(&m_mutex);
+    node->content.clear();
+    node->contentLoaded = false;
+}
+
+bool FvTree::loadChildren(FvNode *node, QString &errorOut) {
+    QMutexLocker lock(&m_mutex);
+    if (node->childrenLoaded) return true;
+    if (!loadContent(node, errorOut)) return false;
+    ABL_TRACE_SPAN("tree_expand");
+
+    const QByteArray &c = node->content;
+    switch (node->kind) {
+    case FvNodeKind::Block:
+        parsePayload(c, node);
+        break;
+    case FvNodeKind::Volume:
+        parseVolume(c, node);
+        break;
+    case FvNodeKind::File:
+        if (mayHaveChildren(node) && !parseSections(c, 0, c.size(), node))
+            node->error = "File body is not a section stream.";
+        break;
+    case FvNodeKind::Section:
+        if (mayHaveChildren(node))
+            parsePayload(c, node);
+        break;
+    }
+    node->childrenLoaded = true;
+    return true;
+}
+
+bool FvTree::rebuild(FvNode *node, const QHash<FvNode*, QByteArray> &edited,
+                     const QSet<FvNode*> &onPath, QByteArray &out, QString &errorOut) {
+    auto it = edited.constFind(node);
+    if (it != edited.constEnd()) {
+        out = it.value();
+    } else {
+        if (!loadContent(node, errorOut)) return false;
+        out = node->content;
+        for (FvNode *n : std::as_const(node->children)) {
+            if (!onPath.contains(n) && !edited.contains(n)) continue;
+            QByteArray c;
+            if (!rebuild(n, edited, onPath, c, errorOut)) return false;
+
+            if (n->compressed) {
+                QString err;
+                if (FvhParser::repackInto(out.data(), out.size(), sectionSlot(n, out),
+                                          c.constData(), c.size(), err) < 0) {
+                    errorOut = QString("%1 at +0x%2: %3").arg(label(n)).arg(n->offset, 0, 16).arg(err);
+                    return false;
+                }
+            } else {
+                const qint64 len = n->size - n->headerSize;
+                if (c.size() != len) {
+                    errorOut = QString("%1 changed size (%2 → %3 bytes); only compressed sections can change size.")
+                               .arg(label(n)).arg(len).arg(c.size());
+                    return false;
+                }
+                std::memcpy(out.data() + n->offset + n->headerSize, c.constData(), c.size());
+            }
+            if (n->kind == FvNodeKind::File)
+                fixFileChecksum(out.data() + n->offset, n->headerSize, n->size);
+        }
+    }
+    if (node->kind == FvNodeKind::Volume)
+        fixVolumeChecksum(out.data(), out.size());
+    return true;
+}
+
+QByteArray FvTree::repack(const QVector<Edit> &edits, QString &errorOut) {
+    QMutexLocker lock(&m_mutex);
+    ABL_TRACE_SPAN("tree_repack");
+    if (edits.isEmpty()) {
+        errorOut = "Nothing to repack.";
+        return {};
+    }
+
+    QHash<FvNode*, QByteArray> edited;
+    QSet<FvNode*> onPath;
+    QVector<FvNode*> roots;
+    for (const Edit &e : edits) {
+        edited.insert(e.node, e.content);
+        FvNode *r = e.node;
+        for (FvNode *p = e.node->parent; p; p = p->parent) {
+            onPath.insert(p);
+            r = p;
+        }
+        if (!roots.contains(r)) roots.append(r);
+    }
+    // Both were edited from the decoded bytes; neither holds the other's edits
+    for (const Edit &e : edits) {
+        if (onPath.contains(e.node)) {
+            errorOut = QString("%1 is edited, and so is a node inside it; revert one of them.")
+                       .arg(label(e.node));
+            return {};
+        }
+    }
+
+    QByteArray image = m_image;
+    QVector<FvhParser::RepackEdit> batch;
+    QVector<QPair<qint64, qint64>> rawRanges;
+    for (FvNode *r : std::as_const(roots)) {
+        QByteArray c;
+        if (!rebuild(r, edited, onPath, c, errorOut)) return {};
+        const FvhBlock &b = m_blocks[r->blockIndex];
+        if (b.hasLzma) {
+            FvhParser::RepackEdit edit;
+            edit.block   = b;
+            edit.patched = c;
+            batch.append(edit);
+            continue;
+        }
+        if (c.size() != b.raw.size()) {
+            errorOut = "Raw FV block size changed.";
+            return {};
+        }
+        std::memcpy(image.data() + b.fvStart, c.constData(), c.size());
+        rawRanges.append({ b.fvStart, b.fvStart + c.size() });
+    }
+
+    if (batch.isEmpty()) {
+        QVector<int> stale;
+        HashSegment::refresh(m_image, image.data(), image.size(), rawRanges, stale);
+        return image;
+    }
+    if (!FvhParser::repackBatchInto(m_image, image.data(), image.size(), batch, errorOut, rawRanges))
+        return {};
+    return image;
+}
+
+// ── Presentation ─────────────────────────────────────────────────────────────
+
+bool FvTree::mayHaveChildren(const FvNode *node) {
+    switch (node->kind) {
+    case FvNodeKind::Block:
+    case FvNodeKind::Volume:
+        return true;
+    case FvNodeKind::File:
+        return node->type != FFS_TYPE_RAW && node->type != FFS_TYPE_PAD;
+    case FvNodeKind::Section:
+        if (node->opaque) return false;
+        return node->type == SECTION_FV_IMAGE
+            || node->type == SECTION_COMPRESSION
+            || node->type == SECTION_GUID;
+    }
+    return false;
+}
+
+QString FvTree::kindName(const FvNode *node) {
+    switch (node->kind) {
+    case FvNodeKind::Block:  return "Block";
+    case FvNodeKind::Volume: return "FV";
+    case FvNodeKind::File: {
+        static const char *types[] = {
+            "ALL", "RAW", "FREEFORM", "SEC_CORE", "PEI_CORE", "DXE_CORE", "PEIM",
+            "DRIVER", "COMBINED", "APPLICATION", "MM", "FV_IMAGE"
+        };
+        if (node->type < sizeof(types) / sizeof(types[0])) return types[node->type];
+        return QString("FILE 0x%1").arg(node->type, 2, 16, QChar('0'));
+    }
+    case FvNodeKind::Section:
+        switch (node->type) {
+        case 0x01: return "COMPRESSION";
+        case 0x02: return node->compressed ? "LZMA" : "GUID_DEFINED";
+        case 0x10: return "PE32";
+        case 0x11: return "PIC";
+        case 0x12: return "TE";
+        case 0x13: return "DXE_DEPEX";
+        case 0x14: return "VERSION";
+        case 0x15: return "UI";
+        case 0x16: return "COMPAT16";
+        case 0x17: return "FV_IMAGE";
+        case 0x18: return "FREEFORM";
+        case 0x19: return "RAW";
+        case 0x1B: return "PEI_DEPEX";
+        case 0x1C: return "MM_DEPEX";
+        default:   return QString("SECTION 0x%1").arg(node->type, 2, 16, QChar('0'));
+        }
+    }
+    return QString();
+}
+
+QString FvTree::label(const FvNode *node) {
+    QString text = kindName(node);
+    if (node->kind == FvNodeKind::Block)
+        text += QString(" %1").arg(node->blockIndex + 1);
+    if (!node->name.isEmpty())
+        text += "  " + node->name;
+    return text + QString("  (%1 bytes)").arg(node->size);
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QSet>
+#include <QString>
+#include <QVector>
+#include <QtAlgorithms>
+#include "FvhParser.h"
+
+enum class FvNodeKind {
+    Block,      // top-level _FVH block; content is its decoded LZMA payload
+    Volume,     // nested firmware volume; content is the whole FV
+    File,       // FFS file; content is the file body
+    Section     // FFS section; content is the section body (decoded if compressed)
+};
+
+// One node of the firmware tree. Offsets are relative to the parent's content.
+// Children and content are filled in lazily by FvTree.
+struct FvNode {
+    FvNodeKind kind;
+    FvNode    *parent     = nullptr;
+    int        blockIndex = -1;     // index into the scanned blocks (Block only)
+
+    qint64     offset     = 0;      // start of the node (header included) in the parent's content
+    qint64     size       = 0;      // total size, header included
+    qint64     headerSize = 0;      // bytes before the body
+    quint8     type       = 0;      // FFS file type / section type
+    QString    name;                // GUID, or the UI name for files that have one
+    bool       compressed = false;  // body is an LZMA stream (GUID-defined LZMA section)
+    bool       opaque     = false;  // body needs processing we can't do (other GUIDs, EFI compression)
+
+    bool       contentLoaded  = false;
+    bool       childrenLoaded = false;
+    QByteArray content;
+    QVector<FvNode*> children;
+    QString    error;               // why content or children couldn't be produced
+
+    explicit FvNode(FvNodeKind k) : kind(k) {}
+    ~FvNode() { qDeleteAll(children); }
+    Q_DISABLE_COPY(FvNode)
+};
+
+// Lazily expanded view of every _FVH block in an image: nested volumes, FFS
+// files and sections. Nothing is decoded until content() or loadChildren()
+// asks for that node. Thread-safe; calls are serialised internally.
+class FvTree {
+public:
+    FvTree(const QByteArray &image, const QVector<FvhBlock> &blocks);
+    ~FvTree();
+
+    int     rootCount() const { return m_roots.size(); }
+    FvNode *root(int index) const { return m_roots[index]; }
+
+    // Append a block found after construction (progressive scan); returns its index
+    int addRoot(const FvhBlock &block);
+
+    // Move root `index` of `from`, with everything already decoded and
+    // discovered below it, to the end of this tree as `block` (whose bytes
+    // must be the same). `from` keeps an empty root in its place. Returns
+    // the new index.
+    int adoptRoot(FvTree &from, int index, const FvhBlock &block);
+
+    // Bytes of `node`, decoding/extracting (and caching) on first use.
+    // Returns false and sets errorOut on failure.
+    bool content(FvNode *node, QByteArray &out, QString &errorOut);
+
+    // Seed a block's decoded payload when it was already decoded elsewhere
+    void setBlockContent(int blockIndex, const QByteArray &payload);
+
+    // Forget the cached bytes of `node`; they are decoded again on next use.
+    // Children already discovered stay valid.
+    void releaseContent(FvNode *node);
+
+    // Discover the children of `node`. Loads its content but not theirs.
+    bool loadChildren(FvNode *node, QString &errorOut);
+
+    // One node's new content for repack()
+    struct Edit {
+        FvNode    *node;
+        QByteArray content;
+    };
+
+    // Image with every edit written into its node and every enclosing level
+    // rebuilt: sections re-compressed into their original slots, FFS and FV
+    // checksums updated, the top-level LZMA streams repacked in one batch.
+    // Edits of sibling nodes and of different blocks are combined; a node
+    // can't be edited together with one inside it. The tree itself is not
+    // modified. Returns an empty array on error.
+    QByteArray repack(const QVector<Edit> &edits, QString &errorOut);
+
+    static bool    mayHaveChildren(const FvNode *node);
+    static QString label(const FvNode *node);
+    static QString kindName(const FvNode *node);
+
+private:
+    bool loadContent(FvNode *node, QString &errorOut);
+    // New content of `node` with the edits at and below it applied; `onPath`
+    // holds the nodes enclosing an edit
+    bool rebuild(FvNode *node, const QHash<FvNode*, QByteArray> &edited,
+                 const QSet<FvNode*> &onPath, QByteArray &out, QString &errorOut);
+
+    QByteArray        m_image;
+    QVector<FvhBlock> m_blocks;
+    QVector<FvNode*>  m_roots;
+    QMutex            m_mutex;
+};
@@ -1,104 +1,320 @@
 #include "FvhParser.h"
-#include <functional>
+#include "HashSegment.h"
+#include "Trace.h"
+#include "ElfImage.h"
+#include <QFile>
+#include <QSaveFile>
+#include <QThread>
+#include <QtConcurrent>
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <condition_variable>
 #include <lzma.h>
-#include <QDebug>
+#include <cstdlib>
 #include <cstring>
+#include <memory>
+#include <mutex>
+#include <numeric>
+#include <thread>
 
 static constexpr quint8  LZMA_MAGIC_BYTE  = 0x5D;
 static constexpr quint32 MIN_FV_SIZE      = 32768;
 static constexpr qint64  MAX_DECOMP_SIZE  = 256 * 1024 * 1024; // 256 MiB safety cap
 
+static std::atomic<quint32> s_xzThreads{0};
+static std::atomic<quint64> s_xzMemlimit{0};
+static std::atomic<bool>    s_verifyRepack{true};
+
 FvhParser::FvhParser(const QByteArray &data) : m_data(data) {}
 
+// First "_FVH" starting in [from, end - 4], or -1. Never reads past `end`.
+static qint64 findFvhSig(const char *d, qint64 from, qint64 end) {
+    while (from + 4 <= end) {
+        const void *hit = std::memchr(d + from, '_', end - 3 - from);
+        if (!hit) return -1;
+        from = static_cast<const char *>(hit) - d;
+        if (std::memcmp(d + from, "_FVH", 4) == 0) return from;
+        ++from;
+    }
+    return -1;
+}
+
 QVector<FvhBlock> FvhParser::findBlocks(quint32 minSize) const {
+    return findBlocks(minSize, FvhScanSink());
+}
+
+QVector<FvhBlock> FvhParser::findBlocks(quint32 minSize, const FvhScanSink &sink) const {
+    ABL_TRACE_SPAN("scan");
     QVector<FvhBlock> result;
-    const QByteArray sig = "_FVH";
-    int pos = 0;
+
+    const QVector<ElfSegment> segments = ElfImage::loadSegments(m_data);
+    if (segments.isEmpty()) {
+        scanRange(0, m_data.size(), -1, minSize, sink, 0, m_data.size(), result);
+    } else {
+        qint64 total = 0, scanned = 0;
+        for (const ElfSegment &seg : segments) total += seg.fileSize;
+        for (const ElfSegment &seg : segments) {
+            if (!scanRange(seg.offset, seg.offset + seg.fileSize, seg.index, minSize,
+                           sink, scanned, total, result))
+                break;
+            scanned += seg.fileSize;
+        }
+    }
+
+    ABL_TRACE_COUNT("abl_blocks_found_total", "FV blocks accepted by findBlocks.", result.size());
+    return result;
+}
+
+// Signature search step between progress reports
+static constexpr qint64 SCAN_STEP = 4 * 1024 * 1024;
+
+// Largest FV size field taken at face value
+static constexpr qint64 MAX_FV_SIZE = 128 * 1024 * 1024;
+
+// FV around the _FVH at `pos`, clipped to [begin, end). Tries the known
+// header layouts in turn; false if none has a plausible size. `d` holds the
+// bytes from absolute offset `base` and must cover [pos - 0x28, pos + 0x34)
+// within the range.
+static bool fvExtent(const char *d, qint64 base, qint64 pos, qint64 begin, qint64 end,
+                     quint32 minSize, qint64 &fvStartOut, qint64 &sizeOut)
+{
+    // Try multiple FV start candidates and size offsets
+    struct Candidate { qint64 fvStart; qint64 sizeOff; };
+    Candidate cands[] = {
+        { pos - 0x28, (pos - 0x28) + 0x20 }, // UEFI spec: sig at +0x28, size at +0x20
+        { pos - 0x10, (pos - 0x10) + 0x20 }, // Qualcomm variant
+        { pos - 0x10, pos + 0x30 },            // original guess
+        { pos,        pos + 0x10 },
+    };
+
+    for (auto &c : cands) {
+        if (c.fvStart < begin) c.fvStart = begin;
+        if (c.sizeOff < begin || c.sizeOff + 4 > end) continue;
+
+        quint32 fvSize = 0;
+        std::memcpy(&fvSize, d + (c.sizeOff - base), 4);
+
+        ABL_TRACE_COUNT("abl_fv_candidates_total", "FV header layouts tried per _FVH hit.", 1);
+        if (fvSize == 0 || fvSize > MAX_FV_SIZE || fvSize < minSize) continue;
+
+        qint64 actualSize = qMin((qint64)fvSize, end - c.fvStart);
+        if (actualSize < (qint64)minSize) continue;
+
+        fvStartOut = c.fvStart;
+        sizeOut    = actualSize;
+        return true;
+    }
+    return false;
+}
+
+// Scan [begin, end) for _FVH signatures. FV blocks are clipped to the range,
+// which is one PT_LOAD segment (`segment` >= 0) or the whole file. Returns
+// false if a sink callback stopped the scan.
+bool FvhParser::scanRange(qint64 begin, qint64 end, int segment, quint32 minSize,
+                          const FvhScanSink &sink, qint64 scannedBefore, qint64 total,
+                          QVector<FvhBlock> &result) const
+{
+    ABL_TRACE_COUNT("abl_scanned_bytes_total", "Bytes scanned for _FVH signatures.", end - begin);
+    qint64 pos = begin;
+    bool keepGoing = true;
+
+    auto makeBlock = [&](qint64 fvhPos, qint64 fvStart, qint64 size) {
+        FvhBlock blk;
+        blk.fvhOffset   = fvhPos;
+        blk.fvStart     = fvStart;
+        blk.fvSize      = (quint32)size;
+        blk.raw         = m_data.mid(fvStart, size);
+        blk.lzmaOffset  = -1;
+        blk.lzmaSize    = 0;
+        blk.hasLzma     = false;
+        blk.segment     = segment;
+        blk.segOffset   = segment >= 0 ? begin : 0;
+        blk.segFileSize = segment >= 0 ? end - begin : 0;
+        LzmaParams params;
+        blk.hasLzma = findLzmaStream(blk.raw, blk.lzmaOffset, blk.lzmaSize, params, blk.isXz);
+        result.append(blk);
+        if (sink.block && !sink.block(blk)) keepGoing = false;
+    };
+    auto report = [&](qint64 at) {
+        if (sink.progress && !sink.progress(scannedBefore + (at - begin), total)) keepGoing = false;
+        return keepGoing;
+    };
 
     while (true) {
-        pos = m_data.indexOf(sig, pos);
-        if (pos < 0) break;
-
-        qDebug() << "[FVH] Found _FVH at offset" << QString("0x%1").arg(pos, 8, 16, QChar('0'));
-
-        // Try multiple FV start candidates and size offsets
-        struct Candidate { qint64 fvStart; qint64 sizeOff; };
-        QVector<Candidate> cands = {
-            { pos - 0x28, (pos - 0x28) + 0x20 }, // UEFI spec: sig at +0x28, size at +0x20
-            { pos - 0x10, (pos - 0x10) + 0x20 }, // Qualcomm variant
-            { pos - 0x10, pos + 0x30 },            // original guess
-            { pos,        pos + 0x10 },
-        };
-
-        bool added = false;
-        for (auto &c : cands) {
-            if (c.fvStart < 0) c.fvStart = 0;
-            if (c.sizeOff + 4 > m_data.size()) continue;
-
-            quint32 fvSize = 0;
-            std::memcpy(&fvSize, m_data.constData() + c.sizeOff, 4);
-
-            qDebug() << "  try fvStart=" << QString("0x%1").arg(c.fvStart,0,16)
-                     << "sizeOff=" << QString("0x%1").arg(c.sizeOff,0,16)
-                     << "fvSize=" << fvSize;
-
-            if (fvSize == 0 || fvSize > 128u*1024*1024 || fvSize < minSize) continue;
-
-            qint64 actualSize = qMin((qint64)fvSize, m_data.size() - c.fvStart);
-            if (actualSize < (qint64)minSize) continue;
-
-            FvhBlock blk;
-            blk.fvhOffset  = pos;
-            blk.fvStart    = c.fvStart;
-            blk.fvSize     = (quint32)actualSize;
-            blk.raw        = m_data.mid(c.fvStart, actualSize);
-            blk.lzmaOffset = -1;
-            blk.lzmaSize   = 0;
-            blk.hasLzma    = false;
-            LzmaParams params;
-            blk.hasLzma = findLzmaStream(blk.raw, blk.lzmaOffset, blk.lzmaSize, params);
-            qDebug() << "  -> ACCEPTED hasLzma=" << blk.hasLzma;
-            result.append(blk);
-            added = true;
-            break;
+        // Search a step at a time so progress (and cancellation) keeps up
+        // with long stretches without signatures
+        const qint64 stepEnd = qMin(end, pos + SCAN_STEP);
+        const qint64 hit = findFvhSig(m_data.constData(), pos, stepEnd);
+        if (hit < 0) {
+            if (stepEnd == end) break;
+            pos = stepEnd - 3;   // a signature may straddle the step boundary
+            if (!report(pos)) return false;
+            continue;
+        }
+        pos = hit;
+
+        ABL_TRACE_COUNT("abl_fvh_signatures_total", "_FVH signatures found while scanning.", 1);
+        if (std::binary_search(sink.known.constBegin(), sink.known.constEnd(), pos)) {
+            ++pos;
+            continue;
         }
 
-        if (!added) {
-            // Fallback: add everything from nearest plausible FV start to EOF
-            qint64 fvStart = qMax(0LL, (qint64)pos - 0x28);
-            qint64 actualSize = m_data.size() - fvStart;
-            if (actualSize >= (qint64)minSize) {
-                qDebug() << "  -> fallback raw block";
+        qint64 fvStart = 0, fvSize = 0;
+        if (fvExtent(m_data.constData(), 0, pos, begin, end, minSize, fvStart, fvSize)) {
+            makeBlock(pos, fvStart, fvSize);
+        } else {
+            // Fallback: add everything from nearest plausible FV start to the end of the range
+            fvStart = qMax(begin, pos - 0x28);
+            fvSize  = end - fvStart;
+            if (fvSize >= (qint64)minSize) {
+                ABL_TRACE_COUNT("abl_fv_fallback_blocks_total", "Blocks accepted via the raw-to-end-of-range fallback.", 1);
+                makeBlock(pos, fvStart, fvSize);
+            }
+        }
+        ++pos;
+        if (!report(pos)) return false;
+    }
+    return report(end);
+}
+
+// ── Streaming scan ────────────────────────────────────────────────────────────
+
+// Bytes each worker searches per read; memory stays at one chunk per core
+static constexpr qint64 STREAM_CHUNK = 16 * 1024 * 1024;
+
+QVector<FvhBlock> FvhParser::scanFile(const QString &path, qint64 begin, qint64 end,
+                                      quint32 minSize, const FvhScanSink &sink,
+                                      QString &errorOut)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        errorOut = "Cannot open " + path;
+        return {};
+    }
+    FvhByteSource source;
+    source.name = path;
+    source.size = file.size();
+    source.read = [path](qint64 offset, qint64 length, char *out) {   // own handle per call
+        QFile f(path);
+        return f.open(QIODevice::ReadOnly) && f.seek(offset) && f.read(out, length) == length;
+    };
+    return scanSource(source, begin, end, minSize, sink, errorOut);
+}
+
+QVector<FvhBlock> FvhParser::scanSource(const FvhByteSource &source, qint64 begin, qint64 end,
+                                        quint32 minSize, const FvhScanSink &sink,
+                                        QString &errorOut)
+{
+    ABL_TRACE_SPAN("scan_stream");
+    QVector<FvhBlock> result;
+    end = qMin(end, source.size);
+    if (begin < 0 || begin >= end) return result;
+    ABL_TRACE_COUNT("abl_scanned_bytes_total", "Bytes scanned for _FVH signatures.", end - begin);
+
+    auto readAt = [&source](qint64 offset, qint64 length, QByteArray &out) {
+        out.resize(length);
+        return source.read(offset, length, out.data());
+    };
+
+    struct ChunkHits { QVector<qint64> hits; bool ok = true; };
+    const int workers = qMax(1, QThread::idealThreadCount());
+    QVector<qint64> batch;
+    for (qint64 chunk = begin; chunk < end;) {
+        batch.clear();
+        for (int w = 0; w < workers && chunk < end; ++w, chunk += STREAM_CHUNK) batch.append(chunk);
+
+        // Every chunk is read with the 3 bytes after it, so a signature that
+        // straddles a boundary belongs to the chunk it starts in
+        const QVector<ChunkHits> found = QtConcurrent::blockingMapped<QVector<ChunkHits>>(
+            batch, [&source, end](qint64 start) {
+                ChunkHits r;
+                const qint64 stop = qMin(end, start + STREAM_CHUNK);
+                const qint64 n    = qMin(end, stop + 3) - start;
+                QByteArray buf(n, Qt::Uninitialized);
+                if (!source.read(start, n, buf.data())) {
+                    r.ok = false;
+                    return r;
+                }
+                for (qint64 pos = findFvhSig(buf.constData(), 0, n); pos >= 0 && start + pos < stop;
+                     pos = findFvhSig(buf.constData(), pos + 1, n))
+                    r.hits.append(start + pos);
+                return r;
+            });
+
+        // Only the blocks themselves are read into memory
+        for (int i = 0; i < found.size(); ++i) {
+            if (!found[i].ok) {
+                errorOut = QString("Read error in %1 at 0x%2").arg(source.name).arg(batch[i], 0, 16);
+                return result;
+            }
+            for (qint64 pos : found[i].hits) {
+                ABL_TRACE_COUNT("abl_fvh_signatures_total", "_FVH signatures found while scanning.", 1);
+                if (std::binary_search(sink.known.constBegin(), sink.known.constEnd(), pos)) continue;
+
+                const qint64 hdrStart = qMax(begin, pos - 0x28);
+                QByteArray hdr;
+                if (!readAt(hdrStart, qMin(end, pos + 0x34) - hdrStart, hdr)) {
+                    errorOut = QString("Read error in %1 at 0x%2").arg(source.name).arg(hdrStart, 0, 16);
+                    return result;
+                }
+                // No raw-to-end fallback past MAX_FV_SIZE: the range may be a whole device
+                qint64 fvStart = 0, fvSize = 0;
+                if (!fvExtent(hdr.constData(), hdrStart, pos, begin, end, minSize, fvStart, fvSize)) {
+                    fvStart = hdrStart;
+                    fvSize  = end - fvStart;
+                    if (fvSize < (qint64)minSize || fvSize > MAX_FV_SIZE) continue;
+                    ABL_TRACE_COUNT("abl_fv_fallback_blocks_total", "Blocks accepted via the raw-to-end-of-range fallback.", 1);
+                }
+
                 FvhBlock blk;
                 blk.fvhOffset  = pos;
                 blk.fvStart    = fvStart;
-                blk.fvSize     = (quint32)actualSize;
-                blk.raw        = m_data.mid(fvStart, actualSize);
+                blk.fvSize     = (quint32)fvSize;
                 blk.lzmaOffset = -1;
                 blk.lzmaSize   = 0;
                 blk.hasLzma    = false;
+                if (!readAt(fvStart, fvSize, blk.raw)) {
+                    errorOut = QString("Read error in %1 at 0x%2").arg(source.name).arg(fvStart, 0, 16);
+                    return result;
+                }
                 LzmaParams params;
-                blk.hasLzma = findLzmaStream(blk.raw, blk.lzmaOffset, blk.lzmaSize, params);
+                blk.hasLzma = findLzmaStream(blk.raw, blk.lzmaOffset, blk.lzmaSize, params, blk.isXz);
                 result.append(blk);
-            } else {
-                qDebug() << "  -> REJECTED";
+                if (sink.block && !sink.block(blk)) return result;
             }
         }
-        ++pos;
+        if (sink.progress && !sink.progress(qMin(chunk, end) - begin, end - begin)) return result;
     }
-
-    qDebug() << "[FVH] Total blocks:" << result.size();
     return result;
 }
 
 bool FvhParser::findLzmaStream(const QByteArray &fvRaw,
                                 qint64 &offsetOut,
                                 qint64 &sizeOut,
-                                LzmaParams &paramsOut)
+                                LzmaParams &paramsOut,
+                                bool &xzOut)
 {
+    ABL_TRACE_SPAN("detect_header");
     const auto *d = reinterpret_cast<const quint8*>(fvRaw.constData());
     const qint64 sz = fvRaw.size();
 
+    // .xz containers have a real magic and a CRC-protected stream header, so
+    // check for one before falling back to the LZMA1 props heuristic
+    const QByteArray xzMagic("\xFD" "7zXZ\0", 6);
+    for (qint64 at = fvRaw.indexOf(xzMagic); at >= 0; at = fvRaw.indexOf(xzMagic, at + 1)) {
+        lzma_stream_flags flags;
+        if (sz - at < LZMA_STREAM_HEADER_SIZE || lzma_stream_header_decode(&flags, d + at) != LZMA_OK)
+            continue;
+        std::memset(paramsOut.props, 0, sizeof(paramsOut.props));
+        paramsOut.uncompSize = 0xFFFFFFFFFFFFFFFFULL;
+        offsetOut = at;
+        sizeOut   = sz - at;
+        xzOut     = true;
+        return true;
+    }
+    xzOut = false;
+
     for (qint64 i = 0; i < sz - 13; ++i) {
         quint8 props = d[i];
 
@@ -135,90 +351,197 @@ bool FvhParser::findLzmaStream(const QByteArray &fvRaw,
     return false;
 }
 
-// Try decompressing with a given decoder initializer
-static QByteArray tryDecode(const uint8_t *inData, size_t inSize,
-                             std::function<lzma_ret(lzma_stream*)> initFn,
-                             size_t outBufSize, QString &errOut)
+// ── .xz containers ────────────────────────────────────────────────────────────
+
+struct XzInfo {
+    quint64    uncompressed = 0;
+    quint64    blocks       = 0;
+    quint64    sizedBlocks  = 0;    // blocks whose header records their compressed size
+    quint64    firstBlock   = 0;    // offset of the first block header in the stream
+    lzma_check check        = LZMA_CHECK_NONE;
+};
+
+static void freeFilters(lzma_filter *filters) {
+    for (int i = 0; filters[i].id != LZMA_VLI_UNKNOWN; ++i) {
+        std::free(filters[i].options);
+        filters[i].options = nullptr;
+    }
+}
+
+// Decode the block header at `off`. On success the caller owns the filter
+// options and must release them with freeFilters().
+static bool readXzBlockHeader(const uint8_t *in, size_t size, quint64 off, lzma_check check,
+                              lzma_filter *filters, bool &sizedOut)
 {
-    QByteArray out(outBufSize, '\0');
-    lzma_stream strm = LZMA_STREAM_INIT;
-    lzma_ret ret = initFn(&strm);
-    if (ret != LZMA_OK) {
-        errOut = QString("decoder init failed: %1").arg(ret);
-        return {};
+    if (off >= size || in[off] == 0x00) return false;   // 0x00 starts the index
+    lzma_block blk = {};
+    blk.version     = 1;
+    blk.check       = check;
+    blk.filters     = filters;
+    blk.header_size = lzma_block_header_size_decode(in[off]);
+    if (off + blk.header_size > size) return false;
+    if (lzma_block_header_decode(&blk, nullptr, in + off) != LZMA_OK) return false;
+    sizedOut = blk.compressed_size != LZMA_VLI_UNKNOWN;
+    return true;
+}
+
+// Parse header, footer and index of the .xz stream at the start of `in`. The
+// slot usually continues past the stream (padding), so the footer is found by
+// scanning back for a valid one rather than assumed at the end.
+static bool readXzInfo(const uint8_t *in, size_t size, XzInfo &info, QString &err) {
+    lzma_stream_flags header;
+    if (size < 2 * LZMA_STREAM_HEADER_SIZE || lzma_stream_header_decode(&header, in) != LZMA_OK) {
+        err = "not an .xz stream";
+        return false;
     }
-    strm.next_in   = inData;
-    strm.avail_in  = inSize;
-    strm.next_out  = reinterpret_cast<uint8_t*>(out.data());
-    strm.avail_out = outBufSize;
-    ret = lzma_code(&strm, LZMA_FINISH);
-    size_t outPos = outBufSize - strm.avail_out;
-    lzma_end(&strm);
-    if (ret != LZMA_STREAM_END && ret != LZMA_OK) {
-        // LZMA error codes: 1=OK, 2=STREAM_END, 4=MEM_ERROR, 5=FORMAT_ERROR, 
-        // 6=OPTIONS_ERROR, 7=PROG_ERROR, 8=DATA_ERROR, 9=BUF_ERROR
-        const char* errNames[] = {"OK", "STREAM_END", "MEM_ERROR", "FORMAT_ERROR", 
-                                  "OPTIONS_ERROR", "PROG_ERROR", "DATA_ERROR", "BUF_ERROR"};
-        const char* errName = (ret >= 1 && ret <= 8) ? errNames[ret] : "UNKNOWN";
-        errOut = QString("decode error: %1 (%2)").arg(ret).arg(errName);
-        return {};
+
+    for (size_t end = size & ~size_t(3); end >= 2 * LZMA_STREAM_HEADER_SIZE; end -= 4) {
+        if (in[end - 2] != 'Y' || in[end - 1] != 'Z') continue;
+        lzma_stream_flags footer;
+        if (lzma_stream_footer_decode(&footer, in + end - LZMA_STREAM_HEADER_SIZE) != LZMA_OK
+            || lzma_stream_flags_compare(&header, &footer) != LZMA_OK)
+            continue;
+        if (footer.backward_size > end - 2 * LZMA_STREAM_HEADER_SIZE) continue;
+
+        const size_t indexStart = end - LZMA_STREAM_HEADER_SIZE - footer.backward_size;
+        lzma_index *idx = nullptr;
+        uint64_t memlimit = UINT64_MAX;
+        size_t pos = 0;
+        if (lzma_index_buffer_decode(&idx, &memlimit, nullptr, in + indexStart, &pos,
+                                     footer.backward_size) != LZMA_OK)
+            continue;
+        if (lzma_index_stream_size(idx) != end) {
+            lzma_index_end(idx, nullptr);
+            continue;
+        }
+
+        info = XzInfo();
+        info.uncompressed = lzma_index_uncompressed_size(idx);
+        info.check        = header.check;
+        lzma_index_iter it;
+        lzma_index_iter_init(&it, idx);
+        while (!lzma_index_iter_next(&it, LZMA_INDEX_ITER_BLOCK)) {
+            if (info.blocks++ == 0) info.firstBlock = it.block.compressed_stream_offset;
+            lzma_filter filters[LZMA_FILTERS_MAX + 1];
+            bool sized = false;
+            if (readXzBlockHeader(in, size, it.block.compressed_stream_offset, header.check,
+                                  filters, sized)) {
+                freeFilters(filters);
+                info.sizedBlocks += sized;
+            }
+        }
+        lzma_index_end(idx, nullptr);
+        return true;
     }
-    out.resize(outPos);
-    return out;
+    err = "no valid .xz stream footer/index found";
+    return false;
 }
 
-QByteArray FvhParser::decompress(const FvhBlock &block, QString &errorOut) {
-    if (!block.hasLzma || block.lzmaOffset < 0) {
-        errorOut = "";
-        return block.raw;
-    }
+static lzma_mt xzThreading() {
+    const XzDecodeOptions o = FvhParser::xzDecodeOptions();
+    const uint64_t phys = lzma_physmem();
+    lzma_mt mt = {};
+    mt.threads            = o.threads ? o.threads : qMax<quint32>(1, lzma_cputhreads());
+    mt.memlimit_threading = o.memlimit ? o.memlimit : (phys ? phys / 4 : UINT64_MAX);
+    mt.memlimit_stop      = UINT64_MAX;
+    return mt;
+}
 
-    const auto *inData = reinterpret_cast<const uint8_t*>(
-        block.raw.constData() + block.lzmaOffset);
-    size_t inSize = static_cast<size_t>(block.lzmaSize);
+void FvhParser::setXzDecodeOptions(const XzDecodeOptions &options) {
+    s_xzThreads.store(options.threads);
+    s_xzMemlimit.store(options.memlimit);
+}
 
-    // Read declared uncompressed size from LZMA alone header (bytes 5..12)
-    quint64 uncompSize = 0;
-    if (inSize >= 13) std::memcpy(&uncompSize, inData + 5, 8);
-    bool knownSize = (uncompSize != 0xFFFFFFFFFFFFFFFFULL) && (uncompSize > 0)
-                     && (uncompSize < (quint64)MAX_DECOMP_SIZE);
-    
-    // For unknown size, start with a reasonable buffer and grow if needed
-    size_t outBufSize = knownSize ? (size_t)uncompSize + 4096 : (size_t)(16 * 1024 * 1024);
+XzDecodeOptions FvhParser::xzDecodeOptions() {
+    XzDecodeOptions o;
+    o.threads  = s_xzThreads.load();
+    o.memlimit = s_xzMemlimit.load();
+    return o;
+}
 
-    qDebug() << "[LZMA] lzmaOffset=" << Qt::hex << block.lzmaOffset
-             << "inSize=" << inSize
-             << "uncompSize=" << uncompSize
-             << "props[0]=" << Qt::hex << (uint)inData[0]
-             << "dictSize=" << *reinterpret_cast<const quint32*>(inData+1);
+void FvhParser::setVerifyRepack(bool on) {
+    s_verifyRepack.store(on);
+}
 
-    QString err;
-    QByteArray result;
-
-    // 1. Try lzma_alone_decoder (LZMA1 with .lzma header: props+dictsize+uncompsize)
-    result = tryDecode(inData, inSize,
-        [](lzma_stream *s){ return lzma_alone_decoder(s, UINT64_MAX); },
-        outBufSize, err);
-    if (!result.isEmpty()) {
-        qDebug() << "[LZMA] alone_decoder succeeded, size=" << result.size();
-        return result;
+bool FvhParser::verifyRepack() {
+    return s_verifyRepack.load();
+}
+
+// ── Decoding ──────────────────────────────────────────────────────────────────
+
+static constexpr size_t PROBE_OUTPUT    = 16 * 1024;   // output a candidate must produce to be trusted
+static constexpr size_t PROBE_CHUNK     = 4 * 1024;    // cancellation granularity while probing
+static constexpr int    MAX_HEADER_SKIP = 64;
+
+enum class DecoderKind { Alone, Auto, Xz, Count };
+
+// One way of reading the slot: a decoder type starting `skip` bytes in
+struct Candidate {
+    DecoderKind kind;
+    size_t      skip;
+};
+
+static lzma_ret initDecoder(lzma_stream *s, DecoderKind kind) {
+    switch (kind) {
+    case DecoderKind::Alone: return lzma_alone_decoder(s, UINT64_MAX);
+    case DecoderKind::Auto:  return lzma_auto_decoder(s, UINT64_MAX, 0);
+    case DecoderKind::Xz: {
+        const lzma_mt mt = xzThreading();
+        return lzma_stream_decoder_mt(s, &mt);
+    }
+    default: return LZMA_PROG_ERROR;
+    }
+}
+
+// Probe decoders kept per thread and per decoder type. Re-initialising a live
+// lzma_stream with the same decoder reuses its allocations instead of
+// building everything from scratch per candidate. Only small ones are kept:
+// these threads live as long as the process (GUI, worker, daemon pool), and
+// a dictionary can take 256 MiB that no cache budget accounts for.
+class DecoderPool {
+public:
+    static constexpr uint64_t KeepBytes = 16 * 1024 * 1024;
+
+    static lzma_stream *acquire(DecoderKind kind, lzma_ret &ret) {
+        lzma_stream *s = &pool().m_streams[int(kind)];
+        ret = initDecoder(s, kind);
+        return s;
     }
-    qDebug() << "[LZMA] alone_decoder failed:" << err;
 
-    // 2. Try auto_decoder (handles .lzma, .xz, raw)
-    err.clear();
-    result = tryDecode(inData, inSize,
-        [](lzma_stream *s){ return lzma_auto_decoder(s, UINT64_MAX, 0); },
-        outBufSize, err);
-    if (!result.isEmpty()) {
-        qDebug() << "[LZMA] auto_decoder succeeded, size=" << result.size();
-        return result;
+    // Done with a stream from acquire(); a big one is freed right away
+    static void release(lzma_stream *s) {
+        if (lzma_memusage(s) > KeepBytes) lzma_end(s);
     }
-    qDebug() << "[LZMA] auto_decoder failed:" << err;
 
-    // 3. Scan forward up to 64 bytes to find a better LZMA header start
-    for (int skip = 1; skip <= 64; ++skip) {
-        if ((size_t)skip >= inSize - 13) break;
+private:
+    DecoderPool() { for (lzma_stream &s : m_streams) s = LZMA_STREAM_INIT; }
+    ~DecoderPool() { for (lzma_stream &s : m_streams) lzma_end(&s); }
+
+    static DecoderPool &pool() {
+        thread_local DecoderPool p;
+        return p;
+    }
+
+    lzma_stream m_streams[int(DecoderKind::Count)];
+};
+
+static QString lzmaError(lzma_ret ret) {
+    // LZMA error codes: 1=OK, 2=STREAM_END, 4=MEM_ERROR, 5=FORMAT_ERROR,
+    // 6=OPTIONS_ERROR, 7=PROG_ERROR, 8=DATA_ERROR, 9=BUF_ERROR
+    const char* errNames[] = {"OK", "STREAM_END", "MEM_ERROR", "FORMAT_ERROR",
+                              "OPTIONS_ERROR", "PROG_ERROR", "DATA_ERROR", "BUF_ERROR"};
+    const char* errName = (ret >= 1 && ret <= 8) ? errNames[ret] : "UNKNOWN";
+    return QString("%1 (%2)").arg(ret).arg(errName);
+}
+
+// Every plausible reading of the slot, most likely first: the header where
+// findLzmaStream put it, then LZMA1 headers up to 64 bytes further in.
+static QVector<Candidate> decodeCandidates(const uint8_t *inData, size_t inSize, bool xz) {
+    if (xz) return { { DecoderKind::Xz, 0 } };
+
+    QVector<Candidate> cands = { { DecoderKind::Alone, 0 }, { DecoderKind::Auto, 0 } };
+    for (int skip = 1; skip <= MAX_HEADER_SKIP; ++skip) {
+        if ((size_t)skip + 13 >= inSize) break;
         const uint8_t *p = inData + skip;
         uint8_t props = p[0];
         if (props > 224) continue;
@@ -227,107 +550,687 @@ QByteArray FvhParser::decompress(const FvhBlock &block, QString &errorOut) {
         if (pb > 4 || lp > 4 || lc > 8) continue;
         quint32 dict = 0; std::memcpy(&dict, p+1, 4);
         if (dict < 4096 || dict > 256u*1024*1024) continue;
+        cands.append({ DecoderKind::Alone, (size_t)skip });
+    }
+    return cands;
+}
 
-        err.clear();
-        result = tryDecode(p, inSize - skip,
-            [](lzma_stream *s){ return lzma_alone_decoder(s, UINT64_MAX); },
-            outBufSize, err);
-        if (!result.isEmpty()) {
-            qDebug() << "[LZMA] alone_decoder succeeded at skip=" << skip << "size=" << result.size();
-            return result;
+// Decode only the first PROBE_OUTPUT bytes of candidate `index`. A wrong
+// header offset fails within the first few bytes; a right one produces
+// output. Gives up as soon as an earlier candidate has passed.
+static bool probe(const uint8_t *inData, size_t inSize, const Candidate &c,
+                  int index, const std::atomic<int> &best)
+{
+    ABL_TRACE_SPAN("decode_probe");
+    ABL_TRACE_COUNT("abl_decode_probes_total", "Header candidates checked with a partial decode.", 1);
+    thread_local uint8_t scratch[PROBE_OUTPUT];
+
+    lzma_ret ret;
+    lzma_stream *s = DecoderPool::acquire(c.kind, ret);
+    const std::unique_ptr<lzma_stream, void (*)(lzma_stream *)> back(s, DecoderPool::release);
+    if (ret != LZMA_OK) return false;
+    s->next_in  = inData + c.skip;
+    s->avail_in = inSize - c.skip;
+
+    size_t produced = 0;
+    while (produced < PROBE_OUTPUT) {
+        if (best.load(std::memory_order_relaxed) < index) return false;
+        s->next_out  = scratch + produced;
+        s->avail_out = PROBE_CHUNK;
+        ret = lzma_code(s, LZMA_FINISH);
+        produced += PROBE_CHUNK - s->avail_out;
+        if (ret == LZMA_STREAM_END) return produced > 0;
+        if (ret != LZMA_OK) return false;
+    }
+    return true;
+}
+
+// Decode candidate `c` to the end. With `grow` set the output lives in that
+// array and is enlarged in place (up to MAX_DECOMP_SIZE) when it fills, so an
+// unknown size never restarts the decode; otherwise `out`/`cap` is fixed and
+// noSpaceOut reports a full buffer. The decoder is freed afterwards: its
+// dictionary (and an .xz decoder's threads) would otherwise stay behind.
+static qint64 decodeFull(const uint8_t *inData, size_t inSize, const Candidate &c,
+                         QByteArray *grow, uint8_t *out, size_t cap,
+                         QString &errOut, bool &noSpaceOut)
+{
+    ABL_TRACE_SPAN("decode_attempt");
+    ABL_TRACE_COUNT("abl_decode_attempts_total", "Full LZMA decodes started.", 1);
+    lzma_stream stream = LZMA_STREAM_INIT;
+    lzma_stream *s = &stream;
+    const std::unique_ptr<lzma_stream, void (*)(lzma_stream *)> end(s, lzma_end);
+    lzma_ret ret = initDecoder(s, c.kind);
+    if (ret != LZMA_OK) {
+        errOut = "decoder init failed: " + lzmaError(ret);
+        return -1;
+    }
+    if (grow) {
+        out = reinterpret_cast<uint8_t*>(grow->data());
+        cap = (size_t)grow->size();
+    }
+    s->next_in   = inData + c.skip;
+    s->avail_in  = inSize - c.skip;
+    s->next_out  = out;
+    s->avail_out = cap;
+
+    while (true) {
+        ret = lzma_code(s, LZMA_FINISH);
+        if (ret != LZMA_OK) break;
+        // The threaded decoder may return before the output is full
+        if (s->avail_out > 0) continue;
+
+        if (!grow || cap >= (size_t)MAX_DECOMP_SIZE) {
+            noSpaceOut = true;
+            errOut = QString("output buffer too small (%1 bytes)").arg(cap);
+            return -1;
         }
+        const size_t newCap = qMin(cap * 2, (size_t)MAX_DECOMP_SIZE);
+        grow->resize((qsizetype)newCap);
+        out = reinterpret_cast<uint8_t*>(grow->data());
+        s->next_out  = out + cap;
+        s->avail_out = newCap - cap;
+        cap = newCap;
+    }
+    if (ret != LZMA_STREAM_END) {
+        errOut = "decode error: " + lzmaError(ret);
+        return -1;
+    }
+    return static_cast<qint64>(cap - s->avail_out);
+}
+
+// Probe all candidates in parallel, then fully decode only the earliest one
+// that passed. Should that decode still fail (damage past the probe window),
+// the remaining candidates are probed and tried in order.
+static qint64 decodeBest(const uint8_t *inData, size_t inSize, bool xz,
+                         QByteArray *grow, uint8_t *out, size_t cap,
+                         QString &err, bool &noSpace)
+{
+    noSpace = false;
+    const QVector<Candidate> cands = decodeCandidates(inData, inSize, xz);
+
+    int first = 0;
+    if (cands.size() > 1) {
+        std::atomic<int> best{INT_MAX};
+        QVector<int> order(cands.size());
+        std::iota(order.begin(), order.end(), 0);
+        QtConcurrent::blockingMap(order, [&](int i) {
+            if (best.load(std::memory_order_relaxed) < i) return;
+            if (!probe(inData, inSize, cands[i], i, best)) return;
+            int cur = best.load();
+            while (i < cur && !best.compare_exchange_weak(cur, i)) {}
+        });
+        first = best.load();
+        if (first == INT_MAX) {
+            err = QString("no header candidate decoded cleanly (%1 tried)").arg(cands.size());
+            return -1;
+        }
+    }
+
+    const std::atomic<int> none{INT_MAX};
+    for (int i = first; i < cands.size(); ++i) {
+        if (i != first && !probe(inData, inSize, cands[i], i, none)) continue;
+        err.clear();
+        qint64 n = decodeFull(inData, inSize, cands[i], grow, out, cap, err, noSpace);
+        if (n > 0 || noSpace) return n;
+    }
+    return -1;
+}
+
+qint64 FvhParser::decodedSize(const FvhBlock &block) {
+    if (!block.hasLzma || block.lzmaOffset < 0)
+        return block.raw.size();
+    if (block.lzmaSize < 13)
+        return -1;
+
+    if (block.isXz) {
+        XzInfo info;
+        QString err;
+        const auto *in = reinterpret_cast<const uint8_t*>(block.raw.constData() + block.lzmaOffset);
+        if (!readXzInfo(in, (size_t)block.lzmaSize, info, err)) return -1;
+        return info.uncompressed < (quint64)MAX_DECOMP_SIZE ? (qint64)info.uncompressed : -1;
+    }
+
+    // Declared uncompressed size from LZMA alone header (bytes 5..12)
+    quint64 uncompSize = 0;
+    std::memcpy(&uncompSize, block.raw.constData() + block.lzmaOffset + 5, 8);
+    bool knownSize = (uncompSize != 0xFFFFFFFFFFFFFFFFULL) && (uncompSize > 0)
+                     && (uncompSize < (quint64)MAX_DECOMP_SIZE);
+    return knownSize ? (qint64)uncompSize : -1;
+}
+
+QString FvhParser::decodeStrategy(const FvhBlock &block) {
+    if (!block.hasLzma || block.lzmaOffset < 0)
+        return "No LZMA stream: raw FV bytes, nothing to decode.";
+
+    if (!block.isXz)
+        return "LZMA1 (.lzma alone) stream: one continuous range-coded stream with no "
+               "block boundaries, so it cannot be decoded in parallel; using one thread.";
+
+    XzInfo info;
+    QString err;
+    const auto *in = reinterpret_cast<const uint8_t*>(block.raw.constData() + block.lzmaOffset);
+    if (!readXzInfo(in, (size_t)block.lzmaSize, info, err))
+        return QString("xz stream with unreadable index (%1); decoding on one thread.").arg(err);
+
+    const lzma_mt mt = xzThreading();
+    QString text = QString("xz stream, %1 block(s), %2 bytes").arg(info.blocks).arg(info.uncompressed);
+    if (info.blocks < 2)
+        return text + ": a single block cannot be split; using one thread.";
+    if (info.sizedBlocks < info.blocks)
+        text += QString(", %1 block(s) without recorded sizes decode on one thread")
+                .arg(info.blocks - info.sizedBlocks);
+    if (mt.threads < 2)
+        return text + "; thread limit is 1, decoding on one thread.";
+    return text + QString("; multi-threaded decode with up to %1 thread(s).")
+                  .arg(qMin<quint64>(mt.threads, info.blocks));
+}
+
+QByteArray FvhParser::decompress(const FvhBlock &block, QString &errorOut) {
+    if (!block.hasLzma || block.lzmaOffset < 0) {
+        errorOut = "";
+        return block.raw;
+    }
+
+    const auto *inData = reinterpret_cast<const uint8_t*>(
+        block.raw.constData() + block.lzmaOffset);
+    size_t inSize = static_cast<size_t>(block.lzmaSize);
+
+    // For unknown size, start with a reasonable buffer; it grows during the decode
+    qint64 declared = decodedSize(block);
+    size_t outBufSize = declared >= 0 ? (size_t)declared + 4096 : (size_t)(16 * 1024 * 1024);
+
+    QString err;
+    bool noSpace = false;
+    QByteArray result(outBufSize, Qt::Uninitialized);
+    qint64 n = decodeBest(inData, inSize, block.isXz, &result, nullptr, 0, err, noSpace);
+    if (n > 0) {
+        ABL_TRACE_COUNT("abl_decoded_bytes_total", "Bytes produced by successful decodes.", n);
+        result.resize(n);
+        return result;
     }
 
-    // 4. Nothing worked — return raw bytes so user can inspect
+    // Nothing worked — return raw bytes so user can inspect
     errorOut = QString("LZMA decompression failed with all methods. "
                        "Showing raw FV block bytes for manual inspection. "
                        "Last error: %1").arg(err);
-    qDebug() << "[LZMA] all methods failed, returning raw bytes";
+    ABL_TRACE_COUNT("abl_decode_failures_total", "Blocks no decoder strategy could handle.", 1);
     return block.raw;
 }
 
+qint64 FvhParser::decompressInto(const FvhBlock &block,
+                                 char *out, qint64 capacity,
+                                 QString &errorOut)
+{
+    if (!block.hasLzma || block.lzmaOffset < 0) {
+        if (capacity < block.raw.size()) {
+            errorOut = QString("Output buffer too small (%1 bytes, need %2)")
+                       .arg(capacity).arg(block.raw.size());
+            return -1;
+        }
+        std::memcpy(out, block.raw.constData(), block.raw.size());
+        return block.raw.size();
+    }
+
+    const auto *inData = reinterpret_cast<const uint8_t*>(
+        block.raw.constData() + block.lzmaOffset);
+    QString err;
+    bool noSpace = false;
+    qint64 n = decodeBest(inData, static_cast<size_t>(block.lzmaSize), block.isXz,
+                          nullptr, reinterpret_cast<uint8_t*>(out), (size_t)capacity,
+                          err, noSpace);
+    if (n > 0) {
+        ABL_TRACE_COUNT("abl_decoded_bytes_total", "Bytes produced by successful decodes.", n);
+        return n;
+    }
+
+    errorOut = noSpace
+        ? QString("Output buffer too small (%1 bytes)").arg(capacity)
+        : QString("LZMA decompression failed: %1").arg(err);
+    return -1;
+}
+
+// Set up an .xz encoder that reproduces the original stream's layout: same
+// integrity check, same filter chain (BCJ + LZMA2 dictionary/lc/lp/pb) and
+// the same block size, so a multi-block payload stays parallel-decodable.
+static bool initXzEncoder(lzma_stream *strm, const uint8_t *orig, size_t origSize, QString &err) {
+    XzInfo info;
+    if (!readXzInfo(orig, origSize, info, err)) {
+        err = "Cannot repack .xz stream: " + err;
+        return false;
+    }
+    lzma_filter filters[LZMA_FILTERS_MAX + 1];
+    bool sized = false;
+    if (info.blocks == 0
+        || !readXzBlockHeader(orig, origSize, info.firstBlock, info.check, filters, sized)) {
+        err = "Cannot repack .xz stream: first block header is unreadable.";
+        return false;
+    }
+
+    // Decoded LZMA options only carry dict_size/lc/lp/pb; the encoder needs
+    // the rest from a preset
+    lzma_options_lzma lzmaOpts[LZMA_FILTERS_MAX];
+    void *decoded[LZMA_FILTERS_MAX + 1] = {};
+    for (int i = 0; filters[i].id != LZMA_VLI_UNKNOWN; ++i) {
+        decoded[i] = filters[i].options;
+        if (filters[i].id != LZMA_FILTER_LZMA2 && filters[i].id != LZMA_FILTER_LZMA1) continue;
+        const auto *src = static_cast<const lzma_options_lzma *>(filters[i].options);
+        lzma_lzma_preset(&lzmaOpts[i], LZMA_PRESET_DEFAULT);
+        lzmaOpts[i].dict_size = src->dict_size;
+        lzmaOpts[i].lc        = src->lc;
+        lzmaOpts[i].lp        = src->lp;
+        lzmaOpts[i].pb        = src->pb;
+        filters[i].options    = &lzmaOpts[i];
+    }
+
+    lzma_mt mt = xzThreading();
+    mt.filters    = filters;
+    mt.check      = info.check;
+    mt.block_size = info.blocks > 1 ? (info.uncompressed + info.blocks - 1) / info.blocks : 0;
+    lzma_ret ret = lzma_stream_encoder_mt(strm, &mt);
+
+    for (int i = 0; filters[i].id != LZMA_VLI_UNKNOWN; ++i) std::free(decoded[i]);
+    if (ret != LZMA_OK) {
+        err = QString("lzma_stream_encoder_mt init failed: %1").arg(ret);
+        return false;
+    }
+    return true;
+}
+
+// ── Repack verification ───────────────────────────────────────────────────────
+
+// Decodes the encoder's output on a second thread while it is still being
+// produced and compares it with the encoder's input, so a stream that does
+// not round-trip fails the repack without a separate decode pass afterwards.
+// A dedicated thread rather than the global pool: callers often run repacks
+// on every pool thread, and the check must overlap with its own encode.
+class StreamVerifier {
+public:
+    StreamVerifier(const uint8_t *stream, const uint8_t *expected, size_t expectedSize, bool xz)
+        : m_stream(stream), m_expected(expected), m_expectedSize(expectedSize), m_xz(xz),
+          m_thread([this]() { run(); }) {}
+
+    ~StreamVerifier() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_cancelled = true;
+        }
+        m_cv.notify_one();
+        if (m_thread.joinable()) m_thread.join();
+    }
+
+    // Encoder side: the first `bytes` of the stream are final
+    void publish(size_t bytes) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_published = bytes;
+        }
+        m_cv.notify_one();
+    }
+
+    bool failed() const { return m_failed.load(std::memory_order_relaxed); }
+
+    // Declare the stream complete and wait for the verdict
+    bool finish(size_t bytes, QString &errorOut) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_published = bytes;
+            m_complete  = true;
+        }
+        m_cv.notify_one();
+        m_thread.join();
+        errorOut = m_error;
+        return m_error.isEmpty();
+    }
+
+private:
+    void run() {
+        ABL_TRACE_SPAN("verify");
+        lzma_stream s = LZMA_STREAM_INIT;
+        lzma_ret ret;
+        if (m_xz) {
+            const lzma_mt mt = xzThreading();
+            ret = lzma_stream_decoder_mt(&s, &mt);
+        } else {
+            ret = lzma_alone_decoder(&s, UINT64_MAX);
+        }
+        if (ret != LZMA_OK) {
+            fail(QString("decoder init failed: %1").arg(ret));
+            return;
+        }
+
+        uint8_t buf[64 * 1024];
+        size_t consumed = 0, compared = 0;
+        for (;;) {
+            size_t available;
+            bool complete;
+            {
+                std::unique_lock<std::mutex> lock(m_mutex);
+                m_cv.wait(lock, [&]() { return m_cancelled || m_complete || m_published > consumed; });
+                if (m_cancelled) break;
+                available = m_published;
+                complete  = m_complete;
+            }
+
+            s.next_in  = m_stream + consumed;
+            s.avail_in = available - consumed;
+            do {
+                s.next_out  = buf;
+                s.avail_out = sizeof(buf);
+                ret = lzma_code(&s, complete ? LZMA_FINISH : LZMA_RUN);
+                const size_t n = sizeof(buf) - s.avail_out;
+                if (compared + n > m_expectedSize) {
+                    fail(QString("decodes to more than the %1 input bytes").arg(m_expectedSize));
+                    break;
+                }
+                if (std::memcmp(buf, m_expected + compared, n) != 0) {
+                    size_t at = 0;
+                    while (buf[at] == m_expected[compared + at]) ++at;
+                    fail(QString("decoded byte 0x%1 differs from the input").arg(compared + at, 0, 16));
+                    break;
+                }
+                compared += n;
+            } while (ret == LZMA_OK && (s.avail_out == 0 || complete));
+            consumed = available - s.avail_in;
+
+            if (failed()) break;
+            if (ret == LZMA_STREAM_END) {
+                if (compared != m_expectedSize)
+                    fail(QString("decodes to %1 bytes, expected %2").arg(compared).arg(m_expectedSize));
+                break;
+            }
+            if (ret != LZMA_OK || complete) {
+                fail(ret == LZMA_OK || ret == LZMA_BUF_ERROR ? QString("stream is truncated")
+                                                             : lzmaError(ret));
+                break;
+            }
+        }
+        lzma_end(&s);
+    }
+
+    void fail(const QString &message) {
+        m_error = message;
+        m_failed.store(true, std::memory_order_relaxed);
+    }
+
+    const uint8_t *m_stream;
+    const uint8_t *m_expected;
+    size_t         m_expectedSize;
+    bool           m_xz;
+
+    std::mutex              m_mutex;
+    std::condition_variable m_cv;
+    size_t                  m_published = 0;
+    bool                    m_complete  = false;
+    bool                    m_cancelled = false;
+    std::atomic<bool>       m_failed{false};
+    QString                 m_error;        // written by the verifier thread only
+
+    std::thread             m_thread;       // last: starts once the rest is set up
+};
+
 QByteArray FvhParser::repack(const QByteArray &originalData,
                               const FvhBlock   &block,
                               const QByteArray &patchedBinary,
                               QString          &errorOut)
 {
-    // 1. Compress patchedBinary with original LZMA props
-    const auto *inData = reinterpret_cast<const uint8_t*>(patchedBinary.constData());
-    size_t inSize = patchedBinary.size();
+    ABL_TRACE_SPAN("patch");
+    QByteArray result = originalData;
+    if (repackInto(result.data(), result.size(), block,
+                   patchedBinary.constData(), patchedBinary.size(), errorOut) < 0)
+        return {};
+    QVector<int> stale;   // reported by HashSegment::describe() where it matters
+    HashSegment::refresh(originalData, result.data(), result.size(),
+                         block.fvStart + block.lzmaOffset, block.lzmaSize, stale);
+    return result;
+}
+
+// The block's LZMA slot, where repackInto() may write
+static bool checkSlot(const FvhBlock &block, qint64 imageSize, QString &errorOut) {
+    if (!block.hasLzma || block.lzmaOffset < 0) {
+        errorOut = "Block has no LZMA stream to repack.";
+        return false;
+    }
+    const qint64 patchStart   = block.fvStart + block.lzmaOffset;
+    const qint64 origLzmaSize = block.lzmaSize;
+    if (patchStart < 0 || patchStart + origLzmaSize > imageSize) {
+        errorOut = QString("LZMA slot 0x%1+%2 lies outside the image (%3 bytes).")
+                   .arg(patchStart, 0, 16).arg(origLzmaSize).arg(imageSize);
+        return false;
+    }
+    if (block.segment >= 0
+        && (patchStart < block.segOffset
+            || patchStart + origLzmaSize > block.segOffset + block.segFileSize
+            || block.segOffset + block.segFileSize > imageSize)) {
+        errorOut = QString("LZMA slot 0x%1+%2 is not inside PT_LOAD segment %3 (0x%4+%5).")
+                   .arg(patchStart, 0, 16).arg(origLzmaSize).arg(block.segment)
+                   .arg(block.segOffset, 0, 16).arg(block.segFileSize);
+        return false;
+    }
+    return true;
+}
+
+qint64 FvhParser::repackInto(char *image, qint64 imageSize,
+                             const FvhBlock &block,
+                             const char *patched, qint64 patchedSize,
+                             QString &errorOut)
+{
+    ABL_TRACE_SPAN("encode");
+    if (!checkSlot(block, imageSize, errorOut)) return -1;
+    const qint64 patchStart   = block.fvStart + block.lzmaOffset;
+    const qint64 origLzmaSize = block.lzmaSize;
+
+    // 1. Compress patched bytes with original LZMA props
+    const auto *inData = reinterpret_cast<const uint8_t*>(patched);
+    size_t inSize = static_cast<size_t>(patchedSize);
 
     // Get original props from the raw block
     const auto *origProps = reinterpret_cast<const uint8_t*>(
         block.raw.constData() + block.lzmaOffset);
 
-    lzma_options_lzma opt;
-    lzma_lzma_preset(&opt, LZMA_PRESET_DEFAULT);
-
-    // Decode original props
-    uint8_t props = origProps[0];
-    opt.lc = props % 9;
-    uint8_t rest = props / 9;
-    opt.lp = rest % 5;
-    opt.pb = rest / 5;
-    std::memcpy(&opt.dict_size, origProps + 1, 4);
-
-    lzma_filter filters[2];
-    filters[0].id      = LZMA_FILTER_LZMA1;
-    filters[0].options = &opt;
-    filters[1].id      = LZMA_VLI_UNKNOWN;
+    lzma_stream strm = LZMA_STREAM_INIT;
+    lzma_ret ret;
+    if (block.isXz) {
+        if (!initXzEncoder(&strm, origProps, (size_t)block.lzmaSize, errorOut))
+            return -1;
+    } else {
+        lzma_options_lzma opt;
+        lzma_lzma_preset(&opt, LZMA_PRESET_DEFAULT);
 
-    // Estimate output buffer (compressed is usually smaller, but allow 2x)
-    size_t outBufSize = inSize + inSize / 2 + 65536;
-    QByteArray compressed(outBufSize, '\0');
+        // Decode original props
+        uint8_t props = origProps[0];
+        opt.lc = props % 9;
+        uint8_t rest = props / 9;
+        opt.lp = rest % 5;
+        opt.pb = rest / 5;
+        std::memcpy(&opt.dict_size, origProps + 1, 4);
 
-    lzma_stream strm = LZMA_STREAM_INIT;
-    lzma_ret ret = lzma_alone_encoder(&strm, &opt);
-    if (ret != LZMA_OK) {
-        errorOut = QString("lzma_alone_encoder init failed: %1").arg(ret);
-        return {};
+        ret = lzma_alone_encoder(&strm, &opt);
+        if (ret != LZMA_OK) {
+            errorOut = QString("lzma_alone_encoder init failed: %1").arg(ret);
+            return -1;
+        }
     }
 
-    strm.next_in   = inData;
-    strm.avail_in  = inSize;
-    strm.next_out  = reinterpret_cast<uint8_t*>(compressed.data());
-    strm.avail_out = outBufSize;
+    // 2. Encode directly into the original slot; running out of room there
+    //    means the patched stream doesn't fit. Input goes in chunks so the
+    //    verifier can decode what is already written while encoding goes on.
+    auto *slot = reinterpret_cast<uint8_t*>(image + patchStart);
+    strm.next_out  = slot;
+    strm.avail_out = static_cast<size_t>(origLzmaSize);
+
+    std::unique_ptr<StreamVerifier> verifier;
+    if (s_verifyRepack.load())
+        verifier.reset(new StreamVerifier(slot, inData, inSize, block.isXz));
 
-    ret = lzma_code(&strm, LZMA_FINISH);
-    size_t compSize = outBufSize - strm.avail_out;
+    static constexpr size_t ENCODE_CHUNK = 1024 * 1024;
+    size_t fed = 0;
+    ret = LZMA_OK;
+    while (ret == LZMA_OK && strm.avail_out > 0) {
+        if (strm.avail_in == 0 && fed < inSize) {
+            strm.next_in  = inData + fed;
+            strm.avail_in = qMin(ENCODE_CHUNK, inSize - fed);
+            fed += strm.avail_in;
+        }
+        ret = lzma_code(&strm, fed == inSize ? LZMA_FINISH : LZMA_RUN);
+        if (!verifier) continue;
+        verifier->publish(static_cast<size_t>(origLzmaSize) - strm.avail_out);
+        if (verifier->failed()) break;
+    }
+    if (ret == LZMA_OK && strm.avail_out == 0) {
+        verifier.reset();
+        // Keep encoding into a scratch buffer only to report the real size
+        uint8_t scratch[65536];
+        quint64 overflow = 0;
+        while (ret == LZMA_OK) {
+            strm.next_out  = scratch;
+            strm.avail_out = sizeof(scratch);
+            ret = lzma_code(&strm, LZMA_FINISH);
+            overflow += sizeof(scratch) - strm.avail_out;
+        }
+        lzma_end(&strm);
+        if (ret != LZMA_STREAM_END) {
+            errorOut = QString("LZMA compression failed: %1").arg(ret);
+            return -1;
+        }
+        errorOut = QString("Compressed size (%1 bytes) exceeds original LZMA slot (%2 bytes). "
+                           "Patched binary is too large.")
+                   .arg((quint64)origLzmaSize + overflow).arg(origLzmaSize);
+        return -1;
+    }
+    size_t compSize = static_cast<size_t>(origLzmaSize) - strm.avail_out;
     lzma_end(&strm);
 
+    if (verifier && (ret == LZMA_STREAM_END || verifier->failed())) {
+        QString verr;
+        if (!verifier->finish(compSize, verr)) {
+            ABL_TRACE_COUNT("abl_repack_verify_failures_total",
+                            "Repacked streams that did not decode back to their input.", 1);
+            errorOut = "Repacked LZMA stream does not decode back to the patched binary: " + verr;
+            return -1;
+        }
+    }
     if (ret != LZMA_STREAM_END) {
         errorOut = QString("LZMA compression failed: %1").arg(ret);
-        return {};
+        return -1;
     }
-    compressed.resize(compSize);
 
-    // 2. Check if compressed fits in original slot
-    qint64 origLzmaSize = block.lzmaSize;
-    if ((qint64)compSize > origLzmaSize) {
-        errorOut = QString("Compressed size (%1 bytes) exceeds original LZMA slot (%2 bytes). "
-                           "Patched binary is too large.")
-                   .arg(compSize).arg(origLzmaSize);
-        return {};
+    // 3. Zero-pad the rest of the original LZMA slot
+    if ((qint64)compSize < origLzmaSize) {
+        std::memset(slot + compSize, 0x00, origLzmaSize - compSize);
     }
 
-    // 3. Patch: copy original file, replace LZMA bytes, zero-pad remainder
-    QByteArray result = originalData;
-    qint64 patchStart = block.fvStart + block.lzmaOffset;
+    // 4. Update uncompressed size field in LZMA header (offset +5, 8 bytes LE);
+    //    .xz records sizes in its own index
+    if (!block.isXz) {
+        quint64 uncompSz = static_cast<quint64>(inSize);
+        std::memcpy(slot + 5, &uncompSz, 8);
+    }
 
-    std::memcpy(result.data() + patchStart,
-                compressed.constData(),
-                compSize);
+    ABL_TRACE_COUNT("abl_encoded_bytes_total", "Compressed bytes written by repack.", compSize);
+    return static_cast<qint64>(compSize);
+}
 
-    // Zero-pad the rest of the original LZMA slot
-    if ((qint64)compSize < origLzmaSize) {
-        std::memset(result.data() + patchStart + compSize,
-                    0x00,
-                    origLzmaSize - compSize);
+// ── Batch repack ──────────────────────────────────────────────────────────
+
+bool FvhParser::repackBatchInto(const QByteArray &originalData, char *image, qint64 imageSize,
+                                QVector<RepackEdit> &edits, QString &errorOut,
+                                const QVector<QPair<qint64, qint64>> &alsoChanged)
+{
+    ABL_TRACE_SPAN("patch_batch");
+    if (edits.isEmpty()) {
+        errorOut = "Nothing to repack.";
+        return false;
+    }
+    for (RepackEdit &e : edits) {
+        e.compressedSize = -1;
+        e.error.clear();
     }
 
-    // 4. Update uncompressed size field in LZMA header (offset +5, 8 bytes LE)
-    quint64 uncompSz = static_cast<quint64>(inSize);
-    std::memcpy(result.data() + patchStart + 5, &uncompSz, 8);
+    // Every slot must fit before anything is written: in the image, in its
+    // segment, and clear of every other slot
+    QVector<int> order(edits.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&edits](int a, int b) {
+        return edits[a].block.fvStart + edits[a].block.lzmaOffset
+             < edits[b].block.fvStart + edits[b].block.lzmaOffset;
+    });
+    for (int k = 0; k < order.size(); ++k) {
+        RepackEdit &e = edits[order[k]];
+        if (!checkSlot(e.block, imageSize, e.error)) {
+            errorOut = QString("Block at 0x%1: %2").arg(e.block.fvhOffset, 0, 16).arg(e.error);
+            return false;
+        }
+        if (k == 0) continue;
+        const FvhBlock &prev = edits[order[k - 1]].block;
+        if (prev.fvStart + prev.lzmaOffset + prev.lzmaSize > e.block.fvStart + e.block.lzmaOffset) {
+            e.error  = QString("LZMA slot overlaps the one of the block at 0x%1.")
+                       .arg(prev.fvhOffset, 0, 16);
+            errorOut = QString("Block at 0x%1: %2").arg(e.block.fvhOffset, 0, 16).arg(e.error);
+            return false;
+        }
+    }
 
+    // Slots are disjoint, so every block encodes straight into the image at once
+    RepackEdit *data = edits.data();
+    QtConcurrent::blockingMap(order, [data, image, imageSize](int i) {
+        RepackEdit &e = data[i];
+        e.compressedSize = repackInto(image, imageSize, e.block,
+                                      e.patched.constData(), e.patched.size(), e.error);
+    });
+
+    int failed = 0;
+    for (const RepackEdit &e : edits) {
+        if (e.compressedSize >= 0) continue;
+        if (failed++ == 0)
+            errorOut = QString("Block at 0x%1: %2").arg(e.block.fvhOffset, 0, 16).arg(e.error);
+    }
+    if (failed > 0) {
+        // Roll back: put every original slot back, encoded or not
+        for (const RepackEdit &e : edits) {
+            const qint64 at = e.block.fvStart + e.block.lzmaOffset;
+            std::memcpy(image + at, originalData.constData() + at, size_t(e.block.lzmaSize));
+        }
+        if (failed > 1) errorOut += QString(" (%1 more block(s) failed)").arg(failed - 1);
+        return false;
+    }
+
+    // One pass over exactly the rewritten slots: a segment holding two of
+    // them gets the digest of both edits, not a stale one in between, and
+    // the segments between slots aren't hashed at all
+    QVector<HashSegment::Range> touched = alsoChanged;
+    for (const RepackEdit &e : edits) {
+        const qint64 at = e.block.fvStart + e.block.lzmaOffset;
+        touched.append({ at, at + e.block.lzmaSize });
+    }
+    QVector<int> stale;
+    HashSegment::refresh(originalData, image, imageSize, touched, stale);
+    return true;
+}
+
+QByteArray FvhParser::repackBatch(const QByteArray &originalData,
+                                  QVector<RepackEdit> &edits, QString &errorOut)
+{
+    QByteArray result = originalData;
+    if (!repackBatchInto(originalData, result.data(), result.size(), edits, errorOut))
+        return {};
     return result;
 }
+
+bool FvhParser::repackBatchToFile(const QByteArray &originalData, QVector<RepackEdit> &edits,
+                                  const QString &outPath, QString &errorOut)
+{
+    const QByteArray result = repackBatch(originalData, edits, errorOut);
+    if (result.isEmpty()) return false;
+
+    // Only a complete image replaces the target
+    QSaveFile out(outPath);
+    if (!out.open(QIODevice::WriteOnly)) {
+        errorOut = "Cannot write to " + outPath;
+        return false;
+    }
+    if (out.write(result) != result.size() || !out.commit()) {
+        errorOut = "Cannot write to " + outPath;
+        return false;
+    }
+    return true;
+}
@@ -1,8 +1,10 @@
 #pragma once
 
 #include <QByteArray>
+#include <QPair>
 #include <QString>
 #include <QVector>
+#include <functional>
 
 struct FvhBlock {
     qint64  fvhOffset;      // offset of '_FVH' in original file
@@ -12,6 +14,10 @@ struct FvhBlock {
     qint64  lzmaSize;       // size of LZMA stream
     bool    hasLzma;        // whether a valid LZMA stream was detected
     QByteArray raw;         // raw bytes of the FV block (fvSize bytes from fvStart)
+    bool    isXz = false;    // LZMA stream is an .xz container (LZMA2) rather than LZMA1 "alone"
+    int     segment = -1;   // ELF program header index of the PT_LOAD holding it, -1 if not ELF
+    qint64  segOffset = 0;  // that segment's p_offset
+    qint64  segFileSize = 0;// and p_filesz (clipped to the file)
 };
 
 struct LzmaParams {
@@ -19,29 +25,133 @@ struct LzmaParams {
     quint64 uncompSize;     // uncompressed size from LZMA header (8 bytes LE, may be 0xFFFFFFFFFFFFFFFF)
 };
 
+// Multi-threaded .xz decoding; LZMA1 streams always decode on one thread
+struct XzDecodeOptions {
+    quint32 threads  = 0;   // 0 = one per CPU core
+    quint64 memlimit = 0;   // threading memory limit in bytes; 0 = a quarter of RAM
+};
+
+// Hooks for an incremental findBlocks(). Either callback may be empty; one
+// returning false stops the scan.
+struct FvhScanSink {
+    std::function<bool(const FvhBlock &)>             block;      // each block as soon as it is found
+    std::function<bool(qint64 scanned, qint64 total)> progress;   // bytes covered so far
+    QVector<qint64> known;   // sorted fvhOffsets an interrupted scan already reported; skipped
+};
+
+// Random-access bytes for the streaming scan: a plain file, or the expanded
+// view of a sparse image. read() is called from several threads at once.
+struct FvhByteSource {
+    QString name;   // for error messages
+    qint64  size = 0;
+    std::function<bool(qint64 offset, qint64 length, char *out)> read;
+};
+
 class FvhParser {
 public:
     explicit FvhParser(const QByteArray &data);
 
+    // ELF files are scanned only inside their PT_LOAD segments, so hash,
+    // signature and padding segments are never matched; anything else is
+    // scanned end to end.
     QVector<FvhBlock> findBlocks(quint32 minSize = 32768) const;
+    QVector<FvhBlock> findBlocks(quint32 minSize, const FvhScanSink &sink) const;
+
+    // findBlocks() over [begin, end) of a file too large to load (a full
+    // device dump). Chunks are searched on all cores, a few at a time; only
+    // the FV blocks themselves are read into memory. Offsets in the blocks
+    // are file offsets. A read error stops the scan with errorOut set.
+    static QVector<FvhBlock> scanFile(const QString &path, qint64 begin, qint64 end,
+                                      quint32 minSize, const FvhScanSink &sink,
+                                      QString &errorOut);
+    // The same over any byte source, e.g. a sparse image's expanded view
+    static QVector<FvhBlock> scanSource(const FvhByteSource &source, qint64 begin, qint64 end,
+                                        quint32 minSize, const FvhScanSink &sink,
+                                        QString &errorOut);
 
     // Extract and decompress LZMA from a block
     // Returns decompressed bytes or empty on error
     static QByteArray decompress(const FvhBlock &block, QString &errorOut);
 
+    // Uncompressed size declared in the LZMA header (or the .xz index), or -1 if unknown
+    static qint64 decodedSize(const FvhBlock &block);
+
+    // How decompress() will decode this block, e.g. "xz, 12 blocks, 8 threads"
+    // or why it has to stay single-threaded
+    static QString decodeStrategy(const FvhBlock &block);
+
+    // Process-wide; takes effect for decodes started afterwards
+    static void setXzDecodeOptions(const XzDecodeOptions &options);
+    static XzDecodeOptions xzDecodeOptions();
+
+    // Same as decompress() but writes into a caller-provided buffer instead of
+    // allocating one for the output (the decoders still allocate their own
+    // state). Returns bytes written, or -1 on error.
+    static qint64 decompressInto(const FvhBlock &block,
+                                 char *out, qint64 capacity,
+                                 QString &errorOut);
+
+    // Process-wide, on by default: every repack decodes its new stream on a
+    // second thread while encoding and fails if it differs from the input
+    static void setVerifyRepack(bool on);
+    static bool verifyRepack();
+
     // Compress data back with the same LZMA params, patch into original data
     // originalData is the full abl file; block is the original FvhBlock
+    // The hash segment digest of the touched PT_LOAD segment is updated too
     // Returns modified full abl bytes or empty on error
     static QByteArray repack(const QByteArray &originalData,
                              const FvhBlock   &block,
                              const QByteArray &patchedBinary,
                              QString          &errorOut);
 
+    // Compress patched bytes straight into the LZMA slot of `image`, which must
+    // already hold a copy of the original file. No intermediate buffers.
+    // Returns the compressed size, or -1 on error (slot contents are undefined then).
+    static qint64 repackInto(char *image, qint64 imageSize,
+                             const FvhBlock &block,
+                             const char *patched, qint64 patchedSize,
+                             QString &errorOut);
+
+    // One block's new payload for repackBatch(). compressedSize and error
+    // are filled in per block.
+    struct RepackEdit {
+        FvhBlock   block;
+        QByteArray patched;
+        qint64     compressedSize = -1;
+        QString    error;
+    };
+
+    // Repack several blocks at once. Every slot is checked up front, then all
+    // blocks are encoded concurrently into one copy of the image and the hash
+    // segment is refreshed once, for the segments holding a slot. If any
+    // block fails, nothing is applied.
+    // `image` must hold a copy of originalData, except for `alsoChanged`:
+    // ranges [first, second) the caller already rewrote outside the slots,
+    // whose segments get their digests refreshed in the same pass. On
+    // failure the slots are restored. Returns false on error.
+    static bool repackBatchInto(const QByteArray &originalData, char *image, qint64 imageSize,
+                                QVector<RepackEdit> &edits, QString &errorOut,
+                                const QVector<QPair<qint64, qint64>> &alsoChanged = {});
+
+    // Same, into a new image; empty on error
+    static QByteArray repackBatch(const QByteArray &originalData,
+                                  QVector<RepackEdit> &edits, QString &errorOut);
+
+    // Same, written to `outPath`, which is left untouched on any error
+    static bool repackBatchToFile(const QByteArray &originalData, QVector<RepackEdit> &edits,
+                                  const QString &outPath, QString &errorOut);
+
 private:
+    bool scanRange(qint64 begin, qint64 end, int segment, quint32 minSize,
+                   const FvhScanSink &sink, qint64 scannedBefore, qint64 total,
+                   QVector<FvhBlock> &result) const;
+
     static bool findLzmaStream(const QByteArray &fvRaw,
                                qint64 &offsetOut,
                                qint64 &sizeOut,
-                               LzmaParams &paramsOut);
+                               LzmaParams &paramsOut,
+                               bool &xzOut);
 
     const QByteArray &m_data;
 };
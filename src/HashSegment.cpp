@@ -0,0 +1,133 @@
+#include "HashSegment.h"
+#include "ElfImage.h"
+#include "Sha256.h"
+#include "Trace.h"
+
+#include <QStringList>
+#include <QtConcurrent>
+#include <cstring>
+
+// Segment type in bits 24-26 of p_flags (MI_PBT_SEGMENT_TYPE), 2 = hash table
+static constexpr quint32 PT_LOAD_      = 1;
+static constexpr quint32 SEG_TYPE_MASK = 0x07000000;
+static constexpr quint32 SEG_TYPE_HASH = 0x02000000;
+
+struct Extent { qint64 offset, size; };
+
+// File range of program header `s`, clipped to the file
+static Extent extentOf(const ElfSegment &s, qint64 fileSize) {
+    const qint64 off = qint64(qMin<quint64>(s.offset, quint64(fileSize)));
+    return { off, qint64(qMin<quint64>(s.fileSize, quint64(fileSize - off))) };
+}
+
+static int hashIndex(const QVector<ElfSegment> &phdrs) {
+    for (const ElfSegment &s : phdrs)
+        if ((s.flags & SEG_TYPE_MASK) == SEG_TYPE_HASH) return s.index;
+    return -1;
+}
+
+// Offsets of `digest` within `table`
+static QVector<qint64> occurrences(const char *table, qint64 size, const QByteArray &digest) {
+    QVector<qint64> at;
+    for (qint64 i = 0; i + Sha256::DigestSize <= size; ++i)
+        if (std::memcmp(table + i, digest.constData(), Sha256::DigestSize) == 0) at.append(i);
+    return at;
+}
+
+static bool overlapsAny(const QVector<HashSegment::Range> &ranges, qint64 offset, qint64 size) {
+    for (const HashSegment::Range &r : ranges)
+        if (r.first < offset + size && offset < r.second) return true;
+    return false;
+}
+
+int HashSegment::find(const QByteArray &image) {
+    QVector<ElfSegment> phdrs;
+    QString err;
+    return ElfImage::parse(image, phdrs, err) ? hashIndex(phdrs) : -1;
+}
+
+int HashSegment::refresh(const QByteArray &before, char *image, qint64 imageSize,
+                         qint64 offset, qint64 length, QVector<int> &staleOut)
+{
+    return refresh(before, image, imageSize, { { offset, offset + length } }, staleOut);
+}
+
+int HashSegment::refresh(const QByteArray &before, char *image, qint64 imageSize,
+                         const QVector<Range> &ranges, QVector<int> &staleOut)
+{
+    const QByteArray view = QByteArray::fromRawData(image, imageSize);
+    QVector<ElfSegment> phdrs;
+    QString err;
+    if (!ElfImage::parse(view, phdrs, err)) return 0;
+    const int hs = hashIndex(phdrs);
+    if (hs < 0) return 0;
+    ABL_TRACE_SPAN("rehash");
+    const Extent table = extentOf(phdrs[hs], imageSize);
+
+    // Old and new contents of every touched segment, all hashed at once
+    struct Job { int segment; const char *data; qint64 size; };
+    QVector<Job> jobs;
+    for (const ElfSegment &s : phdrs) {
+        const Extent e = extentOf(s, imageSize);
+        if (s.type != PT_LOAD_ || s.index == hs || e.size == 0) continue;
+        if (!overlapsAny(ranges, e.offset, e.size)) continue;
+        if (e.offset + e.size > before.size()) {
+            staleOut.append(s.index);
+            continue;
+        }
+        jobs.append({ s.index, before.constData() + e.offset, e.size });
+        jobs.append({ s.index, image + e.offset, e.size });
+    }
+    const QVector<QByteArray> digests = QtConcurrent::blockingMapped<QVector<QByteArray>>(
+        jobs, [](const Job &j) { return Sha256::hash(j.data, j.size); });
+
+    int rewritten = 0;
+    for (int i = 0; i < jobs.size(); i += 2) {
+        const QByteArray &was = digests[i], &now = digests[i + 1];
+        if (was == now) continue;
+        const QVector<qint64> at = occurrences(image + table.offset, table.size, was);
+        if (at.size() != 1) {
+            staleOut.append(jobs[i].segment);
+            continue;
+        }
+        std::memcpy(image + table.offset + at.first(), now.constData(), Sha256::DigestSize);
+        ++rewritten;
+    }
+    ABL_TRACE_COUNT("abl_hash_entries_rewritten_total", "Hash table digests rewritten after a repack.", rewritten);
+    return rewritten;
+}
+
+QString HashSegment::describe(const QByteArray &before, const QByteArray &after) {
+    QVector<ElfSegment> phdrs;
+    QString err;
+    if (!ElfImage::parse(after, phdrs, err)) return {};
+    const int hs = hashIndex(phdrs);
+    if (hs < 0) return {};
+    const Extent table = extentOf(phdrs[hs], after.size());
+
+    QVector<ElfSegment> changed;
+    for (const ElfSegment &s : phdrs) {
+        const Extent e = extentOf(s, after.size());
+        if (s.type != PT_LOAD_ || s.index == hs || e.size == 0) continue;
+        if (e.offset + e.size > before.size()
+            || std::memcmp(before.constData() + e.offset, after.constData() + e.offset, size_t(e.size)) != 0)
+            changed.append(s);
+    }
+    if (changed.isEmpty()) return {};
+
+    const QVector<QByteArray> digests = QtConcurrent::blockingMapped<QVector<QByteArray>>(
+        changed, [&after](const ElfSegment &s) {
+            const Extent e = extentOf(s, after.size());
+            return Sha256::hash(after.constData() + e.offset, e.size);
+        });
+    QStringList current, stale;
+    for (int i = 0; i < changed.size(); ++i) {
+        const bool listed = !occurrences(after.constData() + table.offset, table.size, digests[i]).isEmpty();
+        (listed ? current : stale) << QString::number(changed[i].index);
+    }
+    if (stale.isEmpty())
+        return QString("Hash segment: SHA-256 of segment(s) %1 updated (%2).")
+               .arg(current.join(", "), Sha256::backend());
+    return QString("Hash segment: no current digest for segment(s) %1; the image will fail the "
+                   "bootloader's hash check unless verification is off.").arg(stale.join(", "));
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <QByteArray>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+// Signed Qualcomm ELFs (abl.elf among them) carry a hash table segment: an
+// MBN header followed by one digest per program header, which the
+// bootloader checks every loadable segment against. A repack changes a
+// segment, so its digest has to follow. Only SHA-256 tables are handled,
+// and the signature over the table is left alone.
+class HashSegment {
+public:
+    using Range = QPair<qint64, qint64>;   // [first, second)
+
+    // Program header index of the hash table segment, -1 if there is none
+    static int find(const QByteArray &image);
+
+    // `image` is `before` with [offset, offset+length) rewritten. The
+    // PT_LOAD segments overlapping that range are hashed, old and new
+    // contents in parallel, and the digest of each one's old contents is
+    // replaced by that of its new contents. Returns the number of entries
+    // rewritten; segments whose old digest isn't in the table exactly once
+    // (not SHA-256, or stale already) go to staleOut untouched.
+    static int refresh(const QByteArray &before, char *image, qint64 imageSize,
+                       qint64 offset, qint64 length, QVector<int> &staleOut);
+
+    // Same for several rewritten ranges at once: a segment overlapping any of
+    // them is hashed once, the ones between them not at all
+    static int refresh(const QByteArray &before, char *image, qint64 imageSize,
+                       const QVector<Range> &ranges, QVector<int> &staleOut);
+
+    // Log line on the table of a repacked image: whether it holds the
+    // current digest of every segment that changed. Empty without a table
+    // or changes.
+    static QString describe(const QByteArray &before, const QByteArray &after);
+};
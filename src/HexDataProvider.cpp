@@ -0,0 +1,52 @@
+#include "HexDataProvider.h"
+#include "SparseImage.h"
+
+// ── ByteArrayProvider ─────────────────────────────────────────────
+
+bool ByteArrayProvider::readPage(qint64 page, QByteArray &out) {
+    const qint64 start = page * PageSize;
+    if (page < 0 || start >= m_data.size()) return false;
+    // View into m_data; the editor drops its pages whenever a byte is written
+    out = QByteArray::fromRawData(m_data.constData() + start,
+                                  qMin(PageSize, m_data.size() - start));
+    return true;
+}
+
+// ── MappedFileProvider ────────────────────────────────────────────
+
+bool MappedFileProvider::open(const QString &path, QString &errorOut) {
+    m_file.setFileName(path);
+    if (!m_file.open(QIODevice::ReadOnly)) {
+        errorOut = QString("Cannot open %1: %2").arg(path, m_file.errorString());
+        return false;
+    }
+    m_size = m_file.size();
+    if (m_size > 0)
+        m_map = m_file.map(0, m_size);   // nullptr → read() fallback
+    return true;
+}
+
+bool MappedFileProvider::readPage(qint64 page, QByteArray &out) {
+    const qint64 start = page * PageSize;
+    if (page < 0 || start >= m_size) return false;
+    const qint64 len = qMin(PageSize, m_size - start);
+
+    if (m_map) {
+        out = QByteArray::fromRawData(reinterpret_cast<const char*>(m_map) + start, len);
+        return true;
+    }
+    if (!m_file.seek(start)) return false;
+    out = m_file.read(len);
+    return out.size() == len;
+}
+
+// ── SparseImageProvider ───────────────────────────────────────────
+
+qint64 SparseImageProvider::size() const { return m_image->size(); }
+
+bool SparseImageProvider::readPage(qint64 page, QByteArray &out) {
+    const qint64 start = page * PageSize;
+    if (page < 0 || start >= m_image->size()) return false;
+    out.resize(qMin(PageSize, m_image->size() - start));
+    return m_image->read(start, out.size(), out.data());
+}
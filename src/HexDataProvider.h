@@ -0,0 +1,79 @@
+#pragma once
+
+#include <QByteArray>
+#include <QFile>
+#include <QSharedPointer>
+#include <QString>
+
+class SparseImage;
+
+// Byte source behind HexEditor. The editor asks for fixed-size pages and
+// keeps only a handful of them around, so the data never has to be in RAM
+// as a whole.
+class HexDataProvider {
+public:
+    static constexpr qint64 PageSize = 64 * 1024;   // multiple of the row width
+
+    virtual ~HexDataProvider() = default;
+
+    virtual qint64 size() const = 0;
+
+    // Bytes [page * PageSize, +PageSize), shorter for the last page.
+    // Returns false if the page can't be read.
+    virtual bool readPage(qint64 page, QByteArray &out) = 0;
+
+    // Contents to edit in place, nullptr for read-only sources. Pages read
+    // before the call are stale afterwards.
+    virtual char *writableBytes() { return nullptr; }
+    virtual bool isWritable() const { return false; }
+
+    // Whole contents when they already live in memory, nullptr otherwise
+    virtual const QByteArray *bytes() const { return nullptr; }
+};
+
+// In-memory payload (decoded blocks, nested nodes). Shares the caller's
+// buffer until the first edit.
+class ByteArrayProvider : public HexDataProvider {
+public:
+    explicit ByteArrayProvider(const QByteArray &data) : m_data(data) {}
+
+    qint64 size() const override { return m_data.size(); }
+    bool readPage(qint64 page, QByteArray &out) override;
+    char *writableBytes() override { return m_data.data(); }
+    bool isWritable() const override { return true; }
+    const QByteArray *bytes() const override { return &m_data; }
+
+private:
+    QByteArray m_data;
+};
+
+// Read-only file view for images too large to load (raw partition dumps).
+// The file is memory-mapped when possible; the kernel pages in only what is
+// touched. Falls back to seek + read where mapping isn't available.
+class MappedFileProvider : public HexDataProvider {
+public:
+    MappedFileProvider() = default;
+
+    bool open(const QString &path, QString &errorOut);
+
+    qint64 size() const override { return m_size; }
+    bool readPage(qint64 page, QByteArray &out) override;
+
+private:
+    QFile        m_file;
+    const uchar *m_map  = nullptr;
+    qint64       m_size = 0;
+};
+
+// Read-only expanded view of an Android sparse image; unstored blocks
+// (FILL, DONT_CARE) are generated per page.
+class SparseImageProvider : public HexDataProvider {
+public:
+    explicit SparseImageProvider(QSharedPointer<const SparseImage> image) : m_image(std::move(image)) {}
+
+    qint64 size() const override;
+    bool readPage(qint64 page, QByteArray &out) override;
+
+private:
+    QSharedPointer<const SparseImage> m_image;
+};
@@ -1,33 +1,101 @@
 #include "HexEditor.h"
+#include <QApplication>
+#include <QClipboard>
+#include <QContextMenuEvent>
+#include <QInputDialog>
+#include <QMenu>
+#include <QMessageBox>
 #include <QPainter>
+#include <QRegularExpression>
 #include <QScrollBar>
 #include <QKeyEvent>
 #include <QMouseEvent>
 #include <QFontMetrics>
 #include <QFont>
+#include <QSignalBlocker>
+#include <algorithm>
+#include <climits>
+#include <cstring>
+
+// Pages kept decoded/mapped at once; a screenful needs one or two
+static constexpr int kCachedPages = 16;
+
+// Bytes of undo history kept; the oldest steps go first. An edit that would
+// need more than this on its own can't be undone.
+static constexpr qint64 kUndoBudget = 64 * 1024 * 1024;
 
 HexEditor::HexEditor(QWidget *parent) : QAbstractScrollArea(parent) {
     QFont font("Monospace", 10);
     font.setStyleHint(QFont::TypeWriter);
     setFont(font);
     setFocusPolicy(Qt::StrongFocus);
+    m_pages.setMaxCost(kCachedPages);
     updateGeometry();
+    // Only user scrolling reaches this; setTopRow() blocks the signal
+    connect(verticalScrollBar(), &QScrollBar::valueChanged, this, [this](int value) {
+        const qint64 maxTop = qMax<qint64>(0, totalRows() - visibleRows());
+        m_topRow = qMin((qint64)value * m_rowStep, maxTop);
+        emit topOffsetChanged(m_topRow * m_cols);
+        viewport()->update();
+    });
 }
 
 void HexEditor::setData(const QByteArray &data) {
-    m_data = data;
+    setProvider(QSharedPointer<HexDataProvider>(new ByteArrayProvider(data)));
+}
+
+void HexEditor::setProvider(const QSharedPointer<HexDataProvider> &provider) {
+    m_provider = provider;
+    m_pages.clear();
+    m_size = provider ? provider->size() : 0;
+    m_topRow = 0;
     m_cursorOffset = 0;
+    m_selAnchor = -1;
+    m_pressOffset = -1;
     m_modified = false;
+    m_undo.clear();
+    m_undoBytes = 0;
     updateGeometry();
+    setTopRow(0);
+    emit dataReset();
+}
+
+const QByteArray &HexEditor::data() const {
+    static const QByteArray empty;
+    const QByteArray *bytes = m_provider ? m_provider->bytes() : nullptr;
+    return bytes ? *bytes : empty;
+}
+
+const QByteArray *HexEditor::pageFor(qint64 offset) {
+    if (!m_provider || offset < 0 || offset >= m_size) return nullptr;
+    const qint64 page = offset / HexDataProvider::PageSize;
+    if (const QByteArray *cached = m_pages.object(page)) return cached;
+
+    auto *bytes = new QByteArray;
+    if (!m_provider->readPage(page, *bytes)) {
+        delete bytes;
+        return nullptr;
+    }
+    m_pages.insert(page, bytes, 1);
+    return bytes;
+}
+
+void HexEditor::setTopRow(qint64 row) {
+    const qint64 maxTop = qMax<qint64>(0, totalRows() - visibleRows());
+    m_topRow = qBound<qint64>(0, row, maxTop);
+    {
+        QSignalBlocker block(verticalScrollBar());
+        verticalScrollBar()->setValue(int(m_topRow / m_rowStep));
+    }
+    emit topOffsetChanged(m_topRow * m_cols);
     viewport()->update();
 }
 
 void HexEditor::goTo(qint64 offset) {
-    if (offset < 0 || offset >= m_data.size()) return;
+    if (offset < 0 || offset >= m_size) return;
     m_cursorOffset = offset;
-    int row = offset / m_cols;
-    verticalScrollBar()->setValue(row);
-    viewport()->update();
+    setTopRow(offset / m_cols);
+    emit cursorMoved(offset);
 }
 
 void HexEditor::setHighlight(qint64 start, qint64 length) {
@@ -36,24 +104,46 @@ void HexEditor::setHighlight(qint64 start, qint64 length) {
     viewport()->update();
 }
 
+void HexEditor::setMarkers(const QVector<HexMarker> &markers) {
+    m_markers = markers;
+    viewport()->update();
+}
+
+qint64 HexEditor::topOffset() const {
+    return m_topRow * m_cols;
+}
+
+void HexEditor::scrollToOffset(qint64 offset) {
+    if (offset < 0) return;
+    setTopRow(offset / m_cols);
+}
+
 void HexEditor::updateGeometry() {
     QFontMetrics fm(font());
     m_charW = fm.horizontalAdvance('F');
     m_charH = fm.height();
     m_rowH  = m_charH + 4;
     m_cols  = 16;
-    // Address column: 8 hex digits + 2 spaces
-    m_addrW  = m_charW * 10;
+    // Address column: 8 hex digits (more past 4 GiB) + 2 spaces
+    m_addrDigits = 8;
+    while (m_addrDigits < 16 && ((m_size - 1) >> (4 * m_addrDigits)) > 0) ++m_addrDigits;
+    m_addrW  = m_charW * (m_addrDigits + 2);
     // Hex area: "XX " per byte
     m_hexX   = m_addrW;
     // ASCII area after hex
     m_asciiX = m_hexX + m_cols * (m_charW * 3) + m_charW;
 
-    if (!m_data.isEmpty()) {
-        int rows = (m_data.size() + m_cols - 1) / m_cols;
-        verticalScrollBar()->setRange(0, qMax(0, rows - viewport()->height() / m_rowH));
-        verticalScrollBar()->setPageStep(viewport()->height() / m_rowH);
+    // QScrollBar is int-based: past INT_MAX rows one step covers several rows
+    QSignalBlocker block(verticalScrollBar());
+    if (m_size > 0) {
+        const qint64 maxTop = qMax<qint64>(0, totalRows() - visibleRows());
+        m_topRow  = qMin(m_topRow, maxTop);
+        m_rowStep = qMax<qint64>(1, (maxTop + INT_MAX - 1) / INT_MAX);
+        verticalScrollBar()->setRange(0, int(maxTop / m_rowStep));
+        verticalScrollBar()->setPageStep(int(qMax<qint64>(1, visibleRows() / m_rowStep)));
+        verticalScrollBar()->setValue(int(m_topRow / m_rowStep));
     } else {
+        m_rowStep = 1;
         verticalScrollBar()->setRange(0, 0);
     }
     horizontalScrollBar()->setRange(0, 0);
@@ -68,44 +158,69 @@ void HexEditor::paintEvent(QPaintEvent *) {
     QPainter p(viewport());
     p.fillRect(viewport()->rect(), QColor(30, 30, 30));
 
-    if (m_data.isEmpty()) return;
+    if (m_size == 0) return;
 
-    QFontMetrics fm(font());
     p.setFont(font());
 
-    int firstRow = verticalScrollBar()->value();
-    int visRows  = viewport()->height() / m_rowH + 2;
-    int totalRows = (m_data.size() + m_cols - 1) / m_cols;
-
-    for (int row = firstRow; row < qMin(firstRow + visRows, totalRows); ++row) {
-        int y = (row - firstRow) * m_rowH + m_charH;
+    const qint64 lastRow = qMin(m_topRow + visibleRows() + 2, totalRows());
+    for (qint64 row = m_topRow; row < lastRow; ++row) {
+        int y = int(row - m_topRow) * m_rowH + m_charH;
         drawRow(p, row, y);
     }
 }
 
-void HexEditor::drawRow(QPainter &p, int row, int y) {
-    qint64 baseOff = (qint64)row * m_cols;
+void HexEditor::drawRow(QPainter &p, qint64 row, int y) {
+    qint64 baseOff = row * m_cols;
 
     // Address
     p.setPen(QColor(100, 150, 200));
-    p.drawText(0, y, QString("%1").arg(baseOff, 8, 16, QChar('0')).toUpper() + "  ");
+    p.drawText(0, y, QString("%1").arg(baseOff, m_addrDigits, 16, QChar('0')).toUpper() + "  ");
+
+    // Rows never straddle a page (PageSize is a multiple of m_cols)
+    const QByteArray *page = pageFor(baseOff);
+    if (!page) {
+        p.setPen(QColor(200, 90, 90));
+        p.drawText(m_hexX, y, "?? read error");
+        return;
+    }
+    const qint64 pageBase = baseOff - baseOff % HexDataProvider::PageSize;
+
+    // First marker that may overlap this row
+    auto mk = std::upper_bound(m_markers.cbegin(), m_markers.cend(), baseOff,
+        [](qint64 off, const HexMarker &m) { return off < m.start; });
+    if (mk != m_markers.cbegin()) --mk;
+
+    const qint64 selStart = hasSelection() ? selectionStart() : -1;
+    const qint64 selEnd   = selStart + selectionLength();
 
     for (int col = 0; col < m_cols; ++col) {
         qint64 off = baseOff + col;
-        if (off >= m_data.size()) break;
+        if (off >= m_size || off - pageBase >= page->size()) break;
 
-        quint8 byte = static_cast<quint8>(m_data[off]);
+        quint8 byte = static_cast<quint8>(page->at(off - pageBase));
         int hexX = m_hexX + col * m_charW * 3;
         int ascX = m_asciiX + col * m_charW;
 
         // Highlight
         bool inHighlight = m_hlStart >= 0 && off >= m_hlStart && off < m_hlStart + m_hlLen;
         bool isCursor    = (off == m_cursorOffset);
+        bool inSelection = selStart >= 0 && off >= selStart && off < selEnd;
 
+        while (mk != m_markers.cend() && mk->start + mk->length <= off) ++mk;
+        if (mk != m_markers.cend() && off >= mk->start) {
+            p.fillRect(hexX - 1, y - m_charH + 2, m_charW * 3, m_rowH - 2, mk->color);
+            p.fillRect(ascX, y - m_charH + 2, m_charW, m_rowH - 2, mk->color);
+        }
         if (inHighlight) {
             p.fillRect(hexX - 1, y - m_charH + 2, m_charW * 2 + 1, m_rowH - 2,
                        QColor(60, 80, 40));
         }
+        if (inSelection) {
+            // Spans the gap to the next cell so a range reads as one block
+            const int w = (off + 1 < selEnd && col + 1 < m_cols) ? m_charW * 3 : m_charW * 2 + 1;
+            p.fillRect(hexX - 1, y - m_charH + 2, w, m_rowH - 2, QColor(70, 70, 120));
+            p.fillRect(ascX, y - m_charH + 2, m_charW, m_rowH - 2, QColor(70, 70, 120));
+        }
         if (isCursor) {
             p.fillRect(hexX - 1, y - m_charH + 2, m_charW * 2 + 1, m_rowH - 2,
                        QColor(80, 120, 200));
@@ -129,44 +244,78 @@ void HexEditor::drawRow(QPainter &p, int row, int y) {
     }
 }
 
+qint64 HexEditor::offsetAt(const QPoint &pos, bool clamp) const {
+    const int relX = pos.x() - m_hexX;
+    qint64 row = m_topRow + (pos.y() >= 0 ? pos.y() / m_rowH : -1);
+    int col = relX >= 0 ? relX / (m_charW * 3) : -1;
+    if (!clamp && (col < 0 || col >= m_cols)) return -1;
+    col = qBound(0, col, m_cols - 1);
+    if (clamp) row = qBound<qint64>(0, row, totalRows() - 1);
+    const qint64 off = row * m_cols + col;
+    if (off < 0 || off >= m_size) return clamp ? qBound<qint64>(0, off, m_size - 1) : -1;
+    return off;
+}
+
+void HexEditor::moveCursor(qint64 offset, bool extend) {
+    if (extend && m_selAnchor < 0) m_selAnchor = m_cursorOffset;
+    if (!extend) m_selAnchor = -1;
+    m_cursorOffset = qBound<qint64>(0, offset, m_size - 1);
+    m_cursorHiNib  = true;
+    // Scroll into view
+    const qint64 row = m_cursorOffset / m_cols;
+    const int visRows = visibleRows();
+    if (row < m_topRow) setTopRow(row);
+    if (row >= m_topRow + visRows) setTopRow(row - visRows + 1);
+    emit cursorMoved(m_cursorOffset);
+    viewport()->update();
+}
+
 void HexEditor::mousePressEvent(QMouseEvent *event) {
-    if (m_data.isEmpty()) return;
-    int row = verticalScrollBar()->value() + event->pos().y() / m_rowH;
-    int relX = event->pos().x() - m_hexX;
-    if (relX < 0) return;
-    int col = relX / (m_charW * 3);
-    if (col >= m_cols) return;
-    qint64 off = (qint64)row * m_cols + col;
-    if (off >= m_data.size()) return;
+    if (m_size == 0 || event->button() != Qt::LeftButton) return;
+    const qint64 off = offsetAt(event->pos(), false);
+    if (off < 0) return;
+    const bool extend = event->modifiers() & Qt::ShiftModifier;
+    m_pressOffset = extend && m_selAnchor >= 0 ? m_selAnchor : extend ? m_cursorOffset : off;
+    moveCursor(off, extend);
+}
+
+void HexEditor::mouseMoveEvent(QMouseEvent *event) {
+    if (m_size == 0 || m_pressOffset < 0 || !(event->buttons() & Qt::LeftButton)) return;
+    // Dragging past the top or bottom edge scrolls a row at a time
+    if (event->pos().y() < 0) setTopRow(m_topRow - 1);
+    else if (event->pos().y() >= viewport()->height()) setTopRow(m_topRow + 1);
+    const qint64 off = offsetAt(event->pos(), true);
+    if (off == m_cursorOffset) return;
+    m_selAnchor    = m_pressOffset;
     m_cursorOffset = off;
     m_cursorHiNib  = true;
+    emit cursorMoved(off);
     viewport()->update();
 }
 
 void HexEditor::keyPressEvent(QKeyEvent *event) {
-    if (m_data.isEmpty()) return;
-
-    auto move = [&](qint64 delta) {
-        qint64 newOff = qBound(0LL, m_cursorOffset + delta, (qint64)m_data.size() - 1);
-        m_cursorOffset = newOff;
-        m_cursorHiNib  = true;
-        // Scroll into view
-        int row = newOff / m_cols;
-        int firstRow = verticalScrollBar()->value();
-        int visRows  = viewport()->height() / m_rowH;
-        if (row < firstRow) verticalScrollBar()->setValue(row);
-        if (row >= firstRow + visRows) verticalScrollBar()->setValue(row - visRows + 1);
-        viewport()->update();
-    };
+    if (m_size == 0) return;
+
+    if (event->matches(QKeySequence::Copy))      { copyAsHex();  return; }
+    if (event->matches(QKeySequence::Paste))     { pasteHex();   return; }
+    if (event->matches(QKeySequence::Undo))      { undo();       return; }
+    if (event->matches(QKeySequence::SelectAll)) { setSelection(0, m_size); return; }
+
+    const bool shift = event->modifiers() & Qt::ShiftModifier;
+    auto move = [&](qint64 delta) { moveCursor(m_cursorOffset + delta, shift); };
 
     switch (event->key()) {
     case Qt::Key_Right: move(1);      break;
     case Qt::Key_Left:  move(-1);     break;
     case Qt::Key_Down:  move(m_cols); break;
     case Qt::Key_Up:    move(-m_cols);break;
-    case Qt::Key_PageDown: move(m_cols * (viewport()->height() / m_rowH)); break;
-    case Qt::Key_PageUp:   move(-m_cols * (viewport()->height() / m_rowH)); break;
+    case Qt::Key_PageDown: move((qint64)m_cols * visibleRows()); break;
+    case Qt::Key_PageUp:   move(-(qint64)m_cols * visibleRows()); break;
+    case Qt::Key_Home:  if (event->modifiers() & Qt::ControlModifier) move(-m_cursorOffset); break;
+    case Qt::Key_End:   if (event->modifiers() & Qt::ControlModifier) move(m_size - 1 - m_cursorOffset); break;
+    case Qt::Key_Escape: clearSelection(); break;
     default: {
+        if (!editable()) break;
         QString txt = event->text().toUpper();
         if (txt.isEmpty()) break;
         QChar c = txt[0];
@@ -175,21 +324,255 @@ void HexEditor::keyPressEvent(QKeyEvent *event) {
         if (c >= 'A' && c <= 'F') nibble = c.unicode() - 'A' + 10;
         if (nibble < 0) break;
 
-        quint8 cur = static_cast<quint8>(m_data[m_cursorOffset]);
+        const qint64 edited = m_cursorOffset;
+        char *bytes = beginEdit(edited, 1, true);
+        if (!bytes) break;
+        quint8 cur = static_cast<quint8>(bytes[edited]);
+        cur = m_cursorHiNib ? (cur & 0x0F) | (nibble << 4) : (cur & 0xF0) | nibble;
+        bytes[edited] = static_cast<char>(cur);
+        m_selAnchor = -1;
         if (m_cursorHiNib) {
-            cur = (cur & 0x0F) | (nibble << 4);
-            m_data[m_cursorOffset] = static_cast<char>(cur);
             m_cursorHiNib = false;
         } else {
-            cur = (cur & 0xF0) | nibble;
-            m_data[m_cursorOffset] = static_cast<char>(cur);
-            m_cursorHiNib = true;
-            move(1);
+            moveCursor(edited + 1, false);
         }
-        m_modified = true;
-        emit dataChanged();
-        viewport()->update();
+        endEdit(edited, 1);
         break;
     }
     }
 }
+
+void HexEditor::contextMenuEvent(QContextMenuEvent *event) {
+    if (m_size == 0) return;
+    const bool canEdit = editable();
+    const bool sel     = hasSelection();
+
+    QMenu menu(this);
+    menu.addAction("Copy as hex", this, &HexEditor::copyAsHex);
+    menu.addAction("Paste hex", this, &HexEditor::pasteHex)->setEnabled(canEdit);
+    menu.addSeparator();
+    QAction *fill = menu.addAction("Fill…", this, [this]() {
+        promptHex("Fill selection", [this](const QByteArray &b) { return fillSelection(b); });
+    });
+    QAction *x = menu.addAction("XOR with…", this, [this]() {
+        promptHex("XOR selection", [this](const QByteArray &b) { return applyToSelection(ByteOps::Logic::Xor, b); });
+    });
+    QAction *a = menu.addAction("AND with…", this, [this]() {
+        promptHex("AND selection", [this](const QByteArray &b) { return applyToSelection(ByteOps::Logic::And, b); });
+    });
+    QAction *o = menu.addAction("OR with…", this, [this]() {
+        promptHex("OR selection", [this](const QByteArray &b) { return applyToSelection(ByteOps::Logic::Or, b); });
+    });
+    QMenu *swap = menu.addMenu("Byte swap");
+    for (int width : { 2, 4, 8 })
+        swap->addAction(QString("%1-bit").arg(width * 8), this, [this, width]() { swapSelection(width); });
+    for (QAction *act : { fill, x, a, o, swap->menuAction() }) act->setEnabled(canEdit && sel);
+    menu.addSeparator();
+    menu.addAction("Undo", this, &HexEditor::undo)->setEnabled(canEdit && !m_undo.isEmpty());
+    menu.exec(event->globalPos());
+}
+
+void HexEditor::promptHex(const QString &title, const std::function<bool(const QByteArray &)> &op) {
+    bool ok;
+    const QString text = QInputDialog::getText(this, title,
+        "Hex bytes, repeated over the selection (e.g. 1F 20 03 D5):", QLineEdit::Normal, "", &ok);
+    if (!ok || text.isEmpty()) return;
+    QByteArray bytes;
+    if (parseHex(text, bytes)) op(bytes);
+}
+
+// ── Selection ─────────────────────────────────────────────────────
+
+qint64 HexEditor::selectionStart() const {
+    return hasSelection() ? qMin(m_selAnchor, m_cursorOffset) : -1;
+}
+
+qint64 HexEditor::selectionLength() const {
+    return hasSelection() ? qAbs(m_cursorOffset - m_selAnchor) + 1 : 0;
+}
+
+void HexEditor::setSelection(qint64 start, qint64 length) {
+    if (start < 0 || length <= 0 || start >= m_size) return;
+    m_selAnchor    = start;
+    m_cursorOffset = qMin(start + length, m_size) - 1;
+    m_cursorHiNib  = true;
+    emit cursorMoved(m_cursorOffset);
+    viewport()->update();
+}
+
+void HexEditor::clearSelection() {
+    if (m_selAnchor < 0) return;
+    m_selAnchor = -1;
+    viewport()->update();
+}
+
+QByteArray HexEditor::selectedBytes() {
+    const qint64 start = hasSelection() ? selectionStart() : m_cursorOffset;
+    const qint64 end   = hasSelection() ? start + selectionLength() : qMin(start + 1, m_size);
+    QByteArray out;
+    out.reserve(end - start);
+    for (qint64 at = start; at < end; ) {
+        const QByteArray *page = pageFor(at);
+        if (!page) return {};
+        const qint64 inPage = at % HexDataProvider::PageSize;
+        const qint64 n = qMin(page->size() - inPage, end - at);
+        out.append(page->constData() + inPage, n);
+        at += n;
+    }
+    return out;
+}
+
+void HexEditor::copyAsHex() {
+    const QByteArray bytes = selectedBytes();
+    if (!bytes.isEmpty())
+        QApplication::clipboard()->setText(QString::fromLatin1(bytes.toHex(' ').toUpper()));
+}
+
+bool HexEditor::pasteHex() {
+    QByteArray bytes;
+    return parseHex(QApplication::clipboard()->text(), bytes) && paste(bytes);
+}
+
+bool HexEditor::parseHex(const QString &text, QByteArray &out) {
+    static const QRegularExpression separators("[\\s,;]+");
+    static const QRegularExpression nonHex("[^0-9A-Fa-f]");
+    QString hex;
+    for (QString token : text.split(separators, Qt::SkipEmptyParts)) {
+        if (token.startsWith("0x", Qt::CaseInsensitive)) token = token.mid(2);
+        hex += token;
+    }
+    if (hex.isEmpty() || hex.size() % 2 || hex.contains(nonHex)) return false;
+    out = QByteArray::fromHex(hex.toLatin1());
+    return true;
+}
+
+// ── Editing ───────────────────────────────────────────────────────
+
+bool HexEditor::editable() const {
+    return !m_readOnly && m_provider && m_provider->isWritable();
+}
+
+char *HexEditor::beginEdit(qint64 offset, qint64 length, bool typed) {
+    if (!editable() || offset < 0 || length <= 0 || offset + length > m_size) return nullptr;
+    char *bytes = m_provider->writableBytes();
+    if (!bytes) return nullptr;
+
+    // Typing on through a run of bytes stays one step
+    if (typed && !m_undo.isEmpty() && m_undo.last().typed) {
+        UndoStep &last = m_undo.last();
+        const qint64 end = last.offset + last.length;
+        if (offset >= last.offset && offset < end) return bytes;
+        if (offset == end) {
+            last.data.append(bytes[offset]);
+            ++last.length;
+            ++m_undoBytes;
+            return bytes;
+        }
+    }
+
+    if (length > kUndoBudget) {
+        const auto answer = QMessageBox::question(this, "Edit can't be undone",
+            QString("This edit changes %1 MiB, more than the undo history holds (%2 MiB).\n"
+                    "It can't be undone, and earlier undo steps are dropped. Continue?")
+                .arg(length / (1024 * 1024)).arg(kUndoBudget / (1024 * 1024)));
+        if (answer != QMessageBox::Yes) return nullptr;
+        m_undo.clear();
+        m_undoBytes = 0;
+        return bytes;
+    }
+    pushUndo({ UndoStep::Restore, offset, length, QByteArray(bytes + offset, length), 0, typed });
+    return bytes;
+}
+
+char *HexEditor::beginEdit(const UndoStep &inverse) {
+    if (!editable() || inverse.offset < 0 || inverse.length <= 0
+        || inverse.offset + inverse.length > m_size) return nullptr;
+    char *bytes = m_provider->writableBytes();
+    if (!bytes) return nullptr;
+    pushUndo(inverse);
+    return bytes;
+}
+
+void HexEditor::pushUndo(const UndoStep &step) {
+    m_undo.append(step);
+    m_undoBytes += step.data.size();
+    while (m_undoBytes > kUndoBudget) {
+        m_undoBytes -= m_undo.first().data.size();
+        m_undo.removeFirst();
+    }
+}
+
+void HexEditor::endEdit(qint64 offset, qint64 length) {
+    m_pages.clear();   // the write may have detached/moved the buffer
+    m_modified = true;
+    emit bytesChanged(offset, length);
+    emit dataChanged();
+    viewport()->update();
+}
+
+bool HexEditor::fillSelection(const QByteArray &pattern) {
+    if (!hasSelection() || pattern.isEmpty()) return false;
+    const qint64 start = selectionStart(), length = selectionLength();
+    char *bytes = beginEdit(start, length);
+    if (!bytes) return false;
+    ByteOps::fill(bytes + start, length, pattern);
+    endEdit(start, length);
+    return true;
+}
+
+bool HexEditor::applyToSelection(ByteOps::Logic op, const QByteArray &key) {
+    if (!hasSelection() || key.isEmpty()) return false;
+    const qint64 start = selectionStart(), length = selectionLength();
+    // XOR with the same key is its own inverse
+    char *bytes = op == ByteOps::Logic::Xor
+        ? beginEdit({ UndoStep::Xor, start, length, key })
+        : beginEdit(start, length);
+    if (!bytes) return false;
+    ByteOps::apply(op, bytes + start, length, key);
+    endEdit(start, length);
+    return true;
+}
+
+bool HexEditor::swapSelection(int width) {
+    if (!hasSelection() || (width != 2 && width != 4 && width != 8)) return false;
+    const qint64 start = selectionStart(), length = selectionLength() / width * width;
+    if (length == 0) return false;
+    char *bytes = beginEdit({ UndoStep::Swap, start, length, {}, width });
+    if (!bytes) return false;
+    ByteOps::swap(bytes + start, length, width);
+    endEdit(start, length);
+    return true;
+}
+
+bool HexEditor::paste(const QByteArray &bytes) {
+    const qint64 start  = hasSelection() ? selectionStart() : m_cursorOffset;
+    const qint64 length = qMin<qint64>(bytes.size(), m_size - start);
+    char *data = beginEdit(start, length);
+    if (!data) return false;
+    std::memcpy(data + start, bytes.constData(), size_t(length));
+    setSelection(start, length);
+    endEdit(start, length);
+    return true;
+}
+
+bool HexEditor::undo() {
+    if (m_undo.isEmpty() || !editable()) return false;
+    char *bytes = m_provider->writableBytes();
+    if (!bytes) return false;
+    const UndoStep step = m_undo.takeLast();
+    m_undoBytes -= step.data.size();
+    switch (step.kind) {
+    case UndoStep::Restore:
+        std::memcpy(bytes + step.offset, step.data.constData(), size_t(step.length));
+        break;
+    case UndoStep::Xor:
+        ByteOps::apply(ByteOps::Logic::Xor, bytes + step.offset, step.length, step.data);
+        break;
+    case UndoStep::Swap:
+        ByteOps::swap(bytes + step.offset, step.length, step.width);
+        break;
+    }
+    setSelection(step.offset, step.length);
+    endEdit(step.offset, step.length);
+    return true;
+}
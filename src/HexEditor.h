@@ -2,11 +2,28 @@
 
 #include <QAbstractScrollArea>
 #include <QByteArray>
+#include <QCache>
+#include <QColor>
+#include <QSharedPointer>
+#include <QVector>
+#include <functional>
+#include "ByteOps.h"
+#include "HexDataProvider.h"
 
 // Lightweight hex editor widget.
 // Displays bytes as hex + ASCII side by side.
-// Supports editing individual bytes by clicking a hex cell and typing two hex digits.
-// Emits dataChanged() when any byte is modified.
+// Supports editing individual bytes by clicking a hex cell and typing two hex digits,
+// and bulk edits of a selected range (Shift+arrows or drag), each one undo step.
+// Emits dataChanged() once per edit.
+// Bytes come from a HexDataProvider one page at a time, so the view works the
+// same for a decoded payload and for a multi-GB file mapped from disk.
+
+// Background tint for a byte range (diff hunks, search hits, ...)
+struct HexMarker {
+    qint64 start;
+    qint64 length;
+    QColor color;
+};
 
 class HexEditor : public QAbstractScrollArea {
     Q_OBJECT
@@ -14,7 +31,12 @@ public:
     explicit HexEditor(QWidget *parent = nullptr);
 
     void setData(const QByteArray &data);
-    const QByteArray &data() const { return m_data; }
+    void setProvider(const QSharedPointer<HexDataProvider> &provider);
+    QSharedPointer<HexDataProvider> provider() const { return m_provider; }
+
+    // Whole buffer for in-memory providers; empty for file-backed ones
+    const QByteArray &data() const;
+    qint64 size() const { return m_size; }
     bool isModified() const { return m_modified; }
     void clearModified() { m_modified = false; }
 
@@ -24,31 +46,119 @@ public:
     // Highlight a range (e.g., LZMA stream)
     void setHighlight(qint64 start, qint64 length);
 
+    // Tinted ranges drawn under the hex cells; must be sorted by start
+    void setMarkers(const QVector<HexMarker> &markers);
+
+    void setReadOnly(bool readOnly) { m_readOnly = readOnly; }
+    qint64 cursorOffset() const { return m_cursorOffset; }
+
+    // Selected range; drag or Shift+move to select, Esc to clear
+    bool   hasSelection() const { return m_selAnchor >= 0; }
+    qint64 selectionStart() const;
+    qint64 selectionLength() const;
+    void   setSelection(qint64 start, qint64 length);
+    void   clearSelection();
+
+    // Bulk edits of the selection, recorded as one undo step with a single
+    // bytesChanged()/dataChanged(). False when read-only or nothing is selected.
+    // XOR and byte swap are undone by applying them again, at any size. Fill,
+    // AND, OR and paste save the old bytes; past the undo budget they ask
+    // first, can't be undone and drop the earlier history.
+    bool fillSelection(const QByteArray &pattern);    // pattern repeats from the start
+    bool applyToSelection(ByteOps::Logic op, const QByteArray &key);
+    bool swapSelection(int width);                    // 2, 4 or 8
+    // Overwrite from the selection start (or the cursor), clipped at the end
+    bool paste(const QByteArray &bytes);
+    bool undo();
+
+    // The selection, or the byte under the cursor
+    QByteArray selectedBytes();
+    void copyAsHex();
+    bool pasteHex();
+
+    // "DE AD", "dead" or "0xDE, 0xAD"; false if `text` isn't hex bytes
+    static bool parseHex(const QString &text, QByteArray &out);
+
+    // Offset of the first byte in the top visible row
+    qint64 topOffset() const;
+    qint64 visibleBytes() const { return (qint64)visibleRows() * m_cols; }
+    void scrollToOffset(qint64 offset);
+
 signals:
     void dataChanged();
+    void bytesChanged(qint64 offset, qint64 length);   // edit of a specific range
+    void dataReset();                                  // new provider / buffer
+    void cursorMoved(qint64 offset);
+    void topOffsetChanged(qint64 offset);
 
 protected:
     void paintEvent(QPaintEvent *event) override;
     void keyPressEvent(QKeyEvent *event) override;
     void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void contextMenuEvent(QContextMenuEvent *event) override;
     void resizeEvent(QResizeEvent *event) override;
 
 private:
+    // How to take back one edit of [offset, +length)
+    struct UndoStep {
+        enum Kind { Restore, Xor, Swap };
+        Kind       kind;
+        qint64     offset;
+        qint64     length;
+        QByteArray data;        // Restore: bytes before the edit; Xor: the key
+        int        width = 0;   // Swap
+        bool       typed = false;   // nibble typing, extended by the next typed byte
+    };
+
     void updateGeometry();
-    qint64 posToOffset(int x, int y) const;
-    void drawRow(QPainter &p, int row, int y);
+    void drawRow(QPainter &p, qint64 row, int y);
+    void setTopRow(qint64 row);
+    qint64 totalRows() const { return (m_size + m_cols - 1) / m_cols; }
+    int visibleRows() const { return qMax(1, viewport()->height() / m_rowH); }
+
+    // Page holding `offset`, fetched through the cache; nullptr on read error
+    const QByteArray *pageFor(qint64 offset);
+
+    // Byte under `pos` in the hex area; with `clamp`, the nearest byte instead of -1
+    qint64 offsetAt(const QPoint &pos, bool clamp) const;
+    void   moveCursor(qint64 offset, bool extend);
+
+    // Writable buffer with [offset, +length) saved for undo, nullptr if the
+    // view can't be edited or the user declined an edit too large to undo;
+    // endEdit() publishes the change
+    char *beginEdit(qint64 offset, qint64 length, bool typed = false);
+    // Same, for an edit that `inverse` takes back without saving any bytes
+    char *beginEdit(const UndoStep &inverse);
+    void  pushUndo(const UndoStep &step);
+    void  endEdit(qint64 offset, qint64 length);
+    bool  editable() const;
+
+    // Ask for hex bytes and run `op` on them; for the context menu
+    void promptHex(const QString &title, const std::function<bool(const QByteArray &)> &op);
 
-    QByteArray m_data;
+    QSharedPointer<HexDataProvider> m_provider;
+    QCache<qint64, QByteArray>      m_pages;   // page index → bytes, LRU
+    qint64     m_size          = 0;
+    qint64     m_topRow        = 0;
+    qint64     m_rowStep       = 1;      // rows per scrollbar step (files > INT_MAX rows)
     qint64     m_cursorOffset  = 0;
     bool       m_cursorHiNib   = true;   // editing high nibble first
     bool       m_modified      = false;
     qint64     m_hlStart       = -1;
     qint64     m_hlLen         = 0;
+    bool       m_readOnly      = false;
+    qint64     m_selAnchor     = -1;     // other end of the selection, -1 = none
+    qint64     m_pressOffset   = -1;     // byte the left button went down on
+    QVector<HexMarker> m_markers;
+    QVector<UndoStep>  m_undo;
+    qint64     m_undoBytes     = 0;
 
     // Layout constants (computed in updateGeometry)
     int m_charW   = 10;
     int m_charH   = 16;
     int m_cols    = 16;  // bytes per row
+    int m_addrDigits = 8;
     int m_addrW   = 0;
     int m_hexX    = 0;
     int m_asciiX  = 0;
@@ -0,0 +1,49 @@
+#include "ImageDelta.h"
+#include "Trace.h"
+
+#include <QHashFunctions>
+#include <QtConcurrent>
+#include <numeric>
+
+QVector<quint64> ImageDelta::chunkHashes(const QByteArray &image) {
+    ABL_TRACE_SPAN("chunk_hash");
+    QVector<qint64> starts((image.size() + ChunkSize - 1) / ChunkSize);
+    std::iota(starts.begin(), starts.end(), 0);
+    for (qint64 &s : starts) s *= ChunkSize;
+    return QtConcurrent::blockingMapped<QVector<quint64>>(starts, [&image](qint64 start) {
+        const qint64 n = qMin(ChunkSize, image.size() - start);
+        return quint64(qHashBits(image.constData() + start, size_t(n), size_t(n)));
+    });
+}
+
+QVector<ImageDelta::Range> ImageDelta::changedRanges(const QVector<quint64> &before, qint64 beforeSize,
+                                                     const QVector<quint64> &after, qint64 afterSize)
+{
+    QVector<Range> ranges;
+    auto add = [&ranges](qint64 from, qint64 to) {
+        if (!ranges.isEmpty() && ranges.last().second >= from)
+            ranges.last().second = qMax(ranges.last().second, to);
+        else
+            ranges.append({ from, to });
+    };
+    const qint64 common = qMin(before.size(), after.size());
+    for (qint64 i = 0; i < common; ++i)
+        if (before[i] != after[i]) add(i * ChunkSize, qMin((i + 1) * ChunkSize, afterSize));
+    if (beforeSize != afterSize) {   // the last shared chunk may be partial in one of them
+        const qint64 from = qMin(beforeSize, afterSize) / ChunkSize * ChunkSize;
+        add(from, qMax(beforeSize, afterSize));
+    }
+    return ranges;
+}
+
+qint64 ImageDelta::totalBytes(const QVector<Range> &ranges) {
+    qint64 n = 0;
+    for (const Range &r : ranges) n += r.second - r.first;
+    return n;
+}
+
+bool ImageDelta::touches(const QVector<Range> &ranges, qint64 offset, qint64 size) {
+    for (const Range &r : ranges)
+        if (r.first < offset + size && offset < r.second) return true;
+    return false;
+}
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <QByteArray>
+#include <QPair>
+#include <QVector>
+
+// Which byte ranges of an image changed between two loads of the same file.
+// Each load is summarised as one 64-bit hash per fixed-size chunk; comparing
+// two summaries gives the chunk-aligned ranges that differ.
+//
+//   const auto before = ImageDelta::chunkHashes(oldImage);
+//   const auto after  = ImageDelta::chunkHashes(newImage);
+//   const auto ranges = ImageDelta::changedRanges(before, oldImage.size(), after, newImage.size());
+//   if (!ImageDelta::touches(ranges, block.fvStart, block.fvSize)) { /* keep it */ }
+class ImageDelta {
+public:
+    using Range = QPair<qint64, qint64>;   // [first, second)
+
+    static constexpr qint64 ChunkSize = 64 * 1024;
+
+    // Hash of every ChunkSize piece of `image`, computed on all cores
+    static QVector<quint64> chunkHashes(const QByteArray &image);
+
+    // Merged ranges whose chunks differ. Bytes past the shorter image count
+    // as changed, so a file that grew or shrank reports its tail.
+    static QVector<Range> changedRanges(const QVector<quint64> &before, qint64 beforeSize,
+                                        const QVector<quint64> &after, qint64 afterSize);
+
+    static qint64 totalBytes(const QVector<Range> &ranges);
+    static bool   touches(const QVector<Range> &ranges, qint64 offset, qint64 size);
+};
@@ -0,0 +1,197 @@
+#include "Log.h"
+
+#include <QDateTime>
+#include <QFile>
+#include <QStringList>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+namespace Log {
+
+static constexpr int    RING_CAPACITY    = 8192;
+static constexpr int    THROTTLE_PER_SEC = 500;   // Debug/Info messages let through per second
+
+// ── Ring ──────────────────────────────────────────────────────────
+
+Ring::Ring(int capacity) {
+    quint64 n = 2;
+    while (n < quint64(capacity)) n <<= 1;
+    m_slots.reset(new Slot[n]);
+    m_mask = n - 1;
+    for (quint64 i = 0; i < n; ++i) m_slots[i].seq.store(i, std::memory_order_relaxed);
+}
+
+bool Ring::push(Entry &&entry) {
+    quint64 pos = m_head.load(std::memory_order_relaxed);
+    Slot *slot;
+    for (;;) {
+        slot = &m_slots[pos & m_mask];
+        const qint64 diff = qint64(slot->seq.load(std::memory_order_acquire)) - qint64(pos);
+        if (diff == 0) {
+            if (m_head.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) break;
+        } else if (diff < 0) {
+            return false;   // the reader is a whole lap behind
+        } else {
+            pos = m_head.load(std::memory_order_relaxed);
+        }
+    }
+    slot->entry = std::move(entry);
+    slot->seq.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+bool Ring::pop(Entry &out) {
+    Slot &slot = m_slots[m_tail & m_mask];
+    if (slot.seq.load(std::memory_order_acquire) != m_tail + 1) return false;
+    out = std::move(slot.entry);
+    slot.seq.store(m_tail + m_mask + 1, std::memory_order_release);
+    ++m_tail;
+    return true;
+}
+
+// ── Tee ───────────────────────────────────────────────────────────
+
+// Lines handed over by drain() are written and flushed on its own thread
+class Tee {
+public:
+    explicit Tee(const QString &path) : m_file(path) {}
+    ~Tee() {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_stop = true;
+        }
+        m_wake.notify_one();
+        if (m_thread.joinable()) m_thread.join();
+    }
+
+    bool open() {
+        if (!m_file.open(QIODevice::WriteOnly | QIODevice::Append | QIODevice::Text)) return false;
+        m_thread = std::thread([this] { run(); });
+        return true;
+    }
+
+    void post(QByteArray &&lines) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_pending += lines;
+        }
+        m_wake.notify_one();
+    }
+
+private:
+    void run() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        for (;;) {
+            m_wake.wait(lock, [this] { return m_stop || !m_pending.isEmpty(); });
+            QByteArray lines;
+            lines.swap(m_pending);
+            const bool stop = m_stop;
+            lock.unlock();
+            if (!lines.isEmpty()) {
+                m_file.write(lines);
+                m_file.flush();
+            }
+            if (stop) return;
+            lock.lock();
+        }
+    }
+
+    QFile                   m_file;
+    std::thread             m_thread;
+    std::mutex              m_mutex;
+    std::condition_variable m_wake;
+    QByteArray              m_pending;
+    bool                    m_stop = false;
+};
+
+// ── Process-wide log ──────────────────────────────────────────────
+
+static Ring &ring() {
+    static Ring r(RING_CAPACITY);
+    return r;
+}
+
+static std::atomic<quint64> g_throttled{0};
+static std::atomic<quint64> g_dropped{0};
+static std::atomic<qint64>  g_windowStart{0};   // current one-second throttle window
+static std::atomic<int>     g_windowCount{0};
+
+static std::mutex           g_teeMutex;
+static std::unique_ptr<Tee> g_tee;
+
+void write(Level level, const QString &text) {
+    const qint64 now = QDateTime::currentMSecsSinceEpoch();
+    if (level <= Info) {
+        qint64 start = g_windowStart.load(std::memory_order_relaxed);
+        if (now - start >= 1000 && g_windowStart.compare_exchange_strong(start, now))
+            g_windowCount.store(0, std::memory_order_relaxed);
+        if (g_windowCount.fetch_add(1, std::memory_order_relaxed) >= THROTTLE_PER_SEC) {
+            g_throttled.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+    Entry e;
+    e.msecs = now;
+    e.level = level;
+    e.text  = text;
+    if (!ring().push(std::move(e)))
+        g_dropped.fetch_add(1, std::memory_order_relaxed);
+}
+
+int drain(QVector<Entry> &out, int max) {
+    const int first = out.size();
+    const quint64 throttled = g_throttled.exchange(0, std::memory_order_relaxed);
+    const quint64 dropped   = g_dropped.exchange(0, std::memory_order_relaxed);
+    if (throttled || dropped) {
+        Entry note;
+        note.msecs = QDateTime::currentMSecsSinceEpoch();
+        note.level = Warning;
+        QStringList parts;
+        if (throttled) parts << QString("%1 message(s) throttled").arg(throttled);
+        if (dropped)   parts << QString("%1 dropped, log ring full").arg(dropped);
+        note.text  = "… " + parts.join(", ");
+        out.append(note);
+    }
+    Entry e;
+    while (out.size() - first < max && ring().pop(e)) out.append(std::move(e));
+
+    std::lock_guard<std::mutex> lock(g_teeMutex);
+    if (g_tee && out.size() > first) {
+        QByteArray lines;
+        for (int i = first; i < out.size(); ++i) {
+            lines += QDateTime::fromMSecsSinceEpoch(out[i].msecs).toString("yyyy-MM-dd HH:mm:ss.zzz").toUtf8();
+            lines += " [" + levelName(out[i].level).toUtf8() + "] ";
+            lines += out[i].text.toUtf8();
+            lines += '\n';
+        }
+        g_tee->post(std::move(lines));
+    }
+    return out.size() - first;
+}
+
+bool setTeeFile(const QString &path, QString &errorOut) {
+    std::unique_ptr<Tee> tee;
+    if (!path.isEmpty()) {
+        tee.reset(new Tee(path));
+        if (!tee->open()) {
+            errorOut = "Cannot open log file " + path;
+            return false;
+        }
+    }
+    std::lock_guard<std::mutex> lock(g_teeMutex);
+    g_tee = std::move(tee);   // the old tee finishes its backlog and stops
+    return true;
+}
+
+QString levelName(Level level) {
+    switch (level) {
+    case Debug:   return "DEBUG";
+    case Info:    return "INFO";
+    case Warning: return "WARN";
+    case Error:   return "ERROR";
+    }
+    return {};
+}
+
+} // namespace Log
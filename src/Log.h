@@ -0,0 +1,57 @@
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <atomic>
+#include <memory>
+
+// Application log. Any thread writes into one bounded lock-free ring; the
+// GUI drains it on a timer. Chatty Debug/Info output is throttled, and a
+// full ring drops the message instead of blocking the writer; both are
+// reported by the next drain. Drained entries can also be teed to a file,
+// written on a thread of its own.
+//
+//   Log::write(Log::Info, "Decompressing LZMA stream...");
+
+namespace Log {
+
+enum Level : quint8 { Debug, Info, Warning, Error };
+
+struct Entry {
+    qint64  msecs = 0;      // since the epoch
+    Level   level = Info;
+    QString text;
+};
+
+// Bounded multi-producer / single-consumer queue (Vyukov's sequence-per-slot
+// scheme). push() never blocks or takes a lock; pop() is for one thread.
+class Ring {
+public:
+    explicit Ring(int capacity);   // rounded up to a power of two
+
+    bool push(Entry &&entry);      // false when full
+    bool pop(Entry &out);
+
+private:
+    struct Slot {
+        std::atomic<quint64> seq;
+        Entry                entry;
+    };
+    std::unique_ptr<Slot[]> m_slots;
+    quint64                 m_mask;
+    alignas(64) std::atomic<quint64> m_head{0};   // next slot to claim
+    alignas(64) quint64              m_tail = 0;  // next slot to read
+};
+
+void write(Level level, const QString &text);
+
+// Up to `max` entries in order. The first one may be a Warning saying how
+// many messages were throttled or dropped since the last drain.
+int drain(QVector<Entry> &out, int max);
+
+// Append every drained entry to `path` as well; empty path stops the tee
+bool setTeeFile(const QString &path, QString &errorOut);
+
+QString levelName(Level level);
+
+} // namespace Log
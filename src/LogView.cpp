@@ -0,0 +1,142 @@
+#include "LogView.h"
+
+#include <QAction>
+#include <QApplication>
+#include <QClipboard>
+#include <QColor>
+#include <QComboBox>
+#include <QDateTime>
+#include <QHBoxLayout>
+#include <QListView>
+#include <QScrollBar>
+#include <QVBoxLayout>
+#include <algorithm>
+
+static constexpr int kDrainMs    = 50;
+static constexpr int kDrainBatch = 4096;   // entries per tick, so a flood can't stall the UI
+static constexpr int kTrimSlack  = 2000;   // trim in blocks rather than per line
+
+// ── LogModel ──────────────────────────────────────────────────────
+
+int LogModel::rowCount(const QModelIndex &parent) const {
+    return parent.isValid() ? 0 : m_shown.size();
+}
+
+QString LogModel::lineAt(int row) const {
+    const Log::Entry &e = m_entries[m_shown[row]];
+    const QString time = QDateTime::fromMSecsSinceEpoch(e.msecs).toString("HH:mm:ss");
+    if (e.level >= Log::Warning)
+        return QString("[%1] %2: %3").arg(time, Log::levelName(e.level), e.text);
+    return QString("[%1] %2").arg(time, e.text);
+}
+
+QVariant LogModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || index.row() >= m_shown.size()) return {};
+    const Log::Entry &e = m_entries[m_shown[index.row()]];
+    switch (role) {
+    case Qt::DisplayRole:
+        return lineAt(index.row());
+    case Qt::ToolTipRole:
+        return QDateTime::fromMSecsSinceEpoch(e.msecs).toString("yyyy-MM-dd HH:mm:ss.zzz");
+    case Qt::ForegroundRole:
+        switch (e.level) {
+        case Log::Debug:   return QColor("#777777");
+        case Log::Info:    return QColor("#aaffaa");
+        case Log::Warning: return QColor("#ffd27f");
+        case Log::Error:   return QColor("#ff8080");
+        }
+        break;
+    }
+    return {};
+}
+
+void LogModel::append(const QVector<Log::Entry> &entries) {
+    if (entries.isEmpty()) return;
+    if (m_entries.size() + entries.size() > MaxLines + kTrimSlack) {
+        const int drop = qMin<int>(m_entries.size(), m_entries.size() + entries.size() - MaxLines);
+        int hidden = 0;   // shown rows that go with them
+        while (hidden < m_shown.size() && m_shown[hidden] < drop) ++hidden;
+        if (hidden) beginRemoveRows(QModelIndex(), 0, hidden - 1);
+        m_entries.remove(0, drop);
+        m_shown.remove(0, hidden);
+        for (int &i : m_shown) i -= drop;
+        if (hidden) endRemoveRows();
+    }
+
+    QVector<int> added;
+    for (const Log::Entry &e : entries) {
+        if (e.level >= m_minLevel) added.append(m_entries.size());
+        m_entries.append(e);
+    }
+    if (added.isEmpty()) return;
+    beginInsertRows(QModelIndex(), m_shown.size(), m_shown.size() + added.size() - 1);
+    m_shown += added;
+    endInsertRows();
+}
+
+void LogModel::setMinLevel(Log::Level level) {
+    beginResetModel();
+    m_minLevel = level;
+    m_shown.clear();
+    for (int i = 0; i < m_entries.size(); ++i)
+        if (m_entries[i].level >= level) m_shown.append(i);
+    endResetModel();
+}
+
+// ── LogView ───────────────────────────────────────────────────────
+
+LogView::LogView(QWidget *parent) : QWidget(parent), m_model(new LogModel(this)) {
+    auto *layout = new QHBoxLayout(this);
+    layout->setContentsMargins(0, 0, 0, 0);
+
+    m_list = new QListView;
+    m_list->setModel(m_model);
+    m_list->setUniformItemSizes(true);   // row heights never measured: O(visible) layout
+    m_list->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    m_list->setFont(QFont("Monospace", 9));
+    m_list->setStyleSheet("background: #1a1a1a;");
+    layout->addWidget(m_list, 1);
+
+    auto *copy = new QAction("Copy", m_list);
+    copy->setShortcut(QKeySequence::Copy);
+    copy->setShortcutContext(Qt::WidgetShortcut);
+    connect(copy, &QAction::triggered, this, &LogView::copySelection);
+    m_list->addAction(copy);
+    m_list->setContextMenuPolicy(Qt::ActionsContextMenu);
+
+    m_level = new QComboBox;
+    m_level->addItem("Debug",    int(Log::Debug));
+    m_level->addItem("Info",     int(Log::Info));
+    m_level->addItem("Warnings", int(Log::Warning));
+    m_level->addItem("Errors",   int(Log::Error));
+    m_level->setCurrentIndex(1);
+    connect(m_level, &QComboBox::currentIndexChanged, this, [this]() {
+        m_model->setMinLevel(Log::Level(m_level->currentData().toInt()));
+        m_list->scrollToBottom();
+    });
+    auto *side = new QVBoxLayout;
+    side->addWidget(m_level);
+    side->addStretch();
+    layout->addLayout(side);
+
+    m_timer.setInterval(kDrainMs);
+    connect(&m_timer, &QTimer::timeout, this, &LogView::flush);
+    m_timer.start();
+}
+
+void LogView::flush() {
+    QVector<Log::Entry> batch;
+    if (Log::drain(batch, kDrainBatch) == 0) return;
+    QScrollBar *bar = m_list->verticalScrollBar();
+    const bool follow = bar->value() == bar->maximum();   // stay put if scrolled back
+    m_model->append(batch);
+    if (follow) m_list->scrollToBottom();
+}
+
+void LogView::copySelection() {
+    QModelIndexList rows = m_list->selectionModel()->selectedRows();
+    std::sort(rows.begin(), rows.end());
+    QStringList lines;
+    for (const QModelIndex &i : rows) lines << m_model->lineAt(i.row());
+    QApplication::clipboard()->setText(lines.join('\n'));
+}
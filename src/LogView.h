@@ -0,0 +1,49 @@
+#pragma once
+
+#include <QAbstractListModel>
+#include <QTimer>
+#include <QWidget>
+#include "Log.h"
+
+class QComboBox;
+class QListView;
+
+// Drained log entries, oldest trimmed past MaxLines. Rows are the entries
+// at or above the chosen level.
+class LogModel : public QAbstractListModel {
+    Q_OBJECT
+public:
+    static constexpr int MaxLines = 20000;
+
+    explicit LogModel(QObject *parent = nullptr) : QAbstractListModel(parent) {}
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role) const override;
+
+    void append(const QVector<Log::Entry> &entries);
+    void setMinLevel(Log::Level level);
+    QString lineAt(int row) const;
+
+private:
+    QVector<Log::Entry> m_entries;
+    QVector<int>        m_shown;          // indices into m_entries
+    Log::Level          m_minLevel = Log::Info;
+};
+
+// Log panel. Drains Log's ring on a short timer; the list view lays out and
+// paints only the rows on screen, so its cost doesn't grow with the history.
+class LogView : public QWidget {
+    Q_OBJECT
+public:
+    explicit LogView(QWidget *parent = nullptr);
+
+    void flush();   // drain now instead of on the next tick
+
+private:
+    void copySelection();
+
+    LogModel  *m_model;
+    QListView *m_list;
+    QComboBox *m_level;
+    QTimer     m_timer;
+};
@@ -1,4 +1,12 @@
 #include "MainWindow.h"
+#include "Trace.h"
+#include "DiffWindow.h"
+#include "PatchPort.h"
+#include "DeviceDump.h"
+#include "HashSegment.h"
+#include "SparseImage.h"
+#include "ImageDelta.h"
+#include "ElfImage.h"
 
 #include <QApplication>
 #include <QFileDialog>
@@ -11,6 +19,7 @@
 #include <QDropEvent>
 #include <QMimeData>
 #include <QInputDialog>
+#include <QMenu>
 #include <QGroupBox>
 #include <QLabel>
 #include <QSizePolicy>
@@ -18,6 +27,23 @@
 #include <QFile>
 #include <QFileInfo>
 #include <QDateTime>
+#include <QFutureWatcher>
+#include <QPointer>
+#include <QSignalBlocker>
+#include <QtConcurrent>
+#include <algorithm>
+#include <functional>
+
+// Tree items carry the FvNode they show
+static constexpr int NodeRole = Qt::UserRole + 1;
+
+static FvNode *nodeOf(QTreeWidgetItem *item) {
+    return item ? reinterpret_cast<FvNode*>(item->data(0, NodeRole).value<quintptr>()) : nullptr;
+}
+
+static void setNode(QTreeWidgetItem *item, FvNode *node) {
+    item->setData(0, NodeRole, QVariant::fromValue(reinterpret_cast<quintptr>(node)));
+}
 
 MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     setWindowTitle("ABL Tool — Qualcomm Bootloader Editor");
@@ -31,6 +57,12 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     m_btnOpen = new QPushButton("📂 Open ABL");
     m_btnOpen->setToolTip("Open abl.elf / abl.img file");
     tb->addWidget(m_btnOpen);
+
+    m_btnWatch = new QPushButton("👁 Watch");
+    m_btnWatch->setToolTip("Reload this image whenever it changes on disk; only the blocks that changed are decoded again");
+    m_btnWatch->setCheckable(true);
+    m_btnWatch->setEnabled(false);
+    tb->addWidget(m_btnWatch);
     tb->addSeparator();
 
     m_btnCopyFvh = new QPushButton("📋 Copy _FVH block");
@@ -60,6 +92,26 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     m_btnSearch = new QPushButton("🔍 Search bytes");
     m_btnSearch->setEnabled(false);
     tb->addWidget(m_btnSearch);
+    tb->addSeparator();
+
+    m_btnDiff = new QPushButton("⇄ Diff with…");
+    m_btnDiff->setToolTip("Compare decompressed blocks against another ABL image");
+    m_btnDiff->setEnabled(false);
+    tb->addWidget(m_btnDiff);
+
+    m_btnPatches = new QPushButton("🩹 Patch set");
+    m_btnPatches->setToolTip("Save edits as a relocatable patch set, or port one into this block");
+    m_btnPatches->setEnabled(false);
+    QMenu *patchMenu = new QMenu(m_btnPatches);
+    connect(patchMenu->addAction("Save edits as patch set…"), &QAction::triggered, this, &MainWindow::savePatchSet);
+    connect(patchMenu->addAction("Port patch set into this block…"), &QAction::triggered, this, &MainWindow::portPatchSet);
+    m_btnPatches->setMenu(patchMenu);
+    tb->addWidget(m_btnPatches);
+
+    m_btnCost = new QPushButton("Δ LZMA cost");
+    m_btnCost->setToolTip("Tint regions whose estimated compressed size differs from the original payload");
+    m_btnCost->setCheckable(true);
+    tb->addWidget(m_btnCost);
 
     // ── Central layout ────────────────────────────────────────────
     QWidget *central = new QWidget;
@@ -68,23 +120,47 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     mainLayout->setSpacing(4);
     mainLayout->setContentsMargins(6, 6, 6, 6);
 
+    // Tabs: one per open image
+    m_tabs = new QTabBar;
+    m_tabs->setTabsClosable(true);
+    m_tabs->setDocumentMode(true);
+    m_tabs->setExpanding(false);
+    m_tabs->setVisible(false);
+    mainLayout->addWidget(m_tabs);
+
     // Top splitter: block list | hex editor
     m_splitter = new QSplitter(Qt::Horizontal);
 
-    // Left: FVH block list
+    // Left: FVH block list (index 0 is the empty tree shown with no image open)
     QGroupBox *blockGroup = new QGroupBox("FVH Blocks");
     QVBoxLayout *blockLayout = new QVBoxLayout(blockGroup);
-    m_blockList = new QListWidget;
-    m_blockList->setMaximumWidth(260);
-    m_blockList->setMinimumWidth(200);
-    blockLayout->addWidget(m_blockList);
+    m_treeStack = new QStackedWidget;
+    m_treeStack->setMaximumWidth(360);
+    m_treeStack->setMinimumWidth(200);
+    m_blockTree = createBlockTree();
+    m_treeStack->addWidget(m_blockTree);
+    blockLayout->addWidget(m_treeStack);
     m_splitter->addWidget(blockGroup);
 
     // Right: hex editor
     QGroupBox *hexGroup = new QGroupBox("Decompressed Binary (editable)");
     QVBoxLayout *hexLayout = new QVBoxLayout(hexGroup);
     m_hexEditor = new HexEditor;
-    hexLayout->addWidget(m_hexEditor);
+    m_minimap   = new Minimap(m_hexEditor);
+    m_costMap   = new CostMap(m_hexEditor, this);
+    m_disasmView = new DisasmView(m_hexEditor);
+    QWidget *hexPane = new QWidget;
+    QHBoxLayout *hexRow = new QHBoxLayout(hexPane);
+    hexRow->setContentsMargins(0, 0, 0, 0);
+    hexRow->setSpacing(2);
+    hexRow->addWidget(m_hexEditor);
+    hexRow->addWidget(m_minimap);
+    QSplitter *hexSplit = new QSplitter(Qt::Horizontal);
+    hexSplit->addWidget(hexPane);
+    hexSplit->addWidget(m_disasmView);
+    hexSplit->setStretchFactor(0, 3);
+    hexSplit->setStretchFactor(1, 2);
+    hexLayout->addWidget(hexSplit);
     m_splitter->addWidget(hexGroup);
 
     m_splitter->setStretchFactor(0, 0);
@@ -94,11 +170,8 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     // Bottom: log
     QGroupBox *logGroup = new QGroupBox("Log");
     QVBoxLayout *logLayout = new QVBoxLayout(logGroup);
-    m_logView = new QTextEdit;
-    m_logView->setReadOnly(true);
+    m_logView = new LogView;
     m_logView->setMaximumHeight(140);
-    m_logView->setFont(QFont("Monospace", 9));
-    m_logView->setStyleSheet("background: #1a1a1a; color: #aaffaa;");
     logLayout->addWidget(m_logView);
     mainLayout->addWidget(logGroup);
 
@@ -109,6 +182,9 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     m_progress->setVisible(false);
     m_progress->setMaximumWidth(150);
     statusBar()->addWidget(m_statusLabel, 1);
+    m_costLabel = new QLabel;
+    m_costLabel->setVisible(false);
+    statusBar()->addPermanentWidget(m_costLabel);
     statusBar()->addPermanentWidget(m_progress);
 
     // Dark theme
@@ -139,32 +215,63 @@ MainWindow::MainWindow(QWidget *parent) : QMainWindow(parent) {
     connect(m_btnSave,    &QPushButton::clicked, this, &MainWindow::saveOutput);
     connect(m_btnGoTo,    &QPushButton::clicked, this, &MainWindow::goToOffset);
     connect(m_btnSearch,  &QPushButton::clicked, this, &MainWindow::searchBytes);
+    connect(m_btnDiff,    &QPushButton::clicked, this, &MainWindow::diffWithFile);
 
-    connect(m_blockList, &QListWidget::currentRowChanged, this, &MainWindow::onBlockSelected);
+    connect(m_btnWatch,   &QPushButton::toggled, this, &MainWindow::setWatched);
+
+    connect(m_tabs, &QTabBar::currentChanged,    this, &MainWindow::onTabChanged);
+    connect(m_tabs, &QTabBar::tabCloseRequested, this, &MainWindow::onTabCloseRequested);
 
     connect(m_worker, &AblWorker::extractDone, this, &MainWindow::onExtractDone);
-    connect(m_worker, &AblWorker::repackDone,  this, &MainWindow::onRepackDone);
     connect(m_worker, &AblWorker::error,        this, &MainWindow::onWorkerError);
-    connect(m_worker, &AblWorker::progress,     this, &MainWindow::onWorkerProgress);
+
+    // Compressed-size overlay: costs are compared with the payload as decoded
+    connect(m_btnCost, &QPushButton::toggled, m_costMap, &CostMap::setEnabled);
+    connect(m_hexEditor, &HexEditor::dataReset, this, [this]() { m_costMap->reset(m_decompressed); });
+    connect(m_costMap, &CostMap::deltaChanged, this, [this](qint64 bytes, bool valid) {
+        m_costLabel->setVisible(valid);
+        m_costLabel->setText(QString("LZMA %1%2 B (est.)").arg(bytes > 0 ? "+" : "").arg(bytes));
+        m_costLabel->setStyleSheet(bytes > 0 ? "color: #ff8c78;" : "color: #9be09b;");
+    });
 
     connect(m_hexEditor, &HexEditor::dataChanged, this, [this]() {
         m_btnRepack->setEnabled(true);
+        m_editsPending = true;
+        ++m_editSerial;
         setWindowTitle("ABL Tool — * unsaved changes");
     });
 
+    // Watch mode. A rebuild usually lands as several writes, or as a new
+    // file renamed over the old one, so changes are settled before reloading.
+    m_fileWatcher = new QFileSystemWatcher(this);
+    m_reloadTimer.setSingleShot(true);
+    m_reloadTimer.setInterval(500);
+    connect(m_fileWatcher, &QFileSystemWatcher::fileChanged,      this, &MainWindow::onWatchedFileChanged);
+    connect(m_fileWatcher, &QFileSystemWatcher::directoryChanged, this, &MainWindow::onWatchedDirChanged);
+    connect(&m_reloadTimer, &QTimer::timeout, this, &MainWindow::reloadChangedFiles);
+
+    // Decoded payloads kept across block and tab switches
+    const int budgetMb = qEnvironmentVariableIntValue("ABL_PAYLOAD_BUDGET_MB");
+    if (budgetMb > 0) m_payloads.setBudget(qint64(budgetMb) * 1024 * 1024);
+
     log("ABL Tool ready. Drop or open an abl.elf / abl.img file.");
+    log(QString("ARM64 disassembly: %1 decoder").arg(m_disasmView->backend()));
+    log(QString("Payload cache: %1 MiB").arg(m_payloads.budget() / (1024 * 1024)));
 }
 
 MainWindow::~MainWindow() {
+    cancelScan();
     m_thread->quit();
     m_thread->wait();
     delete m_worker;
+    m_logView->flush();   // last lines out to the tee file
 }
 
 // ── Drag & Drop ───────────────────────────────────────────────────
 
 void MainWindow::dragEnterEvent(QDragEnterEvent *event) {
-    if (event->mimeData()->hasUrls()) event->acceptProposedAction();
+    // Not while a job runs: opening replaces the tree the job reports into
+    if (event->mimeData()->hasUrls() && m_btnOpen->isEnabled()) event->acceptProposedAction();
 }
 
 void MainWindow::dropEvent(QDropEvent *event) {
@@ -180,76 +287,895 @@ void MainWindow::openFile() {
     if (!path.isEmpty()) loadFile(path);
 }
 
+// Files above this are shown read-only straight from disk instead of being
+// loaded (raw partition / UFS dumps); their partitions are opened separately
+static constexpr qint64 kRawViewThreshold = 1024LL * 1024 * 1024;
+
+// Dump-view tree items: [offset, size, name] of a partition or FV to open
+static constexpr int SliceRole = Qt::UserRole + 2;
+
 void MainWindow::loadFile(const QString &path) {
+    if (!m_btnOpen->isEnabled()) {   // a job is running on the shown image
+        log(QString("Busy — %1 not opened; try again when the current job finishes.")
+            .arg(QFileInfo(path).fileName()), Log::Warning);
+        return;
+    }
+    ABL_TRACE_SPAN("load");
+    const QString absPath = QFileInfo(path).absoluteFilePath();
+    for (auto it = m_sessions.constBegin(); it != m_sessions.constEnd(); ++it) {
+        if (it->path == absPath && it->sliceOffset < 0) {   // already open: just show its tab
+            m_tabs->setCurrentIndex(tabIndexOf(it.key()));
+            return;
+        }
+    }
+
+    if (SparseImage::isSparse(path)) {
+        openSparse(absPath);
+        return;
+    }
+    if (QFileInfo(path).size() > kRawViewThreshold) {
+        openRawView(path);
+        return;
+    }
+
     QFile f(path);
     if (!f.open(QIODevice::ReadOnly)) {
         QMessageBox::critical(this, "Error", "Cannot open file: " + path);
         return;
     }
+    openSession(absPath);
     m_ablData = f.readAll();
-    m_ablPath = path;
-    m_decompressed.clear();
-    m_repackedAbl.clear();
+    beginImage(QFileInfo(path).fileName());
+}
+
+// Reset the view for the freshly loaded m_ablData and start scanning it
+void MainWindow::beginImage(const QString &name) {
     m_hexEditor->setData({});
+    m_hexEditor->setReadOnly(false);
     m_btnExtract->setEnabled(false);
     m_btnCopyFvh->setEnabled(false);
     m_btnRepack->setEnabled(false);
     m_btnSave->setEnabled(false);
     m_btnGoTo->setEnabled(false);
     m_btnSearch->setEnabled(false);
+    m_btnDiff->setEnabled(false);
+    m_btnPatches->setEnabled(false);
+    updateWatchButton();
+
+    log(QString("Loaded: %1 (%2 bytes)").arg(name).arg(m_ablData.size()));
+
+    // Blocks are added to the tree as the background scan finds them
+    m_fvTree.reset(new FvTree(m_ablData, {}));
+    m_scanComplete = false;
+    m_statusLabel->setText(QString("File: %1 | scanning…").arg(name));
+    setWindowTitle(QString("ABL Tool — %1").arg(name));
+    startScan();
+}
 
-    log(QString("Loaded: %1 (%2 bytes)").arg(QFileInfo(path).fileName()).arg(m_ablData.size()));
+// ── Background scan ───────────────────────────────────────────────
+
+// Scan the shown image for _FVH blocks on a pool thread. Blocks already in
+// m_blocks (from a scan that was interrupted by a tab switch) are skipped.
+// A dump without a partition table, or a large sparse image, is streamed
+// from disk instead.
+void MainWindow::startScan() {
+    cancelScan();
+    QVector<qint64> known;
+    for (const FvhBlock &b : m_blocks) known.append(b.fvhOffset);
+    std::sort(known.begin(), known.end());
+
+    auto *watcher = new QFutureWatcher<FvhBlock>(this);
+    m_scanWatcher = watcher;
+    const auto error = QSharedPointer<QString>::create();
+    connect(watcher, &QFutureWatcher<FvhBlock>::resultReadyAt, this, [this, watcher](int index) {
+        onBlockFound(watcher->resultAt(index));
+    });
+    connect(watcher, &QFutureWatcher<FvhBlock>::progressValueChanged, this, [this, watcher](int kib) {
+        m_progress->setRange(0, watcher->progressMaximum());
+        m_progress->setValue(kib);
+        const double secs = qMax<qint64>(1, m_scanClock.elapsed()) / 1000.0;
+        m_progress->setFormat(QString("%p% · %1 MB/s").arg(kib / 1024.0 / secs, 0, 'f', 0));
+    });
+    connect(watcher, &QFutureWatcher<FvhBlock>::finished, this, [this, watcher, error]() {
+        watcher->deleteLater();
+        if (!error->isEmpty()) log(*error, Log::Error);
+        onScanFinished();
+    });
 
-    FvhParser parser(m_ablData);
-    m_blocks = parser.findBlocks();
+    m_scanClock.start();
+    m_progress->setRange(0, 0);
+    m_progress->setVisible(true);
+    const QByteArray data = m_ablData;
+    const QString dumpPath = m_rawView ? m_ablPath : QString();
+    const qint64 dumpSize  = m_rawView ? m_rawView->size() : 0;
+    const QSharedPointer<const SparseImage> sparse = m_rawView ? m_sparse : nullptr;
+    watcher->setFuture(QtConcurrent::run([data, known, dumpPath, dumpSize, sparse, error](QPromise<FvhBlock> &promise) {
+        FvhScanSink sink;
+        sink.known = known;
+        sink.block = [&promise](const FvhBlock &block) {
+            promise.addResult(block);
+            return !promise.isCanceled();
+        };
+        sink.progress = [&promise](qint64 scanned, qint64 total) {   // KiB keeps it in int range
+            promise.setProgressRange(0, int(total / 1024));
+            promise.setProgressValue(int(scanned / 1024));
+            return !promise.isCanceled();
+        };
+        if (dumpPath.isEmpty()) {
+            FvhParser(data).findBlocks(32768, sink);
+        } else if (sparse) {
+            FvhByteSource source;
+            source.name = dumpPath;
+            source.size = sparse->size();
+            source.read = [sparse](qint64 offset, qint64 length, char *out) {
+                return sparse->read(offset, length, out);
+            };
+            FvhParser::scanSource(source, 0, dumpSize, 32768, sink, *error);
+        } else {
+            FvhParser::scanFile(dumpPath, 0, dumpSize, 32768, sink, *error);
+        }
+    }));
+}
 
+// Stop the running scan; blocks not yet delivered are found again when it restarts
+void MainWindow::cancelScan() {
+    if (!m_scanWatcher) return;
+    m_scanWatcher->disconnect(this);
+    m_scanWatcher->cancel();
+    if (m_scanWatcher->isFinished())
+        m_scanWatcher->deleteLater();
+    else
+        connect(m_scanWatcher, &QFutureWatcher<FvhBlock>::finished, m_scanWatcher, &QObject::deleteLater);
+    m_scanWatcher = nullptr;
+    m_progress->setRange(0, 0);
+    m_progress->resetFormat();
+    m_progress->setVisible(!m_btnOpen->isEnabled());
+}
+
+void MainWindow::onBlockFound(const FvhBlock &block) {
+    if (m_rawView) {   // FV inside a dump: listed, opened in its own tab on click
+        FvhBlock b = block;
+        b.raw.clear();
+        m_blocks.append(b);
+        addSliceItem(QString("FV %1").arg(m_blocks.size()), block.fvStart, block.fvSize,
+                     block.hasLzma ? QString("LZMA @ +0x%1").arg(block.lzmaOffset, 0, 16)
+                                   : QString("no LZMA"));
+        return;
+    }
+    m_blocks.append(block);
+    const int index = m_fvTree->addRoot(block);
+    QTreeWidgetItem *item = addBlockItem(index);
+    if (!m_blockTree->currentItem())
+        m_blockTree->setCurrentItem(item);   // the first block is usable right away
+    m_btnDiff->setEnabled(m_btnOpen->isEnabled());   // unless a job is running
+}
+
+void MainWindow::onScanFinished() {
+    const bool cancelled = m_scanWatcher && m_scanWatcher->isCanceled();
+    m_scanWatcher = nullptr;
+    m_progress->setRange(0, 0);
+    m_progress->resetFormat();
+    m_progress->setVisible(!m_btnOpen->isEnabled());
+    if (cancelled) return;
+
+    m_scanComplete = true;
+    const QString name = QFileInfo(m_ablPath).fileName();
+    const qint64 scanned = m_rawView ? m_rawView->size() : m_ablData.size();
+    const double secs = qMax<qint64>(1, m_scanClock.elapsed()) / 1000.0;
     if (m_blocks.isEmpty()) {
-        QMessageBox::warning(this, "No FVH blocks", "No _FVH blocks found in this file.\nMake sure it is a valid ABL ELF image.");
+        m_statusLabel->setText(QString("File: %1 | no FVH blocks").arg(name));
         log("No _FVH blocks found.");
+        if (!m_rawView)
+            QMessageBox::warning(this, "No FVH blocks", "No _FVH blocks found in this file.\nMake sure it is a valid ABL ELF image.");
+        return;
+    }
+    log(QString("Found %1 FVH block(s) in %2 s (%3 MB/s).")
+        .arg(m_blocks.size()).arg(secs, 0, 'f', 2)
+        .arg(scanned / (1024.0 * 1024.0) / secs, 0, 'f', 0));
+    m_statusLabel->setText(QString("File: %1 | %2 FVH block(s)").arg(name).arg(m_blocks.size()));
+}
+
+// ── Device dumps ──────────────────────────────────────────────────
+
+// Read-only view of a whole dump. Its partitions come from the GPT; without
+// one, the dump is streamed through the _FVH scanner. Clicking an entry
+// loads just that range as an image of its own.
+void MainWindow::openRawView(const QString &path, const QSharedPointer<SparseImage> &sparse) {
+    QSharedPointer<HexDataProvider> provider;
+    QString err;
+    if (sparse) {
+        provider.reset(new SparseImageProvider(sparse));
+    } else {
+        auto mapped = QSharedPointer<MappedFileProvider>::create();
+        if (!mapped->open(path, err)) {
+            QMessageBox::critical(this, "Error", err);
+            return;
+        }
+        provider = mapped;
+    }
+
+    openSession(QFileInfo(path).absoluteFilePath());
+    m_rawView = provider;
+    m_sparse  = sparse;
+    setUiBusy(false);
+
+    m_hexEditor->setProvider(provider);
+    m_hexEditor->setReadOnly(true);
+    m_btnGoTo->setEnabled(true);
+    updateWatchButton();
+
+    const QString name = QFileInfo(path).fileName();
+    log(QString("Opened %1 (%2 MiB) as a read-only raw view.")
+        .arg(name).arg(provider->size() / (1024 * 1024)));
+    m_statusLabel->setText(QString("Raw view: %1").arg(name));
+    setWindowTitle(QString("ABL Tool — %1 (raw)").arg(name));
+
+    if (m_sparse) {   // one partition already; nothing to index
+        m_scanComplete = false;
+        startScan();
+        return;
+    }
+    GptTable gpt;
+    if (!DeviceDump::readGpt(m_ablPath, gpt, err)) {
+        log(QString("No partition table (%1); scanning the whole dump for _FVH blocks.").arg(err));
+        m_scanComplete = false;
+        startScan();
+        return;
+    }
+    for (const GptPartition &p : gpt.partitions) {
+        QTreeWidgetItem *item = addSliceItem(p.name, p.offset, p.size,
+            p.truncated ? QString("⚠ past end of dump") : QString("#%1").arg(p.index + 1));
+        if (p.name.startsWith("abl")) {
+            QFont bold = item->font(0);
+            bold.setBold(true);
+            item->setFont(0, bold);
+        }
+    }
+    QStringList abl;
+    for (const QString &slot : { QString("abl_a"), QString("abl_b"), QString("abl") })
+        if (const GptPartition *p = gpt.find(slot))
+            abl << QString("%1 @ 0x%2").arg(slot).arg(p->offset, 0, 16);
+    log(QString("GPT: %1 partition(s), %2-byte sectors%3. %4")
+        .arg(gpt.partitions.size()).arg(gpt.sectorSize)
+        .arg(gpt.fromBackup ? ", from the backup header" : "")
+        .arg(abl.isEmpty() ? QString("No abl partition.") : abl.join(", ")));
+    m_statusLabel->setText(QString("Raw view: %1 | %2 partition(s) — click one to open it")
+        .arg(name).arg(gpt.partitions.size()));
+}
+
+QTreeWidgetItem *MainWindow::addSliceItem(const QString &name, qint64 offset, qint64 size,
+                                          const QString &note) {
+    auto *item = new QTreeWidgetItem(QStringList(QString("%1\n  @ 0x%2\n  Size: %3 KiB\n  %4")
+        .arg(name).arg(offset, 0, 16).arg(size / 1024).arg(note)));
+    item->setFont(0, QFont("Monospace", 9));
+    item->setData(0, SliceRole, QVariantList{ offset, size, name });
+    m_blockTree->addTopLevelItem(item);
+    return item;
+}
+
+void MainWindow::onItemClicked(QTreeWidgetItem *item) {
+    const QVariantList slice = item->data(0, SliceRole).toList();
+    if (slice.size() == 3)
+        openSlice(slice[0].toLongLong(), slice[1].toLongLong(), slice[2].toString());
+}
+
+// Load [offset, offset+size) of the shown dump as an image in a new tab
+void MainWindow::openSlice(qint64 offset, qint64 size, const QString &name) {
+    const QString path = m_ablPath;
+    for (auto it = m_sessions.constBegin(); it != m_sessions.constEnd(); ++it) {
+        if (it->path == path && it->sliceOffset == offset) {
+            m_tabs->setCurrentIndex(tabIndexOf(it.key()));
+            return;
+        }
+    }
+    if (size > kRawViewThreshold) {   // userdata and the like: just go there
+        m_hexEditor->goTo(offset);
+        log(QString("%1 is too large to load (%2 MiB); shown in the raw view.").arg(name).arg(size / (1024 * 1024)));
         return;
     }
 
-    populateBlockList();
-    log(QString("Found %1 FVH block(s).").arg(m_blocks.size()));
-    m_statusLabel->setText(QString("File: %1 | %2 FVH block(s)").arg(QFileInfo(path).fileName()).arg(m_blocks.size()));
+    QString err;
+    const QSharedPointer<SparseImage> sparse = m_sparse;
+    const QByteArray data = sparse ? sparse->read(offset, size, err) : DeviceDump::read(path, offset, size, err);
+    if (data.isEmpty()) {
+        QMessageBox::critical(this, "Error", err);
+        return;
+    }
+    const QString title = QString("%1 @ %2").arg(name, QFileInfo(path).fileName());
+    openSession(path, title);
+    m_sparse      = sparse;
+    m_sliceOffset = offset;
+    m_ablData     = data;
+    beginImage(title);
+}
+
+// ── Sparse images ─────────────────────────────────────────────────
+
+// Android sparse image: expanded in memory like a plain image when it is
+// small enough, otherwise shown as a raw view and streamed through the
+// scanner. Either way only the chunks that change are rewritten on save.
+void MainWindow::openSparse(const QString &path) {
+    auto image = QSharedPointer<SparseImage>::create();
+    QString err;
+    if (!image->open(path, err)) {
+        QMessageBox::critical(this, "Error", err);
+        return;
+    }
+    log(QString("Sparse image: %1 chunk(s), %2 of %3 KiB stored in the file.")
+        .arg(image->chunkCount()).arg(image->storedBytes() / 1024).arg(image->size() / 1024));
+    if (image->size() > kRawViewThreshold) {
+        openRawView(path, image);
+        return;
+    }
+
+    const QByteArray data = image->read(0, image->size(), err);
+    if (data.isEmpty()) {
+        QMessageBox::critical(this, "Error", err.isEmpty() ? "The sparse image is empty." : err);
+        return;
+    }
+    openSession(path);
+    m_sparse  = image;
+    m_ablData = data;
+    beginImage(QFileInfo(path).fileName());
+}
+
+// Write a new sparse image with the repacked bytes in place of the shown range
+void MainWindow::saveSparse() {
+    const qint64 offset = qMax<qint64>(0, m_sliceOffset);
+    if (m_repackedAbl.size() != m_ablData.size()) {
+        QMessageBox::critical(this, "Error", "The patched image changed size; it can't replace its range of the sparse image.");
+        return;
+    }
+    const QString defaultName = QFileInfo(m_ablPath).completeBaseName()
+        + "_patched_"
+        + QDateTime::currentDateTime().toString("yyyyMMdd_HHmmss")
+        + ".img";
+    const QString path = QFileDialog::getSaveFileName(this, "Save patched sparse image",
+        QFileInfo(m_ablPath).dir().filePath(defaultName),
+        "Sparse images (*.img);;All files (*)");
+    if (path.isEmpty()) return;
+    if (QFileInfo(path).absoluteFilePath() == m_sparse->path()) {   // still read from by open tabs
+        QMessageBox::critical(this, "Error", "The open image is read from " + path + "; choose another file.");
+        return;
+    }
+
+    QString err;
+    if (!m_sparse->writePatched(path, offset, m_repackedAbl, err)) {
+        QMessageBox::critical(this, "Error", err);
+        return;
+    }
+    SparseImage written;
+    const int chunks = written.open(path, err) ? written.chunkCount() : 0;
+    log(QString("Saved sparse image → %1 (%2 chunk(s), was %3)%4")
+        .arg(path).arg(chunks).arg(m_sparse->chunkCount())
+        .arg(m_sparse->hasCrc() ? "; CRC32 chunks dropped" : ""));
+    m_repackUnsaved = false;
+    m_statusLabel->setText("Saved: " + QFileInfo(path).fileName());
     setWindowTitle(QString("ABL Tool — %1").arg(QFileInfo(path).fileName()));
 }
 
-void MainWindow::populateBlockList() {
-    m_blockList->clear();
+// ── Tabs ──────────────────────────────────────────────────────────
+
+QTreeWidget *MainWindow::createBlockTree() {
+    auto *tree = new QTreeWidget;
+    tree->setHeaderHidden(true);
+    connect(tree, &QTreeWidget::currentItemChanged, this, &MainWindow::onItemSelected);
+    connect(tree, &QTreeWidget::itemExpanded,       this, &MainWindow::onItemExpanded);
+    connect(tree, &QTreeWidget::itemClicked,        this, &MainWindow::onItemClicked);
+    return tree;
+}
+
+int MainWindow::tabIndexOf(int id) const {
+    for (int i = 0; i < m_tabs->count(); ++i)
+        if (m_tabs->tabData(i).toInt() == id) return i;
+    return -1;
+}
+
+// New tab for `path`; the previous one is stashed and the members start empty
+void MainWindow::openSession(const QString &path, const QString &tabName) {
+    cancelScan();   // a scan of the previous image resumes when its tab is shown
+    stashSession();
+    const int id = ++m_nextSessionId;
+    ImageSession &s = m_sessions[id];
+    s.path      = path;
+    s.blockTree = createBlockTree();
+    m_treeStack->addWidget(s.blockTree);
+
+    clearSession();
+    m_sessionId = id;
+    m_ablPath   = path;
+    m_blockTree = s.blockTree;
+    m_treeStack->setCurrentWidget(m_blockTree);
+
+    QSignalBlocker block(m_tabs);
+    const int index = m_tabs->addTab(tabName.isEmpty() ? QFileInfo(path).fileName() : tabName);
+    m_tabs->setTabData(index, id);
+    m_tabs->setTabToolTip(index, path);
+    m_tabs->setCurrentIndex(index);
+    m_tabs->setVisible(true);
+}
+
+// Move the shown image's state into its session before another tab takes over
+void MainWindow::stashSession() {
+    if (!m_sessions.contains(m_sessionId)) return;
+    storeCurrentPayload();
+    ImageSession &s = m_sessions[m_sessionId];
+    s.data          = m_ablData;
+    s.blocks        = m_blocks;
+    s.tree          = m_fvTree;
+    s.rawView       = m_rawView;
+    s.sparse        = m_sparse;
+    s.selectedBlock = m_selectedBlock;
+    s.selectedNode  = m_selectedNode;
+    s.repacked      = m_repackedAbl;
+    s.sliceOffset   = m_sliceOffset;
+    s.scanComplete  = m_scanComplete;
+    s.editsPending  = m_editsPending;
+    s.repackUnsaved = m_repackUnsaved;
+    s.title         = windowTitle();
+    s.status        = m_statusLabel->text();
+}
+
+void MainWindow::activateSession(int id) {
+    const ImageSession &s = m_sessions[id];
+    m_sessionId     = id;
+    m_ablPath       = s.path;
+    m_ablData       = s.data;
+    m_blocks        = s.blocks;
+    m_fvTree        = s.tree;
+    m_rawView       = s.rawView;
+    m_sparse        = s.sparse;
+    m_selectedBlock = s.selectedBlock;
+    m_selectedNode  = s.selectedNode;
+    m_repackedAbl   = s.repacked;
+    m_sliceOffset   = s.sliceOffset;
+    m_scanComplete  = s.scanComplete;
+    m_editsPending  = s.editsPending;
+    m_repackUnsaved = s.repackUnsaved;
+    m_decompressed.clear();
+    m_payloads.setActive(nullptr);
+    m_blockTree = s.blockTree;
+    m_treeStack->setCurrentWidget(m_blockTree);
+
+    if (m_rawView) {
+        m_hexEditor->setProvider(m_rawView);
+        m_hexEditor->setReadOnly(true);
+    } else {
+        m_hexEditor->setData({});
+        m_hexEditor->setReadOnly(false);
+        if (m_selectedNode) showCachedPayload(m_selectedNode);
+    }
+    setUiBusy(false);
+    m_btnGoTo->setEnabled(m_rawView || !m_decompressed.isEmpty());
+    m_btnSearch->setEnabled(!m_decompressed.isEmpty());
+    setWindowTitle(s.title);
+    m_statusLabel->setText(s.status);
+    updateWatchButton();
+    if (s.reloadPending)
+        reloadShown();
+    else if (!m_scanComplete)
+        startScan();   // only the shown image is scanned
+}
+
+// Members back to "no image"
+void MainWindow::clearSession() {
+    cancelScan();
+    m_scanComplete = true;
+    m_sessionId = 0;
+    m_ablData.clear();
+    m_ablPath.clear();
+    m_blocks.clear();
+    m_fvTree.reset();
+    m_rawView.reset();
+    m_sparse.reset();
+    m_selectedBlock = -1;
+    m_selectedNode  = nullptr;
+    m_decompressed.clear();
+    m_repackedAbl.clear();
+    m_sliceOffset = -1;
+    m_editsPending  = false;
+    m_repackUnsaved = false;
+    m_payloads.setActive(nullptr);
+}
+
+void MainWindow::onTabChanged(int index) {
+    const int id = m_tabs->tabData(index).toInt();
+    if (index < 0 || id == m_sessionId) return;
+    cancelScan();
+    stashSession();
+    activateSession(id);
+}
+
+void MainWindow::onTabCloseRequested(int index) {
+    const int id = m_tabs->tabData(index).toInt();
+    if (id == m_sessionId) {
+        cancelScan();
+        stashSession();
+    }
+    const ImageSession s = m_sessions.value(id);
+    const QString name = QFileInfo(s.path).fileName();
+
+    const int dirty = m_payloads.dirtyCount(s.tree.data());
+    if (hasUnsavedWork(s)) {
+        auto reply = QMessageBox::question(this, "Close image",
+            QString("%1 has %2 edited payload(s) or a repacked image that hasn't been saved. Close anyway?")
+                .arg(name).arg(dirty),
+            QMessageBox::Yes | QMessageBox::No);
+        if (reply != QMessageBox::Yes) {
+            if (id == m_sessionId && !m_scanComplete) startScan();
+            return;
+        }
+    }
+
+    m_payloads.dropTree(s.tree.data());
+    m_sessions.remove(id);
+    if (s.watched) updateWatchedPaths();
+    m_treeStack->removeWidget(s.blockTree);
+    s.blockTree->disconnect(this);
+    s.blockTree->deleteLater();
+
+    if (id == m_sessionId) m_sessionId = 0;   // nothing left to stash
+    m_tabs->removeTab(index);                 // shows a neighbour via onTabChanged
+    if (m_tabs->count() == 0) {
+        clearSession();
+        m_blockTree = qobject_cast<QTreeWidget*>(m_treeStack->widget(0));
+        m_treeStack->setCurrentWidget(m_blockTree);
+        m_hexEditor->setData({});
+        m_hexEditor->setReadOnly(false);
+        setUiBusy(false);
+        m_btnGoTo->setEnabled(false);
+        m_btnSearch->setEnabled(false);
+        updateWatchButton();
+        m_tabs->setVisible(false);
+        m_statusLabel->setText("Drop an ABL file here or click Open.");
+        setWindowTitle("ABL Tool — Qualcomm Bootloader Editor");
+    }
+    log(QString("Closed %1.").arg(name));
+}
+
+// ── Watch mode ────────────────────────────────────────────────────
+
+void MainWindow::setWatched(bool on) {
+    if (!m_sessions.contains(m_sessionId)) return;
+    ImageSession &s = m_sessions[m_sessionId];
+    if (s.watched == on) return;
+    s.watched       = on;
+    s.reloadPending = false;
+    s.chunkHashes   = on ? ImageDelta::chunkHashes(m_ablData) : QVector<quint64>();
+    updateWatchedPaths();
+    log(on ? QString("Watching %1 for changes.").arg(m_ablPath)
+           : QString("Stopped watching %1.").arg(m_ablPath));
+}
+
+// Only whole images loaded from their own file can be reloaded in place
+void MainWindow::updateWatchButton() {
+    const bool plain = m_sessions.contains(m_sessionId) && !m_rawView && !m_sparse && m_sliceOffset < 0;
+    QSignalBlocker block(m_btnWatch);
+    m_btnWatch->setEnabled(plain);
+    m_btnWatch->setChecked(plain && m_sessions[m_sessionId].watched);
+}
+
+// Every watched image and its directory; the directory notices a file
+// replaced by a rename, which drops the watch on the file itself
+void MainWindow::updateWatchedPaths() {
+    QStringList wanted;
+    for (const ImageSession &s : std::as_const(m_sessions))
+        if (s.watched) wanted << s.path << QFileInfo(s.path).absolutePath();
+    const QStringList current = m_fileWatcher->files() + m_fileWatcher->directories();
+    for (const QString &p : current)
+        if (!wanted.contains(p)) m_fileWatcher->removePath(p);
+    for (const QString &p : std::as_const(wanted))
+        if (!current.contains(p) && QFileInfo::exists(p)) m_fileWatcher->addPath(p);
+}
+
+void MainWindow::onWatchedFileChanged(const QString &path) {
+    m_changedPaths.insert(path);
+    m_reloadTimer.start();
+}
+
+void MainWindow::onWatchedDirChanged(const QString &dir) {
+    const QStringList files = m_fileWatcher->files();
+    for (const ImageSession &s : std::as_const(m_sessions))
+        if (s.watched && QFileInfo(s.path).absolutePath() == dir && !files.contains(s.path))
+            onWatchedFileChanged(s.path);
+    updateWatchedPaths();
+}
+
+void MainWindow::reloadChangedFiles() {
+    if (!m_btnOpen->isEnabled()) {   // a job is running on the shown image
+        m_reloadTimer.start();
+        return;
+    }
+    const QSet<QString> paths = std::exchange(m_changedPaths, {});
+    updateWatchedPaths();
+    QVector<int> ids;
+    for (auto it = m_sessions.begin(); it != m_sessions.end(); ++it)
+        if (it->watched && paths.contains(it->path) && QFileInfo::exists(it->path)) ids.append(it.key());
+    for (int id : std::as_const(ids)) {
+        if (id == m_sessionId) {
+            reloadShown();
+        } else if (!m_sessions[id].reloadPending) {
+            m_sessions[id].reloadPending = true;
+            log(QString("%1 changed on disk; it is reloaded when its tab is shown.")
+                .arg(QFileInfo(m_sessions[id].path).fileName()));
+        }
+    }
+}
+
+// Re-read the shown image after it changed on disk. Blocks whose bytes and
+// segment are unchanged keep their tree nodes and payloads, edits included;
+// the scan and decoding are redone only for the rest.
+void MainWindow::reloadShown() {
+    ImageSession &s = m_sessions[m_sessionId];
+    s.reloadPending = false;
+    const QString name = QFileInfo(m_ablPath).fileName();
+    QFile f(m_ablPath);
+    if (!f.open(QIODevice::ReadOnly)) {
+        log(QString("Cannot read %1; waiting for the next change.").arg(m_ablPath), Log::Warning);
+        return;
+    }
+    const QByteArray data = f.readAll();
+    const QVector<quint64> hashes = ImageDelta::chunkHashes(data);
+    const QVector<ImageDelta::Range> changed =
+        ImageDelta::changedRanges(s.chunkHashes, m_ablData.size(), hashes, data.size());
+    if (changed.isEmpty()) {
+        s.chunkHashes = hashes;
+        log(QString("%1 was rewritten with the same contents.").arg(name));
+        return;
+    }
+    ABL_TRACE_SPAN("reload");
+
+    const QVector<ElfSegment> segments = ElfImage::loadSegments(data);
+    auto unchanged = [&](const FvhBlock &b) {
+        if (ImageDelta::touches(changed, b.fvStart, b.fvSize)) return false;
+        if (b.segment < 0) return segments.isEmpty();
+        for (const ElfSegment &seg : segments)
+            if (seg.index == b.segment)
+                return qint64(seg.offset) == b.segOffset && qint64(seg.fileSize) == b.segFileSize;
+        return false;
+    };
+    QVector<int>     keep;
+    QVector<FvNode*> keptRoots;
     for (int i = 0; i < m_blocks.size(); ++i) {
-        const auto &b = m_blocks[i];
-        QString lzmaInfo = b.hasLzma
-            ? QString("LZMA @ +0x%1").arg(b.lzmaOffset, 0, 16)
-            : QString("⚠ No LZMA detected (raw extract)");
-        QString label = QString("Block %1\n  FV @ 0x%2\n  Size: %3 KiB\n  %4")
-            .arg(i + 1)
-            .arg(b.fvStart, 8, 16, QChar('0'))
-            .arg(b.fvSize / 1024)
-            .arg(lzmaInfo);
-        auto *item = new QListWidgetItem(label);
-        item->setFont(QFont("Monospace", 9));
-        if (!b.hasLzma)
-            item->setForeground(QColor(255, 180, 60));
-        m_blockList->addItem(item);
-    }
-    m_blockList->setCurrentRow(0);
-}
-
-void MainWindow::onBlockSelected(int index) {
-    if (index < 0 || index >= m_blocks.size()) return;
-    m_selectedBlock = index;
+        if (!unchanged(m_blocks[i])) continue;
+        keep.append(i);
+        keptRoots.append(m_fvTree->root(i));
+    }
+
+    storeCurrentPayload();
+    const int lost = m_payloads.dirtyCountOutside(m_fvTree.data(), keptRoots);
+    if (lost > 0) {
+        auto reply = QMessageBox::question(this, "Image changed on disk",
+            QString("%1 changed on disk, including the blocks behind %2 edited payload(s). "
+                    "Reload and discard those edits?").arg(name).arg(lost),
+            QMessageBox::Yes | QMessageBox::No);
+        if (reply != QMessageBox::Yes) {
+            log(QString("Kept the loaded %1; it is compared with the file again on its next change.").arg(name));
+            return;
+        }
+    }
+    cancelScan();
+
+    QSharedPointer<FvTree> tree(new FvTree(data, {}));
+    QVector<FvhBlock> blocks;
+    int selectedBlock = -1;
+    for (int i : std::as_const(keep)) {
+        const int index = tree->adoptRoot(*m_fvTree, i, m_blocks[i]);
+        blocks.append(m_blocks[i]);
+        if (i == m_selectedBlock) selectedBlock = index;
+    }
+    m_payloads.rebase(m_fvTree.data(), tree, keptRoots);
+
+    const int blocksBefore = m_blocks.size();
+    s.chunkHashes   = hashes;
+    m_ablData       = data;
+    m_blocks        = blocks;
+    m_fvTree        = tree;
+    m_selectedBlock = selectedBlock;
+    if (selectedBlock < 0) m_selectedNode = nullptr;
+    m_decompressed.clear();
+    m_repackedAbl.clear();   // built from the old bytes
+    m_repackUnsaved = false;
+    m_payloads.setActive(nullptr);
+    rebuildBlockTree();
+
+    m_hexEditor->setData({});
+    if (m_selectedNode) showCachedPayload(m_selectedNode);
+    setUiBusy(false);
+    m_btnGoTo->setEnabled(!m_decompressed.isEmpty());
+    m_btnSearch->setEnabled(!m_decompressed.isEmpty());
+    m_btnDiff->setEnabled(false);
+    const int dirty = m_payloads.dirtyCount(tree.data());
+    m_editsPending = dirty > 0;
+    setWindowTitle(dirty ? "ABL Tool — * unsaved changes" : QString("ABL Tool — %1").arg(name));
+
+    log(QString("Reloaded %1: %2 KiB changed in %3 range(s); %4 of %5 block(s) kept%6, rescanning the rest.")
+        .arg(name).arg(ImageDelta::totalBytes(changed) / 1024).arg(changed.size())
+        .arg(keep.size()).arg(blocksBefore)
+        .arg(dirty ? QString(" (%1 with edits)").arg(dirty) : QString()));
+    m_statusLabel->setText(QString("File: %1 | reloaded, scanning…").arg(name));
+    m_scanComplete = false;
+    startScan();   // kept blocks are skipped as already known
+}
+
+// Fresh tree widget for the shown image: its blocks, with the children
+// already discovered under them
+void MainWindow::rebuildBlockTree() {
+    QTreeWidget *old = m_blockTree;
+    m_blockTree = createBlockTree();
+    m_treeStack->addWidget(m_blockTree);
+    m_treeStack->setCurrentWidget(m_blockTree);
+    m_treeStack->removeWidget(old);
+    old->disconnect(this);
+    old->deleteLater();   // expansions still running see their tree gone
+    m_sessions[m_sessionId].blockTree = m_blockTree;
+
+    QSignalBlocker block(m_blockTree);
+    std::function<void(QTreeWidgetItem *)> restore = [&](QTreeWidgetItem *item) {
+        FvNode *node = nodeOf(item);
+        if (node == m_selectedNode) m_blockTree->setCurrentItem(item);
+        if (!node->childrenLoaded) return;
+        addChildItems(item, node);
+        item->setExpanded(true);
+        for (int i = 0; i < item->childCount(); ++i)
+            if (nodeOf(item->child(i))) restore(item->child(i));
+    };
+    for (int i = 0; i < m_blocks.size(); ++i) restore(addBlockItem(i));
+}
+
+// ── Payload cache ─────────────────────────────────────────────────
+
+// Keep the hex view's payload (with any edits) for when its node is selected again
+void MainWindow::storeCurrentPayload() {
+    if (!m_selectedNode || m_decompressed.isEmpty() || m_rawView) return;
+    PayloadCache::Payload p;
+    p.original = m_decompressed;
+    p.current  = m_hexEditor->data();
+    p.cursor   = m_hexEditor->cursorOffset();
+    p.top      = m_hexEditor->topOffset();
+    m_payloads.store(m_fvTree, m_selectedNode, p);
+}
+
+// Edits not yet repacked (undone ones don't count), or a repack not yet saved
+bool MainWindow::hasUnsavedWork(const ImageSession &s) const {
+    return (s.editsPending && m_payloads.dirtyCount(s.tree.data()) > 0) || s.repackUnsaved;
+}
+
+bool MainWindow::showCachedPayload(FvNode *node) {
+    PayloadCache::Payload p;
+    QString err;
+    if (!m_payloads.fetch(node, p, err)) {
+        if (!err.isEmpty()) log(err, Log::Error);
+        return false;
+    }
+    m_payloads.setActive(node);
+    m_decompressed = p.original;
+    m_hexEditor->setData(p.current);
+    m_hexEditor->goTo(p.cursor);
+    m_hexEditor->scrollToOffset(p.top);
+    m_btnGoTo->setEnabled(true);
+    m_btnSearch->setEnabled(true);
+    m_btnPatches->setEnabled(true);
+    m_btnRepack->setEnabled(p.isDirty() || m_payloads.dirtyCount(m_fvTree.data()) > 0);
+    m_statusLabel->setText(QString("%1: %2 bytes%3")
+        .arg(FvTree::kindName(node)).arg(p.current.size())
+        .arg(p.isDirty() ? " — unsaved edits, Repack when done" : ""));
+    return true;
+}
+
+// ── Block tree ────────────────────────────────────────────────────
+
+// Top-level item for block `index`
+QTreeWidgetItem *MainWindow::addBlockItem(int index) {
+    const auto &b = m_blocks[index];
+    QString lzmaInfo = b.hasLzma
+        ? QString("LZMA @ +0x%1").arg(b.lzmaOffset, 0, 16)
+        : QString("⚠ No LZMA detected (raw extract)");
+    QString label = QString("Block %1\n  FV @ 0x%2\n  Size: %3 KiB\n  %4")
+        .arg(index + 1)
+        .arg(b.fvStart, 8, 16, QChar('0'))
+        .arg(b.fvSize / 1024)
+        .arg(lzmaInfo);
+    if (b.segment >= 0)
+        label += QString("\n  PT_LOAD #%1 @ 0x%2").arg(b.segment).arg(b.segOffset, 0, 16);
+    auto *item = new QTreeWidgetItem(QStringList(label));
+    item->setFont(0, QFont("Monospace", 9));
+    if (!b.hasLzma)
+        item->setForeground(0, QColor(255, 180, 60));
+    item->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
+    setNode(item, m_fvTree->root(index));
+    m_blockTree->addTopLevelItem(item);
+    return item;
+}
+
+// One tree item per child of `node`; their own children stay unloaded
+void MainWindow::addChildItems(QTreeWidgetItem *item, FvNode *node) {
+    if (!node->error.isEmpty()) {
+        auto *err = new QTreeWidgetItem(QStringList("⚠ " + node->error));
+        err->setForeground(0, QColor(255, 180, 60));
+        err->setFlags(Qt::ItemIsEnabled);
+        item->addChild(err);
+    }
+    for (FvNode *child : node->children) {
+        auto *ci = new QTreeWidgetItem(QStringList(FvTree::label(child)));
+        ci->setFont(0, QFont("Monospace", 9));
+        ci->setToolTip(0, QString("%1 @ +0x%2 in parent, %3 bytes")
+            .arg(FvTree::kindName(child)).arg(child->offset, 0, 16).arg(child->size));
+        if (child->opaque)
+            ci->setForeground(0, QColor(150, 150, 150));
+        ci->setChildIndicatorPolicy(FvTree::mayHaveChildren(child)
+            ? QTreeWidgetItem::ShowIndicator
+            : QTreeWidgetItem::DontShowIndicator);
+        setNode(ci, child);
+        item->addChild(ci);
+    }
+    if (node->children.isEmpty() && node->error.isEmpty())
+        item->setChildIndicatorPolicy(QTreeWidgetItem::DontShowIndicator);
+}
+
+void MainWindow::onItemExpanded(QTreeWidgetItem *item) {
+    FvNode *node = nodeOf(item);
+    if (!node || node->childrenLoaded || item->data(0, Qt::UserRole).toBool()) return;
+
+    // Expanding may decode a whole LZMA payload, so do it off the UI thread
+    item->setData(0, Qt::UserRole, true);
+    const QSharedPointer<FvTree> tree = m_fvTree;
+    const QPointer<QTreeWidget> widget = m_blockTree;
+    log(QString("Expanding %1...").arg(FvTree::label(node)));
+
+    auto *watcher = new QFutureWatcher<void>(this);
+    connect(watcher, &QFutureWatcher<void>::finished, this, [this, watcher, tree, widget, item, node]() {
+        watcher->deleteLater();
+        if (!widget) return;   // its tab was closed meanwhile
+        item->setData(0, Qt::UserRole, false);
+        addChildItems(item, node);
+        log(QString("%1: %2 child node(s)").arg(FvTree::label(node)).arg(node->children.size()));
+    });
+    watcher->setFuture(QtConcurrent::run([tree, node]() {
+        QString err;
+        tree->loadChildren(node, err);   // failures are recorded in node->error
+    }));
+}
+
+void MainWindow::onItemSelected(QTreeWidgetItem *item) {
+    FvNode *node = nodeOf(item);
+    if (!node || node == m_selectedNode) return;
+    storeCurrentPayload();
+
+    FvNode *root = node;
+    while (root->parent) root = root->parent;
+    m_selectedBlock = root->blockIndex;
+    m_selectedNode  = node;
     m_btnExtract->setEnabled(true);
     m_btnCopyFvh->setEnabled(true);
     m_decompressed.clear();
+    m_payloads.setActive(nullptr);
     m_hexEditor->setData({});
     m_btnRepack->setEnabled(false);
     m_btnGoTo->setEnabled(false);
     m_btnSearch->setEnabled(false);
+    m_btnPatches->setEnabled(false);
 
-    const auto &b = m_blocks[index];
+    // Opened before: back instantly, edits included
+    if (showCachedPayload(node)) {
+        log(QString("Selected %1: %2 bytes from memory%3")
+            .arg(FvTree::label(node)).arg(m_hexEditor->size())
+            .arg(m_hexEditor->data() != m_decompressed ? ", with unsaved edits" : ""));
+        return;
+    }
+
+    if (node != root) {
+        log(QString("Selected %1 in block %2: +0x%3, %4 bytes")
+            .arg(FvTree::label(node))
+            .arg(m_selectedBlock + 1)
+            .arg(node->offset, 0, 16)
+            .arg(node->size));
+        return;
+    }
+
+    const auto &b = m_blocks[m_selectedBlock];
     log(QString("Selected block %1: FV start=0x%2 size=%3 bytes, LZMA offset=+0x%4 size=%5 bytes")
-        .arg(index + 1)
+        .arg(m_selectedBlock + 1)
         .arg(b.fvStart, 8, 16, QChar('0'))
         .arg(b.fvSize)
         .arg(b.lzmaOffset, 0, 16)
@@ -260,21 +1186,47 @@ void MainWindow::onBlockSelected(int index) {
 
 void MainWindow::extractBlock() {
     if (m_selectedBlock < 0) return;
+    if (m_selectedNode && m_selectedNode->parent) {
+        extractNode(m_selectedNode);
+        return;
+    }
+    m_extractNode = m_selectedNode;
+    m_extractTree = m_fvTree;
     setUiBusy(true);
     log("Extracting and decompressing...");
+    m_statusLabel->setText("Decompressing…");
     QMetaObject::invokeMethod(m_worker, "extract",
         Q_ARG(QByteArray, m_ablData),
         Q_ARG(FvhBlock, m_blocks[m_selectedBlock]));
 }
 
 void MainWindow::onExtractDone(QByteArray decompressed) {
+    FvNode *node = m_extractNode;
+    const QSharedPointer<FvTree> tree = std::exchange(m_extractTree, {});
+    m_extractNode = nullptr;
+    if (!node || tree != m_fvTree) {   // the image was replaced while decoding
+        log("Discarded a decoded block of an image that is no longer shown.", Log::Warning);
+        setUiBusy(false);
+        return;
+    }
+    m_fvTree->setBlockContent(node->blockIndex, decompressed);
+    if (node != m_selectedNode) {   // selection moved on while decoding
+        m_payloads.store(m_fvTree, node, { decompressed, decompressed });
+        log(QString("Block %1 decoded (%2 bytes); kept for later.").arg(node->blockIndex + 1).arg(decompressed.size()));
+        setUiBusy(false);
+        return;
+    }
+
     m_decompressed = decompressed;
+    m_payloads.setActive(node);
+    m_payloads.store(m_fvTree, node, { decompressed, decompressed });
     const auto &b = m_blocks[m_selectedBlock];
 
     m_hexEditor->setData(decompressed);
     m_hexEditor->setHighlight(0, decompressed.size());
     m_btnGoTo->setEnabled(true);
     m_btnSearch->setEnabled(true);
+    m_btnPatches->setEnabled(true);
 
     if (b.hasLzma) {
         log(QString("Decompressed OK. Size: %1 bytes (%.1f KiB)")
@@ -289,41 +1241,155 @@ void MainWindow::onExtractDone(QByteArray decompressed) {
     setUiBusy(false);
 }
 
+// Nested node: decode just the levels above it, in the background
+void MainWindow::extractNode(FvNode *node) {
+    struct ContentJob { QByteArray data; QString error; };
+    const QSharedPointer<FvTree> tree = m_fvTree;
+
+    setUiBusy(true);
+    log(QString("Extracting %1...").arg(FvTree::label(node)));
+
+    auto *watcher = new QFutureWatcher<ContentJob>(this);
+    connect(watcher, &QFutureWatcher<ContentJob>::finished, this, [this, watcher, tree, node]() {
+        ContentJob job = watcher->result();
+        watcher->deleteLater();
+        if (tree != m_fvTree || node != m_selectedNode) {
+            if (tree == m_fvTree && job.error.isEmpty())
+                m_payloads.store(tree, node, { job.data, job.data });
+            setUiBusy(false);
+            return;
+        }
+        if (!job.error.isEmpty()) {
+            onWorkerError(job.error);
+            return;
+        }
+        m_payloads.setActive(node);
+        m_payloads.store(tree, node, { job.data, job.data });
+        m_decompressed = job.data;
+        m_hexEditor->setData(job.data);
+        m_hexEditor->setHighlight(0, job.data.size());
+        m_btnGoTo->setEnabled(true);
+        m_btnSearch->setEnabled(true);
+        m_btnPatches->setEnabled(true);
+        log(QString("Extracted %1: %2 bytes").arg(FvTree::label(node)).arg(job.data.size()));
+        m_statusLabel->setText(QString("%1: %2 bytes — edit hex then Repack")
+            .arg(FvTree::kindName(node)).arg(job.data.size()));
+        setUiBusy(false);
+    });
+    watcher->setFuture(QtConcurrent::run([tree, node]() {
+        ContentJob job;
+        tree->content(node, job.data, job.error);
+        return job;
+    }));
+}
+
 // ── Repack ────────────────────────────────────────────────────────
 
+// Every edited payload of the image goes into one repack, built from the
+// original bytes; a repack of one edit would drop the others
 void MainWindow::repackBlock() {
-    if (m_selectedBlock < 0 || m_decompressed.isEmpty()) {
+    if (!m_fvTree || m_rawView) return;
+    storeCurrentPayload();
+    QVector<FvTree::Edit> edits;
+    QString err;
+    if (!m_payloads.dirtyEdits(m_fvTree.data(), edits, err)) {
+        QMessageBox::critical(this, "Error", err);
+        return;
+    }
+    if (edits.isEmpty()) {
         QMessageBox::information(this, "Nothing to repack", "Extract a block first, then edit bytes.");
         return;
     }
 
+    QStringList names;
+    for (const FvTree::Edit &e : std::as_const(edits)) names << FvTree::label(e.node);
+    names.sort();
     auto reply = QMessageBox::question(this, "Repack",
-        "Compress the edited binary and patch it back into the original ABL.\n\n"
-        "This will replace the LZMA stream in the file. Continue?",
+        QString("Compress the edited payload(s) and patch them back into the original ABL:\n\n%1\n\n"
+                "This will replace their LZMA streams in the file. Continue?").arg(names.join("\n")),
         QMessageBox::Yes | QMessageBox::No);
     if (reply != QMessageBox::Yes) return;
+    repackEdits(edits);
+}
+
+void MainWindow::repackEdits(const QVector<FvTree::Edit> &edits) {
+    struct RepackJob { QByteArray image; QString error; };
+    const QSharedPointer<FvTree> tree = m_fvTree;
+    const quint64 serial = m_editSerial;   // edits made from here on aren't in this image
 
     setUiBusy(true);
-    log("Compressing and repacking into ABL...");
-    QMetaObject::invokeMethod(m_worker, "repack",
-        Q_ARG(QByteArray, m_ablData),
-        Q_ARG(FvhBlock, m_blocks[m_selectedBlock]),
-        Q_ARG(QByteArray, m_hexEditor->data()));
+    log(QString("Compressing and repacking %1 edited payload(s) into ABL...").arg(edits.size()));
+    m_statusLabel->setText("Compressing…");
+
+    auto *watcher = new QFutureWatcher<RepackJob>(this);
+    connect(watcher, &QFutureWatcher<RepackJob>::finished, this, [this, watcher, tree, serial]() {
+        RepackJob job = watcher->result();
+        watcher->deleteLater();
+        if (tree != m_fvTree) {
+            setUiBusy(false);
+            return;
+        }
+        if (job.image.isEmpty())
+            onWorkerError(job.error);
+        else
+            onRepackDone(job.image, serial);
+    });
+    watcher->setFuture(QtConcurrent::run([tree, edits]() {
+        RepackJob job;
+        job.image = tree->repack(edits, job.error);
+        return job;
+    }));
 }
 
-void MainWindow::onRepackDone(QByteArray newAbl) {
-    m_repackedAbl = newAbl;
+void MainWindow::onRepackDone(const QByteArray &newAbl, quint64 editSerial) {
+    m_repackedAbl   = newAbl;
+    m_repackUnsaved = true;
+    m_editsPending  = m_editSerial != editSerial;   // edited again while compressing
     m_btnSave->setEnabled(true);
+    const QString hashes = HashSegment::describe(m_ablData, newAbl);
+    if (!hashes.isEmpty()) log(hashes);
     log("Repack complete. Click 'Save patched ABL' to write to disk.");
     setUiBusy(false);
     m_statusLabel->setText("Repack done — save the patched ABL.");
-    setWindowTitle(windowTitle().replace("* unsaved changes", "* ready to save"));
+    if (!m_editsPending)
+        setWindowTitle(windowTitle().replace("* unsaved changes", "* ready to save"));
 }
 
 // ── Save ──────────────────────────────────────────────────────────
 
 void MainWindow::saveOutput() {
     if (m_repackedAbl.isEmpty()) return;
+    ABL_TRACE_SPAN("save");
+    if (m_sparse) {
+        saveSparse();
+        return;
+    }
+
+    // A partition of a dump goes back where it came from, unless asked otherwise
+    if (m_sliceOffset >= 0) {
+        QMessageBox ask(QMessageBox::Question, "Save patched partition",
+            QString("Write the patched image back into %1 at 0x%2 (%3 bytes)?")
+                .arg(QFileInfo(m_ablPath).fileName()).arg(m_sliceOffset, 0, 16).arg(m_repackedAbl.size()),
+            QMessageBox::Cancel, this);
+        QPushButton *inPlace = ask.addButton("Write into dump", QMessageBox::AcceptRole);
+        QPushButton *saveAs  = ask.addButton("Save as file…", QMessageBox::ActionRole);
+        ask.exec();
+        if (ask.clickedButton() == inPlace) {
+            QString err;
+            if (m_repackedAbl.size() != m_ablData.size()) {
+                err = "The patched image changed size; it can't replace the partition in place.";
+            } else if (DeviceDump::writeAt(m_ablPath, m_sliceOffset, m_repackedAbl, err)) {
+                m_repackUnsaved = false;
+                log(QString("Patched %1 in place at 0x%2.").arg(QFileInfo(m_ablPath).fileName()).arg(m_sliceOffset, 0, 16));
+                m_statusLabel->setText("Written into " + QFileInfo(m_ablPath).fileName());
+                setWindowTitle(QString("ABL Tool — %1").arg(m_tabs->tabText(m_tabs->currentIndex())));
+                return;
+            }
+            QMessageBox::critical(this, "Error", err);
+            return;
+        }
+        if (ask.clickedButton() != saveAs) return;
+    }
 
     QString defaultName = QFileInfo(m_ablPath).baseName()
         + "_patched_"
@@ -342,6 +1408,7 @@ void MainWindow::saveOutput() {
     }
     f.write(m_repackedAbl);
     f.close();
+    m_repackUnsaved = false;
 
     log(QString("Saved patched ABL → %1").arg(path));
     m_statusLabel->setText("Saved: " + QFileInfo(path).fileName());
@@ -420,39 +1487,164 @@ void MainWindow::searchBytes() {
     log(QString("Found at offset 0x%1").arg(found, 0, 16));
 }
 
+// ── Diff ──────────────────────────────────────────────────────────
+
+void MainWindow::diffWithFile() {
+    if (m_ablData.isEmpty()) return;
+    QString path = QFileDialog::getOpenFileName(this, "Diff against ABL file",
+        QFileInfo(m_ablPath).absolutePath(),
+        "ABL images (*.elf *.img *.bin);;All files (*)");
+    if (path.isEmpty()) return;
+
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        QMessageBox::critical(this, "Error", "Cannot open file: " + path);
+        return;
+    }
+    QByteArray other = f.readAll();
+    f.close();
+
+    struct DiffJob { QVector<BlockDiff> diffs; QString error; };
+    const QByteArray mine = m_ablData;
+    const QString nameA = QFileInfo(m_ablPath).fileName();
+    const QString nameB = QFileInfo(path).fileName();
+
+    setUiBusy(true);
+    log(QString("Diffing %1 against %2...").arg(nameA, nameB));
+
+    auto *watcher = new QFutureWatcher<DiffJob>(this);
+    connect(watcher, &QFutureWatcher<DiffJob>::finished, this, [this, watcher, nameA, nameB]() {
+        DiffJob job = watcher->result();
+        watcher->deleteLater();
+        setUiBusy(false);
+        if (job.diffs.isEmpty()) {
+            log("Diff failed: " + job.error);
+            QMessageBox::warning(this, "Diff", job.error);
+            return;
+        }
+        int total = 0;
+        for (const BlockDiff &d : job.diffs) total += d.changes.size();
+        log(QString("Diff done: %1 block pair(s), %2 changed range(s).").arg(job.diffs.size()).arg(total));
+        (new DiffWindow(nameA, nameB, job.diffs, this))->show();
+    });
+    watcher->setFuture(QtConcurrent::run([mine, other]() {
+        DiffJob job;
+        job.diffs = AblDiff::diffImages(mine, other, job.error);
+        return job;
+    }));
+}
+
+// ── Patch sets ────────────────────────────────────────────────────
+
+void MainWindow::savePatchSet() {
+    if (m_decompressed.isEmpty()) return;
+
+    QString err;
+    const QVector<PatchSignature> sigs =
+        PatchPort::fromEdits(m_decompressed, m_hexEditor->data(), 32, err);
+    if (sigs.isEmpty()) {
+        QMessageBox::information(this, "Patch set", err);
+        return;
+    }
+
+    QString defaultName = QFileInfo(m_ablPath).baseName()
+        + QString("_block%1.ablpatch").arg(m_selectedBlock + 1);
+    QString path = QFileDialog::getSaveFileName(this, "Save patch set",
+        QFileInfo(m_ablPath).dir().filePath(defaultName),
+        "ABL patch sets (*.ablpatch);;All files (*)");
+    if (path.isEmpty()) return;
+
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly)) {
+        QMessageBox::critical(this, "Error", "Cannot write to: " + path);
+        return;
+    }
+    f.write(PatchPort::toJson(sigs));
+    f.close();
+    log(QString("Saved %1 patch(es) → %2").arg(sigs.size()).arg(path));
+}
+
+void MainWindow::portPatchSet() {
+    if (m_decompressed.isEmpty()) return;
+
+    QString path = QFileDialog::getOpenFileName(this, "Port patch set",
+        QFileInfo(m_ablPath).absolutePath(),
+        "ABL patch sets (*.ablpatch);;All files (*)");
+    if (path.isEmpty()) return;
+
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        QMessageBox::critical(this, "Error", "Cannot open file: " + path);
+        return;
+    }
+    QString err;
+    const QVector<PatchSignature> sigs = PatchPort::fromJson(f.readAll(), err);
+    f.close();
+    if (sigs.isEmpty()) {
+        QMessageBox::warning(this, "Patch set", err);
+        return;
+    }
+
+    QByteArray payload = m_hexEditor->data();
+    const QVector<PortResult> results = PatchPort::locate(payload, sigs);
+    for (int i = 0; i < sigs.size(); ++i) {
+        const PortResult &r = results[i];
+        QStringList offs;
+        for (qint64 o : r.offsets.mid(0, 4)) offs << QString("0x%1").arg(o, 0, 16);
+        if (r.offsets.size() > 4) offs << "…";
+        log(QString("  %1: %2 %3").arg(sigs[i].name, PatchPort::statusName(r.status), offs.join(", ")));
+    }
+
+    const int applied = PatchPort::apply(payload, sigs, results);
+    log(QString("Ported %1 of %2 patch(es) from %3.")
+        .arg(applied).arg(sigs.size()).arg(QFileInfo(path).fileName()));
+    if (applied == 0) return;
+
+    m_hexEditor->setData(payload);
+    m_btnRepack->setEnabled(true);
+    m_editsPending = true;
+    ++m_editSerial;
+    setWindowTitle("ABL Tool — * unsaved changes");
+    m_statusLabel->setText(QString("Ported %1 patch(es) — review, then Repack").arg(applied));
+}
+
 // ── Misc ──────────────────────────────────────────────────────────
 
 void MainWindow::setUiBusy(bool busy) {
     m_btnOpen->setEnabled(!busy);
+    m_tabs->setEnabled(!busy);
     m_btnCopyFvh->setEnabled(!busy && m_selectedBlock >= 0);
     m_btnExtract->setEnabled(!busy && m_selectedBlock >= 0);
     m_btnRepack->setEnabled(!busy && !m_decompressed.isEmpty());
     m_btnSave->setEnabled(!busy && !m_repackedAbl.isEmpty());
-    m_progress->setVisible(busy);
+    m_btnDiff->setEnabled(!busy && !m_blocks.isEmpty() && !m_rawView);
+    m_btnPatches->setEnabled(!busy && !m_decompressed.isEmpty());
+    m_progress->setVisible(busy || m_scanWatcher);
 }
 
-void MainWindow::log(const QString &msg) {
-    m_logView->append(QString("[%1] %2")
-        .arg(QTime::currentTime().toString("HH:mm:ss"))
-        .arg(msg));
+// Queued for the log panel, which drains it on a short timer
+void MainWindow::log(const QString &msg, Log::Level level) {
+    Log::write(level, msg);
 }
 
 void MainWindow::onWorkerError(QString message) {
+    m_extractNode = nullptr;
+    m_extractTree.reset();
     setUiBusy(false);
-    log("ERROR: " + message);
+    log(message, Log::Error);
     QMessageBox::critical(this, "Error", message);
     m_statusLabel->setText("Error — see log.");
 }
 
-void MainWindow::onWorkerProgress(QString message) {
-    log(message);
-    m_statusLabel->setText(message);
-}
-
 void MainWindow::closeEvent(QCloseEvent *event) {
-    if (!m_repackedAbl.isEmpty() && windowTitle().contains("ready to save")) {
+    stashSession();
+    QStringList unsaved;
+    for (const ImageSession &s : m_sessions)
+        if (hasUnsavedWork(s))
+            unsaved << QFileInfo(s.path).fileName();
+    if (!unsaved.isEmpty()) {
         auto reply = QMessageBox::question(this, "Unsaved changes",
-            "You have a repacked ABL that hasn't been saved. Quit anyway?",
+            QString("Edits or repacked images haven't been saved (%1). Quit anyway?").arg(unsaved.join(", ")),
             QMessageBox::Yes | QMessageBox::No);
         if (reply != QMessageBox::Yes) { event->ignore(); return; }
     }
@@ -2,16 +2,56 @@
 
 #include <QMainWindow>
 #include <QByteArray>
+#include <QElapsedTimer>
+#include <QFileSystemWatcher>
+#include <QFutureWatcher>
+#include <QPointer>
 #include <QThread>
 #include <QLabel>
 #include <QPushButton>
-#include <QListWidget>
+#include <QTreeWidget>
+#include <QHash>
+#include <QSet>
+#include <QTimer>
+#include <QSharedPointer>
 #include <QSplitter>
-#include <QTextEdit>
+#include <QStackedWidget>
+#include <QTabBar>
 #include <QProgressBar>
 #include "HexEditor.h"
+#include "LogView.h"
+#include "Minimap.h"
+#include "CostMap.h"
+#include "DisasmView.h"
 #include "FvhParser.h"
 #include "AblWorker.h"
+#include "FvTree.h"
+#include "PayloadCache.h"
+#include "SparseImage.h"
+
+// One open image (a tab). The shown image's state lives in MainWindow's
+// members and is stashed here while another tab is active.
+struct ImageSession {
+    QString           path;
+    QByteArray        data;
+    QVector<FvhBlock> blocks;
+    QSharedPointer<FvTree> tree;
+    QSharedPointer<HexDataProvider> rawView;   // read-only raw dump instead of a scan
+    QSharedPointer<SparseImage> sparse;        // `path` is a sparse image; data is expanded from it
+    QTreeWidget      *blockTree = nullptr;     // kept per tab, with its expansion state
+    int               selectedBlock = -1;
+    FvNode           *selectedNode  = nullptr;
+    QByteArray        repacked;
+    qint64            sliceOffset = -1;        // data is this range of the dump at `path`
+    bool              scanComplete = true;     // false: resume the _FVH scan when shown
+    bool              watched = false;         // reloaded when `path` changes on disk
+    bool              reloadPending = false;   // changed while another tab was shown
+    QVector<quint64>  chunkHashes;             // ImageDelta summary of data, while watched
+    bool              editsPending = false;    // payload edits made since the last repack
+    bool              repackUnsaved = false;   // `repacked` hasn't been written anywhere yet
+    QString           title;
+    QString           status;
+};
 
 class MainWindow : public QMainWindow {
     Q_OBJECT
@@ -26,31 +66,93 @@ protected:
 
 private slots:
     void openFile();
-    void onBlockSelected(int index);
+    void onItemSelected(QTreeWidgetItem *item);
+    void onItemExpanded(QTreeWidgetItem *item);
     void extractBlock();
     void repackBlock();
     void saveOutput();
     void copyFvhBlock();
     void onExtractDone(QByteArray decompressed);
-    void onRepackDone(QByteArray newAbl);
     void onWorkerError(QString message);
-    void onWorkerProgress(QString message);
     void goToOffset();
     void searchBytes();
+    void diffWithFile();
+    void savePatchSet();
+    void portPatchSet();
+    void onTabChanged(int index);
+    void onTabCloseRequested(int index);
+    void onItemClicked(QTreeWidgetItem *item);
 
 private:
     void loadFile(const QString &path);
-    void populateBlockList();
+    void openRawView(const QString &path, const QSharedPointer<SparseImage> &sparse = {});
+    void openSparse(const QString &path);
+    void saveSparse();
+    void openSlice(qint64 offset, qint64 size, const QString &name);
+    QTreeWidgetItem *addSliceItem(const QString &name, qint64 offset, qint64 size, const QString &note);
+    void beginImage(const QString &name);
+    void openSession(const QString &path, const QString &tabName = QString());
+    void stashSession();
+    void activateSession(int id);
+    void clearSession();
+    int  tabIndexOf(int id) const;
+    QTreeWidget *createBlockTree();
+    void storeCurrentPayload();
+    bool showCachedPayload(FvNode *node);
+    bool hasUnsavedWork(const ImageSession &s) const;   // stashed sessions only
+    void startScan();
+    void cancelScan();
+    void onBlockFound(const FvhBlock &block);
+    void onScanFinished();
+    QTreeWidgetItem *addBlockItem(int index);
+    void addChildItems(QTreeWidgetItem *item, FvNode *node);
+    void extractNode(FvNode *node);
+    void repackEdits(const QVector<FvTree::Edit> &edits);
+    void onRepackDone(const QByteArray &newAbl, quint64 editSerial);
+    void setWatched(bool on);
+    void updateWatchButton();
+    void updateWatchedPaths();
+    void onWatchedFileChanged(const QString &path);
+    void onWatchedDirChanged(const QString &dir);
+    void reloadChangedFiles();
+    void reloadShown();
+    void rebuildBlockTree();
     void setUiBusy(bool busy);
-    void log(const QString &msg);
+    void log(const QString &msg, Log::Level level = Log::Info);
 
     // Data
     QByteArray        m_ablData;
     QString           m_ablPath;
     QVector<FvhBlock> m_blocks;
     int               m_selectedBlock = -1;
+    FvNode           *m_selectedNode  = nullptr;   // tree node behind the hex view
+    FvNode           *m_extractNode   = nullptr;   // node the worker is decoding
+    QSharedPointer<FvTree> m_extractTree;         // and the tree it belongs to
+    QSharedPointer<FvTree> m_fvTree;              // nested volumes/files/sections
+    QSharedPointer<HexDataProvider> m_rawView;
+    QSharedPointer<SparseImage> m_sparse;          // m_ablPath is sparse; offsets are expanded ones
     QByteArray        m_decompressed;
     QByteArray        m_repackedAbl;
+    qint64            m_sliceOffset = -1;          // m_ablData's offset in the dump at m_ablPath
+    bool              m_editsPending  = false;     // see ImageSession
+    bool              m_repackUnsaved = false;
+    quint64           m_editSerial    = 0;         // bumped on every payload edit
+
+    // Background _FVH scan of the shown image
+    QPointer<QFutureWatcher<FvhBlock>> m_scanWatcher;
+    QElapsedTimer     m_scanClock;
+    bool              m_scanComplete = true;
+
+    // Open images
+    QHash<int, ImageSession> m_sessions;
+    int               m_sessionId     = 0;         // shown tab, 0 = none
+    int               m_nextSessionId = 0;
+    PayloadCache      m_payloads{1024LL * 1024 * 1024};
+
+    // Watch mode: images reloaded after another tool rewrites them
+    QFileSystemWatcher *m_fileWatcher = nullptr;
+    QTimer            m_reloadTimer;               // settles a burst of writes
+    QSet<QString>     m_changedPaths;
 
     // Worker thread
     QThread    *m_thread = nullptr;
@@ -58,17 +160,27 @@ private:
 
     // UI
     QSplitter    *m_splitter    = nullptr;
-    QListWidget  *m_blockList   = nullptr;
+    QTabBar      *m_tabs        = nullptr;
+    QStackedWidget *m_treeStack = nullptr;   // one block tree per tab
+    QTreeWidget  *m_blockTree   = nullptr;   // the shown one
     HexEditor    *m_hexEditor   = nullptr;
-    QTextEdit    *m_logView     = nullptr;
+    Minimap      *m_minimap     = nullptr;
+    CostMap      *m_costMap     = nullptr;
+    DisasmView   *m_disasmView  = nullptr;
+    LogView      *m_logView     = nullptr;
     QLabel       *m_statusLabel = nullptr;
     QProgressBar *m_progress    = nullptr;
+    QLabel       *m_costLabel   = nullptr;
 
     QPushButton  *m_btnOpen    = nullptr;
+    QPushButton  *m_btnWatch   = nullptr;
     QPushButton  *m_btnExtract = nullptr;
     QPushButton  *m_btnRepack  = nullptr;
     QPushButton  *m_btnSave    = nullptr;
     QPushButton  *m_btnCopyFvh = nullptr;
     QPushButton  *m_btnGoTo    = nullptr;
     QPushButton  *m_btnSearch  = nullptr;
+    QPushButton  *m_btnDiff    = nullptr;
+    QPushButton  *m_btnPatches = nullptr;
+    QPushButton  *m_btnCost    = nullptr;
 };
@@ -0,0 +1,147 @@
+#include "Minimap.h"
+#include "HexEditor.h"
+
+#include <QFutureWatcher>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QToolTip>
+#include <QtConcurrent>
+
+Minimap::Minimap(HexEditor *editor, QWidget *parent) : QWidget(parent), m_editor(editor) {
+    setFixedWidth(28);
+    setMouseTracking(true);
+    setCursor(Qt::PointingHandCursor);
+
+    connect(m_editor, &HexEditor::dataReset,        this, &Minimap::recompute);
+    connect(m_editor, &HexEditor::bytesChanged,     this, &Minimap::onBytesChanged);
+    connect(m_editor, &HexEditor::topOffsetChanged, this, [this]() { update(); });
+}
+
+// ── Stats ─────────────────────────────────────────────────────────
+
+void Minimap::recompute() {
+    const quint64 generation = ++m_generation;
+    const QByteArray data = m_editor->data();   // shared, not copied
+    m_stats.clear();
+    m_size = data.size();
+    m_dirtyStart = m_dirtyEnd = -1;
+    m_computing = !data.isEmpty();
+    render();
+    if (data.isEmpty()) return;   // nothing loaded, or a file-backed raw view
+
+    auto *watcher = new QFutureWatcher<QVector<ChunkStats>>(this);
+    connect(watcher, &QFutureWatcher<QVector<ChunkStats>>::finished, this, [this, watcher, generation]() {
+        watcher->deleteLater();
+        if (generation != m_generation) return;
+        m_stats = watcher->result();
+        m_computing = false;
+        if (m_dirtyStart >= 0)
+            ByteStats::update(m_editor->data(), m_stats, m_dirtyStart, m_dirtyEnd - m_dirtyStart);
+        m_dirtyStart = m_dirtyEnd = -1;
+        render();
+    });
+    watcher->setFuture(QtConcurrent::run([data]() { return ByteStats::compute(data); }));
+}
+
+void Minimap::onBytesChanged(qint64 offset, qint64 length) {
+    if (m_computing) {
+        m_dirtyStart = m_dirtyStart < 0 ? offset : qMin(m_dirtyStart, offset);
+        m_dirtyEnd   = qMax(m_dirtyEnd, offset + length);
+        return;
+    }
+    ByteStats::update(m_editor->data(), m_stats, offset, length);
+    render();
+}
+
+// ── Rendering ─────────────────────────────────────────────────────
+
+QColor Minimap::colorFor(const ChunkStats &s) {
+    if (s.fill > 0.9f)    return QColor(20, 20, 20);                     // 00/FF padding
+    if (s.text > 0.85f)   return QColor(90, 190, 90);                    // strings
+    if (s.code > 0.7f)    return QColor(60, 110, int(140 + 15 * s.entropy));   // ARM64 code
+    if (s.entropy > 7.2f) return QColor(200, 70, 50);                    // compressed / encrypted
+    const int v = int(40 + 20 * s.entropy);                              // other data
+    return QColor(v, v * 4 / 5, 40);
+}
+
+void Minimap::render() {
+    const int h = qMax(1, height());
+    m_image = QImage(1, h, QImage::Format_RGB32);
+    m_image.fill(QColor(30, 30, 30));
+    const qint64 n = m_stats.size();
+    if (n == 0) {
+        update();
+        return;
+    }
+
+    // Each pixel row averages the chunks it covers
+    for (int y = 0; y < h; ++y) {
+        const qint64 first = qMin(n - 1, y * n / h);
+        const qint64 last  = qMax(first + 1, qMin(n, (y + 1) * n / h));
+        ChunkStats avg;
+        for (qint64 c = first; c < last; ++c) {
+            avg.entropy += m_stats[c].entropy;
+            avg.fill    += m_stats[c].fill;
+            avg.text    += m_stats[c].text;
+            avg.code    += m_stats[c].code;
+        }
+        const float k = 1.0f / float(last - first);
+        avg.entropy *= k; avg.fill *= k; avg.text *= k; avg.code *= k;
+        m_image.setPixelColor(0, y, colorFor(avg));
+    }
+    update();
+}
+
+void Minimap::paintEvent(QPaintEvent *) {
+    QPainter p(this);
+    p.drawImage(rect(), m_image);
+    if (m_size <= 0) return;
+
+    // Outline of what the hex view currently shows
+    const double scale = double(height()) / m_size;
+    const int y0 = int(m_editor->topOffset() * scale);
+    const int hh = qMax(3, int(m_editor->visibleBytes() * scale));
+    p.setPen(QColor(230, 230, 230));
+    p.setBrush(Qt::NoBrush);
+    p.drawRect(0, y0, width() - 1, qMin(hh, height() - 1 - y0));
+}
+
+void Minimap::resizeEvent(QResizeEvent *event) {
+    QWidget::resizeEvent(event);
+    render();
+}
+
+// ── Navigation ────────────────────────────────────────────────────
+
+qint64 Minimap::offsetAt(int y) const {
+    if (m_size <= 0 || height() <= 0) return -1;
+    return qBound<qint64>(0, qint64(double(y) / height() * m_size), m_size - 1);
+}
+
+void Minimap::jumpTo(int y) {
+    const qint64 off = offsetAt(y);
+    if (off < 0) return;
+    // Centre the clicked spot in the hex view
+    m_editor->scrollToOffset(qMax<qint64>(0, off - m_editor->visibleBytes() / 2));
+}
+
+void Minimap::mousePressEvent(QMouseEvent *event) {
+    if (event->button() == Qt::LeftButton) jumpTo(event->pos().y());
+}
+
+void Minimap::mouseMoveEvent(QMouseEvent *event) {
+    if (event->buttons() & Qt::LeftButton) {
+        jumpTo(event->pos().y());
+        return;
+    }
+    const qint64 off = offsetAt(event->pos().y());
+    const qint64 c = off / ByteStats::ChunkSize;
+    if (off < 0 || c >= m_stats.size()) return;
+    const ChunkStats &s = m_stats[c];
+    QToolTip::showText(event->globalPosition().toPoint(),
+        QString("0x%1\nentropy %2 bits/byte\npadding %3%  text %4%  code %5%")
+            .arg(c * ByteStats::ChunkSize, 0, 16)
+            .arg(s.entropy, 0, 'f', 2)
+            .arg(int(s.fill * 100)).arg(int(s.text * 100)).arg(int(s.code * 100)),
+        this);
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <QImage>
+#include <QWidget>
+#include "ByteStats.h"
+
+class HexEditor;
+
+// Vertical overview strip for a HexEditor: one colour per pixel row showing
+// what the bytes there look like (padding, ARM64 code, strings, compressed
+// data). The visible range is outlined; click or drag to jump.
+class Minimap : public QWidget {
+    Q_OBJECT
+public:
+    explicit Minimap(HexEditor *editor, QWidget *parent = nullptr);
+
+    QSize sizeHint() const override { return QSize(28, 200); }
+
+protected:
+    void paintEvent(QPaintEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+
+private:
+    void recompute();
+    void onBytesChanged(qint64 offset, qint64 length);
+    void render();
+    qint64 offsetAt(int y) const;
+    void jumpTo(int y);
+
+    static QColor colorFor(const ChunkStats &s);
+
+    HexEditor          *m_editor;
+    QVector<ChunkStats> m_stats;
+    qint64              m_size       = 0;
+    quint64             m_generation = 0;     // drops results for replaced data
+    bool                m_computing  = false;
+    qint64              m_dirtyStart = -1;    // edits made while computing
+    qint64              m_dirtyEnd   = -1;
+    QImage              m_image;
+};
@@ -0,0 +1,466 @@
+#include "PatchPort.h"
+#include "Trace.h"
+
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QtConcurrent>
+#include <cstring>
+#include <unordered_map>
+#include <vector>
+
+static constexpr int    FORMAT_VERSION   = 1;
+static constexpr int    ANCHOR_LEN       = 8;
+static constexpr int    MERGE_GAP        = 8;          // runs closer than this share a signature
+static constexpr qint64 SEGMENT_SIZE     = 4 * 1024 * 1024;
+static constexpr int    FILTER_BITS      = 20;         // 128 KB pre-filter over 4-byte prefixes
+
+static inline quint32 load32(const quint8 *p) {
+    quint32 v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+static inline quint64 load64(const quint8 *p) {
+    quint64 v;
+    std::memcpy(&v, p, 8);
+    return v;
+}
+
+static inline quint32 filterSlot(quint32 prefix) {
+    return (prefix * 0x9E3779B1u) >> (32 - FILTER_BITS);
+}
+
+// ── ARM64 relocation masks ───────────────────────────────────────────────────
+
+quint32 PatchPort::arm64RelocMask(quint32 insn, quint32 prev) {
+    // B / BL imm26
+    if ((insn & 0x7C000000) == 0x14000000) return 0xFC000000;
+    // B.cond imm19
+    if ((insn & 0xFF000010) == 0x54000000) return 0xFF00001F;
+    // CBZ / CBNZ imm19
+    if ((insn & 0x7E000000) == 0x34000000) return 0xFF00001F;
+    // TBZ / TBNZ imm14
+    if ((insn & 0x7E000000) == 0x36000000) return 0xFFF8001F;
+    // ADR / ADRP immlo:immhi
+    if ((insn & 0x1F000000) == 0x10000000) return 0x9F00001F;
+    // LDR / LDRSW / PRFM (literal) imm19
+    if ((insn & 0x3B000000) == 0x18000000) return 0xFF00001F;
+
+    // Page offset paired with a preceding ADRP on the same register
+    const bool prevAdrp = (prev & 0x9F000000) == 0x90000000;
+    if (prevAdrp) {
+        const quint32 page = prev & 0x1F;
+        const quint32 rn   = (insn >> 5) & 0x1F;
+        // ADD (immediate), 32/64-bit, no flags
+        if ((insn & 0x7F800000) == 0x11000000 && rn == page) return 0xFFC003FF;
+        // LDR / STR (unsigned offset), any size
+        if ((insn & 0x3B000000) == 0x39000000 && rn == page) return 0xFFC003FF;
+    }
+    return 0xFFFFFFFF;
+}
+
+// `ctxStart` must be 4-byte aligned within `data`
+static QByteArray buildMask(const QByteArray &data, qint64 ctxStart, qint64 ctxLen) {
+    QByteArray mask(ctxLen, char(0xFF));
+    const quint8 *p = reinterpret_cast<const quint8 *>(data.constData());
+    for (qint64 i = 0; i + 4 <= ctxLen; i += 4) {
+        const qint64 at = ctxStart + i;
+        const quint32 insn = load32(p + at);
+        const quint32 prev = at >= 4 ? load32(p + at - 4) : 0;
+        const quint32 m = PatchPort::arm64RelocMask(insn, prev);
+        std::memcpy(mask.data() + i, &m, 4);
+    }
+    return mask;
+}
+
+// ── Building signatures ──────────────────────────────────────────────────────
+
+QVector<PatchSignature> PatchPort::fromEdits(const QByteArray &original,
+                                             const QByteArray &edited,
+                                             int contextRadius,
+                                             QString &errorOut)
+{
+    if (original.size() != edited.size()) {
+        errorOut = QString("Payload size changed (%1 → %2 bytes); only in-place edits can be ported.")
+                       .arg(original.size()).arg(edited.size());
+        return {};
+    }
+
+    const qint64 size = original.size();
+    const char *a = original.constData();
+    const char *b = edited.constData();
+
+    QVector<PatchSignature> sigs;
+    qint64 i = 0;
+    while (i < size) {
+        if (a[i] == b[i]) { ++i; continue; }
+
+        // Extend the run, swallowing short stretches of equal bytes
+        qint64 end = i + 1;
+        qint64 lastDiff = i;
+        while (end < size && end - lastDiff <= MERGE_GAP) {
+            if (a[end] != b[end]) lastDiff = end;
+            ++end;
+        }
+        end = lastDiff + 1;
+
+        const qint64 ctxStart = qMax<qint64>(0, i - contextRadius) & ~qint64(3);
+        const qint64 ctxEnd   = qMin<qint64>(size, (end + contextRadius + 3) & ~qint64(3));
+
+        PatchSignature s;
+        s.name         = QString("patch@0x%1").arg(i, 8, 16, QChar('0'));
+        s.sourceOffset = i;
+        s.context      = original.mid(ctxStart, ctxEnd - ctxStart);
+        s.mask         = buildMask(original, ctxStart, ctxEnd - ctxStart);
+        s.patchOffset  = qint32(i - ctxStart);
+        s.original     = original.mid(i, end - i);
+        s.replacement  = edited.mid(i, end - i);
+        sigs.append(s);
+
+        i = end;
+    }
+
+    if (sigs.isEmpty()) errorOut = "No edits to save: the payload is unchanged.";
+    return sigs;
+}
+
+// ── Serialisation ────────────────────────────────────────────────────────────
+
+QByteArray PatchPort::toJson(const QVector<PatchSignature> &sigs) {
+    QJsonArray patches;
+    for (const PatchSignature &s : sigs) {
+        QJsonObject o;
+        o["name"]         = s.name;
+        o["sourceOffset"] = double(s.sourceOffset);
+        o["context"]      = QString::fromLatin1(s.context.toHex());
+        o["mask"]         = QString::fromLatin1(s.mask.toHex());
+        o["patchOffset"]  = s.patchOffset;
+        o["original"]     = QString::fromLatin1(s.original.toHex());
+        o["replacement"]  = QString::fromLatin1(s.replacement.toHex());
+        patches.append(o);
+    }
+    QJsonObject root;
+    root["format"]  = "ablpatch";
+    root["version"] = FORMAT_VERSION;
+    root["patches"] = patches;
+    return QJsonDocument(root).toJson(QJsonDocument::Indented);
+}
+
+QVector<PatchSignature> PatchPort::fromJson(const QByteArray &json, QString &errorOut) {
+    QJsonParseError perr;
+    const QJsonDocument doc = QJsonDocument::fromJson(json, &perr);
+    if (doc.isNull()) {
+        errorOut = "Invalid patch file: " + perr.errorString();
+        return {};
+    }
+    const QJsonObject root = doc.object();
+    if (root["format"].toString() != "ablpatch" || root["version"].toInt() != FORMAT_VERSION) {
+        errorOut = "Not an ablpatch v1 file.";
+        return {};
+    }
+
+    QVector<PatchSignature> sigs;
+    const QJsonArray patches = root["patches"].toArray();
+    for (int i = 0; i < patches.size(); ++i) {
+        const QJsonObject o = patches[i].toObject();
+        PatchSignature s;
+        s.name         = o["name"].toString();
+        s.sourceOffset = qint64(o["sourceOffset"].toDouble(-1));
+        s.context      = QByteArray::fromHex(o["context"].toString().toLatin1());
+        s.mask         = QByteArray::fromHex(o["mask"].toString().toLatin1());
+        s.patchOffset  = o["patchOffset"].toInt(-1);
+        s.original     = QByteArray::fromHex(o["original"].toString().toLatin1());
+        s.replacement  = QByteArray::fromHex(o["replacement"].toString().toLatin1());
+
+        if (s.mask.size() != s.context.size() || s.original.isEmpty()
+            || s.original.size() != s.replacement.size() || s.patchOffset < 0
+            || s.patchOffset + s.original.size() > s.context.size()) {
+            errorOut = QString("Patch #%1 (%2) is malformed.").arg(i + 1).arg(s.name);
+            return {};
+        }
+        sigs.append(s);
+    }
+    if (sigs.isEmpty()) errorOut = "Patch file contains no patches.";
+    return sigs;
+}
+
+QString PatchPort::statusName(PortStatus status) {
+    switch (status) {
+    case PortStatus::Unique:         return "unique";
+    case PortStatus::Ambiguous:      return "ambiguous";
+    case PortStatus::AlreadyApplied: return "already applied";
+    case PortStatus::Missing:        return "missing";
+    }
+    return QString();
+}
+
+// ── Search ───────────────────────────────────────────────────────────────────
+
+namespace {
+
+// Where a signature's anchor sits inside its context
+struct Anchor {
+    int sig;
+    int pos;
+};
+
+struct Hit {
+    int    sig;
+    qint64 offset;      // payload offset of the patched bytes
+    bool   applied;     // matched the replacement rather than the original
+};
+
+// Pick the fully-unmasked 8-byte window outside the patched bytes with the
+// most distinct byte values; -1 if the context has none.
+int chooseAnchor(const PatchSignature &s) {
+    const int len = s.context.size();
+    const int patchEnd = s.patchOffset + s.original.size();
+    const quint8 *ctx  = reinterpret_cast<const quint8 *>(s.context.constData());
+    const quint8 *mask = reinterpret_cast<const quint8 *>(s.mask.constData());
+
+    int best = -1, bestScore = 1;
+    for (int pos = 0; pos + ANCHOR_LEN <= len; ++pos) {
+        if (pos < patchEnd && pos + ANCHOR_LEN > s.patchOffset) continue;
+        if (load64(mask + pos) != ~quint64(0)) continue;
+
+        int score = 0;
+        for (int k = 0; k < ANCHOR_LEN; ++k) {
+            bool seen = false;
+            for (int j = 0; j < k; ++j) seen |= ctx[pos + j] == ctx[pos + k];
+            score += !seen;
+        }
+        // Prefer instruction-aligned windows on ties
+        score = score * 2 + (pos % 4 == 0);
+        if (score > bestScore) { bestScore = score; best = pos; }
+    }
+    return best;
+}
+
+bool maskedEqual(const quint8 *p, const quint8 *ref, const quint8 *mask, qint64 n) {
+    for (qint64 i = 0; i < n; ++i)
+        if ((p[i] ^ ref[i]) & mask[i]) return false;
+    return true;
+}
+
+// Verify signature `s` with its context starting at `ctxStart` and record the hit
+void verify(const PatchSignature &s, const quint8 *data, qint64 size, qint64 ctxStart,
+            int sigIndex, QVector<Hit> &hits)
+{
+    const qint64 len = s.context.size();
+    if (ctxStart < 0 || ctxStart + len > size) return;
+
+    const quint8 *p    = data + ctxStart;
+    const quint8 *ctx  = reinterpret_cast<const quint8 *>(s.context.constData());
+    const quint8 *mask = reinterpret_cast<const quint8 *>(s.mask.constData());
+    const qint64 po = s.patchOffset;
+    const qint64 pl = s.original.size();
+
+    if (!maskedEqual(p, ctx, mask, po)) return;
+    if (!maskedEqual(p + po + pl, ctx + po + pl, mask + po + pl, len - po - pl)) return;
+
+    if (maskedEqual(p + po, ctx + po, mask + po, pl)) {
+        hits.append({ sigIndex, ctxStart + po, false });
+    } else if (std::memcmp(p + po, s.replacement.constData(), pl) == 0) {
+        hits.append({ sigIndex, ctxStart + po, true });
+    }
+}
+
+} // namespace
+
+QVector<PortResult> PatchPort::locate(const QByteArray &payload,
+                                      const QVector<PatchSignature> &sigs)
+{
+    ABL_TRACE_SPAN("port_locate");
+
+    const quint8 *data = reinterpret_cast<const quint8 *>(payload.constData());
+    const qint64 size  = payload.size();
+
+    // Index every signature by its anchor; a 4-byte-prefix bit filter keeps
+    // the per-position cost of the scan to one load and one bit test.
+    std::unordered_map<quint64, std::vector<Anchor>> index;
+    std::vector<quint64> filter((size_t(1) << FILTER_BITS) / 64, 0);
+    QVector<int> unanchored;
+    for (int i = 0; i < sigs.size(); ++i) {
+        const int pos = chooseAnchor(sigs[i]);
+        if (pos < 0) { unanchored.append(i); continue; }
+        const quint8 *a = reinterpret_cast<const quint8 *>(sigs[i].context.constData()) + pos;
+        index[load64(a)].push_back({ i, pos });
+        const quint32 slot = filterSlot(load32(a));
+        filter[slot / 64] |= quint64(1) << (slot % 64);
+    }
+
+    // Scan segments in parallel; each one owns the anchor starts inside it
+    QVector<qint64> starts;
+    for (qint64 s = 0; s < size; s += SEGMENT_SIZE) starts.append(s);
+
+    auto perSeg = QtConcurrent::blockingMapped<QVector<QVector<Hit>>>(
+        starts, [&](qint64 segStart) {
+            QVector<Hit> hits;
+            const qint64 segEnd = qMin(size - ANCHOR_LEN + 1, segStart + SEGMENT_SIZE);
+            for (qint64 p = segStart; p < segEnd; ++p) {
+                const quint32 slot = filterSlot(load32(data + p));
+                if (!(filter[slot / 64] >> (slot % 64) & 1)) continue;
+                auto it = index.find(load64(data + p));
+                if (it == index.end()) continue;
+                for (const Anchor &a : it->second)
+                    verify(sigs[a.sig], data, size, p - a.pos, a.sig, hits);
+            }
+            return hits;
+        });
+
+    QVector<Hit> hits;
+    for (const QVector<Hit> &h : perSeg) hits += h;
+
+    // Contexts without a usable anchor (fully relocatable code) fall back to
+    // a direct masked scan
+    for (int i : unanchored) {
+        const qint64 len = sigs[i].context.size();
+        for (qint64 p = 0; p + len <= size; ++p)
+            verify(sigs[i], data, size, p, i, hits);
+    }
+
+    QVector<PortResult> results(sigs.size());
+    QVector<QVector<qint64>> applied(sigs.size());
+    for (const Hit &h : hits) {
+        if (h.applied) applied[h.sig].append(h.offset);
+        else           results[h.sig].offsets.append(h.offset);
+    }
+    for (int i = 0; i < sigs.size(); ++i) {
+        PortResult &r = results[i];
+        if (r.offsets.size() == 1)      r.status = PortStatus::Unique;
+        else if (r.offsets.size() > 1)  r.status = PortStatus::Ambiguous;
+        else if (!applied[i].isEmpty()) { r.status = PortStatus::AlreadyApplied; r.offsets = applied[i]; }
+        else                            r.status = PortStatus::Missing;
+    }
+
+    ABL_TRACE_COUNT("abl_port_scanned_bytes_total", "Payload bytes scanned for patch signatures", size);
+    return results;
+}
+
+int PatchPort::apply(QByteArray &payload,
+                     const QVector<PatchSignature> &sigs,
+                     const QVector<PortResult> &results)
+{
+    int applied = 0;
+    for (int i = 0; i < sigs.size() && i < results.size(); ++i) {
+        if (results[i].status != PortStatus::Unique) continue;
+        const qint64 off = results[i].offsets.first();
+        std::memcpy(payload.data() + off, sigs[i].replacement.constData(), sigs[i].replacement.size());
+        ++applied;
+    }
+    return applied;
+}
+
+// ── Whole images ─────────────────────────────────────────────────────────────
+
+QVector<PortResult> PatchPort::portImage(const QByteArray &image,
+                                         const QVector<PatchSignature> &sigs,
+                                         QByteArray &patchedOut,
+                                         QString &errorOut,
+                                         bool partial)
+{
+    ABL_TRACE_SPAN("port_image");
+    patchedOut.clear();
+
+    const QVector<FvhBlock> blocks = FvhParser(image).findBlocks();
+    if (blocks.isEmpty()) {
+        errorOut = "No _FVH blocks found.";
+        return {};
+    }
+
+    QVector<QByteArray> payloads(blocks.size());
+    for (int b = 0; b < blocks.size(); ++b) {
+        if (!blocks[b].hasLzma) continue;
+        QString err;
+        payloads[b] = FvhParser::decompress(blocks[b], err);
+        if (!err.isEmpty()) payloads[b].clear();
+    }
+    return portDecoded(image, blocks, payloads, sigs, patchedOut, errorOut, partial);
+}
+
+QVector<PortResult> PatchPort::portDecoded(const QByteArray &image,
+                                           const QVector<FvhBlock> &blocks,
+                                           const QVector<QByteArray> &payloads,
+                                           const QVector<PatchSignature> &sigs,
+                                           QByteArray &patchedOut,
+                                           QString &errorOut,
+                                           bool partial)
+{
+    patchedOut.clear();
+
+    // Merge per-block results: a signature that is unique in one block and
+    // absent from the others is still unique overall.
+    QVector<PortResult> merged(sigs.size());
+    QVector<QVector<PortResult>> perBlock(blocks.size());
+    for (int b = 0; b < blocks.size(); ++b) {
+        if (payloads[b].isEmpty()) continue;
+        perBlock[b] = locate(payloads[b], sigs);
+
+        for (int i = 0; i < sigs.size(); ++i) {
+            const PortResult &r = perBlock[b][i];
+            PortResult &m = merged[i];
+            if (r.status == PortStatus::Missing) continue;
+            if (m.status == PortStatus::Missing
+                || (m.status == PortStatus::AlreadyApplied && r.status != PortStatus::AlreadyApplied)) {
+                m = r;
+                m.block = b;
+            } else if (r.status != PortStatus::AlreadyApplied) {
+                // Found in more than one block
+                m.status = PortStatus::Ambiguous;
+                m.offsets += r.offsets;
+            }
+        }
+    }
+
+    // The whole report comes before any repack: a set that doesn't port
+    // completely is only applied in part when asked to
+    if (!partial) {
+        int ambiguous = 0, missing = 0;
+        for (const PortResult &m : merged) {
+            ambiguous += m.status == PortStatus::Ambiguous;
+            missing   += m.status == PortStatus::Missing;
+        }
+        if (ambiguous + missing > 0) {
+            errorOut = QString("%1 ambiguous, %2 missing; nothing applied.").arg(ambiguous).arg(missing);
+            return merged;
+        }
+    }
+
+    QVector<FvhParser::RepackEdit> edits;
+    QVector<int> editBlock;
+    int applied = 0;
+    for (int b = 0; b < blocks.size(); ++b) {
+        if (payloads[b].isEmpty()) continue;
+        QVector<PortResult> mine(sigs.size());
+        for (int i = 0; i < sigs.size(); ++i)
+            if (merged[i].status == PortStatus::Unique && merged[i].block == b) mine[i] = merged[i];
+
+        QByteArray payload = payloads[b];
+        const int n = apply(payload, sigs, mine);
+        if (n == 0) continue;
+
+        FvhParser::RepackEdit edit;
+        edit.block   = blocks[b];
+        edit.patched = payload;
+        edits.append(edit);
+        editBlock.append(b);
+        applied += n;
+    }
+    if (applied == 0) return merged;
+
+    // All touched blocks encode together; one failure leaves the image alone
+    QString err;
+    const QByteArray out = FvhParser::repackBatch(image, edits, err);
+    if (out.isEmpty()) {
+        for (int i = 0; i < edits.size(); ++i) {
+            if (edits[i].error.isEmpty()) continue;
+            errorOut = QString("Block %1: %2").arg(editBlock[i] + 1).arg(edits[i].error);
+            return merged;
+        }
+        errorOut = err;
+        return merged;
+    }
+    patchedOut = out;
+    return merged;
+}
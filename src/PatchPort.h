@@ -0,0 +1,81 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+#include "FvhParser.h"
+
+// A patch anchored by the bytes around it rather than by a raw offset, so it
+// can be found again in a different build of the same payload.
+struct PatchSignature {
+    QString    name;
+    qint64     sourceOffset = -1;   // where it was taken from (informational)
+    QByteArray context;             // surrounding bytes, 4-byte aligned
+    QByteArray mask;                // per-bit mask over context; 0 bits are
+                                    // relocatable ARM64 immediates
+    qint32     patchOffset = 0;     // start of the patched bytes inside context
+    QByteArray original;            // bytes the patch replaces
+    QByteArray replacement;         // bytes it writes
+};
+
+enum class PortStatus {
+    Unique,          // exactly one place matches: safe to apply
+    Ambiguous,       // several places match
+    AlreadyApplied,  // only found with the replacement bytes already in place
+    Missing          // context not found
+};
+
+struct PortResult {
+    PortStatus       status = PortStatus::Missing;
+    int              block  = -1;   // block the matches are in (portImage only)
+    QVector<qint64>  offsets;       // payload offsets of the patched bytes
+};
+
+class PatchPort {
+public:
+    // One signature per run of changed bytes between two same-sized payloads
+    static QVector<PatchSignature> fromEdits(const QByteArray &original,
+                                             const QByteArray &edited,
+                                             int contextRadius,
+                                             QString &errorOut);
+
+    static QByteArray toJson(const QVector<PatchSignature> &sigs);
+    static QVector<PatchSignature> fromJson(const QByteArray &json, QString &errorOut);
+
+    // Locate all signatures with one indexed pass over the payload.
+    // Results are parallel to `sigs`.
+    static QVector<PortResult> locate(const QByteArray &payload,
+                                      const QVector<PatchSignature> &sigs);
+
+    // Write the replacement bytes of every Unique result; returns how many
+    static int apply(QByteArray &payload,
+                     const QVector<PatchSignature> &sigs,
+                     const QVector<PortResult> &results);
+
+    // Decode every block of `image`, port the signatures into whichever block
+    // holds them and repack the touched blocks. Unless `partial` is set,
+    // nothing is applied while any signature is Ambiguous or Missing (the
+    // results still report every one). patchedOut is left empty when
+    // nothing was applied.
+    static QVector<PortResult> portImage(const QByteArray &image,
+                                         const QVector<PatchSignature> &sigs,
+                                         QByteArray &patchedOut,
+                                         QString &errorOut,
+                                         bool partial = false);
+
+    // Same, with the blocks already scanned and decoded (empty payload =
+    // block skipped). `payloads` is parallel to `blocks`.
+    static QVector<PortResult> portDecoded(const QByteArray &image,
+                                           const QVector<FvhBlock> &blocks,
+                                           const QVector<QByteArray> &payloads,
+                                           const QVector<PatchSignature> &sigs,
+                                           QByteArray &patchedOut,
+                                           QString &errorOut,
+                                           bool partial = false);
+
+    static QString statusName(PortStatus status);
+
+    // Bit mask that hides PC-relative / page-offset immediates of one ARM64
+    // instruction. `prev` is the preceding instruction word (for ADRP pairs).
+    static quint32 arm64RelocMask(quint32 insn, quint32 prev);
+};
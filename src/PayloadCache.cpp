@@ -0,0 +1,213 @@
+#include "PayloadCache.h"
+#include "Log.h"
+#include "Trace.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QSet>
+
+PayloadCache::PayloadCache(qint64 budgetBytes)
+    : m_budget(budgetBytes), m_spillDir(QDir::tempPath() + "/abltool-XXXXXX") {}
+
+PayloadCache::~PayloadCache() = default;   // QTemporaryDir removes the spill files
+
+void PayloadCache::setBudget(qint64 bytes) {
+    m_budget = bytes;
+    trim();
+}
+
+qint64 PayloadCache::bytes(const Entry &e) {
+    if (!e.spillPath.isEmpty()) return 0;
+    const Payload &p = e.payload;
+    const bool shared = p.current.constData() == p.original.constData();
+    return p.original.size() + (shared ? 0 : p.current.size());
+}
+
+qint64 PayloadCache::memoryBytes() const {
+    qint64 total = 0;
+    for (const Entry &e : m_entries) total += bytes(e);
+    return total;
+}
+
+int PayloadCache::spilledCount() const {
+    int n = 0;
+    for (const Entry &e : m_entries) n += !e.spillPath.isEmpty();
+    return n;
+}
+
+int PayloadCache::dirtyCount(const FvTree *tree) const {
+    int n = 0;
+    for (const Entry &e : m_entries)
+        if (e.tree.data() == tree && (!e.spillPath.isEmpty() || e.payload.isDirty())) ++n;
+    return n;
+}
+
+static FvNode *rootOf(FvNode *node) {
+    while (node->parent) node = node->parent;
+    return node;
+}
+
+int PayloadCache::dirtyCountOutside(const FvTree *tree, const QVector<FvNode*> &roots) const {
+    int n = 0;
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        const Entry &e = it.value();
+        if (e.tree.data() == tree && (!e.spillPath.isEmpty() || e.payload.isDirty())
+            && !roots.contains(rootOf(it.key())))
+            ++n;
+    }
+    return n;
+}
+
+// ── Store / fetch ─────────────────────────────────────────────────
+
+void PayloadCache::store(const QSharedPointer<FvTree> &tree, FvNode *node, const Payload &payload) {
+    Entry &e = m_entries[node];
+    removeSpill(e);
+    e.tree    = tree;
+    e.payload = payload;
+    e.lastUse = ++m_useCounter;
+    trim();
+}
+
+bool PayloadCache::fetch(FvNode *node, Payload &out, QString &errorOut) {
+    auto it = m_entries.find(node);
+    if (it == m_entries.end()) return false;
+    Entry &e = it.value();
+
+    if (!e.spillPath.isEmpty()) {
+        ABL_TRACE_SPAN("payload_unspill");
+        if (!readSpill(e.spillPath, e.payload, errorOut)) return false;
+        removeSpill(e);
+    }
+    e.lastUse = ++m_useCounter;
+    out = e.payload;
+
+    // Reading it back may push something else out; never this one
+    FvNode *active = m_active;
+    m_active = node;
+    trim();
+    m_active = active;
+    return true;
+}
+
+bool PayloadCache::readSpill(const QString &path, Payload &out, QString &errorOut) {
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        errorOut = "Cannot read spilled payload " + path;
+        return false;
+    }
+    QDataStream in(&f);
+    in >> out.original >> out.current >> out.cursor >> out.top;
+    if (in.status() != QDataStream::Ok) {
+        errorOut = "Spilled payload " + path + " is damaged";
+        return false;
+    }
+    return true;
+}
+
+bool PayloadCache::dirtyEdits(const FvTree *tree, QVector<FvTree::Edit> &out, QString &errorOut) const {
+    for (auto it = m_entries.constBegin(); it != m_entries.constEnd(); ++it) {
+        const Entry &e = it.value();
+        if (e.tree.data() != tree) continue;
+        if (e.spillPath.isEmpty()) {
+            if (e.payload.isDirty()) out.append({ it.key(), e.payload.current });
+            continue;
+        }
+        Payload p;
+        if (!readSpill(e.spillPath, p, errorOut)) return false;
+        if (p.isDirty()) out.append({ it.key(), p.current });
+    }
+    return true;
+}
+
+void PayloadCache::dropTree(const FvTree *tree) {
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it.value().tree.data() == tree) {
+            removeSpill(it.value());
+            if (it.key() == m_active) m_active = nullptr;
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+}
+
+void PayloadCache::rebase(const FvTree *from, const QSharedPointer<FvTree> &to, const QVector<FvNode*> &roots) {
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        Entry &e = it.value();
+        if (e.tree.data() != from) {
+            ++it;
+            continue;
+        }
+        if (roots.contains(rootOf(it.key()))) {
+            e.tree = to;
+            ++it;
+            continue;
+        }
+        removeSpill(e);
+        if (it.key() == m_active) m_active = nullptr;
+        it = m_entries.erase(it);
+    }
+}
+
+// ── Eviction ──────────────────────────────────────────────────────
+
+void PayloadCache::trim() {
+    qint64 total = memoryBytes();
+    QSet<FvNode*> unspillable;   // dirty ones that failed to spill this pass
+    while (total > m_budget) {
+        auto victim = m_entries.end();
+        for (auto it = m_entries.begin(); it != m_entries.end(); ++it) {
+            if (it.key() == m_active || !it.value().spillPath.isEmpty() || unspillable.contains(it.key()))
+                continue;
+            if (victim == m_entries.end() || it.value().lastUse < victim.value().lastUse)
+                victim = it;
+        }
+        if (victim == m_entries.end()) return;   // only the active and pinned ones are left in memory
+
+        Entry &e = victim.value();
+        const qint64 size = bytes(e);
+        if (e.payload.isDirty()) {
+            if (!spill(victim.key(), e)) {
+                // Keep it rather than lose edits, and evict the next one instead
+                unspillable.insert(victim.key());
+                Log::write(Log::Warning, "Cannot write an edited payload to the spill directory; "
+                                         "keeping it in memory over the cache budget.");
+                continue;
+            }
+            ABL_TRACE_COUNT("abl_payload_spills_total", "Dirty payloads written to disk to stay in budget.", 1);
+        } else {
+            e.tree->releaseContent(victim.key());
+            m_entries.erase(victim);
+            ABL_TRACE_COUNT("abl_payload_evictions_total", "Clean payloads dropped to stay in budget.", 1);
+        }
+        total -= size;
+    }
+}
+
+bool PayloadCache::spill(FvNode *node, Entry &e) {
+    if (!m_spillDir.isValid()) return false;
+    ABL_TRACE_SPAN("payload_spill");
+    const QString path = m_spillDir.filePath(QString("payload-%1.bin").arg(++m_spillSeq));
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly)) return false;
+    QDataStream out(&f);
+    out << e.payload.original << e.payload.current << e.payload.cursor << e.payload.top;
+    if (out.status() != QDataStream::Ok || !f.flush()) {
+        f.close();
+        QFile::remove(path);
+        return false;
+    }
+    e.spillPath = path;
+    e.payload.original.clear();
+    e.payload.current.clear();
+    e.tree->releaseContent(node);
+    return true;
+}
+
+void PayloadCache::removeSpill(Entry &e) {
+    if (e.spillPath.isEmpty()) return;
+    QFile::remove(e.spillPath);
+    e.spillPath.clear();
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include <QByteArray>
+#include <QHash>
+#include <QSharedPointer>
+#include <QString>
+#include <QTemporaryDir>
+#include "FvTree.h"
+
+// Decoded payloads of every node the user has opened, across all open
+// images, together with their unsaved edits and view position. The total
+// stays within one memory budget: the least recently used clean payloads
+// are dropped (the tree forgets its copy too, so the memory is really
+// freed), dirty ones are spilled to a temporary directory and read back
+// when reopened. The active payload is never evicted. GUI thread only.
+class PayloadCache {
+public:
+    struct Payload {
+        QByteArray original;    // as decoded
+        QByteArray current;     // with edits; shares original's storage until edited
+        qint64     cursor = 0;
+        qint64     top    = 0;
+
+        bool isDirty() const {
+            return current.constData() != original.constData() && current != original;
+        }
+    };
+
+    explicit PayloadCache(qint64 budgetBytes);
+    ~PayloadCache();
+
+    void   setBudget(qint64 bytes);
+    qint64 budget() const { return m_budget; }
+
+    // Remember `payload` for `node` of `tree`, replacing what was stored,
+    // then evict others until the budget holds
+    void store(const QSharedPointer<FvTree> &tree, FvNode *node, const Payload &payload);
+
+    // Stored payload of `node`, read back from disk if it was spilled.
+    // False if it was never stored or has been dropped; errorOut is set only
+    // when a spilled payload could not be read.
+    bool fetch(FvNode *node, Payload &out, QString &errorOut);
+
+    // The node shown in the editor; exempt from eviction (nullptr = none)
+    void setActive(FvNode *node) { m_active = node; }
+
+    // Forget every payload of `tree` (its image was closed)
+    void dropTree(const FvTree *tree);
+
+    // Payloads of `from` below one of `roots` (moved with FvTree::adoptRoot)
+    // now belong to `to`; the others are forgotten
+    void rebase(const FvTree *from, const QSharedPointer<FvTree> &to, const QVector<FvNode*> &roots);
+
+    // Current bytes of every edited payload of `tree`, spilled ones read
+    // from disk (they stay spilled). False with errorOut if one can't be read.
+    bool   dirtyEdits(const FvTree *tree, QVector<FvTree::Edit> &out, QString &errorOut) const;
+
+    int    dirtyCount(const FvTree *tree) const;
+    int    dirtyCountOutside(const FvTree *tree, const QVector<FvNode*> &roots) const;
+    qint64 memoryBytes() const;
+    int    spilledCount() const;
+
+private:
+    struct Entry {
+        QSharedPointer<FvTree> tree;
+        Payload payload;
+        QString spillPath;      // non-empty while the payload lives on disk
+        quint64 lastUse = 0;
+    };
+
+    static qint64 bytes(const Entry &e);
+    static bool readSpill(const QString &path, Payload &out, QString &errorOut);
+    void trim();
+    bool spill(FvNode *node, Entry &e);
+    void removeSpill(Entry &e);
+
+    qint64 m_budget;
+    QHash<FvNode*, Entry> m_entries;
+    FvNode       *m_active  = nullptr;
+    quint64       m_useCounter = 0;
+    int           m_spillSeq = 0;
+    QTemporaryDir m_spillDir;
+};
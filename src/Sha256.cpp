@@ -0,0 +1,138 @@
+#include "Sha256.h"
+
+#include <cstring>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define ABL_SHA_NI 1
+#include <cpuid.h>
+#include <immintrin.h>
+#endif
+
+static const quint32 K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+using CompressFn = void (*)(quint32 state[8], const uchar *data, qint64 blocks);
+
+// ── Portable ──────────────────────────────────────────────────────
+
+static inline quint32 rotr(quint32 x, int n) { return (x >> n) | (x << (32 - n)); }
+
+static void compressPortable(quint32 state[8], const uchar *data, qint64 blocks) {
+    for (; blocks > 0; --blocks, data += 64) {
+        quint32 w[64];
+        for (int i = 0; i < 16; ++i)
+            w[i] = quint32(data[4 * i]) << 24 | quint32(data[4 * i + 1]) << 16
+                 | quint32(data[4 * i + 2]) << 8 | data[4 * i + 3];
+        for (int i = 16; i < 64; ++i) {
+            const quint32 s0 = rotr(w[i - 15], 7) ^ rotr(w[i - 15], 18) ^ (w[i - 15] >> 3);
+            const quint32 s1 = rotr(w[i - 2], 17) ^ rotr(w[i - 2], 19) ^ (w[i - 2] >> 10);
+            w[i] = w[i - 16] + s0 + w[i - 7] + s1;
+        }
+        quint32 a = state[0], b = state[1], c = state[2], d = state[3];
+        quint32 e = state[4], f = state[5], g = state[6], h = state[7];
+        for (int i = 0; i < 64; ++i) {
+            const quint32 t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[i] + w[i];
+            const quint32 t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+// ── SHA-NI ────────────────────────────────────────────────────────
+
+#ifdef ABL_SHA_NI
+// Four rounds per step; the state is kept as ABEF/CDGH as the instructions want
+__attribute__((target("sha,sse4.1")))
+static void compressShaNi(quint32 state[8], const uchar *data, qint64 blocks) {
+    const __m128i byteSwap = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+    __m128i tmp    = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state)), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(state + 4)), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (; blocks > 0; --blocks, data += 64) {
+        const __m128i abef = state0, cdgh = state1;
+        __m128i w[4];
+        for (int g = 0; g < 16; ++g) {
+            __m128i m;
+            if (g < 4) {
+                m = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(data + 16 * g)), byteSwap);
+            } else {
+                m = _mm_sha256msg1_epu32(w[g & 3], w[(g - 3) & 3]);
+                m = _mm_add_epi32(m, _mm_alignr_epi8(w[(g - 1) & 3], w[(g - 2) & 3], 4));
+                m = _mm_sha256msg2_epu32(m, w[(g - 1) & 3]);
+            }
+            w[g & 3] = m;
+            m = _mm_add_epi32(m, _mm_loadu_si128(reinterpret_cast<const __m128i *>(K + 4 * g)));
+            state1 = _mm_sha256rnds2_epu32(state1, state0, m);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, _mm_shuffle_epi32(m, 0x0E));
+        }
+        state0 = _mm_add_epi32(state0, abef);
+        state1 = _mm_add_epi32(state1, cdgh);
+    }
+
+    tmp    = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state), _mm_blend_epi16(tmp, state1, 0xF0));
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(state + 4), _mm_alignr_epi8(state1, tmp, 8));
+}
+
+static bool cpuHasShaNi() {
+    unsigned a, b, c, d;
+    if (!__get_cpuid(1, &a, &b, &c, &d) || !(c & bit_SSSE3) || !(c & bit_SSE4_1)) return false;
+    return __get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & (1u << 29));
+}
+#endif
+
+static CompressFn compressFn() {
+#ifdef ABL_SHA_NI
+    static const CompressFn fn = cpuHasShaNi() ? compressShaNi : compressPortable;
+    return fn;
+#else
+    return compressPortable;
+#endif
+}
+
+// ── Public ────────────────────────────────────────────────────────
+
+QByteArray Sha256::hash(const char *data, qint64 size) {
+    quint32 state[8] = { 0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+                         0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19 };
+    const CompressFn compress = compressFn();
+    const auto *p = reinterpret_cast<const uchar *>(data);
+    const qint64 whole = size / 64;
+    compress(state, p, whole);
+
+    // Tail, the 0x80 marker and the bit length: one or two more blocks
+    uchar tail[128] = {};
+    const qint64 rest = size - whole * 64;
+    std::memcpy(tail, p + whole * 64, size_t(rest));
+    tail[rest] = 0x80;
+    const qint64 tailBlocks = rest < 56 ? 1 : 2;
+    const quint64 bits = quint64(size) * 8;
+    for (int i = 0; i < 8; ++i) tail[tailBlocks * 64 - 1 - i] = uchar(bits >> (8 * i));
+    compress(state, tail, tailBlocks);
+
+    QByteArray digest(DigestSize, Qt::Uninitialized);
+    for (int i = 0; i < 8; ++i)
+        for (int j = 0; j < 4; ++j) digest[4 * i + j] = char(state[i] >> (24 - 8 * j));
+    return digest;
+}
+
+QString Sha256::backend() {
+#ifdef ABL_SHA_NI
+    if (compressFn() == compressShaNi) return "SHA-NI";
+#endif
+    return "portable";
+}
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+// One-shot SHA-256. Uses the x86 SHA extensions (SHA-NI) when the CPU has
+// them, portable code otherwise; the choice is made once per process.
+class Sha256 {
+public:
+    static constexpr int DigestSize = 32;
+
+    static QByteArray hash(const char *data, qint64 size);
+    static QByteArray hash(const QByteArray &data) { return hash(data.constData(), data.size()); }
+
+    static QString backend();   // "SHA-NI" or "portable"
+};
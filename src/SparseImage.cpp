@@ -0,0 +1,256 @@
+#include "SparseImage.h"
+#include "Trace.h"
+
+#include <QFile>
+#include <QSaveFile>
+#include <algorithm>
+#include <cstring>
+
+static constexpr quint32 SPARSE_MAGIC    = 0xED26FF3A;
+static constexpr quint16 CHUNK_RAW       = 0xCAC1;
+static constexpr quint16 CHUNK_FILL      = 0xCAC2;
+static constexpr quint16 CHUNK_DONT_CARE = 0xCAC3;
+static constexpr quint16 CHUNK_CRC32     = 0xCAC4;
+static constexpr int     FILE_HDR_SIZE   = 28;
+static constexpr int     CHUNK_HDR_SIZE  = 12;
+
+// RAW data is copied through a buffer of this size when writing
+static constexpr qint64 COPY_PIECE = 4 * 1024 * 1024;
+
+// A chunk's total size is a 32-bit field
+static constexpr qint64 MAX_RAW_CHUNK = 0xFFFFFFFFLL - CHUNK_HDR_SIZE;
+
+static quint16 rd16(const char *p) { quint16 v; std::memcpy(&v, p, 2); return v; }
+static quint32 rd32(const char *p) { quint32 v; std::memcpy(&v, p, 4); return v; }
+static void    wr16(char *p, quint16 v) { std::memcpy(p, &v, 2); }
+static void    wr32(char *p, quint32 v) { std::memcpy(p, &v, 4); }
+
+bool SparseImage::isSparse(const QString &path) {
+    QFile f(path);
+    char magic[4];
+    return f.open(QIODevice::ReadOnly) && f.read(magic, 4) == 4 && rd32(magic) == SPARSE_MAGIC;
+}
+
+bool SparseImage::open(const QString &path, QString &errorOut) {
+    ABL_TRACE_SPAN("sparse_open");
+    m_path = path;
+    m_chunks.clear();
+    m_hasCrc = false;
+
+    QFile f(path);
+    if (!f.open(QIODevice::ReadOnly)) {
+        errorOut = "Cannot open " + path;
+        return false;
+    }
+    char hdr[FILE_HDR_SIZE];
+    if (f.read(hdr, FILE_HDR_SIZE) != FILE_HDR_SIZE || rd32(hdr) != SPARSE_MAGIC) {
+        errorOut = path + " is not an Android sparse image.";
+        return false;
+    }
+    const quint16 major     = rd16(hdr + 4);
+    const quint16 fileHdr   = rd16(hdr + 8);
+    const quint16 chunkHdr  = rd16(hdr + 10);
+    m_blockSize             = rd32(hdr + 12);
+    const quint32 totalBlks = rd32(hdr + 16);
+    const quint32 count     = rd32(hdr + 20);
+    if (major != 1 || fileHdr < FILE_HDR_SIZE || chunkHdr < CHUNK_HDR_SIZE
+        || m_blockSize == 0 || m_blockSize % 4) {
+        errorOut = QString("Unsupported sparse header (version %1, block size %2).").arg(major).arg(m_blockSize);
+        return false;
+    }
+    m_size = qint64(totalBlks) * m_blockSize;
+
+    const qint64 fileSize = f.size();
+    qint64 at = fileHdr, start = 0;
+    for (quint32 i = 0; i < count; ++i) {
+        char ch[CHUNK_HDR_SIZE];
+        if (!f.seek(at) || f.read(ch, CHUNK_HDR_SIZE) != CHUNK_HDR_SIZE) {
+            errorOut = QString("Sparse chunk %1 of %2 is cut off.").arg(i).arg(count);
+            return false;
+        }
+        Chunk c;
+        c.type       = rd16(ch);
+        c.start      = start;
+        c.length     = qint64(rd32(ch + 4)) * m_blockSize;
+        c.fileOffset = at + chunkHdr;
+        c.fill       = 0;
+        const qint64 total = rd32(ch + 8);
+        const qint64 data  = total - chunkHdr;
+
+        bool ok = data >= 0;
+        switch (c.type) {
+        case CHUNK_RAW:       ok = ok && data == c.length; break;
+        case CHUNK_DONT_CARE: ok = ok && data == 0;        break;
+        case CHUNK_FILL:
+        case CHUNK_CRC32: {
+            char v[4];
+            ok = ok && data == 4 && f.seek(c.fileOffset) && f.read(v, 4) == 4;
+            c.fill = ok ? rd32(v) : 0;
+            break;
+        }
+        default:
+            errorOut = QString("Sparse chunk %1 has unknown type 0x%2.").arg(i).arg(c.type, 0, 16);
+            return false;
+        }
+        if (!ok || at + total > fileSize || start + c.length > m_size) {
+            errorOut = QString("Sparse chunk %1 at 0x%2 is malformed.").arg(i).arg(at, 0, 16);
+            return false;
+        }
+        at += total;
+        if (c.type == CHUNK_CRC32) {
+            m_hasCrc = true;
+            continue;
+        }
+        if (c.length > 0) m_chunks.append(c);
+        start += c.length;
+    }
+    if (start < m_size)   // short chunk list: the rest reads as unset
+        m_chunks.append({ CHUNK_DONT_CARE, start, m_size - start, 0, 0 });
+    return true;
+}
+
+qint64 SparseImage::storedBytes() const {
+    qint64 n = 0;
+    for (const Chunk &c : m_chunks)
+        if (c.type == CHUNK_RAW) n += c.length;
+    return n;
+}
+
+int SparseImage::chunkAt(qint64 offset) const {
+    auto it = std::upper_bound(m_chunks.constBegin(), m_chunks.constEnd(), offset,
+                               [](qint64 off, const Chunk &c) { return off < c.start; });
+    return int(it - m_chunks.constBegin()) - 1;
+}
+
+// ── Reading ───────────────────────────────────────────────────────
+
+bool SparseImage::read(qint64 offset, qint64 length, char *out) const {
+    if (offset < 0 || length < 0 || offset + length > m_size) return false;
+    QFile f(m_path);   // opened on the first RAW chunk only
+    for (int i = chunkAt(offset); length > 0; ++i) {
+        const Chunk &c = m_chunks[i];
+        const qint64 inChunk = offset - c.start;
+        const qint64 n = qMin(length, c.length - inChunk);
+        if (c.type == CHUNK_RAW) {
+            if (!f.isOpen() && !f.open(QIODevice::ReadOnly)) return false;
+            if (!f.seek(c.fileOffset + inChunk) || f.read(out, n) != n) return false;
+        } else if (c.type == CHUNK_FILL) {
+            char pattern[4];
+            wr32(pattern, c.fill);
+            for (qint64 k = 0; k < n; ++k) out[k] = pattern[(inChunk + k) & 3];
+        } else {
+            std::memset(out, 0, size_t(n));
+        }
+        out += n;
+        offset += n;
+        length -= n;
+    }
+    return true;
+}
+
+QByteArray SparseImage::read(qint64 offset, qint64 length, QString &errorOut) const {
+    QByteArray out(length, Qt::Uninitialized);
+    if (!read(offset, length, out.data())) {
+        errorOut = QString("Cannot read %1 bytes at 0x%2 of sparse image %3").arg(length).arg(offset, 0, 16).arg(m_path);
+        return {};
+    }
+    return out;
+}
+
+// ── Writing ───────────────────────────────────────────────────────
+
+bool SparseImage::writePatched(const QString &outPath, qint64 offset, const QByteArray &bytes,
+                               QString &errorOut) const
+{
+    ABL_TRACE_SPAN("sparse_write");
+    const qint64 pEnd = offset + bytes.size();
+    if (offset < 0 || pEnd > m_size) {
+        errorOut = QString("0x%1+%2 lies outside the sparse image").arg(offset, 0, 16).arg(bytes.size());
+        return false;
+    }
+    // Overlay the patch on expanded bytes [at, at+n) held in `buf`
+    auto patch = [&](qint64 at, qint64 n, char *buf) {
+        const qint64 s = qMax(at, offset), e = qMin(at + n, pEnd);
+        if (s < e) std::memcpy(buf + (s - at), bytes.constData() + (s - offset), size_t(e - s));
+    };
+
+    // Output chunks. Only chunks the patch touches are rebuilt; RAW ones
+    // keep their extent, FILL/DONT_CARE are split around changed blocks.
+    struct Seg { quint16 type; qint64 start, length; quint32 fill; };
+    QVector<Seg> segs;
+    const qint64 blk = m_blockSize;
+    QByteArray was(blk, Qt::Uninitialized), now(blk, Qt::Uninitialized);
+    for (const Chunk &c : m_chunks) {
+        const qint64 cEnd = c.start + c.length;
+        if (c.type == CHUNK_RAW || cEnd <= offset || c.start >= pEnd) {
+            segs.append({ c.type, c.start, c.length, c.fill });
+            continue;
+        }
+        for (qint64 b = c.start; b < cEnd; b += blk) {
+            quint16 type = c.type;
+            if (b < pEnd && b + blk > offset) {
+                if (!read(b, blk, was.data())) {
+                    errorOut = QString("Cannot read sparse image %1").arg(m_path);
+                    return false;
+                }
+                std::memcpy(now.data(), was.constData(), size_t(blk));
+                patch(b, blk, now.data());
+                if (now != was) type = CHUNK_RAW;
+            }
+            const bool joins = !segs.isEmpty() && segs.last().type == type
+                && segs.last().start + segs.last().length == b
+                && (type == CHUNK_RAW ? segs.last().length + blk <= MAX_RAW_CHUNK : segs.last().fill == c.fill);
+            if (joins)
+                segs.last().length += blk;
+            else
+                segs.append({ type, b, blk, c.fill });
+        }
+    }
+
+    QSaveFile out(outPath);
+    if (!out.open(QIODevice::WriteOnly)) {
+        errorOut = "Cannot write to " + outPath;
+        return false;
+    }
+    char hdr[FILE_HDR_SIZE] = {};
+    wr32(hdr, SPARSE_MAGIC);
+    wr16(hdr + 4, 1);
+    wr16(hdr + 6, 0);
+    wr16(hdr + 8, FILE_HDR_SIZE);
+    wr16(hdr + 10, CHUNK_HDR_SIZE);
+    wr32(hdr + 12, m_blockSize);
+    wr32(hdr + 16, quint32(m_size / blk));
+    wr32(hdr + 20, quint32(segs.size()));
+    out.write(hdr, FILE_HDR_SIZE);
+
+    QByteArray piece;
+    for (const Seg &s : segs) {
+        const qint64 data = s.type == CHUNK_RAW ? s.length : s.type == CHUNK_FILL ? 4 : 0;
+        char ch[CHUNK_HDR_SIZE] = {};
+        wr16(ch, s.type);
+        wr32(ch + 4, quint32(s.length / blk));
+        wr32(ch + 8, quint32(CHUNK_HDR_SIZE + data));
+        out.write(ch, CHUNK_HDR_SIZE);
+        if (s.type == CHUNK_FILL) {
+            char v[4];
+            wr32(v, s.fill);
+            out.write(v, 4);
+        } else if (s.type == CHUNK_RAW) {
+            for (qint64 at = s.start; at < s.start + s.length; at += COPY_PIECE) {
+                const qint64 n = qMin(COPY_PIECE, s.start + s.length - at);
+                piece.resize(n);
+                if (!read(at, n, piece.data())) {
+                    errorOut = QString("Cannot read sparse image %1").arg(m_path);
+                    return false;
+                }
+                patch(at, n, piece.data());
+                out.write(piece);
+            }
+        }
+    }
+    if (!out.commit()) {
+        errorOut = QString("Write to %1 failed: %2").arg(outPath, out.errorString());
+        return false;
+    }
+    return true;
+}
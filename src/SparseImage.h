@@ -0,0 +1,52 @@
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+#include <QVector>
+
+// Android sparse image (the format fastboot and vendor packages use) read
+// in place: the expanded partition is addressed linearly, RAW chunks are
+// read from the file on demand, FILL and DONT_CARE chunks are synthesized
+// and never stored.
+class SparseImage {
+public:
+    static bool isSparse(const QString &path);
+
+    bool open(const QString &path, QString &errorOut);
+
+    const QString &path() const { return m_path; }
+    qint64  size() const       { return m_size; }        // expanded
+    quint32 blockSize() const  { return m_blockSize; }
+    int     chunkCount() const { return m_chunks.size(); }
+    qint64  storedBytes() const;                         // RAW data actually in the file
+    bool    hasCrc() const     { return m_hasCrc; }      // carries CRC32 chunks
+
+    // Expanded bytes [offset, offset+length) into `out`. Uses its own file
+    // handle, so several threads may read at once.
+    bool read(qint64 offset, qint64 length, char *out) const;
+    QByteArray read(qint64 offset, qint64 length, QString &errorOut) const;
+
+    // Write this image to `outPath` with expanded bytes [offset, +bytes.size())
+    // replaced. Chunks outside the range are copied as they are; blocks of a
+    // FILL or DONT_CARE chunk that really change become RAW chunks of their
+    // own. CRC32 chunks are dropped, as their sums would no longer hold.
+    // `outPath` may be this image's own path; open() it again afterwards.
+    bool writePatched(const QString &outPath, qint64 offset, const QByteArray &bytes,
+                      QString &errorOut) const;
+
+private:
+    struct Chunk {
+        quint16 type;
+        qint64  start;        // expanded offset
+        qint64  length;       // expanded bytes
+        qint64  fileOffset;   // RAW data in the file
+        quint32 fill;         // FILL pattern
+    };
+    int chunkAt(qint64 offset) const;
+
+    QString        m_path;
+    quint32        m_blockSize = 0;
+    qint64         m_size      = 0;
+    bool           m_hasCrc    = false;
+    QVector<Chunk> m_chunks;   // by start, CRC32 chunks omitted
+};
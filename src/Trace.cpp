@@ -0,0 +1,216 @@
+#include "Trace.h"
+
+#include <QFile>
+#include <QHash>
+#include <QVector>
+#include <QTextStream>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <unistd.h>
+
+namespace Trace {
+
+static constexpr quint64 RING_CAPACITY = 16384;   // events per thread, power of two
+
+struct Event {
+    const Site *site;
+    quint64     startNs;
+    quint64     durNs;
+};
+
+struct ThreadRing {
+    quint64              tid;
+    std::atomic<quint64> head{0};   // total events written; slot = head % capacity
+    Event                events[RING_CAPACITY];
+};
+
+struct Registry {
+    std::mutex                               lock;
+    std::vector<std::shared_ptr<ThreadRing>> rings;
+    std::vector<std::shared_ptr<ThreadRing>> idle;   // rings of exited threads, reused first
+    std::vector<Site*>                       sites;
+    std::vector<Counter*>                    counters;
+    quint64                                  nextTid = 1;
+};
+
+static Registry &registry() {
+    static Registry *r = new Registry;   // never destroyed: rings outlive exiting threads
+    return *r;
+}
+
+// A thread's ring, handed back to the registry when the thread exits and
+// taken over by the next new one. Short-lived threads (a verifier per
+// repack, expiring pool threads) thus reuse rings instead of each leaving
+// one behind: there are never more rings than threads traced at once. The
+// events stay exported; a reused ring keeps its tid and carries on after
+// the previous thread's last event.
+struct RingLease {
+    std::shared_ptr<ThreadRing> ring;
+
+    RingLease() {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> g(reg.lock);
+        if (!reg.idle.empty()) {
+            ring = std::move(reg.idle.back());
+            reg.idle.pop_back();
+            return;
+        }
+        ring = std::make_shared<ThreadRing>();
+        ring->tid = reg.nextTid++;
+        reg.rings.push_back(ring);
+    }
+
+    ~RingLease() {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> g(reg.lock);
+        reg.idle.push_back(std::move(ring));
+    }
+};
+
+static ThreadRing &threadRing() {
+    thread_local RingLease lease;
+    return *lease.ring;
+}
+
+Site::Site(const char *n) : name(n) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> g(reg.lock);
+    reg.sites.push_back(this);
+}
+
+Counter::Counter(const char *n, const char *h) : name(n), help(h) {
+    Registry &reg = registry();
+    std::lock_guard<std::mutex> g(reg.lock);
+    reg.counters.push_back(this);
+}
+
+quint64 nowNs() {
+    using namespace std::chrono;
+    return duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+void record(Site &site, quint64 startNs, quint64 endNs) {
+    const quint64 dur = endNs - startNs;
+    site.calls.fetch_add(1, std::memory_order_relaxed);
+    site.totalNs.fetch_add(dur, std::memory_order_relaxed);
+    quint64 prevMax = site.maxNs.load(std::memory_order_relaxed);
+    while (dur > prevMax
+           && !site.maxNs.compare_exchange_weak(prevMax, dur, std::memory_order_relaxed)) {}
+
+    ThreadRing &ring = threadRing();
+    const quint64 h = ring.head.load(std::memory_order_relaxed);
+    ring.events[h & (RING_CAPACITY - 1)] = { &site, startNs, dur };
+    ring.head.store(h + 1, std::memory_order_release);
+}
+
+static QString jsonEscape(const char *s) {
+    QString out;
+    for (const char *p = s; *p; ++p) {
+        if (*p == '"' || *p == '\\') out += '\\';
+        out += QChar(*p);
+    }
+    return out;
+}
+
+bool exportChromeJson(const QString &path, QString &errorOut) {
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errorOut = QString("Cannot write trace to %1: %2").arg(path, f.errorString());
+        return false;
+    }
+
+    Registry &reg = registry();
+    std::vector<std::shared_ptr<ThreadRing>> rings;
+    {
+        std::lock_guard<std::mutex> g(reg.lock);
+        rings = reg.rings;
+    }
+
+    const qint64 pid = getpid();
+    QTextStream out(&f);
+    out << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    for (const auto &ring : rings) {
+        out << (first ? "" : ",")
+            << QString("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%1,\"tid\":%2,"
+                       "\"args\":{\"name\":\"thread %2\"}}").arg(pid).arg(ring->tid);
+        first = false;
+
+        const quint64 head  = ring->head.load(std::memory_order_acquire);
+        const quint64 count = qMin(head, RING_CAPACITY);
+        for (quint64 i = head - count; i < head; ++i) {
+            const Event &e = ring->events[i & (RING_CAPACITY - 1)];
+            out << QString(",{\"name\":\"%1\",\"cat\":\"abl\",\"ph\":\"X\","
+                           "\"ts\":%2,\"dur\":%3,\"pid\":%4,\"tid\":%5}")
+                   .arg(jsonEscape(e.site->name))
+                   .arg(e.startNs / 1000.0, 0, 'f', 3)
+                   .arg(e.durNs / 1000.0, 0, 'f', 3)
+                   .arg(pid).arg(ring->tid);
+        }
+    }
+    out << "]}\n";
+    out.flush();
+    return true;
+}
+
+bool exportPrometheus(const QString &path, QString &errorOut) {
+    QFile f(path);
+    if (!f.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+        errorOut = QString("Cannot write metrics to %1: %2").arg(path, f.errorString());
+        return false;
+    }
+
+    struct SpanTotals { quint64 calls = 0, totalNs = 0, maxNs = 0; };
+    struct CounterTotals { QString help; quint64 value = 0; };
+    QVector<QString> spanOrder, counterOrder;
+    QHash<QString, SpanTotals> spans;
+    QHash<QString, CounterTotals> counters;
+    {
+        Registry &reg = registry();
+        std::lock_guard<std::mutex> g(reg.lock);
+        for (const Site *s : reg.sites) {
+            const QString name = QString::fromUtf8(s->name);
+            if (!spans.contains(name)) spanOrder.append(name);
+            SpanTotals &t = spans[name];
+            t.calls   += s->calls.load(std::memory_order_relaxed);
+            t.totalNs += s->totalNs.load(std::memory_order_relaxed);
+            t.maxNs    = qMax(t.maxNs, s->maxNs.load(std::memory_order_relaxed));
+        }
+        for (const Counter *c : reg.counters) {
+            const QString name = QString::fromUtf8(c->name);
+            if (!counters.contains(name)) counterOrder.append(name);
+            CounterTotals &t = counters[name];
+            t.help   = QString::fromUtf8(c->help);
+            t.value += c->value.load(std::memory_order_relaxed);
+        }
+    }
+
+    QTextStream out(&f);
+    out << "# HELP abl_span_duration_seconds Wall time spent in traced spans.\n"
+           "# TYPE abl_span_duration_seconds summary\n";
+    for (const QString &name : spanOrder) {
+        const SpanTotals &t = spans[name];
+        out << QString("abl_span_duration_seconds_sum{span=\"%1\"} %2\n")
+               .arg(name).arg(t.totalNs / 1e9, 0, 'f', 9);
+        out << QString("abl_span_duration_seconds_count{span=\"%1\"} %2\n")
+               .arg(name).arg(t.calls);
+    }
+    out << "# HELP abl_span_duration_seconds_max Longest single span.\n"
+           "# TYPE abl_span_duration_seconds_max gauge\n";
+    for (const QString &name : spanOrder) {
+        out << QString("abl_span_duration_seconds_max{span=\"%1\"} %2\n")
+               .arg(name).arg(spans[name].maxNs / 1e9, 0, 'f', 9);
+    }
+    for (const QString &name : counterOrder) {
+        const CounterTotals &t = counters[name];
+        out << "# HELP " << name << ' ' << t.help << '\n'
+            << "# TYPE " << name << " counter\n"
+            << name << ' ' << t.value << '\n';
+    }
+    out.flush();
+    return true;
+}
+
+} // namespace Trace
@@ -0,0 +1,73 @@
+#pragma once
+
+#include <QString>
+#include <atomic>
+
+// Low-overhead tracing: scoped spans recorded into per-thread ring buffers
+// (passed on to new threads as old ones exit), plus aggregate per-span and
+// named counters. Build with ABL_TRACING=0
+// (cmake -DABL_ENABLE_TRACING=OFF) and the macros compile to nothing.
+//
+//   ABL_TRACE_SPAN("scan");                     // lasts until end of scope
+//   ABL_TRACE_COUNT("abl_fvh_hits_total", "...", 1);
+
+#ifndef ABL_TRACING
+#define ABL_TRACING 1
+#endif
+
+namespace Trace {
+
+// One per ABL_TRACE_SPAN call site, registered on first use
+struct Site {
+    explicit Site(const char *name);
+    const char           *name;
+    std::atomic<quint64>  calls{0};
+    std::atomic<quint64>  totalNs{0};
+    std::atomic<quint64>  maxNs{0};
+};
+
+// One per ABL_TRACE_COUNT call site; sites sharing a name are summed on export
+struct Counter {
+    Counter(const char *name, const char *help);
+    const char           *name;
+    const char           *help;
+    std::atomic<quint64>  value{0};
+};
+
+quint64 nowNs();
+void    record(Site &site, quint64 startNs, quint64 endNs);
+
+class Span {
+public:
+    explicit Span(Site &site) : m_site(site), m_start(nowNs()) {}
+    ~Span() { record(m_site, m_start, nowNs()); }
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+private:
+    Site   &m_site;
+    quint64 m_start;
+};
+
+// Call these while traced work is idle; events being written concurrently
+// may be skipped.
+bool exportChromeJson(const QString &path, QString &errorOut);
+bool exportPrometheus(const QString &path, QString &errorOut);
+
+} // namespace Trace
+
+#if ABL_TRACING
+#define ABL_TRACE_CAT2(a, b) a##b
+#define ABL_TRACE_CAT(a, b)  ABL_TRACE_CAT2(a, b)
+#define ABL_TRACE_SPAN(name)                                              \
+    static Trace::Site ABL_TRACE_CAT(ablTraceSite_, __LINE__)(name);      \
+    Trace::Span ABL_TRACE_CAT(ablTraceSpan_, __LINE__)(ABL_TRACE_CAT(ablTraceSite_, __LINE__))
+#define ABL_TRACE_COUNT(name, help, delta)                                \
+    do {                                                                  \
+        static Trace::Counter ablTraceCounter(name, help);                \
+        ablTraceCounter.value.fetch_add((quint64)(delta),                 \
+                                        std::memory_order_relaxed);       \
+    } while (0)
+#else
+#define ABL_TRACE_SPAN(name)               do {} while (0)
+#define ABL_TRACE_COUNT(name, help, delta) do {} while (0)
+#endif
@@ -0,0 +1,138 @@
+#pragma once
+
+/*
+ * libabl — C API over the ABL Tool core (FV scanning, LZMA decode, repack).
+ *
+ * All functions are thread-safe on distinct images. An image is read-only
+ * after opening, so several threads may decode blocks of the same image
+ * concurrently.
+ *
+ * Memory: functions that take a caller buffer write decoded or repacked
+ * bytes straight into it and never allocate a buffer of that size on
+ * their own. They are not allocation-free, though:
+ *   - opening copies every FV block found (also for borrowed buffers);
+ *   - abl_decode() uses liblzma's dictionary plus a small candidate list,
+ *     and may try candidate decoders on several threads;
+ *   - abl_repack() / abl_repack_batch() start a verifier thread per block
+ *     unless abl_set_verify_repack(0), and liblzma allocates the encoder;
+ *   - failures format their message on the heap.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#  define ABL_API __attribute__((visibility("default")))
+#else
+#  define ABL_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define ABL_API_VERSION 2
+
+typedef struct abl_image abl_image;
+
+typedef enum abl_status {
+    ABL_OK            =  0,
+    ABL_E_INVALID     = -1,   /* bad argument or index */
+    ABL_E_IO          = -2,   /* read / mmap failure */
+    ABL_E_NOMEM       = -3,
+    ABL_E_NO_BLOCKS   = -4,   /* no _FVH blocks in the image */
+    ABL_E_DECODE      = -5,
+    ABL_E_ENCODE      = -6,   /* includes "does not fit the original slot" and
+                                 a new stream that fails to decode back */
+    ABL_E_BUFFER      = -7    /* caller buffer too small */
+} abl_status;
+
+/* abl_open_buffer() flags */
+#define ABL_OPEN_COPY  0x1u   /* copy the buffer instead of borrowing it */
+
+#define ABL_SIZE_UNKNOWN UINT64_MAX
+
+typedef struct abl_block_info {
+    uint32_t struct_size;     /* set to sizeof(abl_block_info) before the call */
+    int32_t  has_lzma;
+    uint64_t fvh_offset;      /* offset of '_FVH' in the image */
+    uint64_t fv_start;
+    uint64_t fv_size;
+    int64_t  lzma_offset;     /* relative to fv_start, -1 if none */
+    uint64_t lzma_size;       /* size of the LZMA slot */
+    uint64_t decoded_size;    /* ABL_SIZE_UNKNOWN if the header doesn't declare it */
+    /* Filled only when struct_size covers them */
+    int32_t  segment;         /* ELF program header index of its PT_LOAD, -1 if not ELF */
+    uint64_t segment_offset;  /* p_offset of that segment */
+    uint64_t segment_size;    /* p_filesz, clipped to the file */
+} abl_block_info;
+
+ABL_API uint32_t    abl_api_version(void);
+ABL_API const char *abl_status_string(int status);
+
+/* Message for the last failed call on the calling thread. */
+ABL_API const char *abl_last_error(void);
+
+/* Borrowed buffers must stay valid until abl_close(). */
+ABL_API int  abl_open_buffer(const void *data, size_t size, uint32_t flags, abl_image **out);
+
+/* The fd is mapped read-only and may be closed after this returns. */
+ABL_API int  abl_open_fd(int fd, abl_image **out);
+ABL_API void abl_close(abl_image *image);
+
+ABL_API size_t abl_image_size(const abl_image *image);
+ABL_API size_t abl_block_count(const abl_image *image);
+ABL_API int    abl_block_info_get(const abl_image *image, size_t index, abl_block_info *out);
+
+/* Decode block `index` into `out`. Size the buffer from decoded_size. */
+ABL_API int abl_decode(const abl_image *image, size_t index,
+                       void *out, size_t capacity, size_t *written);
+
+/*
+ * Compress `patched` with the block's original LZMA parameters and write the
+ * full patched image to `out` (at least abl_image_size() bytes). A SHA-256
+ * hash segment gets the new digest of the touched segment. `out` must not
+ * overlap the image's own bytes (ABL_E_INVALID); one buffer may be reused
+ * across calls. Its contents are undefined on failure.
+ */
+ABL_API int abl_repack(const abl_image *image, size_t index,
+                       const void *patched, size_t patched_size,
+                       void *out, size_t capacity, size_t *written);
+
+typedef struct abl_repack_edit {
+    size_t      index;        /* block index */
+    const void *patched;
+    size_t      patched_size;
+} abl_repack_edit;
+
+/*
+ * abl_repack() for several blocks at once: every slot is checked first, the
+ * blocks are compressed concurrently into `out` and the hash segment is
+ * updated once. If any block fails, none is applied and `out` holds the
+ * original image again; abl_last_error() names the failed block. `out`
+ * must not overlap the image, as for abl_repack().
+ */
+ABL_API int abl_repack_batch(const abl_image *image,
+                             const abl_repack_edit *edits, size_t count,
+                             void *out, size_t capacity, size_t *written);
+
+/*
+ * Threads and threading memory limit for decoding multi-block .xz payloads
+ * (0 = one per core / a quarter of RAM). Process-wide. LZMA1 payloads always
+ * decode on one thread.
+ */
+ABL_API void abl_set_xz_decode_options(uint32_t threads, uint64_t memlimit);
+
+/*
+ * Whether abl_repack() decodes each new stream alongside the encoder and
+ * rejects it unless it reproduces `patched` exactly (default 1). Process-wide.
+ */
+ABL_API void abl_set_verify_repack(int on);
+
+/* Write collected trace spans (Chrome trace JSON) / counters (Prometheus text). */
+ABL_API int abl_trace_export_chrome(const char *path);
+ABL_API int abl_metrics_export_prometheus(const char *path);
+
+#ifdef __cplusplus
+}
+#endif
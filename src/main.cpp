@@ -1,12 +1,52 @@
 #include <QApplication>
 #include "MainWindow.h"
+#include "Trace.h"
+#include "Cli.h"
+#include "FvhParser.h"
+#include "Log.h"
+
+// Optional trace / metrics dump for profiling runs
+static void exportTrace() {
+    QString err;
+    const QString tracePath   = qEnvironmentVariable("ABL_TRACE_JSON");
+    const QString metricsPath = qEnvironmentVariable("ABL_METRICS_PROM");
+    if (!tracePath.isEmpty() && !Trace::exportChromeJson(tracePath, err))
+        qWarning("%s", qPrintable(err));
+    if (!metricsPath.isEmpty() && !Trace::exportPrometheus(metricsPath, err))
+        qWarning("%s", qPrintable(err));
+}
+
+// Decoder tuning from the environment (ABL_XZ_THREADS, ABL_XZ_MEMLIMIT_MB,
+// ABL_VERIFY_REPACK=0)
+static void applyDecoderEnvironment() {
+    XzDecodeOptions xz;
+    xz.threads  = qMax(0, qEnvironmentVariableIntValue("ABL_XZ_THREADS"));
+    xz.memlimit = quint64(qMax(0, qEnvironmentVariableIntValue("ABL_XZ_MEMLIMIT_MB"))) * 1024 * 1024;
+    FvhParser::setXzDecodeOptions(xz);
+    if (qEnvironmentVariableIsSet("ABL_VERIFY_REPACK"))
+        FvhParser::setVerifyRepack(qEnvironmentVariableIntValue("ABL_VERIFY_REPACK") != 0);
+}
 
 int main(int argc, char *argv[]) {
+    applyDecoderEnvironment();
+
+    if (isCliCommand(argc, argv)) {
+        int rc = runCli(argc, argv);
+        exportTrace();
+        return rc;
+    }
+
     QApplication app(argc, argv);
     app.setApplicationName("ABL Tool");
     app.setApplicationVersion("1.0");
     app.setOrganizationName("xendr4x");
 
+    // Log panel output copied to a file as well (ABL_LOG_FILE)
+    const QString logPath = qEnvironmentVariable("ABL_LOG_FILE");
+    QString logError;
+    if (!logPath.isEmpty() && !Log::setTeeFile(logPath, logError))
+        qWarning("%s", qPrintable(logError));
+
     MainWindow w;
     w.show();
 
@@ -17,5 +57,7 @@ int main(int argc, char *argv[]) {
             Q_ARG(QString, QString::fromLocal8Bit(argv[1])));
     }
 
-    return app.exec();
+    int rc = app.exec();
+    exportTrace();
+    return rc;
 }
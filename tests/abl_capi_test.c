@@ -0,0 +1,174 @@
+/*
+ * libabl C API smoke test: builds a one-block image in memory, then opens,
+ * lists, decodes and repacks it, and checks that a failed batch repack
+ * leaves the output buffer holding the original image.
+ */
+
+#include <abl.h>
+#include <lzma.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define PAYLOAD_SIZE (256 * 1024)
+#define SLOT_SLACK   4096
+#define FV_MIN_SIZE  (64 * 1024)   /* the scanner skips smaller volumes */
+
+static int failures = 0;
+
+#define CHECK(cond) do {                                                    \
+    if (!(cond)) {                                                          \
+        fprintf(stderr, "%s:%d: CHECK(%s) failed: %s\n",                    \
+                __FILE__, __LINE__, #cond, abl_last_error());               \
+        ++failures;                                                         \
+    }                                                                       \
+} while (0)
+
+static void put_le64(uint8_t *p, uint64_t v) {
+    for (int i = 0; i < 8; ++i) p[i] = (uint8_t)(v >> (8 * i));
+}
+
+/* Text-like payload that compresses well, so a small patch still fits */
+static uint8_t *make_payload(void) {
+    uint8_t *p = malloc(PAYLOAD_SIZE);
+    if (!p) return NULL;
+    size_t at = 0;
+    for (unsigned line = 0; at < PAYLOAD_SIZE; ++line) {
+        char text[64];
+        int n = snprintf(text, sizeof text, "line %05u: LinuxLoader boot stage\n", line);
+        size_t take = (size_t)n < PAYLOAD_SIZE - at ? (size_t)n : PAYLOAD_SIZE - at;
+        memcpy(p + at, text, take);
+        at += take;
+    }
+    return p;
+}
+
+/*
+ * An FV header (only the fields the scanner reads) followed by an .lzma
+ * stream of `payload` and zero padding up to the end of the volume.
+ */
+static uint8_t *make_image(const uint8_t *payload, size_t size, size_t *image_size) {
+    lzma_options_lzma opt;
+    if (lzma_lzma_preset(&opt, 6)) return NULL;
+    lzma_stream strm = LZMA_STREAM_INIT;
+    if (lzma_alone_encoder(&strm, &opt) != LZMA_OK) return NULL;
+
+    size_t cap = 0x48 + lzma_stream_buffer_bound(size) + SLOT_SLACK;
+    if (cap < FV_MIN_SIZE) cap = FV_MIN_SIZE;
+    uint8_t *image = calloc(1, cap);
+    if (!image) { lzma_end(&strm); return NULL; }
+    strm.next_in   = payload;
+    strm.avail_in  = size;
+    strm.next_out  = image + 0x48;
+    strm.avail_out = cap - 0x48 - SLOT_SLACK;
+    lzma_ret ret;
+    while ((ret = lzma_code(&strm, LZMA_FINISH)) == LZMA_OK) {}
+    const size_t comp = (size_t)strm.total_out;
+    lzma_end(&strm);
+    if (ret != LZMA_STREAM_END) { free(image); return NULL; }
+
+    /* The scanner wants the decoded size in the .lzma header */
+    put_le64(image + 0x48 + 5, size);
+
+    size_t total = 0x48 + comp + SLOT_SLACK;
+    if (total < FV_MIN_SIZE) total = FV_MIN_SIZE;
+    memset(image, 0xFF, 0x48);
+    put_le64(image + 0x20, total);
+    memcpy(image + 0x28, "_FVH", 4);
+    *image_size = total;
+    return image;
+}
+
+static uint64_t rng_state = 0x9E3779B97F4A7C15ULL;
+
+static uint8_t next_byte(void) {
+    rng_state ^= rng_state >> 12;
+    rng_state ^= rng_state << 25;
+    rng_state ^= rng_state >> 27;
+    return (uint8_t)((rng_state * 0x2545F4914F6CDD1DULL) >> 56);
+}
+
+int main(void) {
+    CHECK(abl_api_version() == ABL_API_VERSION);
+
+    uint8_t *payload = make_payload();
+    size_t size = 0;
+    uint8_t *data = payload ? make_image(payload, PAYLOAD_SIZE, &size) : NULL;
+    if (!data) {
+        fprintf(stderr, "could not build the test image\n");
+        return 1;
+    }
+
+    /* Open and list */
+    abl_image *image = NULL;
+    CHECK(abl_open_buffer(data, size, 0, &image) == ABL_OK);
+    if (!image) return 1;
+    CHECK(abl_image_size(image) == size);
+    CHECK(abl_block_count(image) == 1);
+
+    abl_block_info info;
+    memset(&info, 0, sizeof info);
+    info.struct_size = sizeof info;
+    CHECK(abl_block_info_get(image, 0, &info) == ABL_OK);
+    CHECK(info.has_lzma);
+    CHECK(info.fv_start == 0);
+    CHECK(info.lzma_offset == 0x48);
+    CHECK(info.decoded_size == PAYLOAD_SIZE);
+    CHECK(abl_block_info_get(image, 1, &info) == ABL_E_INVALID);
+
+    /* Decode */
+    uint8_t *decoded = malloc(PAYLOAD_SIZE);
+    size_t written = 0;
+    CHECK(abl_decode(image, 0, decoded, PAYLOAD_SIZE, &written) == ABL_OK);
+    CHECK(written == PAYLOAD_SIZE);
+    CHECK(memcmp(decoded, payload, PAYLOAD_SIZE) == 0);
+    CHECK(abl_decode(image, 0, decoded, PAYLOAD_SIZE / 2, &written) == ABL_E_BUFFER);
+
+    /* Repack a small patch and read it back */
+    uint8_t *patched = malloc(PAYLOAD_SIZE);
+    memcpy(patched, payload, PAYLOAD_SIZE);
+    memcpy(patched + 0x1000, "PATCHED", 7);
+
+    uint8_t *out = malloc(size);
+    CHECK(abl_repack(image, 0, patched, PAYLOAD_SIZE, out, size, &written) == ABL_OK);
+    CHECK(written == size);
+
+    abl_image *repacked = NULL;
+    CHECK(abl_open_buffer(out, size, ABL_OPEN_COPY, &repacked) == ABL_OK);
+    if (repacked) {
+        CHECK(abl_decode(repacked, 0, decoded, PAYLOAD_SIZE, &written) == ABL_OK);
+        CHECK(written == PAYLOAD_SIZE);
+        CHECK(memcmp(decoded, patched, PAYLOAD_SIZE) == 0);
+        abl_close(repacked);
+    }
+
+    /* A batch whose edit doesn't fit leaves `out` equal to the input */
+    uint8_t *noise = malloc(PAYLOAD_SIZE);
+    for (size_t i = 0; i < PAYLOAD_SIZE; ++i) noise[i] = next_byte();
+    abl_repack_edit edit = { 0, noise, PAYLOAD_SIZE };
+    memset(out, 0xA5, size);
+    CHECK(abl_repack_batch(image, &edit, 1, out, size, &written) == ABL_E_ENCODE);
+    CHECK(memcmp(out, data, size) == 0);
+
+    /* Writing over the borrowed image itself is refused (last: a regression
+       here would overwrite `data`) */
+    CHECK(abl_repack(image, 0, patched, PAYLOAD_SIZE, data, size, &written) == ABL_E_INVALID);
+    CHECK(abl_repack_batch(image, &edit, 1, data, size, &written) == ABL_E_INVALID);
+
+    abl_close(image);
+    free(noise);
+    free(out);
+    free(patched);
+    free(decoded);
+    free(data);
+    free(payload);
+
+    if (failures) {
+        fprintf(stderr, "%d check(s) failed\n", failures);
+        return 1;
+    }
+    printf("abl_capi_test: ok\n");
+    return 0;
+}